@@ -18,6 +18,12 @@
 
 namespace baikaldb {
 
+// 多列组合值的hash，store构建cmsketch和baikaldb计算distinct、估算选择率时使用同一方式
+// seed从0开始，按索引列顺序依次合并各列值的hash，null值的hash为0
+inline uint64_t multi_column_hash(uint64_t seed, uint64_t hash) {
+    return seed ^ (hash + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
 class CMsketchColumn {
 public:
     CMsketchColumn(int depth, int width, int field_id) :  _depth(depth), _width(width),  _field_id(field_id) {
@@ -161,6 +167,15 @@ public:
 
 struct CMsketch {
 public:
+    // 索引前缀的多列统计
+    struct MultiColumn {
+        int64_t index_id = 0;
+        std::vector<int32_t> field_ids;
+        int64_t distinct_cnt = -1;
+        std::shared_ptr<CMsketchColumn> cmsketch;
+    };
+    typedef std::map<std::pair<int64_t, size_t>, MultiColumn> MultiColumnMap; // (index_id, 前缀长度)
+
     CMsketch(int depth, int width) : _depth(depth), _width(width) {
         bthread_mutex_init(&_mutex, NULL);
     }
@@ -181,6 +196,31 @@ public:
         }
     }
 
+    void set_multi_value(int64_t index_id, const std::vector<int32_t>& field_ids, uint64_t hash) {
+        BAIDU_SCOPED_LOCK(_mutex);
+        MultiColumn& multi = _multi_columns[std::make_pair(index_id, field_ids.size())];
+        if (multi.cmsketch == nullptr) {
+            multi.index_id = index_id;
+            multi.field_ids = field_ids;
+            multi.cmsketch = std::make_shared<CMsketchColumn>(_depth, _width, field_ids[0]);
+        }
+        multi.cmsketch->set_value(hash, 1);
+    }
+
+    // 返回拷贝，distinct由调用方根据采样计算后通过set_multi_distinct设置
+    MultiColumnMap multi_columns() {
+        BAIDU_SCOPED_LOCK(_mutex);
+        return _multi_columns;
+    }
+
+    void set_multi_distinct(int64_t index_id, size_t prefix_len, int64_t distinct_cnt) {
+        BAIDU_SCOPED_LOCK(_mutex);
+        auto iter = _multi_columns.find(std::make_pair(index_id, prefix_len));
+        if (iter != _multi_columns.end()) {
+            iter->second.distinct_cnt = distinct_cnt;
+        }
+    }
+
     void to_proto(pb::CMsketch* cmsketch) {
         BAIDU_SCOPED_LOCK(_mutex);
         cmsketch->set_depth(_depth);
@@ -189,6 +229,17 @@ public:
             pb::CMsketchColumn* cmcloumn = cmsketch->add_cmcolumns();
             iter->second->to_proto(cmcloumn);
         }
+        for (auto& pair : _multi_columns) {
+            pb::MultiColumnInfo* multi_pb = cmsketch->add_multi_columns();
+            multi_pb->set_index_id(pair.second.index_id);
+            for (auto field_id : pair.second.field_ids) {
+                multi_pb->add_field_ids(field_id);
+            }
+            if (pair.second.distinct_cnt >= 0) {
+                multi_pb->set_distinct_cnt(pair.second.distinct_cnt);
+            }
+            pair.second.cmsketch->to_proto(multi_pb->mutable_cmsketch());
+        }
     }
 
     void add_proto(const pb::CMsketch& cmsketch) {
@@ -206,6 +257,18 @@ public:
                 _column_cmsketch[cmcolumn.field_id()] = ptr;
             }
         }
+        for (auto& multi_pb : cmsketch.multi_columns()) {
+            if (multi_pb.field_ids_size() < 2 || !multi_pb.has_cmsketch()) {
+                continue;
+            }
+            MultiColumn& multi = _multi_columns[std::make_pair(multi_pb.index_id(), multi_pb.field_ids_size())];
+            if (multi.cmsketch == nullptr) {
+                multi.index_id = multi_pb.index_id();
+                multi.field_ids.assign(multi_pb.field_ids().begin(), multi_pb.field_ids().end());
+                multi.cmsketch = std::make_shared<CMsketchColumn>(_depth, _width, multi_pb.field_ids(0));
+            }
+            multi.cmsketch->add_proto(multi_pb.cmsketch());
+        }
     }
 
     int get_depth() {
@@ -232,12 +295,22 @@ public:
         _table_rows = table_rows;
     }
 
+    int get_multi_column_max_prefix() {
+        return _multi_column_max_prefix;
+    }
+
+    void set_multi_column_max_prefix(int max_prefix) {
+        _multi_column_max_prefix = max_prefix;
+    }
+
 public:
     int _depth;
     int _width;
     int _sample_rows;
     int64_t _table_rows;
+    int _multi_column_max_prefix = 0;
     bthread_mutex_t _mutex;
     std::map<int, std::shared_ptr<CMsketchColumn>> _column_cmsketch;
+    MultiColumnMap _multi_columns;
 };
 }
@@ -33,6 +33,14 @@ extern uint64_t time_to_datetime(int32_t time);
 extern std::string time_to_str(int32_t time);
 extern int32_t str_to_time(const char* str_time);
 extern int32_t seconds_to_time(int32_t seconds);
+
+// 直接格式化到buf中，不构造std::string，返回写入长度
+// buf至少DATETIME_STR_MAX_LEN字节，结果不以'\0'结尾
+const size_t DATETIME_STR_MAX_LEN = 32;
+extern size_t timestamp_to_str(time_t timestamp, char* buf);
+extern size_t datetime_to_str(uint64_t datetime, char* buf);
+extern size_t time_to_str(int32_t time, char* buf);
+extern size_t date_to_str(uint32_t date, char* buf);
 struct DateTime;
 extern uint64_t bin_date_to_datetime(DateTime time_struct);
 extern int32_t bin_time_to_datetime(DateTime time_struct);
@@ -48,13 +56,9 @@ inline uint64_t date_to_datetime(uint32_t date) {
     return (uint64_t)date << 41;
 }
 inline std::string date_to_str(uint32_t date) {
-    int year_month = ((date >> 5) & 0x1FFFF);
-    int year = year_month / 13;
-    int month = year_month % 13;
-    int day = (date & 0x1F);
-    char buf[30] = {0};
-    snprintf(buf, sizeof(buf), "%04d-%02d-%02d", year, month, day);
-    return std::string(buf);
+    char buf[DATETIME_STR_MAX_LEN];
+    size_t len = date_to_str(date, buf);
+    return std::string(buf, len);
 }
 
 extern bool tz_to_second(const char *time_zone, int32_t& result);
@@ -0,0 +1,119 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "common.h"
+
+namespace baikaldb {
+// 并发请求合并执行：同一时刻只有一个执行者，由提交请求的bthread担任；
+// 执行期间到达的请求排队，本批结束后由队首请求所在的bthread接着执行下一批
+template <typename Task>
+class GroupExecutor {
+public:
+    // 处理一批task，结果写在task中
+    typedef std::function<void(std::vector<Task*>& batch)> ProcessFunc;
+    // 批次中有count个task、权重和为weight时是否超限，首个task不受限
+    typedef std::function<bool(size_t count, int64_t weight)> ExceedFunc;
+    typedef std::function<int64_t(const Task* task)> WeightFunc;
+
+    GroupExecutor(const ProcessFunc& process, const ExceedFunc& exceed,
+            const WeightFunc& weight = nullptr) :
+            _process(process), _exceed(exceed), _weight(weight) {}
+
+    // 返回时task所在的批次已经处理完
+    void run(Task* task) {
+        Waiter waiter;
+        waiter.task = task;
+        waiter.cond.increase();
+        bool leader = false;
+        {
+            std::lock_guard<bthread::Mutex> lock(_mutex);
+            _waiters.emplace_back(&waiter);
+            if (!_running) {
+                _running = true;
+                leader = true;
+            }
+        }
+        for (;;) {
+            if (leader) {
+                run_batch();
+            }
+            waiter.cond.wait();
+            if (waiter.done) {
+                break;
+            }
+            // 上一批的执行者唤醒队首，由本bthread执行下一批
+            waiter.cond.increase();
+            leader = true;
+        }
+    }
+
+private:
+    struct Waiter {
+        Task* task = nullptr;
+        bool done = false;
+        BthreadCond cond;
+    };
+
+    void run_batch() {
+        std::vector<Waiter*> waiters;
+        {
+            std::lock_guard<bthread::Mutex> lock(_mutex);
+            int64_t weight = 0;
+            size_t count = 0;
+            while (count < _waiters.size()) {
+                int64_t task_weight = _weight ? _weight(_waiters[count]->task) : 0;
+                if (count > 0 && _exceed(count + 1, weight + task_weight)) {
+                    break;
+                }
+                weight += task_weight;
+                ++count;
+            }
+            waiters.assign(_waiters.begin(), _waiters.begin() + count);
+            _waiters.erase(_waiters.begin(), _waiters.begin() + count);
+        }
+        std::vector<Task*> batch;
+        batch.reserve(waiters.size());
+        for (auto waiter : waiters) {
+            batch.emplace_back(waiter->task);
+        }
+        _process(batch);
+        for (auto waiter : waiters) {
+            waiter->done = true;
+            // waiter在提交者的栈上，唤醒后随时析构
+            waiter->cond.decrease_signal();
+        }
+        std::lock_guard<bthread::Mutex> lock(_mutex);
+        if (_waiters.empty()) {
+            _running = false;
+        } else {
+            _waiters.front()->cond.decrease_signal();
+        }
+    }
+
+    ProcessFunc _process;
+    ExceedFunc _exceed;
+    WeightFunc _weight;
+    bthread::Mutex _mutex;
+    std::deque<Waiter*> _waiters;
+    bool _running = false;
+};
+} // namespace baikaldb
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
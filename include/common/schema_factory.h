@@ -590,6 +590,8 @@ public:
     double get_histogram_ratio(int64_t table_id, int field_id, const ExprValue& lower, const ExprValue& upper);
     // 计算单个值占比
     double get_cmsketch_ratio(int64_t table_id, int field_id, const ExprValue& value);
+    double get_multi_column_ratio(int64_t table_id, const std::vector<int32_t>& field_ids,
+            const std::vector<uint64_t>& hashes);
     SmartStatistics get_statistics_ptr(int64_t table_id);
     int64_t get_histogram_sample_cnt(int64_t table_id);
     int64_t get_histogram_distinct_cnt(int64_t table_id, int field_id); 
@@ -154,6 +154,36 @@ public:
         return _sample_rows;
     }
 
+    // 索引前缀列都是等值条件时的组合选择率，hashes为各组合值的multi_column_hash
+    // 高频值用cmsketch估算，其余按1/ndv；没有多列统计返回-1
+    double get_multi_column_ratio(const std::vector<int32_t>& field_ids, const std::vector<uint64_t>& hashes) {
+        auto iter = _multi_columns.find(field_ids);
+        if (iter == _multi_columns.end() || _total_rows <= 0) {
+            return -1;
+        }
+        double distinct_cnt = iter->second.distinct_cnt;
+        // 采样中大部分组合不重复，认为distinct随总行数线性增长
+        if (_sample_rows > 0 && _total_rows > _sample_rows && distinct_cnt * 2 >= _sample_rows) {
+            distinct_cnt = distinct_cnt * _total_rows / _sample_rows;
+        }
+        auto& cmsketch = iter->second.cmsketch;
+        double ratio = 0.0;
+        for (auto hash : hashes) {
+            int64_t value_cnt = 0;
+            if (cmsketch != nullptr && cmsketch->_total_cnt > 0) {
+                value_cnt = cmsketch->get_value(hash);
+            }
+            if (value_cnt > 0) {
+                ratio += value_cnt * 1.0 / cmsketch->_total_cnt;
+            } else if (distinct_cnt > 0) {
+                ratio += 1.0 / distinct_cnt;
+            } else {
+                return -1;
+            }
+        }
+        return std::min(ratio, 1.0);
+    }
+
     int64_t get_distinct_cnt(int field_id) {
         auto iter = _field_histogram.find(field_id);
         if (iter == _field_histogram.end()) {
@@ -185,6 +215,18 @@ private:
                 _total_rows = ptr->get_total_rows();
             }
         }
+        for (auto& multi : cmsketch.multi_columns()) {
+            if (multi.field_ids_size() < 2) {
+                continue;
+            }
+            std::vector<int32_t> field_ids(multi.field_ids().begin(), multi.field_ids().end());
+            MultiColumnStat& stat = _multi_columns[field_ids];
+            stat.distinct_cnt = multi.distinct_cnt();
+            if (multi.has_cmsketch()) {
+                stat.cmsketch = std::make_shared<CMsketchColumn>(depth, width, field_ids[0]);
+                stat.cmsketch->add_proto(multi.cmsketch());
+            }
+        }
     }
 private:
     int64_t _table_id = 0;
@@ -193,6 +235,12 @@ private:
     int64_t _total_rows = 0;
     std::map<int, std::shared_ptr<Histogram>> _field_histogram;
     std::map<int, std::shared_ptr<CMsketchColumn>> _field_cmsketch;
+    struct MultiColumnStat {
+        int64_t distinct_cnt = 0;
+        std::shared_ptr<CMsketchColumn> cmsketch;
+    };
+    // 索引前缀列 => 多列统计
+    std::map<std::vector<int32_t>, MultiColumnStat> _multi_columns;
 };
 
 typedef std::shared_ptr<Statistics> SmartStatistics;
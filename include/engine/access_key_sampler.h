@@ -0,0 +1,47 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <bthread/mutex.h>
+#include "rocksdb/slice.h"
+#include "common.h"
+
+namespace baikaldb {
+DECLARE_int32(load_split_sample_interval);
+DECLARE_int32(load_split_sample_keys);
+
+// region主键访问的采样，读写按主键访问时调用sample
+// 窗口内对访问做蓄水池采样，采样结果按访问量加权，可用于求访问量的中位数
+class AccessKeySampler {
+public:
+    // key包含region_id + index_id前缀
+    void sample(const rocksdb::Slice& key);
+    // 结束当前窗口，返回窗口内的访问次数和窗口时长，keys为采样到的主键(不含前缀)
+    int64_t swap_window(std::vector<std::string>* keys, int64_t* window_us);
+    void reset();
+
+private:
+    std::atomic<int64_t> _access_count{0};
+    int64_t _sample_count = 0;
+    std::vector<std::string> _keys;
+    TimeCost _window_time;
+    bthread::Mutex _mutex;
+};
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
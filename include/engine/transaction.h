@@ -27,6 +27,7 @@
 #include "trace_state.h"
 #include "my_rocksdb.h"
 #include "tuple_record.h"
+#include "access_key_sampler.h"
 
 namespace baikaldb {
 DECLARE_bool(disable_wal);
@@ -56,6 +57,7 @@ class TransactionPool;
 // 不同region资源隔离，不需要每次从SchemaFactory加锁获取
 struct RegionResource {
     pb::RegionInfo region_info;
+    std::shared_ptr<AccessKeySampler> access_sampler; // region信息变更时沿用同一个
 };
 class Transaction {
 public:
@@ -348,6 +350,15 @@ public:
            }
        }
     }
+    // 按本region的主键访问时采样，key包含region_id + index_id前缀
+    void sample_access_key(int64_t region, int64_t index_id, const rocksdb::Slice& key) {
+        if (_resource == nullptr || _resource->access_sampler == nullptr
+                || region != _resource->region_info.region_id()
+                || index_id != _resource->region_info.table_id()) {
+            return;
+        }
+        _resource->access_sampler->sample(key);
+    }
     bool is_cstore() {
         if (_table_info.get() == nullptr) {
             // _is_global_index
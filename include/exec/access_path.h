@@ -83,6 +83,8 @@ enum IndexHint {
     double calc_field_selectivity(int32_t field_id, range::FieldRange& range);
 
     double fields_to_selectivity(const std::unordered_set<int32_t>& field_ids, std::map<int32_t, double>& filed_selectivity);
+    // 索引前缀为等值条件时用多列统计估算命中列的选择率，不适用返回-1
+    double multi_column_selectivity(std::map<int32_t, double>& filed_selectivity);
     // TODO 后续做成index的统计信息，现在只是单列统计聚合
     void calc_cost(std::map<std::string, std::string>* cost_info, std::map<int32_t, double>& filed_selectivity);
     void show_cost(std::map<std::string, std::string>* cost_info, std::map<int32_t, double>& filed_selectivity);
@@ -26,8 +26,11 @@
 #include "exec_node.h"
 #include "agg_fn_call.h"
 #include "mut_table_key.h"
+#include "external_sorter.h"
 
 namespace baikaldb {
+typedef butil::FlatMap<std::string, MemRow*> AggHashMap;
+
 class AggNode : public ExecNode {
 public:
     AggNode() {
@@ -49,6 +52,10 @@ public:
     virtual void transfer_pb(int64_t region_id, pb::PlanNode* pb_node);
     void encode_agg_key(MemRow* row, MutTableKey& key);
     void process_row_batch(RuntimeState* state, RowBatch& batch, int64_t& used_size, int64_t& release_size);
+    // 按key聚合一行，新key时row的所有权转移给hash_map
+    // is_merge为true时row是中间结果，用merge合并
+    void aggregate_row(AggHashMap& hash_map, std::unique_ptr<MemRow>& row, const std::string& key,
+            bool is_merge, int64_t& used_size, int64_t& release_size);
     void memory_limit_release(RuntimeState* state, int64_t size);
     int memory_limit_exceeded(RuntimeState* state, int64_t size);
     std::vector<ExprNode*>* mutable_group_exprs() {
@@ -70,6 +77,23 @@ public:
     std::vector<AggFnCall*>* mutable_agg_fn_calls() {
         return &_agg_fn_calls;
     }
+private:
+    // group by列都是定长类型时，key直接拷贝数值的原始字节，不经过MutTableKey编码
+    void encode_fixed_agg_key(MemRow* row, std::string* key);
+    void encode_agg_key(MemRow* row, std::string* key);
+    bool can_parallel_agg();
+    // 攒够一批行后，按key的hash分到各分区，每个分区在自己的bthread中聚合
+    int parallel_process_rows(RuntimeState* state);
+    // 聚合一批数据后更新内存统计，超过预算或者query内存quota时把hash表落盘
+    int update_memory(RuntimeState* state, int64_t input_bytes, int64_t used_size,
+            int64_t release_size);
+    bool can_spill_agg();
+    // hash表中的中间结果按key的hash写入各落盘分区，然后释放内存
+    int spill_hash_table(RuntimeState* state);
+    // 读入下一个落盘分区并重新聚合，输出完一个分区再读下一个
+    int load_spill_partition(RuntimeState* state);
+    void clear_spill();
+
 private:
     //需要推导_agg_tuple_id内部slot的类型
     std::vector<ExprNode*> _group_exprs;
@@ -80,8 +104,26 @@ private:
     bool _is_merger = false;
     MemRowDescriptor* _mem_row_desc;
     //用于分组和get_next的定位,用map可与mysql保持一致
-    butil::FlatMap<std::string, MemRow*> _hash_map;
-    butil::FlatMap<std::string, MemRow*>::iterator _iter;
+    AggHashMap _hash_map;
+    AggHashMap::iterator _iter;
+    bool _fixed_key = false;
+    // 并行聚合时每个分区一个hash表，分区间key不重叠，输出时依次遍历，不需要再合并
+    bool _parallel = false;
+    std::vector<std::unique_ptr<AggHashMap>> _partition_maps;
+    AggHashMap* _cur_map = &_hash_map;
+    size_t _partition_idx = 0;
+    std::vector<std::unique_ptr<MemRow>> _pending_rows;
+
+    // 落盘聚合
+    bool _can_spill = false;
+    bool _spilled = false;
+    int64_t _hash_table_bytes = 0;
+    // 本节点计入MemTracker的聚合状态大小，落盘时归还
+    int64_t _agg_charged_bytes = 0;
+    std::vector<std::string> _spill_files;
+    std::vector<std::unique_ptr<SortRunWriter>> _spill_writers;
+    size_t _spill_partition_idx = 0;
+    AggHashMap _spill_map;
 };
 }
 /* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -35,6 +35,20 @@ struct TraceDesc {
     std::shared_ptr<pb::TraceNode> trace_node = nullptr;
 };
 
+// 分块返回的select在store上的游标
+struct StoreCursor {
+    pb::RegionInfo info;
+    std::string addr; // 续读必须发往创建游标的实例
+    uint64_t cursor_id = 0; // 0表示已经读完
+    bool in_flight = false;
+    BthreadCond cond;
+    ErrorType ret = E_OK;
+    std::shared_ptr<RowBatch> next_batch;
+    int64_t scan_rows = 0;
+    int64_t filter_rows = 0;
+    TimeCost active_time; // 上次发起请求的时间，只在执行线程上修改
+};
+
 class FetcherStore {
 public:
     FetcherStore() {
@@ -61,6 +75,10 @@ public:
         primary_timestamp_updated = false;
         no_copy_cache_plan_set.clear();
         dynamic_timeout_ms = -1;
+        region_cursors.clear();
+        cursor_in_flight = 0;
+        enable_cursor = false;
+        chunk_bytes = 0;
     }
 
     // send (cached) cmds with seq_id >= start_seq_id
@@ -89,6 +107,46 @@ public:
                      log_id, retry_times, start_seq_id, current_seq_id, op_type);
     }
 
+    // 构造单个region的请求，不包括实例选择
+    void build_request(RuntimeState* state,
+                       ExecNode* store_request,
+                       pb::RegionInfo& info,
+                       pb::TraceNode* trace_node,
+                       int64_t old_region_id,
+                       int64_t region_id,
+                       uint64_t log_id,
+                       int start_seq_id,
+                       int current_seq_id,
+                       bool need_copy_cache_plan,
+                       pb::OpType op_type,
+                       pb::StoreReq& req);
+    // 选择请求发往的实例，返回true表示可以不读leader
+    bool choose_addr(RuntimeState* state, pb::RegionInfo& info, pb::OpType op_type,
+                     int retry_times, std::string& addr, std::string& backup);
+    // 处理region返回成功的结果
+    ErrorType handle_response(RuntimeState* state,
+                              pb::RegionInfo& info,
+                              int64_t region_id,
+                              uint64_t log_id,
+                              pb::OpType op_type,
+                              const pb::StoreRes& res,
+                              const std::string& remote_addr);
+    bool use_multi_request(RuntimeState* state, ExecNode* store_request, pb::OpType op_type);
+    // 同一实例上的多个region合并为一次query_multi请求，失败的region退化为send_request
+    void send_multi_request(RuntimeState* state,
+                            ExecNode* store_request,
+                            const std::string& addr,
+                            const std::vector<std::pair<pb::RegionInfo*, bool>>& infos,
+                            uint64_t log_id,
+                            int start_seq_id,
+                            int current_seq_id);
+    void send_multi_requests(RuntimeState* state,
+                             ExecNode* store_request,
+                             std::map<int64_t, pb::RegionInfo>& region_infos,
+                             uint64_t log_id,
+                             int start_seq_id,
+                             int current_seq_id);
+
     int run(RuntimeState* state, 
             std::map<int64_t, pb::RegionInfo>& region_infos,
             ExecNode* store_request,
@@ -163,6 +221,23 @@ public:
             DB_DEBUG("all peer faulty, %ld", region_id);
         }
     }
+    bool has_cursor(int64_t region_id) {
+        return region_cursors.count(region_id) > 0;
+    }
+    // 后台续读下一块，和上层处理当前块并行；must为false时超过预取窗口则不发起
+    void prefetch_cursor(RuntimeState* state, int64_t region_id, bool must = false);
+    // 取region的下一块数据，读完后游标被移除
+    int next_cursor_batch(RuntimeState* state, int64_t region_id, std::shared_ptr<RowBatch>& batch);
+    // 提前结束(如limit)时释放store上的游标
+    void close_cursors(RuntimeState* state);
+    // 消费期间给空闲较久的游标发保活请求，避免还没读到的region游标在store上超时
+    void keepalive_cursors(RuntimeState* state);
+    // 收到响应前保留游标id，出错时关闭store上的游标
+    ErrorType fetch_cursor(RuntimeState* state, StoreCursor* cursor, bool close);
+    ErrorType send_cursor_req(RuntimeState* state, StoreCursor* cursor, bool close, pb::StoreRes& res,
+            bool touch = false);
+    // 解码store返回的Arrow格式结果
+    int decode_arrow_rows(RuntimeState* state, const pb::StoreRes& res, RowBatch* batch);
     void choose_other_if_faulty(pb::RegionInfo& info, std::string& addr);
     void other_normal_peer_to_leader(pb::RegionInfo& info, std::string& addr);
     bool need_process_binlog(RuntimeState* state, pb::OpType op_type) {
@@ -218,6 +293,11 @@ public:
     std::set<int64_t> no_copy_cache_plan_set;
     int64_t dynamic_timeout_ms = -1;
     TimeCost binlog_prewrite_time;
+    // 调用方按region顺序流式消费时，select结果分块返回，剩余数据通过游标续读
+    bool enable_cursor = false;
+    int64_t chunk_bytes = 0; // 每块的大小，0表示使用select_chunk_bytes
+    std::map<int64_t, std::shared_ptr<StoreCursor>> region_cursors;
+    int cursor_in_flight = 0; // 已发起还未取走的续读，只在执行线程上修改
 };
 }
 
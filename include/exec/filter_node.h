@@ -15,6 +15,7 @@
 #pragma once
 
 #include "exec_node.h"
+#include "column_batch.h"
 
 namespace baikaldb {
 class FilterNode : public ExecNode {
@@ -66,11 +67,16 @@ public:
         mutable_pb_node()->mutable_derive_node()->mutable_filter_node()->clear_conjuncts();
         _pruned_conjuncts.clear();
         _pruned_conjuncts.insert(_pruned_conjuncts.end(), other_condition.begin(), other_condition.end());
+        _vectorize_inited = false;
     }
     virtual void show_explain(std::vector<std::map<std::string, std::string>>& output);
 private:
     bool need_copy(MemRow* row);
     void memory_limit_release(RuntimeState* state, MemRow* row);
+    // 把_pruned_conjuncts分成批量计算和逐行计算两部分
+    void init_vectorized_conjuncts();
+    // 对_child_row_batch批量计算可向量化的条件，结果写入_selection
+    void vectorized_filter();
 
 private:
     std::vector<ExprNode*> _conjuncts;
@@ -78,6 +84,14 @@ private:
     RowBatch _child_row_batch;
     size_t  _child_row_idx = 0;
     bool    _child_eos = false;
+
+    bool _vectorize_inited = false;
+    std::vector<ExprNode*> _vectorized_conjuncts;
+    std::vector<ExprNode*> _row_conjuncts;
+    ColumnBatch _column_batch;
+    ColumnVector _bool_value;
+    // 和_child_row_batch行下标对齐，0表示已被批量条件过滤
+    std::vector<uint8_t> _selection;
 };
 }
 
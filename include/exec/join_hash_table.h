@@ -0,0 +1,73 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <vector>
+#include <string>
+#ifdef BAIDU_INTERNAL
+#include <base/containers/flat_map.h>
+#else
+#include <butil/containers/flat_map.h>
+#endif
+#include "mem_row.h"
+#include "expr_node.h"
+
+namespace baikaldb {
+// hash join的build表
+// 同key的行用_next数组串成链表，hash表中只保存链表头的下标，不再为每个key分配vector
+// 单个整型key时直接用int64做hash key(fixed key)，否则按MutTableKey编码成string
+// 行的所有权不在本类，由调用方负责释放
+class JoinHashTable {
+public:
+    // build_slots和probe_slots一一对应，都是slot_ref
+    int init(const std::vector<ExprNode*>& build_slots,
+             const std::vector<ExprNode*>& probe_slots);
+    void build(const std::vector<MemRow*>& rows);
+    // 返回第一个匹配行的下标，没有匹配返回-1；key含null时不匹配
+    int32_t probe(MemRow* row);
+    int32_t next(int32_t idx) const {
+        return _next[idx];
+    }
+    MemRow* row(int32_t idx) const {
+        return _rows[idx];
+    }
+    bool is_fixed_key() const {
+        return _fixed_key;
+    }
+    size_t size() const {
+        return _rows.size();
+    }
+    size_t key_count() const {
+        return _fixed_key ? _fixed_map.size() : _string_map.size();
+    }
+    void clear();
+
+private:
+    // key含null时返回false
+    bool encode_fixed_key(MemRow* row, const std::vector<ExprNode*>& slots, int64_t* key);
+    bool encode_string_key(MemRow* row, const std::vector<ExprNode*>& slots, std::string* key);
+
+    std::vector<ExprNode*> _build_slots;
+    std::vector<ExprNode*> _probe_slots;
+    bool _fixed_key = false;
+    butil::FlatMap<int64_t, int32_t> _fixed_map;
+    butil::FlatMap<std::string, int32_t> _string_map;
+    std::vector<MemRow*> _rows;
+    std::vector<int32_t> _next;
+    std::string _key_buf;
+};
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
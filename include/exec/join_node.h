@@ -15,6 +15,8 @@
 #pragma once
 #include "exec_node.h"
 #include "joiner.h"
+#include "join_hash_table.h"
+#include "runtime_filter.h"
 #include "mut_table_key.h"
 #ifdef BAIDU_INTERNAL 
 #include <base/containers/flat_map.h>
@@ -65,6 +67,7 @@ public:
     }
 
     int hash_join(RuntimeState* state);
+    virtual void close(RuntimeState* state);
 
     int nested_loop_join(RuntimeState* state);
 
@@ -84,6 +87,28 @@ public:
             std::map<int32_t, std::set<int32_t>>& tuple_equals_map, 
             std::vector<int32_t>& tuple_order,
             std::vector<ExprNode*>& conditions);
+
+private:
+    // 驱动表行数较多时，不再把所有key拼成in条件下推，
+    // 改为下推[min, max]范围条件，并用bloom filter在probe时过滤
+    bool use_runtime_filter();
+    int construct_runtime_filters(std::vector<ExprNode*>& filter_exprs);
+    // bloom filter随plan发往inner表的store，扫描时预过滤
+    void push_runtime_filters();
+    bool runtime_filter_pass(MemRow* probe_row);
+    void build_join_table();
+    int get_next_via_join_table_inner(RuntimeState* state, RowBatch* batch, bool* eos);
+    int get_next_via_join_table_other(RuntimeState* state, RowBatch* batch, bool* eos);
+
+private:
+    pb::JoinAlgorithm _join_algo = pb::JA_AUTO;
+    bool _use_join_table = false;
+    JoinHashTable _join_table;
+    // 和_inner_equal_slot一一对应
+    std::vector<RuntimeFilter> _runtime_filters;
+    // 当前probe行在_join_table中的匹配位置
+    int32_t _match_idx = -1;
+    bool _probe_started = false;
 };
 }
 
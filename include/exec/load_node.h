@@ -48,8 +48,20 @@ public:
     virtual int open(RuntimeState* state);
 
 private:
+    // 读取的一段完整行，由后台bthread解析成record，按读取顺序插入
+    struct LoadChunk {
+        std::string data;
+        std::vector<std::vector<SmartRecord>> batches;
+        int ret = 0;
+        BthreadCond parsed;
+    };
+    typedef std::shared_ptr<LoadChunk> SmartLoadChunk;
+
     int ignore_specified_lines(butil::File& file, char* data_buffer, int64_t buf_size);
-    int handle_lines(RuntimeState* state, std::vector<std::string>& row_lines);
+    int read_chunk(butil::File& file, char* data_buffer, SmartLoadChunk& chunk);
+    void parse_chunk(const SmartLoadChunk& chunk);
+    int parse_lines(std::vector<std::string>& row_lines, std::vector<SmartRecord>& records);
+    int insert_records(RuntimeState* state, std::vector<SmartRecord>& records);
     ExprValue create_field_value(FieldInfo& field_info, std::string& str_val, bool& is_legal);
     int fill_field_value(SmartRecord record, FieldInfo& field, ExprValue& value);
 
@@ -61,6 +61,7 @@ private:
     int open_histogram(RuntimeState* state);
     int open_cmsketch(RuntimeState* state);
     int open_analyze(RuntimeState* state);
+    void multi_column_distinct(RuntimeState* state, std::vector<std::shared_ptr<RowBatch>>& batch_vector);
     int open_trace(RuntimeState* state);
     int handle_trace(RuntimeState* state);
     int handle_trace2(RuntimeState* state);
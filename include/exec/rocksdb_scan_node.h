@@ -21,6 +21,7 @@
 #include "reverse_index.h"
 #include "reverse_interface.h"
 #include "select_manager_node.h"
+#include "runtime_filter.h"
 
 namespace baikaldb {
 class ReverseIndexBase;
@@ -90,6 +91,10 @@ public:
     std::vector<int64_t>& get_partition() {
         return _partitions;
     }
+    // join build侧生成的bloom filter，随plan发往store，在扫描时预过滤
+    void add_runtime_filter(int32_t slot_id, const RuntimeFilter& filter) {
+        filter.to_pb(slot_id, _pb_node.mutable_derive_node()->mutable_scan_node()->add_runtime_filters());
+    }
 private:
     int get_next_by_table_get(RuntimeState* state, RowBatch* batch, bool* eos);
     int get_next_by_table_seek(RuntimeState* state, RowBatch* batch, bool* eos);
@@ -117,6 +122,16 @@ private:
     }
 
     int memory_limit_exceeded(RuntimeState* state, RowBatch* batch);
+    int init_runtime_filters();
+    // check_index_slots/check_other_slots分别表示是否检查索引中的列和其他列
+    bool runtime_filter_pass(MemRow* row, bool check_index_slots, bool check_other_slots);
+
+    struct ScanRuntimeFilter {
+        int32_t slot_id = 0;
+        int32_t field_id = 0;
+        bool in_index = false;
+        RuntimeFilter filter;
+    };
 
 private:
     std::map<int32_t, FieldInfo*> _field_ids;
@@ -174,6 +189,7 @@ private:
     pb::StorageType _storage_type = pb::ST_UNKNOWN;
     std::vector<int64_t> _partitions {0};
     bool _new_fulltext_tree = false;
+    std::vector<ScanRuntimeFilter> _runtime_filters;
 };
 }
 
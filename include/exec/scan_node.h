@@ -174,6 +174,11 @@ public:
 
 // 两两比较，根据一些简单规则干掉次优索引
     int64_t pre_process_select_index();
+
+    // 按选中索引的代价估算过滤后的行数，read_rows为索引读取的行数；没有统计信息返回-1
+    int64_t estimate_rows(int64_t* read_rows);
+    // 是否有以field_id为第一列的索引，join时可以按驱动表的key查找
+    bool has_index_prefix(int32_t field_id);
     
 protected:
     pb::Engine _engine = pb::ROCKSDB;
@@ -48,7 +48,14 @@ public:
             expr->close();
         }
         _sorter = nullptr;
+        _fetcher_store.close_cursors(state);
         _fetcher_store.clear();
+        _streaming = false;
+        _stream_regions.clear();
+        _stream_idx = 0;
+        _stream_region_started = false;
+        _merging = false;
+        _merge_heap.clear();
     }
     int init_sort_info(SortNode* sort_node) {
         _slot_order_exprs = sort_node->slot_order_exprs();
@@ -77,6 +84,11 @@ public:
     }
 
     int subquery_open(RuntimeState* state);
+    // 按region顺序输出，当前块输出时后台续读下一块
+    int get_next_streaming(RuntimeState* state, RowBatch* batch, bool* eos);
+    // 有序输出时各region分块返回，按块做流式多路归并，满足limit后不再续读
+    int open_merging(RuntimeState* state);
+    int get_next_merging(RuntimeState* state, RowBatch* batch, bool* eos);
 
     void set_slot_column_mapping(std::map<int32_t, int32_t>& slot_column_map) {
         _slot_column_mapping.swap(slot_column_map);
@@ -85,6 +97,21 @@ public:
         _derived_tuple_id = derived_tuple_id;
     }
 private:
+    friend class SelectManagerNodeTest;
+    struct MergeStream {
+        int64_t region_id = 0;
+        std::shared_ptr<RowBatch> chunk; // 当前参与归并的块
+    };
+    // 堆顶为当前行最小的region
+    std::function<bool(const MergeStream&, const MergeStream&)> merge_greater() {
+        MemRowCompare* comp = _mem_row_compare.get();
+        return [comp](const MergeStream& left, const MergeStream& right) {
+            return comp->less(right.chunk->get_row().get(), left.chunk->get_row().get());
+        };
+    }
+    // 取region下一个非空块，读完时chunk为nullptr
+    int next_merge_chunk(RuntimeState* state, MergeStream& stream);
+
     //允许fetcher回来后排序
     std::vector<ExprNode*> _slot_order_exprs;
     std::vector<bool> _is_asc;
@@ -99,6 +126,12 @@ private:
     std::vector<ExprNode*>  _derived_table_projections;
     std::map<int32_t, int32_t>  _slot_column_mapping;
     int32_t         _derived_tuple_id = 0;
+    bool            _streaming = false;
+    std::vector<int64_t> _stream_regions;
+    size_t          _stream_idx = 0;
+    bool            _stream_region_started = false;
+    bool            _merging = false;
+    std::vector<MergeStream> _merge_heap;
 };
 }
 
@@ -16,6 +16,7 @@
 
 #include "exec_node.h"
 #include "sorter.h"
+#include "external_sorter.h"
 #include "mem_row_compare.h"
 #include "property.h"
 
@@ -111,6 +112,7 @@ public:
 
 private:
     int fill_tuple(RowBatch* batch);
+    void memory_limit_release(RuntimeState* state, int64_t size);
 
 private:
     std::vector<ExprNode*> _order_exprs;
@@ -120,7 +122,9 @@ private:
     std::vector<bool> _is_asc;
     std::vector<bool> _is_null_first;
     std::shared_ptr<MemRowCompare> _mem_row_compare;
-    std::shared_ptr<Sorter> _sorter;
+    std::shared_ptr<ExternalSorter> _sorter;
+    // 有limit时只保留前limit行，不做全排序
+    std::shared_ptr<TopNSorter> _topn_sorter;
     bool _monotonic = true; //是否单调(全部升序或降序)
 };
 }
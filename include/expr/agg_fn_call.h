@@ -125,6 +125,25 @@ public:
                 return false;
         }
     }
+    bool is_distinct() const {
+        return _is_distinct;
+    }
+    // 聚合状态只保存在dst行中，不依赖_intermediate_val_map
+    // 不同key可以在多个线程中并行聚合
+    bool is_row_state_agg() const {
+        switch (_agg_type) {
+            case COUNT_STAR:
+            case COUNT:
+            case SUM:
+            case AVG:
+            case MIN:
+            case MAX:
+            case GROUP_CONCAT:
+                return true;
+            default:
+                return false;
+        }
+    }
     bool is_hll_agg() const {
         switch(_agg_type) {
             case HLL_ADD_AGG:
@@ -21,6 +21,8 @@
 #include "proto/expr.pb.h"
 
 namespace baikaldb {
+class ColumnBatch;
+class ColumnVector;
 class ExprNode {
 public:
     ExprNode() {}
@@ -136,6 +138,15 @@ public:
     virtual ExprValue get_value(MemRow* row) { //对每行计算表达式
         return ExprValue::Null();
     } 
+    //批量计算，只有can_vectorize()的表达式支持，需在open之后调用
+    virtual bool can_vectorize() {
+        return false;
+    }
+    //对batch所有行计算表达式，结果列类型为_col_type，失败返回nullptr
+    //结果列由表达式持有，下次调用前有效
+    virtual const ColumnVector* get_batch_value(ColumnBatch* batch) {
+        return nullptr;
+    }
     //释放open创建的资源
     virtual void close() {
         for (auto e : _children) {
@@ -236,6 +247,7 @@ public:
     }
     void get_all_tuple_ids(std::unordered_set<int32_t>& tuple_ids);
     void get_all_slot_ids(std::unordered_set<int32_t>& slot_ids);
+    void get_all_slot_refs(std::vector<ExprNode*>& slot_refs);
     void get_all_field_ids(std::unordered_set<int32_t>& field_ids);
     int32_t tuple_id() const {
         return _tuple_id;
@@ -14,6 +14,7 @@
 
 #pragma once
 #include "expr_node.h"
+#include "column_batch.h"
 //#include "sql_parser.h"
 
 namespace baikaldb {
@@ -34,6 +35,7 @@ public:
 
     void init(const ExprValue& value) {
         _value = value;
+        _batch_value.clear();
         _is_constant = true;
         _has_null = value.is_null();
         value_to_node_type();
@@ -174,6 +176,7 @@ public:
     //  STRING_LITERA => DATETIME_LITERAL
     //  STRING_LITERA => DATE_LITERAL
     void cast_to_type(pb::ExprNodeType literal_type) {
+        _batch_value.clear();
         if (literal_type == pb::TIMESTAMP_LITERAL) {
             _value.cast_to(pb::TIMESTAMP);
         } else if (literal_type == pb::DATE_LITERAL) {
@@ -188,6 +191,7 @@ public:
     }
 
     void cast_to_col_type(pb::PrimitiveType type) {
+        _batch_value.clear();
         if (is_datetime_specic(type) && _value.is_numberic()) {
             _value.cast_to(pb::STRING);
         }
@@ -199,6 +203,31 @@ public:
         return _value.cast_to(_col_type);
     }
 
+    virtual bool can_vectorize() {
+        return !_is_place_holder && !_value.is_null() && column_storage(_col_type) != COL_INVALID;
+    }
+    //常量展开成和batch等长的列，行数不变时复用
+    virtual const ColumnVector* get_batch_value(ColumnBatch* batch) {
+        size_t num_rows = batch->num_rows();
+        if (_batch_value.type() != _col_type || _batch_value.size() != num_rows) {
+            if (_batch_value.init(_col_type) < 0) {
+                return nullptr;
+            }
+            ExprValue value = _value;
+            value.cast_to(_col_type);
+            _batch_value.reserve(num_rows);
+            for (size_t i = 0; i < num_rows; i++) {
+                _batch_value.append_value(value);
+            }
+        }
+        return &_batch_value;
+    }
+
+    virtual void close() {
+        _batch_value.clear();
+        ExprNode::close();
+    }
+
 private:
     void value_to_node_type() {
         _col_type = _value.type;
@@ -229,6 +258,7 @@ private:
 
 private:
     ExprValue _value;
+    ColumnVector _batch_value;
     int _place_holder_id = 0;
     bool _is_place_holder = false;
 };
@@ -15,6 +15,7 @@
 #pragma once
 
 #include <vector>
+#include <string>
 #include "expr_value.h"
 
 namespace baikaldb {
@@ -66,6 +67,46 @@ BINARY_OP_PREDICATE_ALL_TYPES_DEFINE(le);
 BINARY_OP_DEFINE(logic_and, bool);
 BINARY_OP_DEFINE(logic_or, bool);
 //BINARY_OP_DEFINE(logic_xor, bool);
+
+// 批量计算kernel，输入输出都是等长的连续数组，循环体无分支，便于编译器自动向量化
+// 值和null分开计算，null由调用方用merge_null_batch合并
+// bool结果用int64_t存放，和ColumnVector的int列一致
+#define BINARY_OP_BATCH_DEFINE(NAME, CTYPE, RTYPE) \
+    void NAME##_batch(const CTYPE* left, const CTYPE* right, RTYPE* out, size_t n);
+#define BINARY_OP_BATCH_ALL_TYPES_DEFINE(NAME) \
+    BINARY_OP_BATCH_DEFINE(NAME, int64_t, int64_t); \
+    BINARY_OP_BATCH_DEFINE(NAME, uint64_t, uint64_t); \
+    BINARY_OP_BATCH_DEFINE(NAME, double, double);
+#define BINARY_OP_PREDICATE_BATCH_ALL_TYPES_DEFINE(NAME) \
+    BINARY_OP_BATCH_DEFINE(NAME, int64_t, int64_t); \
+    BINARY_OP_BATCH_DEFINE(NAME, uint64_t, int64_t); \
+    BINARY_OP_BATCH_DEFINE(NAME, double, int64_t); \
+    BINARY_OP_BATCH_DEFINE(NAME, std::string, int64_t);
+// + - *
+BINARY_OP_BATCH_ALL_TYPES_DEFINE(add);
+BINARY_OP_BATCH_ALL_TYPES_DEFINE(minus);
+BINARY_OP_BATCH_ALL_TYPES_DEFINE(multiplies);
+// / %，除数为0时结果为null，null_map需已合并输入的null
+void divides_batch(const double* left, const double* right, double* out, uint8_t* null_map, size_t n);
+void mod_batch(const int64_t* left, const int64_t* right, int64_t* out, uint8_t* null_map, size_t n);
+void mod_batch(const uint64_t* left, const uint64_t* right, uint64_t* out, uint8_t* null_map, size_t n);
+// == != > >= < <=
+BINARY_OP_PREDICATE_BATCH_ALL_TYPES_DEFINE(eq);
+BINARY_OP_PREDICATE_BATCH_ALL_TYPES_DEFINE(ne);
+BINARY_OP_PREDICATE_BATCH_ALL_TYPES_DEFINE(gt);
+BINARY_OP_PREDICATE_BATCH_ALL_TYPES_DEFINE(ge);
+BINARY_OP_PREDICATE_BATCH_ALL_TYPES_DEFINE(lt);
+BINARY_OP_PREDICATE_BATCH_ALL_TYPES_DEFINE(le);
+// out = left | right
+void merge_null_batch(const uint8_t* left, const uint8_t* right, uint8_t* out, size_t n);
+// && || !，三值逻辑，语义同AndPredicate/OrPredicate/NotPredicate
+void logic_and_batch(const int64_t* left, const uint8_t* left_null,
+        const int64_t* right, const uint8_t* right_null,
+        int64_t* out, uint8_t* out_null, size_t n);
+void logic_or_batch(const int64_t* left, const uint8_t* left_null,
+        const int64_t* right, const uint8_t* right_null,
+        int64_t* out, uint8_t* out_null, size_t n);
+void logic_not_batch(const int64_t* in, int64_t* out, size_t n);
 }
 
 /* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -22,6 +22,8 @@
 namespace baikaldb {
 class AndPredicate : public ScalarFnCall {
 public:
+    virtual bool can_vectorize();
+    virtual const ColumnVector* get_batch_value(ColumnBatch* batch);
     virtual ExprValue get_value(MemRow* row) {
         ExprValue val1 = _children[0]->get_value(row);
         if (!val1.is_null() && val1.get_numberic<bool>() == false) { // short-circuit
@@ -40,6 +42,8 @@ public:
 
 class OrPredicate : public ScalarFnCall {
 public:
+    virtual bool can_vectorize();
+    virtual const ColumnVector* get_batch_value(ColumnBatch* batch);
     virtual ExprValue get_value(MemRow* row) {
         ExprValue val1 = _children[0]->get_value(row);
         if (!val1.is_null() && val1.get_numberic<bool>() == true) { // short-circuit
@@ -73,6 +77,8 @@ public:
 
 class IsNullPredicate : public ScalarFnCall {
 public:
+    virtual bool can_vectorize();
+    virtual const ColumnVector* get_batch_value(ColumnBatch* batch);
     virtual ExprValue get_value(MemRow* row) {
         ExprValue val1 = _children[0]->get_value(row);
         if (val1.is_null()) {
@@ -98,6 +104,9 @@ public:
     InPredicate() {}
     virtual int open();
     virtual ExprValue get_value(MemRow* row);
+    // 只支持单列in，row expr走行式
+    virtual bool can_vectorize();
+    virtual const ColumnVector* get_batch_value(ColumnBatch* batch);
 
 private:
     int singel_open();
@@ -145,6 +154,8 @@ private:
 
 class NotPredicate : public ScalarFnCall {
 public:
+    virtual bool can_vectorize();
+    virtual const ColumnVector* get_batch_value(ColumnBatch* batch);
     virtual ExprValue get_value(MemRow* row) {
         ExprValue val = _children[0]->get_value(row);
         if (!val.is_null()) {
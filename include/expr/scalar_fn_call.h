@@ -17,6 +17,7 @@
 #include <functional>
 #include "expr_node.h"
 #include "fn_manager.h"
+#include "column_batch.h"
 
 namespace baikaldb {
 class ScalarFnCall : public ExprNode {
@@ -26,6 +27,9 @@ public:
     virtual void children_swap();
     virtual int open();
     virtual ExprValue get_value(MemRow* row);
+    // 目前支持比较和+ - * / %
+    virtual bool can_vectorize();
+    virtual const ColumnVector* get_batch_value(ColumnBatch* batch);
     pb::Function fn() {
         return _fn;
     }
@@ -115,9 +119,17 @@ private:
     }
 
 protected:
+    // 第idx个子表达式的批量结果，按需cast到type
+    const ColumnVector* get_batch_child_value(size_t idx, ColumnBatch* batch, pb::PrimitiveType type);
+    // 批量结果按_col_type返回，和get_value最后的cast_to(_col_type)一致
+    const ColumnVector* batch_result();
+
     pb::Function _fn;
     bool _is_row_expr = false;
     std::function<ExprValue(const std::vector<ExprValue>&)> _fn_call;
+    std::vector<ColumnVector> _batch_args;
+    ColumnVector _batch_value;
+    ColumnVector _batch_cast_value;
 };
 }
 
@@ -14,6 +14,7 @@
 
 #pragma once
 #include "expr_node.h"
+#include "column_batch.h"
 
 namespace baikaldb {
 class SlotRef : public ExprNode {
@@ -34,6 +35,17 @@ public:
         }
         return row->get_value(_tuple_id, _slot_id).cast_to(_col_type);
     }
+    virtual bool can_vectorize() {
+        return column_storage(_col_type) != COL_INVALID;
+    }
+    //列由调用方按slot_ref的col_type加入batch，这里直接返回，不做拷贝
+    virtual const ColumnVector* get_batch_value(ColumnBatch* batch) {
+        ColumnVector* column = batch->get_column(_tuple_id, _slot_id);
+        if (column == nullptr || column->type() != _col_type) {
+            return nullptr;
+        }
+        return column;
+    }
 
     SlotRef* clone() {
         SlotRef* s = new SlotRef;
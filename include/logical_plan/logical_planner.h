@@ -117,6 +117,10 @@ public:
     virtual int plan() = 0;
 
     static int analyze(QueryContext* ctx);
+    // 计算慢查询聚合使用的sample_sql和sign
+    static void make_stat_sign(QueryContext* ctx);
+    // parser常量转成pb表达式节点，plan cache绑定参数时复用
+    static int create_literal_pb(const parser::LiteralExpr* literal, pb::ExprNode* node);
    
     static std::map<parser::JoinType, pb::JoinType> join_type_mapping;
     std::vector<std::string>& select_names() {
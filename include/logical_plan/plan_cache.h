@@ -0,0 +1,71 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Brief:  instance-wide logical plan cache for plain text select
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "lru_cache.h"
+#include "query_context.h"
+#include "parser.h"
+
+namespace baikaldb {
+// where中的常量替换成place holder后生成的逻辑计划模板
+struct CachedPlan {
+    bool valid = false; // false表示模板生成失败，一段时间内不再尝试
+    int64_t create_time_us = 0;
+    pb::Plan plan;
+    std::vector<pb::TupleDescriptor> tuple_descs;
+    // table_id => (db_id, version)，version变化后模板失效
+    std::map<int64_t, std::pair<int64_t, int64_t>> tables;
+    std::string family;
+    std::string table;
+    int64_t table_id = -1;
+    bool need_learner_backup = false;
+    size_t num_params = 0;
+};
+typedef std::shared_ptr<CachedPlan> SmartCachedPlan;
+
+// 全实例共享的select计划缓存，解决短连接和文本协议无法复用prepare计划的问题
+// key为namespace、db、字符集和where常量替换为?后的sql(即慢查询聚合用的sample)，以及各常量的类型
+// 只缓存无join、无子查询的select，命中后复用模板并绑定本次的常量，物理计划仍然每次生成
+class PlanCache {
+public:
+    static PlanCache* get_instance() {
+        static PlanCache _instance;
+        return &_instance;
+    }
+    // 返回0表示ctx的逻辑计划已经由缓存生成，-1表示不适用，走正常流程
+    int plan(QueryContext* ctx);
+    std::string get_info() {
+        return _cache.get_info();
+    }
+
+private:
+    PlanCache();
+    bool is_cacheable(QueryContext* ctx);
+    std::string make_key(QueryContext* ctx, const std::vector<parser::LiteralExpr*>& literals);
+    bool is_valid(QueryContext* ctx, const SmartCachedPlan& cached);
+    SmartCachedPlan create_template(QueryContext* ctx, std::vector<parser::LiteralExpr*>& literals);
+    int bind(QueryContext* ctx, const SmartCachedPlan& cached,
+            const std::vector<parser::LiteralExpr*>& literals);
+
+    Cache<std::string, SmartCachedPlan> _cache;
+};
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
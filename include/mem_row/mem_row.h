@@ -38,6 +38,10 @@ public:
             t = nullptr;
         }
     }
+    // 包含未使用的tuple_id，对应的tuple为nullptr
+    int32_t tuple_size() const {
+        return _tuples.size();
+    }
     google::protobuf::Message* get_tuple(int32_t tuple_id) {
         if (tuple_id >= (int32_t)_tuples.size()) {
             return nullptr;
@@ -151,10 +155,25 @@ public:
         return _used_size + 9 * _tuples.size() + sizeof(MemRow);
     }
 
+    // 计入MemTracker时记录，中途释放内存时只归还计入过的部分
+    void set_charged_size(int64_t size) {
+        _charged_size = size;
+    }
+    int64_t charged_size() const {
+        return _charged_size;
+    }
+    // 返回需要归还的大小并清零，避免重复归还
+    int64_t release_charged_size() {
+        int64_t size = _charged_size;
+        _charged_size = 0;
+        return size;
+    }
+
 private:
     std::vector<google::protobuf::Message*> _tuples;
     std::vector<bool> _tuples_assignd;
     int64_t _used_size;
+    int64_t _charged_size = 0;
 };
 }
 
@@ -30,6 +30,15 @@ public:
     bool need_not_compare() {
         return _slot_order_exprs.size() == 0;
     }
+    std::vector<ExprNode*>& slot_order_exprs() {
+        return _slot_order_exprs;
+    }
+    std::vector<bool>& is_asc() {
+        return _is_asc;
+    }
+    std::vector<bool>& is_null_first() {
+        return _is_null_first;
+    }
     int64_t compare(MemRow* left, MemRow* right);
 
     bool less(MemRow* left, MemRow* right) {
@@ -37,6 +37,13 @@ struct RegionPeerState {
     std::vector<pb::PeerStateInfo> ilegal_peers_state; // peer not in raft-group
 };
 
+// store上报的leader访问负载之和，用于按负载迁移leader
+struct InstanceLeaderLoad {
+    std::string resource_tag;
+    int64_t load = 0;
+    int64_t timestamp = 0;
+};
+
 struct RegionLearnerState {
     std::map<std::string, pb::PeerStateInfo> learner_state_map;
     TimeCost tc;
@@ -125,6 +132,12 @@ public:
                     pb::StoreHeartBeatResponse* response,
                     std::set<int64_t>& trans_leader_region_ids);
     
+    void leader_load_balance_on_hot(const std::string& instance,
+                                    const pb::StoreHeartBeatRequest* request,
+                                    bool can_transfer,
+                                    std::set<int64_t>& trans_leader_region_ids,
+                                    pb::StoreHeartBeatResponse* response);
+    
     void leader_load_balance_on_pk_prefix(const std::string& instance,
                                           const pb::StoreHeartBeatRequest* request,
                                           std::unordered_map<int64_t, int64_t>& table_total_instance_counts,
@@ -171,6 +184,7 @@ public:
         _instance_learner_map.clear();
         _instance_leader_count.clear();
         _instance_pk_prefix_leader_count.clear();
+        _instance_leader_load.clear();
         _remove_region_peer_on_pk_prefix.clear();
         _incremental_region_info.clear();
         _region_learner_peer_state_map.clear();
@@ -436,6 +450,10 @@ public:
         BAIDU_SCOPED_LOCK(_count_mutex);
         _instance_leader_count[instance][table_id]++;
     }
+    // 返回instance所在resource_tag内leader负载的平均值，无有效数据返回-1
+    int64_t get_average_leader_load(const std::string& resource_tag,
+                                    std::unordered_map<std::string, int64_t>* instance_loads);
+    bool is_leader_load_hot(const std::string& instance);
     std::string construct_region_key(int64_t region_id) {
         std::string region_key = MetaServer::SCHEMA_IDENTIFY + MetaServer::REGION_SCHEMA_IDENTIFY;
         region_key.append((char*)&region_id, sizeof(int64_t));
@@ -519,6 +537,7 @@ private:
     std::unordered_map<std::string, std::unordered_map<int64_t, int64_t>> _instance_leader_count;
     // instance_tableID -> pk_prefix -> leader region count
     std::unordered_map<std::string, std::unordered_map<std::string, int64_t>> _instance_pk_prefix_leader_count;
+    std::unordered_map<std::string, InstanceLeaderLoad> _instance_leader_load;
     // region_id -> logical_room，处理store心跳发现大户不均，标记需要迁移的region_id及其候选store需要在的logical room
     // check_peer_count发现region_id在map里，直接按照大户的维度删除peer数最多的candidate，否则按照table维度删除peer
     std::unordered_map<int64_t, std::string>            _remove_region_peer_on_pk_prefix;
@@ -85,6 +85,10 @@ struct TableMem {
         id_keyregion_map.clear();
     }
     int64_t statistics_version = 0;
+    // 统计信息自动收集，只保存在内存中，meta切主后重新累计
+    int64_t modified_rows = 0;     // 上次更新统计信息后的修改行数
+    std::string analyze_address;   // 正在执行analyze的baikaldb
+    int64_t analyze_assign_time = 0;
     void print() {
         //DB_WARNING("whether_level_table: %d, schema_pb: %s, is_global_index: %d, main_table_id:%ld, global_index_id: %ld",
         //            whether_level_table, schema_pb.ShortDebugString().c_str(), is_global_index,  main_table_id, global_index_id);
@@ -175,6 +179,16 @@ public:
         pb::BaikalHeartBeatResponse* response);
     void check_update_statistics(const pb::BaikalOtherHeartBeatRequest* request,
         pb::BaikalOtherHeartBeatResponse* response);
+    // 修改行数超过阈值的表分配给该baikaldb后台analyze
+    void assign_auto_analyze(const pb::BaikalOtherHeartBeatRequest* request,
+        pb::BaikalOtherHeartBeatResponse* response, const std::string& address);
+    void add_modified_rows(int64_t table_id, int64_t modified_rows) {
+        BAIDU_SCOPED_LOCK(_table_mutex);
+        auto iter = _table_info_map.find(table_id);
+        if (iter != _table_info_map.end()) {
+            iter->second.modified_rows += modified_rows;
+        }
+    }
     int get_statistics(const int64_t table_id, pb::Statistics& stat_pb);
     void check_update_or_drop_table(const pb::BaikalHeartBeatRequest* request,
                 pb::BaikalHeartBeatResponse* response);
@@ -15,11 +15,56 @@
 #pragma once
 
 #include "query_context.h"
+#include "scan_node.h"
 
 namespace baikaldb {
 class JoinReorder {
 public:
     int analyze(QueryContext* ctx);
+
+private:
+    friend class JoinReorderTest;
+    struct Relation {
+        int32_t tuple_id = 0;
+        ScanNode* scan_node = nullptr;
+        double rows = 0.0;      // 过滤后的行数
+        double read_rows = 0.0; // 索引读取的行数
+    };
+    // 等值join条件，left/right为relation下标
+    struct EqualEdge {
+        int left = 0;
+        int right = 0;
+        int32_t left_field = 0;
+        int32_t right_field = 0;
+        double selectivity = 1.0;
+    };
+    struct JoinPlan {
+        double cost = 0.0;
+        double rows = 0.0;
+        std::vector<int> order;
+        std::vector<pb::JoinAlgorithm> algos; // 与order一一对应，首表无意义
+    };
+
+    // 有统计信息时按代价枚举join顺序：表少时对子集做动态规划，表多时贪心
+    bool reorder_by_cost(std::map<int32_t, ExecNode*>& tuple_join_child_map,
+            std::vector<ExprNode*>& conditions,
+            std::vector<int32_t>& tuple_reorder,
+            std::vector<pb::JoinAlgorithm>& join_algos);
+    // 没有统计信息时基于规则：有索引的表做驱动表，按等值条件依次连接
+    bool reorder_by_rule(std::map<int32_t, ExecNode*>& tuple_join_child_map,
+            std::map<int32_t, std::set<int32_t>>& tuple_equals_map,
+            std::vector<int32_t>& tuple_order,
+            std::vector<int32_t>& tuple_reorder);
+    double join_step(const JoinPlan& plan, uint32_t mask, int next,
+            double* rows, pb::JoinAlgorithm* algo);
+    // 表数不超过join_reorder_dp_max_tables时dp，否则贪心
+    void enumerate(JoinPlan& best);
+    void dp_enumerate(JoinPlan& best);
+    void greedy_enumerate(JoinPlan& best);
+
+    std::vector<Relation> _relations;
+    std::vector<EqualEdge> _edges;
+    std::vector<uint32_t> _adjacent; // 与每个relation有等值条件的relation集合
 };
 }
 
@@ -21,6 +21,8 @@ namespace baikaldb {
 
 const size_t MAX_ALLOC_BUF_SIZE = (1024 * 1024 * 1024 * 2ULL);
 const size_t DFT_ALLOC_BUF_SIZE = (1024 * 1024);
+// 非string类型的text protocol编码最大长度(含1字节长度)
+const size_t MAX_TEXT_VALUE_LEN = 64;
 
 class DataBuffer {
 public:
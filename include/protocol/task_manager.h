@@ -15,6 +15,8 @@ public:
 
     void process_ddl_work(pb::RegionDdlWork work);
     void process_txn_ddl_work(pb::DdlWorkInfo work);
+    // meta分配的统计信息过期表，走analyze流程重新采样
+    void process_analyze_work(int64_t table_id);
 
 private:
     ConcurrencyBthread _workers {FLAGS_worker_number};
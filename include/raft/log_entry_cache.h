@@ -0,0 +1,114 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <bthread/mutex.h>
+#include <bvar/bvar.h>
+#ifdef BAIDU_INTERNAL
+#include <raft/log_entry.h>
+#else
+#include <braft/log_entry.h>
+#endif
+#include "common.h"
+#include "my_raft_log_storage.h"
+
+namespace baikaldb {
+
+// 单个region最近追加的日志，直接持有braft::LogEntry的引用，data与raft共享block不拷贝
+// 只缓存日志尾部，保证[first_index, last_index]连续且last_index等于storage的last_log_index
+class RegionLogCache {
+public:
+    // 返回0继续，1停止，-1出错
+    typedef std::function<int(int64_t log_index, const LogHead& head,
+            const rocksdb::Slice& data)> ScanFunc;
+
+    RegionLogCache() {}
+    ~RegionLogCache() {
+        clear();
+    }
+    // entries写盘成功后调用
+    void append(const std::vector<braft::LogEntry*>& entries);
+    // 命中返回AddRef过的entry，未命中返回NULL
+    braft::LogEntry* get_entry(int64_t index);
+    void truncate_prefix(int64_t first_index_kept);
+    void truncate_suffix(int64_t last_index_kept);
+    void clear();
+    // start_index不在缓存中返回-2，由调用方读盘；其他返回值同LogEntryReader::scan_log_entry
+    int scan(int64_t start_index, int64_t end_index, const ScanFunc& func);
+
+private:
+    void pop_front();
+
+    bthread::Mutex _mutex;
+    std::deque<scoped_refptr<braft::LogEntry>> _entries;
+    int64_t _bytes = 0;
+};
+
+// region_id => RegionLogCache，供split等不经过LogStorage的读日志流程使用
+class LogEntryCache {
+public:
+    static LogEntryCache* get_instance() {
+        static LogEntryCache _instance;
+        return &_instance;
+    }
+    // LogStorage init时注册，替换掉同一region之前的缓存
+    std::shared_ptr<RegionLogCache> register_region(int64_t region_id);
+    // 只删除自己注册的缓存
+    void unregister_region(int64_t region_id, const std::shared_ptr<RegionLogCache>& cache);
+    void remove_region(int64_t region_id);
+    std::shared_ptr<RegionLogCache> get_region(int64_t region_id);
+
+    bool enabled() const;
+    void add_bytes(int64_t bytes) {
+        _total_bytes.fetch_add(bytes);
+        _cache_bytes << bytes;
+    }
+    bool over_limit() const;
+    // 总量超限时每个region可以保留的字节数
+    int64_t region_share_bytes() const;
+    void hit(int64_t count) {
+        _hit_count << count;
+    }
+    void miss(int64_t count) {
+        _miss_count << count;
+    }
+
+private:
+    LogEntryCache();
+    static double get_hit_ratio(void* arg);
+
+    std::atomic<int64_t> _total_bytes{0};
+    std::atomic<int64_t> _region_num{0};
+    bvar::Adder<int64_t> _cache_bytes;
+    bvar::Adder<int64_t> _hit_count;
+    bvar::Adder<int64_t> _miss_count;
+    bvar::Window<bvar::Adder<int64_t>> _hit_minute;
+    bvar::Window<bvar::Adder<int64_t>> _miss_minute;
+    bvar::PassiveStatus<double> _hit_ratio;
+
+    // 析构时RegionLogCache会更新上面的统计，需要放在最后先析构
+    bthread::Mutex _mutex;
+    std::unordered_map<int64_t, std::shared_ptr<RegionLogCache>> _region_caches;
+};
+
+} // namespace baikaldb
+
+/* vim: set expandtab ts=4 sw=4 sts=4 tw=100: */
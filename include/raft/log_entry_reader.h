@@ -14,7 +14,9 @@
 
 #pragma once
 
+#include <functional>
 #include "rocks_wrapper.h"
+#include "my_raft_log_storage.h"
 
 namespace baikaldb {
 class LogEntryReader {
@@ -41,6 +43,13 @@ public:
     }
     int read_txn_last_log_entry(int64_t region_id, int64_t start_log_index, int64_t end_log_index,
         std::set<uint64_t>& txn_ids, std::map<uint64_t, std::string>& log_entrys);
+    // 返回0继续，1停止，-1出错
+    typedef std::function<int(int64_t log_index, const LogHead& head,
+            const rocksdb::Slice& data)> ScanFunc;
+    // 按log_index顺序扫描[start_log_index, end_log_index]，日志在segment中时从segment读
+    // 返回-1出错，1表示还有后续日志，0表示没有了
+    int scan_log_entry(int64_t region_id, int64_t start_log_index, int64_t end_log_index,
+        const ScanFunc& func);
 private:
     LogEntryReader() {}
 
@@ -36,6 +36,7 @@
 #include "index_term_map.h"
 
 namespace baikaldb {
+class RegionLogCache;
 
 struct LogHead {
     explicit LogHead(const rocksdb::Slice& raw) {
@@ -160,6 +161,7 @@ private:
 
     IndexTermMap _term_map;
     bthread_mutex_t _mutex; // for term_map     
+    std::shared_ptr<RegionLogCache> _cache; // 最近追加的日志
 }; // class 
 
 } //namespace raft
@@ -0,0 +1,240 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <bthread/mutex.h>
+#include <bvar/bvar.h>
+#ifdef BAIDU_INTERNAL
+#include <base/iobuf.h>
+#include <raft/storage.h>
+#else
+#include <butil/iobuf.h>
+#include <braft/storage.h>
+#endif
+#include "common.h"
+#include "group_executor.h"
+#include "rocks_wrapper.h"
+#include "index_term_map.h"
+#include "my_raft_log_storage.h"
+
+namespace baikaldb {
+
+// 一条日志在segment文件中的位置
+struct LogLocation {
+    int64_t segment_id = 0;
+    int64_t offset = 0;     // record header的偏移
+    uint32_t data_len = 0;
+    int type = 0;           // braft::EntryType
+    int64_t term = 0;
+};
+
+// segment文件中的一条记录
+// header: data_len(4) + data_crc(4) + kind(4) + type(4) + region_id(8) + index(8) + term(8)
+//         + header_crc(4)，之后是data
+struct LogRecord {
+    enum Kind {
+        ENTRY = 1,
+        REWRITE = 2,          // gc把region的整段日志倒序重写到新segment
+        TRUNCATE_SUFFIX = 3,  // index为last_index_kept
+        REMOVE_REGION = 4,
+    };
+    static const size_t HEADER_SIZE = 44;
+    int kind = ENTRY;
+    int type = 0;
+    int64_t region_id = 0;
+    int64_t index = 0;
+    int64_t term = 0;
+    butil::IOBuf data;
+    // 写入后填充，不落盘
+    LogLocation location;
+};
+
+// 整个store共享的追加写raft日志引擎，所有region的日志写入同一组segment文件
+// 内存中按region维护index => LogLocation，并发写入的多个region合并为一次write+fdatasync
+// 只有最老的segment可以删除，保证删除后重放剩余segment得到的结果不变
+class SegmentLogEngine {
+friend class SegmentLogEngineTest;
+public:
+    // 返回0继续，1停止，-1出错
+    typedef std::function<int(int64_t log_index, const LogHead& head,
+            const rocksdb::Slice& data)> ScanFunc;
+
+    static SegmentLogEngine* get_instance() {
+        static SegmentLogEngine _instance;
+        return &_instance;
+    }
+    ~SegmentLogEngine() {}
+
+    // 扫描所有segment重建索引，可重复调用
+    int init();
+    bool is_init() const {
+        return _is_init.load();
+    }
+    void close();
+
+    // 同步写入region的records，返回后已落盘并更新索引
+    int append(int64_t region_id, std::vector<LogRecord>& records);
+    int truncate_suffix(int64_t region_id, int64_t last_index_kept);
+    // 只修改内存，first_log_index由调用方持久化
+    void truncate_prefix(int64_t region_id, int64_t first_index_kept);
+    int remove_region(int64_t region_id);
+
+    bool has_region(int64_t region_id);
+    // 按持久化的first_log_index裁剪日志，返回region的所有日志位置(从first_log_index开始)
+    int attach_region(int64_t region_id, int64_t first_log_index,
+            std::vector<LogLocation>* locations);
+    // 删除不属于本store的region日志(region已删除但REMOVE记录未写入)
+    void drop_unknown_regions(const std::set<int64_t>& region_ids);
+
+    int read(int64_t region_id, int64_t index, LogLocation* location, butil::IOBuf* data);
+    // 扫描[start_index, end_index]，返回-1出错，1表示end_index之后还有日志，0表示没有了
+    int scan(int64_t region_id, int64_t start_index, int64_t end_index, const ScanFunc& func);
+
+private:
+    struct Segment {
+        int64_t id = 0;
+        int fd = -1;
+        std::string path;
+        int64_t size = 0;
+        int64_t live_count = 0;
+        ~Segment();
+    };
+    typedef std::shared_ptr<Segment> SmartSegment;
+
+    struct RegionLog {
+        int64_t first_index = 0;
+        std::deque<LogLocation> locations;
+        int64_t last_index() const {
+            return first_index + (int64_t)locations.size() - 1;
+        }
+    };
+
+    struct AppendTask {
+        std::vector<LogRecord>* records = nullptr;
+        int64_t bytes = 0;
+        int ret = 0;
+    };
+
+    SegmentLogEngine();
+    // region级别的写互斥，gc重写region日志时只在每一批的读写期间持有
+    std::shared_ptr<bthread::Mutex> region_write_mutex(int64_t region_id);
+    int append_records(std::vector<LogRecord>& records);
+    int recover_segment(const SmartSegment& segment, bool is_last);
+    int open_segment(int64_t id, SmartSegment* segment);
+    void write_batch(std::vector<AppendTask*>& batch);
+    int write_records(std::vector<AppendTask*>& batch);
+    void apply_record(const LogRecord& record, bool recovering);
+    void remove_locations(RegionLog& log, size_t pos);
+    void release_location(const LogLocation& location);
+    int read_location(int64_t region_id, int64_t index, const LogLocation& location,
+            const SmartSegment& segment, butil::IOBuf* data);
+    void gc_segments();
+    // 删除没有存活日志的最老segment，segment过多时重写占用最老segment的region
+    void gc_once();
+    int rewrite_region(int64_t region_id);
+
+    std::atomic<bool> _is_init{false};
+    bthread::Mutex _init_mutex;
+    std::string _path;
+
+    // 索引和segment列表
+    bthread::Mutex _index_mutex;
+    std::map<int64_t, RegionLog> _region_logs;
+    std::map<int64_t, SmartSegment> _segments;
+    SmartSegment _active;
+
+    bthread::Mutex _region_mutex;
+    std::map<int64_t, std::shared_ptr<bthread::Mutex>> _region_write_mutex;
+
+    // group commit：一次write+fdatasync写入多个region的请求
+    GroupExecutor<AppendTask> _group_writer;
+
+    bool _shutdown = false;
+    Bthread _gc_bth;
+
+    bvar::LatencyRecorder _write_time_cost{"raft_log_segment_write_time_cost"};
+    bvar::IntRecorder _write_batch_size;
+    bvar::Window<bvar::IntRecorder> _write_batch_size_window{
+            "raft_log_segment_write_batch_size", &_write_batch_size, -1};
+};
+
+// 基于SegmentLogEngine的LogStorage，uri: mysegmentlog://my_raft_log?id=region_id
+// first_log_index仍然记录在raft_log_cf的meta key中，raft_log_cf里已有的日志在init时迁移过来
+class SegmentLogStorage : public braft::LogStorage {
+public:
+    SegmentLogStorage() {}
+    ~SegmentLogStorage();
+
+    int init(braft::ConfigurationManager* configuration_manager) override;
+
+    int64_t first_log_index() override {
+        return _first_log_index.load(std::memory_order_relaxed);
+    }
+
+    int64_t last_log_index() override {
+        return _last_log_index.load(std::memory_order_relaxed);
+    }
+
+    braft::LogEntry* get_entry(const int64_t index) override;
+
+    int64_t get_term(const int64_t index) override;
+
+    int append_entry(const braft::LogEntry* entry) override;
+
+    int append_entries(const std::vector<braft::LogEntry*>& entries,
+            braft::IOMetric* metric) override;
+
+    int truncate_prefix(const int64_t first_index_kept) override;
+
+    int truncate_suffix(const int64_t last_index_kept) override;
+
+    int reset(const int64_t next_log_index) override;
+
+    LogStorage* new_instance(const std::string& uri) const override;
+
+private:
+    SegmentLogStorage(int64_t region_id, RocksWrapper* db,
+            rocksdb::ColumnFamilyHandle* raftlog_handle) :
+        _region_id(region_id), _db(db), _raftlog_handle(raftlog_handle) {}
+
+    int load_first_log_index(int64_t* first_log_index);
+    int migrate_from_rocksdb(int64_t first_log_index);
+    int build_record(const braft::LogEntry* entry, LogRecord* record);
+    int parse_meta(braft::LogEntry* entry, const butil::IOBuf& data);
+    std::string log_meta_key();
+
+    std::atomic<int64_t> _first_log_index{0};
+    std::atomic<int64_t> _last_log_index{0};
+    int64_t _region_id = 0;
+    RocksWrapper* _db = nullptr;
+    rocksdb::ColumnFamilyHandle* _raftlog_handle = nullptr;
+    SegmentLogEngine* _engine = SegmentLogEngine::get_instance();
+
+    IndexTermMap _term_map;
+    bthread::Mutex _mutex; // for term_map
+    std::shared_ptr<RegionLogCache> _cache; // 最近追加的日志
+};
+
+} // namespace baikaldb
+
+/* vim: set expandtab ts=4 sw=4 sts=4 tw=100: */
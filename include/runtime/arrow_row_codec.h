@@ -0,0 +1,56 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "column_batch.h"
+#include "proto/plan.pb.h"
+
+namespace arrow {
+class Schema;
+}
+
+namespace baikaldb {
+class MemRowDescriptor;
+// store返回select结果的列式编码，格式为Arrow IPC record batch
+// 每个(tuple_id, slot_id)一列，按tuples和slots的顺序排列，两端由相同的tuple desc得到相同的schema
+// null对应MemRow中未设置的字段
+class ArrowRowCodec {
+public:
+    // 有不支持列存的slot类型时返回-1，调用方使用pb行格式
+    int init(const std::vector<const pb::TupleDescriptor*>& tuples);
+    int append_row(MemRow* row) {
+        return _columns.append_row(row);
+    }
+    size_t num_rows() const {
+        return _columns.num_rows();
+    }
+    int64_t used_size() const {
+        return _columns.used_size();
+    }
+    // 编码已追加的行，之后清空
+    int serialize(std::string* out);
+    // 直接读取in中的Arrow buffer转成行，in在调用期间不能释放
+    int deserialize(const std::string& in, MemRowDescriptor* desc, RowBatch* batch);
+
+private:
+    ColumnBatch _columns;
+    std::shared_ptr<arrow::Schema> _schema;
+};
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
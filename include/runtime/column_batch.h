@@ -0,0 +1,322 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include "expr_value.h"
+#include "mem_row.h"
+#include "row_batch.h"
+
+namespace baikaldb {
+class ExprNode;
+class MemRowDescriptor;
+
+// 列的物理存储类型，和operators里int/uint/double/string的划分保持一致
+enum ColumnStorage {
+    COL_INVALID = 0,
+    COL_INT     = 1,
+    COL_UINT    = 2,
+    COL_DOUBLE  = 3,
+    COL_STRING  = 4
+};
+
+inline ColumnStorage column_storage(pb::PrimitiveType type) {
+    switch (type) {
+        case pb::BOOL:
+        case pb::INT8:
+        case pb::INT16:
+        case pb::INT32:
+        case pb::INT64:
+        case pb::TIME:
+            return COL_INT;
+        case pb::UINT8:
+        case pb::UINT16:
+        case pb::UINT32:
+        case pb::UINT64:
+        case pb::DATE:
+        case pb::DATETIME:
+        case pb::TIMESTAMP:
+            return COL_UINT;
+        case pb::FLOAT:
+        case pb::DOUBLE:
+            return COL_DOUBLE;
+        case pb::STRING:
+        case pb::HEX:
+            return COL_STRING;
+        default:
+            return COL_INVALID;
+    }
+}
+
+// 单个slot的类型化列
+// null行在数据数组中也占位，保证下标对齐
+class ColumnVector {
+using FieldDescriptor = google::protobuf::FieldDescriptor;
+using Message = google::protobuf::Message;
+public:
+    ColumnVector() {}
+    explicit ColumnVector(pb::PrimitiveType type) {
+        init(type);
+    }
+    int init(pb::PrimitiveType type) {
+        _type = type;
+        _storage = column_storage(type);
+        clear();
+        return _storage == COL_INVALID ? -1 : 0;
+    }
+    void reserve(size_t capacity) {
+        _null_map.reserve(capacity);
+        switch (_storage) {
+            case COL_INT:
+                _int_data.reserve(capacity);
+                break;
+            case COL_UINT:
+                _uint_data.reserve(capacity);
+                break;
+            case COL_DOUBLE:
+                _double_data.reserve(capacity);
+                break;
+            case COL_STRING:
+                _string_data.reserve(capacity);
+                break;
+            default:
+                break;
+        }
+    }
+    void clear() {
+        _null_map.clear();
+        _int_data.clear();
+        _uint_data.clear();
+        _double_data.clear();
+        _string_data.clear();
+        _used_size = 0;
+    }
+    // 批量计算时按行数预分配，之后通过mutable接口直接写
+    void resize(size_t size) {
+        _null_map.resize(size, 0);
+        switch (_storage) {
+            case COL_INT:
+                _int_data.resize(size);
+                break;
+            case COL_UINT:
+                _uint_data.resize(size);
+                break;
+            case COL_DOUBLE:
+                _double_data.resize(size);
+                break;
+            case COL_STRING:
+                _string_data.resize(size);
+                break;
+            default:
+                break;
+        }
+    }
+    pb::PrimitiveType type() const {
+        return _type;
+    }
+    ColumnStorage storage() const {
+        return _storage;
+    }
+    size_t size() const {
+        return _null_map.size();
+    }
+    size_t null_count() const {
+        return std::count(_null_map.begin(), _null_map.end(), 1);
+    }
+    bool is_null(size_t idx) const {
+        return _null_map[idx] != 0;
+    }
+    // 每行一个字节，1表示null；用字节而不是bit，批量计算时循环更容易向量化
+    const uint8_t* null_map() const {
+        return _null_map.data();
+    }
+    const int64_t* int_data() const {
+        return _int_data.data();
+    }
+    const uint64_t* uint_data() const {
+        return _uint_data.data();
+    }
+    const double* double_data() const {
+        return _double_data.data();
+    }
+    const std::vector<std::string>& string_data() const {
+        return _string_data;
+    }
+    uint8_t* mutable_null_map() {
+        return _null_map.data();
+    }
+    int64_t* mutable_int_data() {
+        return _int_data.data();
+    }
+    uint64_t* mutable_uint_data() {
+        return _uint_data.data();
+    }
+    double* mutable_double_data() {
+        return _double_data.data();
+    }
+    std::vector<std::string>* mutable_string_data() {
+        return &_string_data;
+    }
+
+    void append_null();
+    void append_int(int64_t val) {
+        _null_map.push_back(0);
+        _int_data.push_back(val);
+    }
+    void append_uint(uint64_t val) {
+        _null_map.push_back(0);
+        _uint_data.push_back(val);
+    }
+    void append_double(double val) {
+        _null_map.push_back(0);
+        _double_data.push_back(val);
+    }
+    void append_string(const std::string& val) {
+        _null_map.push_back(0);
+        _string_data.push_back(val);
+        _used_size += val.size();
+    }
+    // value会先cast到列类型，语义和SlotRef::get_value一致
+    void append_value(const ExprValue& value);
+    // 直接通过反射取值，field为tuple中slot对应的字段
+    void append_field(const Message* tuple, const FieldDescriptor* field);
+
+    ExprValue get_value(size_t idx) const;
+    // 整列cast，语义同ExprValue::cast_to；纯数值之间的转换按列批量做
+    int cast_to(pb::PrimitiveType type, ColumnVector* out) const;
+    // cast到type后存储数组的值不变(如INT32=>INT64)，批量计算时可以直接使用本列
+    bool can_share_storage(pb::PrimitiveType type) const;
+
+    // 两行都非null时的比较，结果和ExprValue::compare一致
+    int64_t compare(size_t left, size_t right) const {
+        switch (_storage) {
+            case COL_INT:
+                return _int_data[left] > _int_data[right] ? 1 :
+                    (_int_data[left] < _int_data[right] ? -1 : 0);
+            case COL_UINT:
+                return _uint_data[left] > _uint_data[right] ? 1 :
+                    (_uint_data[left] < _uint_data[right] ? -1 : 0);
+            case COL_DOUBLE:
+                return _double_data[left] > _double_data[right] ? 1 :
+                    (_double_data[left] < _double_data[right] ? -1 : 0);
+            case COL_STRING:
+                return _string_data[left].compare(_string_data[right]);
+            default:
+                return 0;
+        }
+    }
+
+    int64_t used_size() const {
+        return _used_size + _null_map.size() * (sizeof(uint8_t) + sizeof(int64_t));
+    }
+
+private:
+    pb::PrimitiveType _type = pb::INVALID_TYPE;
+    ColumnStorage _storage = COL_INVALID;
+    std::vector<uint8_t> _null_map;
+    std::vector<int64_t> _int_data;
+    std::vector<uint64_t> _uint_data;
+    std::vector<double> _double_data;
+    std::vector<std::string> _string_data;
+    int64_t _used_size = 0;
+};
+
+// 列式batch，每个(tuple_id, slot_id)一列
+// 通过append_row/to_row和MemRow互转，未改造的节点仍然使用RowBatch
+class ColumnBatch {
+public:
+    ColumnBatch() {}
+    // slot start with 1，返回列下标，类型不支持列存时返回-1
+    int add_column(int32_t tuple_id, int32_t slot_id, pb::PrimitiveType type);
+    // exprs全部是slot_ref且类型支持列存时返回0，否则返回-1，调用方走行式逻辑
+    // 同时按exprs顺序记录列下标，供compare_row使用
+    int add_slot_ref_columns(const std::vector<ExprNode*>& exprs);
+
+    ColumnVector* get_column(int32_t tuple_id, int32_t slot_id) {
+        auto iter = _column_idx.find(std::make_pair(tuple_id, slot_id));
+        if (iter == _column_idx.end()) {
+            return nullptr;
+        }
+        return &_columns[iter->second].column;
+    }
+    ColumnVector* column(size_t idx) {
+        return &_columns[idx].column;
+    }
+    size_t num_columns() const {
+        return _columns.size();
+    }
+    size_t num_rows() const {
+        return _num_rows;
+    }
+    // 清空数据，保留列定义
+    void clear() {
+        for (auto& col : _columns) {
+            col.column.clear();
+        }
+        _num_rows = 0;
+    }
+    void reserve(size_t capacity) {
+        for (auto& col : _columns) {
+            col.column.reserve(capacity);
+        }
+    }
+    // 按行数预分配所有列，之后通过ColumnVector的mutable接口直接写
+    void resize(size_t num_rows) {
+        for (auto& col : _columns) {
+            col.column.resize(num_rows);
+        }
+        _num_rows = num_rows;
+    }
+
+    // 行转列
+    int append_row(MemRow* row);
+    int append_rows(RowBatch* batch);
+
+    // 列转行，只填充本batch包含的slot
+    int to_row(size_t idx, MemRow* row);
+    int to_row_batch(MemRowDescriptor* desc, RowBatch* batch);
+
+    // 按add_slot_ref_columns的exprs顺序比较第left和第right行，语义同MemRowCompare::compare
+    int64_t compare_row(size_t left, size_t right,
+            const std::vector<bool>& is_asc, const std::vector<bool>& is_null_first) const;
+
+    int64_t used_size() const {
+        int64_t used_size = 0;
+        for (auto& col : _columns) {
+            used_size += col.column.used_size();
+        }
+        return used_size;
+    }
+
+private:
+    struct ColumnSlot {
+        int32_t tuple_id = -1;
+        int32_t slot_id = -1;
+        // 同一个query的tuple descriptor不变，首行解析后缓存
+        const google::protobuf::FieldDescriptor* field = nullptr;
+        ColumnVector column;
+    };
+    std::vector<ColumnSlot> _columns;
+    std::map<std::pair<int32_t, int32_t>, size_t> _column_idx;
+    std::vector<size_t> _expr_columns;
+    size_t _num_rows = 0;
+};
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -0,0 +1,156 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <fstream>
+#include <functional>
+#include <vector>
+#include "common.h"
+#include "row_batch.h"
+#include "mem_row_compare.h"
+#include "mem_row_descriptor.h"
+#include "sorter.h"
+
+namespace baikaldb {
+class RuntimeState;
+
+// 败者树，k路归并时每出一行只需要log(k)次比较
+// less(i, j)表示第i路当前行小于第j路，已耗尽的路需要视为最大
+class LoserTree {
+public:
+    void init(size_t k, const std::function<bool(int, int)>& less) {
+        _k = k;
+        _less = less;
+        // -1表示尚未参与比较的空位，视为最小，保证初始化时所有路都能上浮
+        _tree.assign(k, -1);
+        for (int i = (int)k - 1; i >= 0; i--) {
+            adjust(i);
+        }
+    }
+    // 当前最小的路
+    int top() const {
+        return _tree.empty() ? -1 : _tree[0];
+    }
+    // 第leaf路的当前行变化后，沿路径重新比较
+    void adjust(int leaf) {
+        int winner = leaf;
+        for (size_t t = (leaf + _k) / 2; t > 0; t /= 2) {
+            if (_tree[t] == -1 || (winner != -1 && _less(_tree[t], winner))) {
+                std::swap(winner, _tree[t]);
+            }
+        }
+        _tree[0] = winner;
+    }
+
+private:
+    size_t _k = 0;
+    std::vector<int> _tree;
+    std::function<bool(int, int)> _less;
+};
+
+// 落盘的有序run
+// 行编码: varint32(行长度) + 每个tuple的varint32(长度) + pb序列化
+class SortRunWriter {
+public:
+    ~SortRunWriter() {
+        close();
+    }
+    int open(const std::string& path);
+    int append(MemRow* row);
+    int close();
+    int64_t num_rows() const {
+        return _num_rows;
+    }
+    int64_t file_size() const {
+        return _file_size;
+    }
+
+private:
+    int flush();
+
+    std::ofstream _fs;
+    std::string _buf;
+    std::string _row_buf;
+    int64_t _num_rows = 0;
+    int64_t _file_size = 0;
+};
+
+class SortRunReader {
+public:
+    int open(const std::string& path, MemRowDescriptor* desc);
+    // 读完时row为nullptr
+    int next(std::unique_ptr<MemRow>* row);
+
+private:
+    // 文件结尾返回1
+    int read_varint32(uint32_t* value);
+
+    std::ifstream _fs;
+    std::string _buf;
+    std::unique_ptr<char[]> _io_buf;
+    MemRowDescriptor* _desc = nullptr;
+};
+
+// 支持落盘的排序
+// 内存中的数据超过sort_spill_memory_bytes后，排好序写成一个run并释放内存，
+// 最后把所有run和内存中剩余的数据用败者树做多路归并
+// 没有发生落盘时退化为Sorter
+class ExternalSorter {
+public:
+    ExternalSorter(MemRowCompare* comp, MemRowDescriptor* desc, RuntimeState* state) :
+        _comp(comp), _desc(desc), _state(state) {
+    }
+    ~ExternalSorter();
+    int add_batch(std::shared_ptr<RowBatch>& batch);
+    int sort();
+    int get_next(RowBatch* batch, bool* eos);
+
+    size_t run_count() const {
+        return _run_files.size();
+    }
+    int64_t spill_rows() const {
+        return _spill_rows;
+    }
+    int64_t spill_bytes() const {
+        return _spill_bytes;
+    }
+
+private:
+    int spill_run();
+    // 第idx路取下一行到_cur_rows[idx]
+    int fetch_next(size_t idx);
+    bool source_less(int left, int right);
+
+private:
+    MemRowCompare* _comp;
+    MemRowDescriptor* _desc;
+    RuntimeState* _state;
+    std::vector<std::shared_ptr<RowBatch>> _mem_batches;
+    int64_t _mem_bytes = 0;
+    std::shared_ptr<Sorter> _mem_sorter;
+
+    std::vector<std::string> _run_files;
+    std::vector<std::unique_ptr<SortRunReader>> _readers;
+    // 内存中剩余数据作为最后一路，从_mem_sorter分批取
+    RowBatch _mem_batch;
+    bool _mem_eos = true;
+    std::vector<std::unique_ptr<MemRow>> _cur_rows;
+    LoserTree _loser_tree;
+    int64_t _spill_rows = 0;
+    int64_t _spill_bytes = 0;
+};
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -96,6 +96,16 @@ public:
         std::sort(_rows.begin(), _rows.end(), 
                 comp->get_less_func());
     }
+    // 按order给出的下标重排，order必须是[0, size())的一个排列
+    void reorder(const std::vector<size_t>& order) {
+        std::vector<std::unique_ptr<MemRow>> tmp;
+        tmp.reserve(order.size());
+        for (auto idx : order) {
+            tmp.push_back(std::move(_rows[idx]));
+        }
+        _rows.swap(tmp);
+        _idx = 0;
+    }
     void swap(RowBatch& batch) {
         _rows.swap(batch._rows);
     }
@@ -0,0 +1,76 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "expr_value.h"
+#include "proto/plan.pb.h"
+
+namespace baikaldb {
+// join的runtime filter，由build侧的join key生成，作用在probe侧的单个列上
+// 包含一个bloom filter和[min, max]范围，范围可以转成谓词参与索引选择和region裁剪
+// null不会插入，也不会被命中(null不满足等值join)
+class RuntimeFilter {
+public:
+    // hash join按cast_to(STRING)后的值匹配，bloom按列的原始值hash，两者等价时才能使用
+    // 只允许类型相同，或同为有符号/无符号整数；TIMESTAMP和DATETIME、FLOAT和DOUBLE不满足
+    static bool type_match(pb::PrimitiveType left, pb::PrimitiveType right);
+    // type为probe侧列的类型，expected_cnt为build侧的行数
+    int init(pb::PrimitiveType type, int64_t expected_cnt);
+    void insert(const ExprValue& value);
+    // 可能误判为存在，不会漏判
+    bool may_contain(const ExprValue& value) const;
+    // 只序列化bloom filter，范围已经转成了谓词
+    void to_pb(int32_t slot_id, pb::RuntimeFilter* pb_filter) const;
+    int init_from_pb(const pb::RuntimeFilter& pb_filter);
+    size_t byte_size() const {
+        return _bits.size() * sizeof(uint64_t);
+    }
+
+    pb::PrimitiveType type() const {
+        return _type;
+    }
+    bool empty() const {
+        return _num_values == 0;
+    }
+    int64_t num_values() const {
+        return _num_values;
+    }
+    const ExprValue& min_value() const {
+        return _min_value;
+    }
+    const ExprValue& max_value() const {
+        return _max_value;
+    }
+    size_t bits_size() const {
+        return _bits.size() * 64;
+    }
+
+private:
+    // 按列的存储类型归一化后再hash，INT32和INT64的相同值hash一致
+    uint64_t value_hash(const ExprValue& value) const;
+
+    pb::PrimitiveType _type = pb::INVALID_TYPE;
+    std::vector<uint64_t> _bits;
+    uint64_t _num_bits = 0;
+    int32_t _num_hashes = 0;
+    int64_t _num_values = 0;
+    ExprValue _min_value;
+    ExprValue _max_value;
+};
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
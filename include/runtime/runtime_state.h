@@ -21,6 +21,7 @@
 #include <brpc/channel.h>
 #endif
 #include "mem_row_descriptor.h"
+#include "store_plan_cache.h"
 #include "data_buffer.h"
 #include "proto/store.interface.pb.h"
 #include "transaction_pool.h"
@@ -81,11 +82,13 @@ public:
     }
 
     // baikalStore init
+    // prepared非空时使用缓存的tuple desc和MemRowDescriptor，忽略tuples
     int init(const pb::StoreReq& req,
         const pb::Plan& plan, 
         const RepeatedPtrField<pb::TupleDescriptor>& tuples,
         TransactionPool* pool,
-        bool store_compute_separate, bool is_binlog_region = false);
+        bool store_compute_separate, bool is_binlog_region = false,
+        const SmartPreparedTuples& prepared = nullptr);
 
     // baikaldb init
     int init(QueryContext* ctx, DataBuffer* send_buf);
@@ -130,8 +133,18 @@ public:
         return _tuple_descs;
     }
     MemRowDescriptor* mem_row_desc() {
+        if (_shared_mem_row_desc != nullptr) {
+            return _shared_mem_row_desc.get();
+        }
         return &_mem_row_desc;
     }
+    // baikaldb使用，tuple desc的签名，store据此缓存
+    uint64_t tuples_sign() {
+        if (_tuples_sign == 0) {
+            _tuples_sign = make_tuples_sign(_tuple_descs);
+        }
+        return _tuples_sign;
+    }
     int64_t region_id() {
         return _region_id;
     }
@@ -370,6 +383,9 @@ public:
     }
     int memory_limit_exceeded(int64_t bytes);
     int memory_limit_release(int64_t bytes);
+    int64_t used_bytes() const {
+        return _used_bytes;
+    }
 
 public:
     uint64_t          txn_id = 0;
@@ -408,6 +424,9 @@ private:
     bool _is_expr_subquery = false;
     std::vector<pb::TupleDescriptor> _tuple_descs;
     MemRowDescriptor _mem_row_desc;
+    // store上命中缓存时与其他请求共享
+    std::shared_ptr<MemRowDescriptor> _shared_mem_row_desc;
+    uint64_t         _tuples_sign = 0;
     int64_t          _region_id = 0;
     int64_t          _region_version = 0;
     // index_id => ReverseIndex
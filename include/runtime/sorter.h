@@ -38,6 +38,7 @@ public:
         return _min_heap.size();
     }
 private:
+    void sort_batch(RowBatch* batch);
     void multi_sort();
     void make_heap();
     void shiftdown(size_t index);
@@ -47,6 +48,27 @@ private:
     std::vector<std::shared_ptr<RowBatch>> _min_heap;
     size_t _idx;
 };
+
+// ORDER BY ... LIMIT n，只保留前n行(n=offset+limit)
+// 用大顶堆维护当前最小的n行，新行比堆顶小时替换堆顶，最后对堆内的行排序输出
+class TopNSorter {
+public:
+    TopNSorter(MemRowCompare* comp, int64_t limit) : _comp(comp), _limit(limit) {
+    }
+    // 行被移入堆或淘汰，返回淘汰行中已计入MemTracker的大小
+    int64_t add_batch(RowBatch* batch);
+    void sort();
+    int get_next(RowBatch* batch, bool* eos);
+
+    size_t size() {
+        return _rows.size();
+    }
+private:
+    MemRowCompare* _comp;
+    int64_t _limit;
+    std::vector<std::unique_ptr<MemRow>> _rows;
+    size_t _idx = 0;
+};
 }
 
 /* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -0,0 +1,59 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "lru_cache.h"
+#include "mem_row_descriptor.h"
+#include "proto/plan.pb.h"
+
+namespace baikaldb {
+// store上缓存的select准备结果，命中时跳过tuple desc的拷贝和MemRowDescriptor的构建(BuildFile开销大)
+struct PreparedTuples {
+    std::vector<pb::TupleDescriptor> tuple_descs; // 下标为tuple_id
+    std::shared_ptr<MemRowDescriptor> mem_row_desc;
+};
+typedef std::shared_ptr<PreparedTuples> SmartPreparedTuples;
+
+// 按sql_sign + tuples_sign索引，tuples_sign由baikaldb对tuple desc计算
+// schema变更后slot类型等随之变化，tuples_sign不同，旧条目靠lru淘汰
+class StorePlanCache {
+public:
+    static StorePlanCache* get_instance() {
+        static StorePlanCache _instance;
+        return &_instance;
+    }
+    SmartPreparedTuples get(uint64_t sql_sign, uint64_t tuples_sign);
+    // 用请求中的tuples构建并加入缓存，失败返回nullptr
+    SmartPreparedTuples prepare(uint64_t sql_sign, uint64_t tuples_sign,
+            const google::protobuf::RepeatedPtrField<pb::TupleDescriptor>& tuples);
+    std::string get_info() {
+        return _cache.get_info();
+    }
+
+private:
+    StorePlanCache();
+    static std::string make_key(uint64_t sql_sign, uint64_t tuples_sign);
+
+    Cache<std::string, SmartPreparedTuples> _cache;
+};
+
+// tuple desc签名，只计算有tuple_id的desc，与FetcherStore发送的tuples一致
+uint64_t make_tuples_sign(const std::vector<pb::TupleDescriptor>& tuples);
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -18,6 +18,7 @@
 #include "expr_value.h"
 #include "schema_factory.h"
 #include "meta_server_interact.hpp"
+#include "group_executor.h"
 
 #ifdef BAIDU_INTERNAL
 #include <base/endpoint.h>
@@ -36,9 +37,22 @@
 namespace baikaldb {
 
 DECLARE_string(meta_server_bns);
+DECLARE_int32(tso_batch_max_count);
+// 并发的get_tso合并成一次rpc，向meta申请连续的count个tso后分给各请求
+// 只合并rpc发出前已经到达的请求，不缓存多余的tso，保证tso不小于请求到达时meta已分配的tso
 class TsoFetcher {
 public:
     static int64_t get_tso();
+    // 直接向meta申请count个连续tso，返回第一个
+    static int64_t gen_tso(int64_t count);
+
+private:
+    struct TsoWaiter {
+        int64_t timestamp = -1;
+    };
+    static void fetch_batch(std::vector<TsoWaiter*>& batch);
+
+    static GroupExecutor<TsoWaiter> _group_fetcher;
 };
 
 class BinlogContext {
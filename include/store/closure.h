@@ -59,6 +59,16 @@ struct BinlogClosure : public braft::Closure {
     google::protobuf::Closure* done = nullptr;
 };
 
+// query_multi中单个region的query完成后通知
+struct MultiQueryClosure : public google::protobuf::Closure {
+    MultiQueryClosure(BthreadCond& cond) : cond(cond) {};
+    virtual void Run() {
+        cond.decrease_signal();
+        delete this;
+    }
+    BthreadCond& cond;
+};
+
 struct AddPeerClosure : public braft::Closure {
     AddPeerClosure(BthreadCond& cond) : cond(cond) {};
     virtual void Run(); 
@@ -56,6 +56,8 @@ public:
     int update_region_info(const pb::RegionInfo& region_info);
     int update_num_table_lines(int64_t region_id, int64_t num_table_lines);
     int update_apply_index(int64_t region_id, int64_t applied_index, int64_t data_index);
+    int update_apply_index_and_num_table_lines(int64_t region_id, int64_t applied_index,
+                        int64_t data_index, int64_t num_table_lines);
     int write_pre_commit(int64_t region_id, uint64_t txn_id, int64_t num_table_lines, int64_t applied_index);
     int clear_error_pre_commit(int64_t region_id, uint64_t txn_id);
     int write_doing_snapshot(int64_t region_id);
@@ -132,6 +132,25 @@ struct ApproximateInfo {
     TimeCost last_version_time_cost;
 };
 
+// 分块返回的select游标，保存执行到一半的plan和临时事务(快照)，续读时接着get_next
+struct SelectCursor {
+    SmartState state;
+    ExecNode* root = nullptr;
+    int64_t scan_rows = 0;   // 已经返回给baikaldb的scan_rows/filter_rows
+    int64_t filter_rows = 0;
+    TimeCost idle_time;
+    ~SelectCursor() {
+        if (root != nullptr) {
+            root->close(state.get());
+            ExecNode::destroy_tree(root);
+        }
+        if (state != nullptr && state->txn() != nullptr) {
+            state->txn()->rollback();
+        }
+    }
+};
+typedef std::shared_ptr<SelectCursor> SmartSelectCursor;
+
 class region;
 class ScopeProcStatus {
 public:
@@ -158,6 +177,7 @@ typedef std::shared_ptr<Region> SmartRegion;
 class Region : public braft::StateMachine, public std::enable_shared_from_this<Region> {
 friend class RegionControl;
 friend class Backup;
+friend class RegionBulkLoadTest;
 public:
     static const uint8_t PRIMARY_INDEX_FLAG;
     static const uint8_t SECOND_INDEX_FLAG;
@@ -201,6 +221,7 @@ public:
         _disable_write_cond.wait();
         _multi_thread_cond.wait();
         DB_WARNING("_multi_thread_cond wait success, region_id: %ld", _region_id);
+        clear_select_cursors(true);
         _txn_pool.close();
     }
     void get_node_status(braft::NodeStatus* status) {
@@ -302,7 +323,17 @@ public:
             const pb::Plan& plan,
             const RepeatedPtrField<pb::TupleDescriptor>& tuples,
             pb::StoreRes& response);
-    int select_normal(RuntimeState& state, ExecNode* root, pb::StoreRes& response);
+    // max_bytes>0时返回的行超过max_bytes就停止，is_eos返回plan是否执行完
+    // arrow_result为true时尽量按列编码返回
+    int select_normal(RuntimeState& state, ExecNode* root, pb::StoreRes& response,
+            int64_t max_bytes = 0, bool* is_eos = nullptr, bool arrow_result = false);
+    int select_cursor(const pb::StoreReq& request, pb::StoreRes& response);
+    uint64_t add_select_cursor(SmartSelectCursor cursor);
+    // 取出游标，续读期间不在map中，不会被超时清理
+    SmartSelectCursor take_select_cursor(uint64_t cursor_id);
+    // 重置游标的空闲时间，游标不存在返回-1
+    int touch_select_cursor(uint64_t cursor_id);
+    void clear_select_cursors(bool force);
     int select_sample(RuntimeState& state, ExecNode* root, const pb::AnalyzeInfo& analyze_info, pb::StoreRes& response);
     void do_apply(int64_t term, int64_t index, const pb::StoreReq& request, braft::Closure* done);
     virtual void on_apply(braft::Iterator& iter);
@@ -458,6 +489,8 @@ public:
             int64_t& split_end_index);
     
     int get_split_key(std::string& split_key, int64_t& split_key_term);
+    // 访问qps连续多个窗口超过阈值时返回0，split_key取采样访问的中位数
+    int get_load_split_key(std::string& split_key, int64_t& split_key_term);
     
     int64_t get_region_id() const {
         return _region_id;
@@ -717,6 +750,7 @@ public:
         }
         _multi_thread_cond.increase();
         _txn_pool.clear_transactions(this);
+        clear_select_cursors(false);
         _multi_thread_cond.decrease_signal();
     }
     void update_ttl_info() {
@@ -821,7 +855,23 @@ public:
     void process_upload_sst_streaming(brpc::Controller* controller, bool is_ingest,
         const pb::BackupRequest* request,
         pb::BackupResponse* response);
+
+    // bulk load文件的上传、校验和删除
+    void process_bulk_load(brpc::Controller* controller,
+        const pb::BulkLoadRequest* request,
+        pb::StoreRes* response);
+    // leader发起OP_BULK_INGEST前校验所有peer的文件，并在request中记录sst的key区间
+    int check_bulk_ingest(pb::StoreReq* request, pb::StoreRes* response);
+    // 只允许导入到空region，sst的key需属于本region区间且不覆盖已有数据
+    int check_bulk_load_sst(const std::string& path, std::string* smallest = nullptr,
+            std::string* largest = nullptr);
+    // ingest成功后、apply_index落盘前重启，重放时源文件已被rocksdb移走
+    bool bulk_ingest_applied(const pb::StoreReq& request);
+    // apply_index和行数一起落盘后才删除源文件；返回-1表示本peer数据已与leader不一致，需要回滚该日志
+    int apply_bulk_ingest(const pb::StoreReq& request, braft::Closure* done);
     
+    std::string bulk_load_sst_path(const std::string& load_id);
+
     std::shared_ptr<Region> get_ptr() {
         return shared_from_this();
     }
@@ -1146,6 +1196,13 @@ private:
     // TODO:num_table_lines维护太麻烦，后续要考虑使用预估的方式获取
     std::atomic<int64_t>                _num_table_lines;  //total number of pk record in this region
     std::atomic<int64_t>                _num_delete_lines;  //total number of delete rows after last compact
+    std::atomic<int64_t>                _num_modified_rows{0};  //上次心跳后dml修改的行数
+    // 上次心跳后随leader迁移的访问统计(dml和必须读leader的select)，心跳时换算成每秒值上报给meta做负载均衡
+    std::atomic<int64_t>                _num_select_requests{0};
+    std::atomic<int64_t>                _num_dml_requests{0};
+    std::atomic<int64_t>                _num_scan_rows{0};
+    TimeCost                            _load_stat_time;
+    int32_t                             _load_split_hot_windows = 0; // 只在分裂检查线程中访问
     int64_t                             _snapshot_num_table_lines = 0;  //last snapshot number
     TimeCost                            _snapshot_time_cost;
     int64_t                             _snapshot_index = 0; //last snapshot log index
@@ -1153,6 +1210,8 @@ private:
     TimeCost                            _removed_time_cost;
     TransactionPool                     _txn_pool;
     RuntimeStatePool                    _state_pool;
+    bthread::Mutex                      _select_cursor_lock;
+    std::map<uint64_t, SmartSelectCursor> _select_cursors;
 
     // shared_ptr is not thread safe when assign
     std::mutex  _ptr_mutex;
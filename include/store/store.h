@@ -37,6 +37,7 @@
 #include "rocks_wrapper.h"
 #include "table_record.h"
 #include "meta_server_interact.hpp"
+#include "segment_log_storage.h"
 namespace baikaldb {
 DECLARE_int32(snapshot_load_num);
 DECLARE_int32(raft_write_concurrency);
@@ -83,6 +84,12 @@ public:
                        pb::StoreRes* response,
                        google::protobuf::Closure* done);
 
+    // 多region select合并请求，各region并发执行
+    virtual void query_multi(google::protobuf::RpcController* controller,
+                       const pb::StoreMultiReq* request,
+                       pb::StoreMultiRes* response,
+                       google::protobuf::Closure* done);
+
     void async_apply_log_entry(google::protobuf::RpcController* controller,
                               const pb::BatchStoreReq* request,
                               pb::BatchStoreRes* response,
@@ -143,6 +150,11 @@ public:
         pb::BackupResponse* response,
         google::protobuf::Closure* done); 
 
+    virtual void bulk_load(google::protobuf::RpcController* controller,
+        const pb::BulkLoadRequest* request,
+        pb::StoreRes* response,
+        google::protobuf::Closure* done);
+
     //上报心跳
     void heart_beat_thread();
 
@@ -291,6 +303,7 @@ public:
         DB_WARNING("fake binlog bth join");
         _multi_thread_cond.wait();
         DB_WARNING("_multi_thread_cond wait finish");
+        SegmentLogEngine::get_instance()->close();
         _rocksdb->close();
         DB_WARNING("rockdb close, quit success");
     }
@@ -18,8 +18,24 @@
 #include "expr_value.h"
 
 namespace baikaldb {
-std::string timestamp_to_str(time_t timestamp) {
-    char str_time[21] = {0};
+// 按最小宽度width补0写入非负整数，返回写入后的位置
+static inline char* append_digits(char* buf, int value, int width) {
+    char tmp[12];
+    int len = 0;
+    do {
+        tmp[len++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    while (len < width) {
+        tmp[len++] = '0';
+    }
+    while (len > 0) {
+        *buf++ = tmp[--len];
+    }
+    return buf;
+}
+
+size_t timestamp_to_str(time_t timestamp, char* buf) {
     struct tm tm;
     localtime_r(&timestamp, &tm);  
     // 夏令时影响
@@ -27,12 +43,18 @@ std::string timestamp_to_str(time_t timestamp) {
         timestamp = timestamp - 3600;
         localtime_r(&timestamp, &tm);
     }
-    strftime(str_time, sizeof(str_time), "%Y-%m-%d %H:%M:%S", &tm);
-    return std::string(str_time);
+    return strftime(buf, DATETIME_STR_MAX_LEN, "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+std::string timestamp_to_str(time_t timestamp) {
+    char buf[DATETIME_STR_MAX_LEN];
+    size_t len = timestamp_to_str(timestamp, buf);
+    return std::string(buf, len);
 }
 // encode DATETIME to string format
 // ref: https://dev.mysql.com/doc/internals/en/date-and-time-data-type-representation.html
-std::string datetime_to_str(uint64_t datetime) {
+// 格式同"%04d-%02d-%02d %02d:%02d:%02d[.%06d]"
+size_t datetime_to_str(uint64_t datetime, char* buf) {
     int year_month = ((datetime >> 46) & 0x1FFFF);
     int year = year_month / 13;
     int month = year_month % 13;
@@ -42,15 +64,41 @@ std::string datetime_to_str(uint64_t datetime) {
     int second = ((datetime >> 24) & 0x3F);
     int macrosec = (datetime & 0xFFFFFF);
 
-    char buf[30] = {0};
+    char* p = append_digits(buf, year, 4);
+    *p++ = '-';
+    p = append_digits(p, month, 2);
+    *p++ = '-';
+    p = append_digits(p, day, 2);
+    *p++ = ' ';
+    p = append_digits(p, hour, 2);
+    *p++ = ':';
+    p = append_digits(p, minute, 2);
+    *p++ = ':';
+    p = append_digits(p, second, 2);
     if (macrosec > 0) {
-        snprintf(buf, sizeof(buf), "%04d-%02d-%02d %02d:%02d:%02d.%06d",
-                year, month, day, hour, minute, second, macrosec);
-    } else {
-        snprintf(buf, sizeof(buf), "%04d-%02d-%02d %02d:%02d:%02d",
-                year, month, day, hour, minute, second);
+        *p++ = '.';
+        p = append_digits(p, macrosec, 6);
     }
-    return std::string(buf);
+    return p - buf;
+}
+
+std::string datetime_to_str(uint64_t datetime) {
+    char buf[DATETIME_STR_MAX_LEN];
+    size_t len = datetime_to_str(datetime, buf);
+    return std::string(buf, len);
+}
+
+size_t date_to_str(uint32_t date, char* buf) {
+    int year_month = ((date >> 5) & 0x1FFFF);
+    int year = year_month / 13;
+    int month = year_month % 13;
+    int day = (date & 0x1F);
+    char* p = append_digits(buf, year, 4);
+    *p++ = '-';
+    p = append_digits(p, month, 2);
+    *p++ = '-';
+    p = append_digits(p, day, 2);
+    return p - buf;
 }
 
 uint64_t str_to_datetime(const char* str_time) {
@@ -295,19 +343,27 @@ uint64_t time_to_datetime(int32_t time) {
 
     return timestamp_to_datetime(now);
 }
-std::string time_to_str(int32_t time) {
-    bool minus = false;
+size_t time_to_str(int32_t time, char* buf) {
+    char* p = buf;
     if (time < 0) {
-        minus = true;
+        *p++ = '-';
         time = -time;
     }
     int hour = (time >> 12) & 0x3FF;
     int min = (time >> 6) & 0x3F;
     int sec = time & 0x3F;
-    static const char* OP_STR[] = {"", "-"};
-    char buf[20] = {0};
-    snprintf(buf, sizeof(buf), "%s%02d:%02d:%02d", OP_STR[minus], hour, min, sec);
-    return std::string(buf);
+    p = append_digits(p, hour, 2);
+    *p++ = ':';
+    p = append_digits(p, min, 2);
+    *p++ = ':';
+    p = append_digits(p, sec, 2);
+    return p - buf;
+}
+
+std::string time_to_str(int32_t time) {
+    char buf[DATETIME_STR_MAX_LEN];
+    size_t len = time_to_str(time, buf);
+    return std::string(buf, len);
 }
 int32_t str_to_time(const char* str_time) {
     while (*str_time == ' ') {
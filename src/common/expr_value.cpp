@@ -16,6 +16,9 @@
 #include "hll_common.h"
 
 namespace baikaldb {
+// "%.12g"格式化double的最大长度，如-1.23456789012e-308
+static const size_t MAX_FLOAT_TEXT_LEN = 24;
+
 SerializeStatus ExprValue::serialize_to_mysql_text_packet(char* buf, size_t size, size_t& len) const {
     if (size < 1) {
         len = 1;
@@ -61,29 +64,27 @@ SerializeStatus ExprValue::serialize_to_mysql_text_packet(char* buf, size_t size
             return STMPS_SUCCESS;
         }
         case pb::FLOAT: {
-            size_t body_len = 0;
-            char tmp_buf[100] = {0};
-            body_len = snprintf(tmp_buf, sizeof(tmp_buf), "%.6g", _u.float_val);
-            len = body_len + 1;
-            if (len > size) {
+            // 空间足够时直接格式化到buf中，snprintf需要额外1字节写'\0'
+            if (size < MAX_FLOAT_TEXT_LEN + 2) {
+                len = MAX_FLOAT_TEXT_LEN + 2;
                 return STMPS_NEED_RESIZE;
             }
+            size_t body_len = snprintf(buf + 1, size - 1, "%.6g", _u.float_val);
+            len = body_len + 1;
             // byte_array_append_length_coded_binary(body_len < 251LL)
             buf[0] = (uint8_t)(body_len & 0xff);
-            memcpy(buf + 1, tmp_buf, body_len);
             return STMPS_SUCCESS;
         }
         case pb::DOUBLE: {
-            size_t body_len = 0;
-            char tmp_buf[100] = {0};
-            body_len = snprintf(tmp_buf, sizeof(tmp_buf), "%.12g", _u.double_val);
-            len = body_len + 1;
-            if (len > size) {
+            // 空间足够时直接格式化到buf中，snprintf需要额外1字节写'\0'
+            if (size < MAX_FLOAT_TEXT_LEN + 2) {
+                len = MAX_FLOAT_TEXT_LEN + 2;
                 return STMPS_NEED_RESIZE;
             }
+            size_t body_len = snprintf(buf + 1, size - 1, "%.12g", _u.double_val);
+            len = body_len + 1;
             // byte_array_append_length_coded_binary(body_len < 251LL)
             buf[0] = (uint8_t)(body_len & 0xff);
-            memcpy(buf + 1, tmp_buf, body_len);
             return STMPS_SUCCESS;
         }
         case pb::HLL: {
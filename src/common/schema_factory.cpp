@@ -1322,6 +1322,23 @@ double SchemaFactory::get_cmsketch_ratio(int64_t table_id, int field_id, const E
     return 1.0;
 }
 
+double SchemaFactory::get_multi_column_ratio(int64_t table_id, const std::vector<int32_t>& field_ids,
+        const std::vector<uint64_t>& hashes) {
+    DoubleBufferedTable::ScopedPtr table_ptr;
+    if (_double_buffer_table.Read(&table_ptr) != 0) {
+        DB_WARNING("read double_buffer_table error.");
+        return -1; 
+    }
+
+    auto& table_statistics_mapping = table_ptr->table_statistics_mapping;
+    auto iter = table_statistics_mapping.find(table_id);
+    if (iter != table_statistics_mapping.end()) {
+        return iter->second->get_multi_column_ratio(field_ids, hashes);
+    }
+
+    return -1;
+}
+
 SmartStatistics SchemaFactory::get_statistics_ptr(int64_t table_id) {
     if (table_id <= 0) {
         return nullptr;
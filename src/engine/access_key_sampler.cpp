@@ -0,0 +1,63 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "access_key_sampler.h"
+
+namespace baikaldb {
+DEFINE_int32(load_split_sample_interval, 16, "sample one of every N key accesses for load split");
+DEFINE_int32(load_split_sample_keys, 1024, "max sampled keys per region in one window");
+
+void AccessKeySampler::sample(const rocksdb::Slice& key) {
+    ++_access_count;
+    if (key.size() <= 2 * sizeof(int64_t)) {
+        return;
+    }
+    if (FLAGS_load_split_sample_interval > 1 &&
+            butil::fast_rand_less_than(FLAGS_load_split_sample_interval) != 0) {
+        return;
+    }
+    rocksdb::Slice pk(key.data() + 2 * sizeof(int64_t), key.size() - 2 * sizeof(int64_t));
+    std::lock_guard<bthread::Mutex> lock(_mutex);
+    ++_sample_count;
+    if (_keys.size() < (size_t)FLAGS_load_split_sample_keys) {
+        _keys.emplace_back(pk.data(), pk.size());
+        return;
+    }
+    // 蓄水池采样，每次访问被保留的概率相同
+    uint64_t idx = butil::fast_rand_less_than(_sample_count);
+    if (idx < _keys.size()) {
+        _keys[idx].assign(pk.data(), pk.size());
+    }
+}
+
+int64_t AccessKeySampler::swap_window(std::vector<std::string>* keys, int64_t* window_us) {
+    std::lock_guard<bthread::Mutex> lock(_mutex);
+    keys->clear();
+    keys->swap(_keys);
+    *window_us = _window_time.get_time();
+    _window_time.reset();
+    _sample_count = 0;
+    return _access_count.exchange(0);
+}
+
+void AccessKeySampler::reset() {
+    std::lock_guard<bthread::Mutex> lock(_mutex);
+    _keys.clear();
+    _window_time.reset();
+    _sample_count = 0;
+    _access_count = 0;
+}
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
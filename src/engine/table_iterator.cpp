@@ -246,6 +246,15 @@ int Iterator::open(const IndexRange& range, std::map<int32_t, FieldInfo*>& field
     //     _left_open, _right_open,
     //     _lower_is_start, _upper_is_end);
 
+    // 按主键范围扫描时以扫描起点采样，用于按负载分裂；从region边界开始的扫描不采样
+    if (txn != nullptr && (_idx_type == pb::I_PRIMARY || _index_info->is_global)) {
+        if (_forward && !_lower_is_start) {
+            txn->sample_access_key(_region, index_id, _lower_bound.data());
+        } else if (!_forward && !_upper_is_end) {
+            txn->sample_access_key(_region, index_id, _upper_bound.data());
+        }
+    }
+
     rocksdb::ReadOptions read_options;
     if (_left_open) {
         _lower_bound.append_u64(UINT64_MAX);
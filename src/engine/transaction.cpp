@@ -384,6 +384,7 @@ int Transaction::put_primary(int64_t region, IndexInfo& pk_index, SmartRecord re
     } else {
         value = "";
     }
+    sample_access_key(region, pk_index.id, key.data());
     auto res = put_kv_without_lock(key.data(), value, _write_ttl_timestamp_us);
     if (res.IsTimedOut()) {
         print_txninfo_holding_lock(key.data());        
@@ -618,6 +619,7 @@ int Transaction::get_update_primary(
     }
     MutTableKey _key;
     _key.append_i64(region).append_i64(pk_index.id).append_index(key);
+    sample_access_key(region, pk_index.id, _key.data());
 
     rocksdb::PinnableSlice pin_slice;
     rocksdb::Status res;
@@ -14,6 +14,7 @@
 
 #include "access_path.h"
 #include "slot_ref.h"
+#include "cmsketch.h"
 #ifdef BAIDU_INTERNAL 
 #include <base/containers/flat_map.h>
 #else
@@ -23,6 +24,7 @@
 namespace baikaldb {
 using namespace range;
 DEFINE_uint64(max_in_records_num, 10000, "max_in_records_num");
+DEFINE_int32(multi_column_max_combinations, 100, "max in value combinations to estimate by multi-column statistics");
 
 void AccessPath::calc_row_expr_range(std::vector<int32_t>& range_fields, ExprNode* expr, bool in_open,
         std::vector<ExprValue>& values, SmartRecord record, size_t field_idx, bool* out_open, int* out_field_cnt) {
@@ -456,6 +458,62 @@ double AccessPath::fields_to_selectivity(const std::unordered_set<int32_t>& fiel
     return selectivity;
 }
 
+double AccessPath::multi_column_selectivity(std::map<int32_t, double>& filed_selectivity) {
+    if (index_info_ptr == nullptr || index_info_ptr->fields.size() < 2) {
+        return -1;
+    }
+    auto& fields = index_info_ptr->fields;
+    // 索引前缀中连续的等值列
+    size_t eq_prefix_len = 0;
+    size_t combinations = 1;
+    for (auto& field : fields) {
+        if (hit_index_field_ids.count(field.id) == 0) {
+            break;
+        }
+        auto iter = field_range_map.find(field.id);
+        if (iter == field_range_map.end() || (iter->second.type != EQ && iter->second.type != IN)) {
+            break;
+        }
+        size_t values_size = iter->second.eq_in_values.size();
+        if (values_size == 0 || combinations * values_size > (size_t)FLAGS_multi_column_max_combinations) {
+            break;
+        }
+        combinations *= values_size;
+        eq_prefix_len++;
+    }
+    // 多列统计只收集到一定长度的前缀，从长到短找
+    for (size_t len = eq_prefix_len; len >= 2; len--) {
+        std::vector<int32_t> prefix_field_ids;
+        std::vector<uint64_t> hashes = {0};
+        for (size_t i = 0; i < len; i++) {
+            prefix_field_ids.emplace_back(fields[i].id);
+            std::vector<uint64_t> next_hashes;
+            for (auto seed : hashes) {
+                for (auto value : field_range_map[fields[i].id].eq_in_values) {
+                    uint64_t value_hash = 0;
+                    if (!value.is_null()) {
+                        value.cast_to(fields[i].type);
+                        value_hash = value.hash();
+                    }
+                    next_hashes.emplace_back(multi_column_hash(seed, value_hash));
+                }
+            }
+            hashes.swap(next_hashes);
+        }
+        double ratio = SchemaFactory::get_instance()->get_multi_column_ratio(table_id, prefix_field_ids, hashes);
+        if (ratio < 0) {
+            continue;
+        }
+        // 前缀之外的命中列仍按独立假设
+        std::unordered_set<int32_t> rest_field_ids = hit_index_field_ids;
+        for (auto field_id : prefix_field_ids) {
+            rest_field_ids.erase(field_id);
+        }
+        return ratio * fields_to_selectivity(rest_field_ids, filed_selectivity);
+    }
+    return -1;
+}
+
 // TODO 后续做成index的统计信息，现在只是单列统计聚合
 void AccessPath::calc_cost(std::map<std::string, std::string>* cost_info, std::map<int32_t, double>& filed_selectivity) {
     if (cost > 0.0 && cost_info == nullptr) {
@@ -468,6 +526,11 @@ void AccessPath::calc_cost(std::map<std::string, std::string>* cost_info, std::m
         selectivity = 0.1;
     } else {
         selectivity = fields_to_selectivity(hit_index_field_ids, filed_selectivity);
+        // 相关列按独立假设相乘会低估，有多列统计时以其为准
+        double multi_selectivity = multi_column_selectivity(filed_selectivity);
+        if (multi_selectivity >= 0.0) {
+            selectivity = multi_selectivity;
+        }
     }
     index_read_rows = selectivity * table_rows;
     double index_other_condition_selectivity = fields_to_selectivity(index_other_field_ids, filed_selectivity);
@@ -15,9 +15,17 @@
 #include "agg_node.h"
 #include "runtime_state.h"
 #include "query_context.h"
+#include <boost/filesystem.hpp>
 
 namespace baikaldb {
 DECLARE_int64(store_row_number_to_check_memory);
+DEFINE_int32(agg_parallel_partitions, 8, "partitions of parallel hash aggregation, <=1 means serial");
+DEFINE_int32(agg_parallel_chunk_rows, 65536, "rows buffered before each parallel aggregation round");
+DEFINE_bool(agg_enable_spill, true, "spill agg hash table to disk instead of failing on memory limit");
+DEFINE_int64(agg_spill_memory_bytes, 2147483648LL,
+        "agg hash table memory budget per node, spill to disk when exceeded, 0 means only spill on memory limit");
+DEFINE_int32(agg_spill_partitions, 16, "partitions of spilled agg hash table");
+DECLARE_string(sort_spill_dir);
 
 int AggNode::init(const pb::PlanNode& node) {
     int ret = 0;
@@ -122,6 +130,23 @@ int AggNode::open(RuntimeState* state) {
         }
     }
     _mem_row_desc = state->mem_row_desc();
+    _fixed_key = !_group_exprs.empty();
+    for (auto expr : _group_exprs) {
+        if (get_num_size(expr->col_type()) <= 0) {
+            _fixed_key = false;
+        }
+    }
+    _parallel = can_parallel_agg();
+    _can_spill = can_spill_agg();
+    if (_parallel) {
+        _partition_maps.clear();
+        for (int i = 0; i < FLAGS_agg_parallel_partitions; i++) {
+            _partition_maps.emplace_back(new AggHashMap);
+            _partition_maps.back()->init(12301);
+        }
+        _cur_map = _partition_maps[0].get();
+        _partition_idx = 0;
+    }
 
     TimeCost cost;
     int64_t agg_time = 0;
@@ -131,7 +156,7 @@ int AggNode::open(RuntimeState* state) {
         bool eos = false;
         do {
             if (state->is_cancelled()) {
-                _iter = _hash_map.begin();
+                _iter = _cur_map->begin();
                 DB_WARNING_STATE(state, "cancelled");
                 return 0;
             }
@@ -139,20 +164,34 @@ int AggNode::open(RuntimeState* state) {
             RowBatch batch;
             ret = child->get_next(state, &batch, &eos);
             if (ret < 0) {
-                _iter = _hash_map.begin();
+                _iter = _cur_map->begin();
                 DB_WARNING_STATE(state, "child->get_next fail, ret:%d", ret);
                 return ret;
             }
             scan_time += cost.get_time();
             cost.reset();
+            if (_parallel) {
+                row_cnt += batch.size();
+                for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
+                    _pending_rows.push_back(std::move(batch.get_row()));
+                }
+                if ((eos || (int64_t)_pending_rows.size() >= FLAGS_agg_parallel_chunk_rows) &&
+                        parallel_process_rows(state) != 0) {
+                    _iter = _cur_map->begin();
+                    DB_WARNING_STATE(state, "memory limit exceeded");
+                    return -1;
+                }
+                agg_time += cost.get_time();
+                continue;
+            }
             int64_t used_size = 0;
             int64_t release_size = 0;
+            int64_t input_bytes = _can_spill ? batch.used_bytes_size() : 0;
             process_row_batch(state, batch, used_size, release_size);
             agg_time += cost.get_time();
             row_cnt += batch.size();
-            memory_limit_release(state, release_size);
-            if (memory_limit_exceeded(state, used_size) != 0) {
-                _iter = _hash_map.begin();
+            if (update_memory(state, input_bytes, used_size, release_size) != 0) {
+                _iter = _cur_map->begin();
                 DB_WARNING_STATE(state, "memory limit exceeded");
                 return -1;
             }
@@ -162,8 +201,29 @@ int AggNode::open(RuntimeState* state) {
             //}
         } while (!eos);
     }
+    if (_spilled) {
+        // 剩余数据也落盘，之后逐个分区重新聚合输出
+        ret = spill_hash_table(state);
+        if (ret == 0) {
+            for (auto& writer : _spill_writers) {
+                if (writer->close() < 0) {
+                    ret = -1;
+                }
+            }
+        }
+        _spill_writers.clear();
+        if (ret == 0) {
+            ret = load_spill_partition(state);
+        }
+        if (ret != 0) {
+            _iter = _cur_map->begin();
+            DB_WARNING_STATE(state, "agg spill fail");
+            return -1;
+        }
+    }
     LOCAL_TRACE_DESC << "agg time cost:" << agg_time << 
-        " scan time cost:" << scan_time << " rows:" << row_cnt;
+        " scan time cost:" << scan_time << " rows:" << row_cnt <<
+        " spill partitions:" << _spill_files.size();
     //DB_WARNING_STATE(state, "region:%ld, agg time:%ld ,scan time:%ld total:%ld, row_cnt:%d", 
         //state->region_id(), agg_time, scan_time, cost.get_time(), row_cnt);
 
@@ -177,10 +237,215 @@ int AggNode::open(RuntimeState* state) {
         AggFnCall::initialize_all(_agg_fn_calls, key.data(), used_size, row.get());
         _hash_map.insert(key.data(), row.release());
     }
-    _iter = _hash_map.begin();
+    if (!_spilled) {
+        _iter = _cur_map->begin();
+    }
+    return 0;
+}
+
+bool AggNode::can_spill_agg() {
+    if (!FLAGS_agg_enable_spill || FLAGS_agg_spill_partitions <= 0 || _group_exprs.empty()) {
+        return false;
+    }
+    // 落盘的是中间结果，重新聚合时用merge，要求聚合状态都在行内
+    for (auto agg : _agg_fn_calls) {
+        if (!agg->is_row_state_agg() || agg->is_distinct()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int AggNode::update_memory(RuntimeState* state, int64_t input_bytes, int64_t used_size,
+        int64_t release_size) {
+    _hash_table_bytes += input_bytes - release_size + used_size;
+    memory_limit_release(state, release_size);
+    // 只重置本节点设置的超限错误，之前已有的错误保留
+    bool has_error = state->error_code != ER_ERROR_FIRST;
+    int ret = memory_limit_exceeded(state, used_size);
+    bool over_budget = FLAGS_agg_spill_memory_bytes > 0 &&
+        _hash_table_bytes > FLAGS_agg_spill_memory_bytes;
+    if (!_can_spill || (ret == 0 && !over_budget)) {
+        return ret;
+    }
+    if (ret != 0 && !has_error) {
+        // 落盘后内存会归还，不再当做超限错误
+        state->error_code = ER_ERROR_FIRST;
+        state->error_msg.str("");
+    }
+    return spill_hash_table(state);
+}
+
+int AggNode::spill_hash_table(RuntimeState* state) {
+    TimeCost cost;
+    size_t partition_cnt = FLAGS_agg_spill_partitions;
+    if (_spill_files.empty()) {
+        boost::system::error_code ec;
+        boost::filesystem::create_directories(FLAGS_sort_spill_dir, ec);
+        std::string prefix = FLAGS_sort_spill_dir + "/agg_" + std::to_string(state->log_id()) + "_" +
+            std::to_string(butil::gettimeofday_us()) + "_" + std::to_string(butil::fast_rand());
+        for (size_t p = 0; p < partition_cnt; p++) {
+            _spill_files.push_back(prefix + "_" + std::to_string(p));
+            _spill_writers.emplace_back(new SortRunWriter);
+            if (_spill_writers.back()->open(_spill_files.back()) < 0) {
+                return -1;
+            }
+        }
+    }
+    std::hash<std::string> hasher;
+    int64_t spill_rows = 0;
+    // _hash_table_bytes包含没有计入MemTracker的输入行，只用于触发落盘；
+    // 归还的是上游计入的行大小和本节点计入的聚合状态
+    int64_t charged_bytes = _agg_charged_bytes;
+    auto spill_map = [&](AggHashMap& hash_map) -> int {
+        for (auto& pair : hash_map) {
+            if (pair.second == nullptr) {
+                continue;
+            }
+            if (_spill_writers[hasher(pair.first) % partition_cnt]->append(pair.second) < 0) {
+                return -1;
+            }
+            charged_bytes += pair.second->release_charged_size();
+            delete pair.second;
+            pair.second = nullptr;
+            ++spill_rows;
+        }
+        hash_map.clear();
+        return 0;
+    };
+    if (spill_map(_hash_map) < 0) {
+        return -1;
+    }
+    for (auto& hash_map : _partition_maps) {
+        if (spill_map(*hash_map) < 0) {
+            return -1;
+        }
+    }
+    state->memory_limit_release(charged_bytes);
+    DB_WARNING_STATE(state, "agg spill rows:%ld bytes:%ld charged_bytes:%ld cost:%ld",
+            spill_rows, _hash_table_bytes, charged_bytes, cost.get_time());
+    _hash_table_bytes = 0;
+    _agg_charged_bytes = 0;
+    _spilled = true;
     return 0;
 }
 
+int AggNode::load_spill_partition(RuntimeState* state) {
+    if (!_spill_map.initialized()) {
+        _spill_map.init(12301);
+    }
+    for (auto& pair : _spill_map) {
+        delete pair.second;
+    }
+    _spill_map.clear();
+    _cur_map = &_spill_map;
+    _iter = _spill_map.end();
+    if (_spill_partition_idx >= _spill_files.size()) {
+        return 0;
+    }
+    const std::string& path = _spill_files[_spill_partition_idx++];
+    SortRunReader reader;
+    if (reader.open(path, _mem_row_desc) < 0) {
+        return -1;
+    }
+    std::string key;
+    int64_t used_size = 0;
+    int64_t release_size = 0;
+    while (true) {
+        std::unique_ptr<MemRow> row;
+        if (reader.next(&row) < 0) {
+            return -1;
+        }
+        if (row == nullptr) {
+            break;
+        }
+        encode_agg_key(row.get(), &key);
+        aggregate_row(_spill_map, row, key, true, used_size, release_size);
+    }
+    boost::system::error_code ec;
+    boost::filesystem::remove(path, ec);
+    _iter = _spill_map.begin();
+    return 0;
+}
+
+void AggNode::clear_spill() {
+    for (auto& pair : _spill_map) {
+        delete pair.second;
+    }
+    _spill_map.clear();
+    _spill_writers.clear();
+    for (size_t i = _spill_partition_idx; i < _spill_files.size(); i++) {
+        boost::system::error_code ec;
+        boost::filesystem::remove(_spill_files[i], ec);
+    }
+    _spill_files.clear();
+    _spill_partition_idx = 0;
+    _spilled = false;
+    _hash_table_bytes = 0;
+    _agg_charged_bytes = 0;
+}
+
+bool AggNode::can_parallel_agg() {
+    if (FLAGS_agg_parallel_partitions <= 1 || _group_exprs.empty()) {
+        return false;
+    }
+    for (auto agg : _agg_fn_calls) {
+        if (!agg->is_row_state_agg()) {
+            return false;
+        }
+    }
+    // 非merger时update会在worker中计算聚合参数，只允许slot_ref和常量
+    std::function<bool(ExprNode*)> thread_safe = [&thread_safe](ExprNode* expr) {
+        if (!expr->is_slot_ref() && !expr->is_literal()) {
+            return false;
+        }
+        for (size_t i = 0; i < expr->children_size(); i++) {
+            if (!thread_safe(expr->children(i))) {
+                return false;
+            }
+        }
+        return true;
+    };
+    if (!_is_merger) {
+        for (auto agg : _agg_fn_calls) {
+            for (size_t i = 0; i < agg->children_size(); i++) {
+                if (!thread_safe(agg->children(i))) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void AggNode::encode_fixed_agg_key(MemRow* row, std::string* key) {
+    uint8_t null_flag = 0;
+    key->push_back(0);
+    for (uint32_t i = 0; i < _group_exprs.size(); i++) {
+        ExprValue value = _group_exprs[i]->get_value(row);
+        int32_t size = get_num_size(_group_exprs[i]->col_type());
+        if (value.is_null()) {
+            null_flag |= (0x01 << (7 - i));
+            key->append(size, '\0');
+            continue;
+        }
+        value.cast_to(_group_exprs[i]->col_type());
+        key->append((const char*)&value._u, size);
+    }
+    (*key)[0] = null_flag;
+}
+
+void AggNode::encode_agg_key(MemRow* row, std::string* key) {
+    key->clear();
+    if (_fixed_key) {
+        encode_fixed_agg_key(row, key);
+        return;
+    }
+    MutTableKey table_key;
+    encode_agg_key(row, table_key);
+    key->swap(table_key.data());
+}
+
 void AggNode::encode_agg_key(MemRow* row, MutTableKey& key) {
     uint8_t null_flag = 0;
     key.append_u8(null_flag);
@@ -196,37 +461,121 @@ void AggNode::encode_agg_key(MemRow* row, MutTableKey& key) {
 }
 
 void AggNode::process_row_batch(RuntimeState* state, RowBatch& batch, int64_t& used_size, int64_t& release_size) {
+    std::string key;
     for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
         std::unique_ptr<MemRow>& row = batch.get_row();
-        MutTableKey key;
-        MemRow* cur_row = row.get();
-        encode_agg_key(cur_row, key);
-        MemRow** agg_row = _hash_map.seek(key.data());
-        
-        if (agg_row == nullptr) { //不存在则新建
-            cur_row = row.release();
-            agg_row = &cur_row;
-            // fix bug: 多个store agg，有无数据会造条空数据(L157)
-            // merge多个store时，去除这种造的数据
-            // 以便于 select id,count(*) from t where id>1;这种sql时id不会时造出来的null
-            if (_is_merger && _group_exprs.size() == 0) {
-                if (AggFnCall::all_is_initialize(_agg_fn_calls, key.data(), *agg_row)) {
-                    delete cur_row;
-                    continue;
-                }
+        encode_agg_key(row.get(), &key);
+        aggregate_row(_hash_map, row, key, _is_merger, used_size, release_size);
+    }
+}
+
+void AggNode::aggregate_row(AggHashMap& hash_map, std::unique_ptr<MemRow>& row,
+        const std::string& key, bool is_merge, int64_t& used_size, int64_t& release_size) {
+    MemRow* cur_row = row.get();
+    MemRow** agg_row = hash_map.seek(key);
+
+    if (agg_row == nullptr) { //不存在则新建
+        cur_row = row.release();
+        agg_row = &cur_row;
+        // fix bug: 多个store agg，有无数据会造条空数据(L157)
+        // merge多个store时，去除这种造的数据
+        // 以便于 select id,count(*) from t where id>1;这种sql时id不会时造出来的null
+        if (_is_merger && _group_exprs.size() == 0) {
+            if (AggFnCall::all_is_initialize(_agg_fn_calls, key, *agg_row)) {
+                delete cur_row;
+                return;
             }
-            AggFnCall::initialize_all(_agg_fn_calls, key.data(), used_size, *agg_row);
-            // 可能会rehash
-            _hash_map.insert(key.data(), *agg_row);
-        } else {
-            release_size += cur_row->used_size();
         }
-        if (_is_merger) {
-            AggFnCall::merge_all(_agg_fn_calls, key.data(), cur_row, *agg_row);
-        } else {
-            AggFnCall::update_all(_agg_fn_calls, key.data(), cur_row, *agg_row);
+        AggFnCall::initialize_all(_agg_fn_calls, key, used_size, *agg_row);
+        // 可能会rehash
+        hash_map.insert(key, *agg_row);
+    } else {
+        release_size += cur_row->used_size();
+    }
+    if (is_merge) {
+        AggFnCall::merge_all(_agg_fn_calls, key, cur_row, *agg_row);
+    } else {
+        AggFnCall::update_all(_agg_fn_calls, key, cur_row, *agg_row);
+    }
+}
+
+int AggNode::parallel_process_rows(RuntimeState* state) {
+    size_t row_cnt = _pending_rows.size();
+    if (row_cnt == 0) {
+        return 0;
+    }
+    size_t partition_cnt = _partition_maps.size();
+    int64_t input_bytes = 0;
+    if (_can_spill) {
+        for (auto& row : _pending_rows) {
+            input_bytes += row->used_size();
+        }
+    }
+    std::vector<std::string> keys(row_cnt);
+    std::vector<std::vector<uint32_t>> partition_rows(partition_cnt);
+    // group_exprs会在多个bthread中计算，同样只允许slot_ref
+    bool parallel_encode = true;
+    for (auto expr : _group_exprs) {
+        if (!expr->is_slot_ref()) {
+            parallel_encode = false;
+        }
+    }
+    std::vector<uint32_t> partition_ids(row_cnt);
+    auto encode_range = [this, &keys, &partition_ids, partition_cnt](size_t begin, size_t end) {
+        std::hash<std::string> hasher;
+        for (size_t i = begin; i < end; i++) {
+            encode_agg_key(_pending_rows[i].get(), &keys[i]);
+            // 不能用FlatMap内部的hash，否则分区内的桶分布会倾斜
+            partition_ids[i] = hasher(keys[i]) % partition_cnt;
+        }
+    };
+    if (parallel_encode) {
+        size_t step = (row_cnt + partition_cnt - 1) / partition_cnt;
+        BthreadCond cond;
+        for (size_t begin = 0; begin < row_cnt; begin += step) {
+            size_t end = std::min(begin + step, row_cnt);
+            cond.increase();
+            Bthread bth(&BTHREAD_ATTR_SMALL);
+            bth.run([&encode_range, &cond, begin, end]() {
+                encode_range(begin, end);
+                cond.decrease_signal();
+            });
+        }
+        cond.wait();
+    } else {
+        encode_range(0, row_cnt);
+    }
+    for (size_t i = 0; i < row_cnt; i++) {
+        partition_rows[partition_ids[i]].push_back(i);
+    }
+
+    std::vector<int64_t> used_sizes(partition_cnt, 0);
+    std::vector<int64_t> release_sizes(partition_cnt, 0);
+    BthreadCond cond;
+    for (size_t p = 0; p < partition_cnt; p++) {
+        if (partition_rows[p].empty()) {
+            continue;
         }
+        cond.increase();
+        Bthread bth(&BTHREAD_ATTR_SMALL);
+        bth.run([this, p, &keys, &partition_rows, &used_sizes, &release_sizes, &cond]() {
+            AggHashMap& hash_map = *_partition_maps[p];
+            for (auto idx : partition_rows[p]) {
+                aggregate_row(hash_map, _pending_rows[idx], keys[idx], _is_merger,
+                        used_sizes[p], release_sizes[p]);
+            }
+            cond.decrease_signal();
+        });
     }
+    cond.wait();
+    _pending_rows.clear();
+    int64_t used_size = 0;
+    int64_t release_size = 0;
+    for (size_t p = 0; p < partition_cnt; p++) {
+        used_size += used_sizes[p];
+        release_size += release_sizes[p];
+    }
+    return update_memory(state, input_bytes, used_size, release_size);
 }
 
 void AggNode::memory_limit_release(RuntimeState* state, int64_t size) {
@@ -238,6 +587,8 @@ void AggNode::memory_limit_release(RuntimeState* state, int64_t size) {
 
 int AggNode::memory_limit_exceeded(RuntimeState* state, int64_t size) {
     if (state->num_scan_rows() > FLAGS_store_row_number_to_check_memory) {
+        // 超限时也已经计入
+        _agg_charged_bytes += size;
         if (0 != state->memory_limit_exceeded(size)) {
             return -1;
         }
@@ -256,7 +607,27 @@ int AggNode::get_next(RuntimeState* state, RowBatch* batch, bool* eos) {
             *eos = true;
             return 0;
         }
-        if (reached_limit() || _iter == _hash_map.end()) {
+        if (reached_limit()) {
+            *eos = true;
+            return 0;
+        }
+        if (_iter == _cur_map->end()) {
+            if (_spilled) {
+                if (_spill_partition_idx >= _spill_files.size()) {
+                    *eos = true;
+                    return 0;
+                }
+                if (load_spill_partition(state) < 0) {
+                    DB_WARNING_STATE(state, "load agg spill partition fail");
+                    return -1;
+                }
+                continue;
+            }
+            if (_partition_idx + 1 < _partition_maps.size()) {
+                _cur_map = _partition_maps[++_partition_idx].get();
+                _iter = _cur_map->begin();
+                continue;
+            }
             *eos = true;
             return 0;
         }
@@ -279,10 +650,22 @@ void AggNode::close(RuntimeState* state) {
     for (auto agg : _agg_fn_calls) {
         agg->close();
     }
-    for (; _iter != _hash_map.end(); _iter++) {
-        delete _iter->second;
+    // get_next输出后的行已置为nullptr
+    for (auto& pair : _hash_map) {
+        delete pair.second;
     }
     _hash_map.clear();
+    for (auto& hash_map : _partition_maps) {
+        for (auto& pair : *hash_map) {
+            delete pair.second;
+        }
+    }
+    _partition_maps.clear();
+    _pending_rows.clear();
+    clear_spill();
+    _cur_map = &_hash_map;
+    _partition_idx = 0;
+    _iter = _hash_map.end();
 }
 void AggNode::transfer_pb(int64_t region_id, pb::PlanNode* pb_node) {
     ExecNode::transfer_pb(region_id, pb_node);
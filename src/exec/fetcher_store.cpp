@@ -25,6 +25,7 @@
 #include "query_context.h"
 #include "dml_node.h"
 #include "trace_state.h"
+#include "arrow_row_codec.h"
 #ifdef BAIDU_INTERNAL
 #include "baidu/rpc/reloadable_flags.h"
 #else
@@ -52,13 +53,53 @@ DEFINE_bool(fetcher_follower_read, true, "where allow follower read for fether")
 DEFINE_bool(fetcher_learner_read, false, "where allow learner read for fether");
 DECLARE_int32(transaction_clear_delay_ms);
 DEFINE_bool(use_dynamic_timeout, false, "whether use dynamic_timeout");
+DEFINE_bool(select_arrow_result, true, "store returns select rows in arrow columnar format");
+DEFINE_int64(select_chunk_bytes, 4 * 1024 * 1024,
+        "store returns select rows in chunks of # bytes when consumed as a stream, 0 to disable");
+DEFINE_bool(select_plan_cache, true, "omit tuples of select request when store has cached them");
+DEFINE_bool(fetcher_multi_region_request, true, "pack select of regions on the same store into one rpc");
+DEFINE_int32(max_regions_per_multi_request, 64, "max regions packed in one multi region rpc");
+DEFINE_int64(select_cursor_keepalive_ms, 20 * 1000,
+        "touch store cursors idle for # ms while still consuming, less than select_cursor_idle_timeout_ms");
 #ifdef BAIDU_INTERNAL
 BAIDU_RPC_VALIDATE_GFLAG(use_dynamic_timeout, brpc::PassValidate);
 #else
 BRPC_VALIDATE_GFLAG(use_dynamic_timeout, brpc::PassValidate);
 #endif
                     
-ErrorType FetcherStore::send_request(
+// 已确认缓存了tuple desc的store，key为addr + sql_sign + tuples_sign
+static Cache<std::string, bool>& store_cached_plans() {
+    static Cache<std::string, bool> cached_plans;
+    return cached_plans;
+}
+
+static std::string cached_plan_key(const std::string& addr, uint64_t sql_sign, uint64_t tuples_sign) {
+    return addr + "_" + std::to_string(sql_sign) + "_" + std::to_string(tuples_sign);
+}
+
+// backup_request的两个响应merge后repeated字段会重复，row_values和tuple_ids对不上；
+// Arrow结果是bytes字段，merge后只保留一份，只能通过tuple_ids重复发现
+static bool row_tuples_match(const pb::StoreRes& res) {
+    if (res.has_arrow_rows()) {
+        std::set<int32_t> tuple_ids;
+        for (auto tuple_id : res.tuple_ids()) {
+            if (!tuple_ids.insert(tuple_id).second) {
+                return false;
+            }
+        }
+        if (res.row_values_size() > 0) {
+            return false;
+        }
+    }
+    for (auto& pb_row : res.row_values()) {
+        if (pb_row.tuple_values_size() != res.tuple_ids_size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FetcherStore::build_request(
         RuntimeState* state,
         ExecNode* store_request,
         pb::RegionInfo& info,
@@ -66,17 +107,15 @@ ErrorType FetcherStore::send_request(
         int64_t old_region_id,
         int64_t region_id,
         uint64_t log_id,
-        int retry_times,
         int start_seq_id,
         int current_seq_id,
-        pb::OpType op_type) {
-    pb::StoreReq req;
-    pb::StoreRes res;
-    TimeCost total_cost;
+        bool need_copy_cache_plan,
+        pb::OpType op_type,
+        pb::StoreReq& req) {
+    auto client_conn = state->client_conn();
     if (trace_node != nullptr) {
         req.set_is_trace(true);
     }
-
     if (state->explain_type == ANALYZE_STATISTICS) {
         if (state->cmsketch != nullptr) {
             pb::AnalyzeInfo* info = req.mutable_analyze_info();
@@ -84,72 +123,24 @@ ErrorType FetcherStore::send_request(
             info->set_width(state->cmsketch->get_width());
             info->set_sample_rows(state->cmsketch->get_sample_rows());
             info->set_table_rows(state->cmsketch->get_table_rows());
+            info->set_multi_column_max_prefix(state->cmsketch->get_multi_column_max_prefix());
         }
     }
-    ScopeGuard auto_update_trace([&]() {
-        if (trace_node != nullptr) {
-            std::string desc = "baikalDB FetcherStore send_request "
-                               + pb::ErrCode_Name(res.errcode());
-            trace_node->set_description(trace_node->description() + " " + desc);
-            trace_node->set_total_time(total_cost.get_time());
-            trace_node->set_affect_rows(res.affected_rows());
-            pb::TraceNode* local_trace = trace_node->add_child_nodes();
-            if (res.has_errmsg() && res.errcode() == pb::SUCCESS) {
-                pb::TraceNode trace;
-                if (!trace.ParseFromString(res.errmsg())) {
-                    DB_FATAL("parse from pb fail");
-                } else {
-                    (*local_trace) = trace;
-                }
-            }
-        }
-    });
-    if (error != E_OK) {
-        DB_WARNING("recieve error, need not requeset to region_id: %ld, log_id: %lu", region_id, log_id);
-        return E_WARNING;
-    }
-    if (state->is_cancelled()) {
-        DB_FATAL("region_id: %ld is cancelled, log_id: %lu op_type:%s", 
-                region_id, log_id, pb::OpType_Name(op_type).c_str());
-        return E_OK;
-    }
-    //DB_WARNING("region_info; txn: %ld, %s, %lu", _txn_id, info.ShortDebugString().c_str(), records.size());
-    if (retry_times >= 5) {
-        DB_WARNING("region_id: %ld, txn_id: %lu, log_id:%lu, op_type:%s rpc error; retry:%d",
-            region_id, state->txn_id, log_id, pb::OpType_Name(op_type).c_str(), retry_times);
-        return E_FATAL;
-    }
-    // for exec next_statement_after_begin, begin must be added
-    if (current_seq_id == 2 && state->single_sql_autocommit() == false) {
-        //DB_WARNING("start seq id is reset to 1, region_id: %ld", region_id);
-        start_seq_id = 1;
-    }
-    bool need_copy_cache_plan = true;
-    if (state->txn_id != 0) {
-        BAIDU_SCOPED_LOCK(state->client_conn()->region_lock);
-        if (state->client_conn()->region_infos.count(region_id) == 0) {
-            //DB_WARNING("start seq id is reset to 1, region_id: %ld", region_id);
-            start_seq_id = 1;
-            no_copy_cache_plan_set.emplace(region_id);
-        }
-        if (no_copy_cache_plan_set.count(region_id) != 0) {
-            need_copy_cache_plan = false;
-        }
-    }
-    TimeCost cost;
-    auto client_conn = state->client_conn();
-    SchemaFactory* schema_factory = SchemaFactory::get_instance();
-    brpc::Controller cntl;
-    cntl.set_log_id(log_id);
-    if (info.leader() == "0.0.0.0:0" || info.leader() == "") {
-        info.set_leader(rand_peer(info));
-    }
     req.set_db_conn_id(client_conn->get_global_conn_id());
     req.set_op_type(op_type);
     req.set_region_id(region_id);
     req.set_region_version(info.version());
     req.set_log_id(log_id);
     req.set_sql_sign(state->sign);
+    if (enable_cursor && op_type == pb::OP_SELECT && state->txn_id == 0 && trace_node == nullptr) {
+        req.set_select_chunk_bytes(chunk_bytes > 0 ? chunk_bytes : FLAGS_select_chunk_bytes);
+    }
+    if (op_type == pb::OP_SELECT && FLAGS_select_arrow_result) {
+        req.set_arrow_result(true);
+    }
+    if (op_type == pb::OP_SELECT && state->txn_id == 0 && FLAGS_select_plan_cache) {
+        req.set_tuples_sign(state->tuples_sign());
+    }
     for (auto& desc : state->tuple_descs()) {
         if (desc.has_tuple_id()){
             req.add_tuples()->CopyFrom(desc);
@@ -240,20 +231,11 @@ ErrorType FetcherStore::send_request(
             }
         }
     }
-    // save region id for txn commit/rollback
-    int64_t client_lock_tm = 0;
-    if (state->txn_id != 0) {
-        TimeCost cost;
-        BAIDU_SCOPED_LOCK(client_conn->region_lock);
-        if (client_conn->region_infos.count(region_id) == 0) {
-            client_conn->region_infos.insert(std::make_pair(region_id, info));
-        }
-        client_lock_tm = cost.get_time();
-    }
     ExecNode::create_pb_plan(old_region_id, req.mutable_plan(), store_request);
+}
 
-    std::string addr = info.leader();
-    std::string backup;
+bool FetcherStore::choose_addr(RuntimeState* state, pb::RegionInfo& info, pb::OpType op_type,
+        int retry_times, std::string& addr, std::string& backup) {
     // 事务读也读leader
     if (op_type == pb::OP_SELECT && state->txn_id == 0 && 
         info.learners_size() > 0 && (FLAGS_fetcher_learner_read || state->need_learner_backup())) {
@@ -261,7 +243,7 @@ ErrorType FetcherStore::send_request(
         if (retry_times == 0) {
             choose_opt_instance(info.region_id(), info.learners(), addr, nullptr);
         }
-        req.set_select_without_leader(true);
+        return true;
     } else if (op_type == pb::OP_SELECT && state->txn_id == 0 && FLAGS_fetcher_follower_read) {
         // 多机房优化
         if (info.learners_size() > 0) {
@@ -272,12 +254,106 @@ ErrorType FetcherStore::send_request(
                 choose_opt_instance(info.region_id(), info.peers(), addr, &backup);
             }
         }
-        req.set_select_without_leader(true);
+        return true;
     } else if (retry_times == 0) {
         // 重试前已经选择了normal的实例
         // 或者store返回了正确的leader
         choose_other_if_faulty(info, addr);
     }
+    return false;
+}
+
+ErrorType FetcherStore::send_request(
+        RuntimeState* state,
+        ExecNode* store_request,
+        pb::RegionInfo& info,
+        pb::TraceNode* trace_node,
+        int64_t old_region_id,
+        int64_t region_id,
+        uint64_t log_id,
+        int retry_times,
+        int start_seq_id,
+        int current_seq_id,
+        pb::OpType op_type) {
+    pb::StoreReq req;
+    pb::StoreRes res;
+    TimeCost total_cost;
+    ScopeGuard auto_update_trace([&]() {
+        if (trace_node != nullptr) {
+            std::string desc = "baikalDB FetcherStore send_request "
+                               + pb::ErrCode_Name(res.errcode());
+            trace_node->set_description(trace_node->description() + " " + desc);
+            trace_node->set_total_time(total_cost.get_time());
+            trace_node->set_affect_rows(res.affected_rows());
+            pb::TraceNode* local_trace = trace_node->add_child_nodes();
+            if (res.has_errmsg() && res.errcode() == pb::SUCCESS) {
+                pb::TraceNode trace;
+                if (!trace.ParseFromString(res.errmsg())) {
+                    DB_FATAL("parse from pb fail");
+                } else {
+                    (*local_trace) = trace;
+                }
+            }
+        }
+    });
+    if (error != E_OK) {
+        DB_WARNING("recieve error, need not requeset to region_id: %ld, log_id: %lu", region_id, log_id);
+        return E_WARNING;
+    }
+    if (state->is_cancelled()) {
+        DB_FATAL("region_id: %ld is cancelled, log_id: %lu op_type:%s", 
+                region_id, log_id, pb::OpType_Name(op_type).c_str());
+        return E_OK;
+    }
+    //DB_WARNING("region_info; txn: %ld, %s, %lu", _txn_id, info.ShortDebugString().c_str(), records.size());
+    if (retry_times >= 5) {
+        DB_WARNING("region_id: %ld, txn_id: %lu, log_id:%lu, op_type:%s rpc error; retry:%d",
+            region_id, state->txn_id, log_id, pb::OpType_Name(op_type).c_str(), retry_times);
+        return E_FATAL;
+    }
+    // for exec next_statement_after_begin, begin must be added
+    if (current_seq_id == 2 && state->single_sql_autocommit() == false) {
+        //DB_WARNING("start seq id is reset to 1, region_id: %ld", region_id);
+        start_seq_id = 1;
+    }
+    bool need_copy_cache_plan = true;
+    if (state->txn_id != 0) {
+        BAIDU_SCOPED_LOCK(state->client_conn()->region_lock);
+        if (state->client_conn()->region_infos.count(region_id) == 0) {
+            //DB_WARNING("start seq id is reset to 1, region_id: %ld", region_id);
+            start_seq_id = 1;
+            no_copy_cache_plan_set.emplace(region_id);
+        }
+        if (no_copy_cache_plan_set.count(region_id) != 0) {
+            need_copy_cache_plan = false;
+        }
+    }
+    TimeCost cost;
+    auto client_conn = state->client_conn();
+    SchemaFactory* schema_factory = SchemaFactory::get_instance();
+    brpc::Controller cntl;
+    cntl.set_log_id(log_id);
+    if (info.leader() == "0.0.0.0:0" || info.leader() == "") {
+        info.set_leader(rand_peer(info));
+    }
+    build_request(state, store_request, info, trace_node, old_region_id, region_id, log_id,
+            start_seq_id, current_seq_id, need_copy_cache_plan, op_type, req);
+    // save region id for txn commit/rollback
+    int64_t client_lock_tm = 0;
+    if (state->txn_id != 0) {
+        TimeCost cost;
+        BAIDU_SCOPED_LOCK(client_conn->region_lock);
+        if (client_conn->region_infos.count(region_id) == 0) {
+            client_conn->region_infos.insert(std::make_pair(region_id, info));
+        }
+        client_lock_tm = cost.get_time();
+    }
+
+    std::string addr = info.leader();
+    std::string backup;
+    if (choose_addr(state, info, op_type, retry_times, addr, backup)) {
+        req.set_select_without_leader(true);
+    }
     brpc::ChannelOptions option;
     option.max_retry = 1;
     option.connect_timeout_ms = FLAGS_fetcher_connect_timeout;
@@ -329,6 +405,11 @@ ErrorType FetcherStore::send_request(
         client_conn->insert_callid(addr, region_id, cntl.call_id());
     }
 
+    // store已缓存tuple desc时只发送签名
+    if (req.has_tuples_sign() && store_cached_plans().check(
+                cached_plan_key(addr, state->sign, req.tuples_sign())) == 0) {
+        req.clear_tuples();
+    }
     TimeCost query_time;
     pb::StoreService_Stub(&channel).query(&cntl, &req, &res, NULL);
 
@@ -402,6 +483,18 @@ ErrorType FetcherStore::send_request(
         return send_request(state, store_request, info, trace_node, old_region_id, region_id, log_id,
                   retry_times + 1, start_seq_id, current_seq_id,  op_type);
     }
+    if (res.errcode() == pb::PLAN_CACHE_MISS) {
+        // store重启或淘汰了缓存，带上tuples重发
+        DB_WARNING("PLAN_CACHE_MISS, region_id: %ld, addr:%s retry:%d, log_id:%lu",
+                region_id, addr.c_str(), retry_times, log_id);
+        store_cached_plans().del(cached_plan_key(addr, state->sign, req.tuples_sign()));
+        return send_request(state, store_request, info, trace_node, old_region_id, region_id, log_id,
+                  retry_times + 1, start_seq_id, current_seq_id, op_type);
+    }
+    if (res.plan_cached()) {
+        store_cached_plans().add(cached_plan_key(butil::endpoint2str(cntl.remote_side()).c_str(),
+                state->sign, req.tuples_sign()), true);
+    }
     if (res.errcode() == pb::IN_PROCESS) {
         DB_WARNING("txn IN_PROCESS, region_id: %ld, retry:%d, log_id:%lu, op:%d, start_seq_id:%d current_seq_id:%d",
                 region_id, retry_times, log_id, op_type, start_seq_id, current_seq_id);
@@ -552,6 +645,28 @@ ErrorType FetcherStore::send_request(
         return E_FATAL;
     }
 
+    if (!row_tuples_match(res)) {
+        // brpc SelectiveChannel+backup_request有bug，pb的repeated字段merge到一起了
+        SQL_TRACE("backup_request size diff, tuple_ids_size:%d rows:%d",
+                res.tuple_ids_size(), res.row_values_size());
+        return send_request(state, store_request, info, trace_node, old_region_id, region_id, log_id,
+                retry_times + 1, start_seq_id, current_seq_id, op_type);
+    }
+    return handle_response(state, info, region_id, log_id, op_type, res,
+            butil::endpoint2str(cntl.remote_side()).c_str());
+}
+
+ErrorType FetcherStore::handle_response(
+        RuntimeState* state,
+        pb::RegionInfo& info,
+        int64_t region_id,
+        uint64_t log_id,
+        pb::OpType op_type,
+        const pb::StoreRes& res,
+        const std::string& remote_addr) {
+    auto client_conn = state->client_conn();
+    SchemaFactory* schema_factory = SchemaFactory::get_instance();
+    TimeCost cost;
     if (res.records_size() > 0) {
         int64_t main_table_id = info.has_main_table_id() ? info.main_table_id() : info.table_id();
         if (main_table_id <= 0) {
@@ -602,31 +717,33 @@ ErrorType FetcherStore::send_request(
             client_conn->region_infos[region_id].set_leader(res.leader());
         }
     }
-    cost.reset();
-    if (res.row_values_size() > 0) {
-        row_cnt += res.row_values_size();
+    std::shared_ptr<RowBatch> batch = std::make_shared<RowBatch>();
+    if (res.has_arrow_rows() && decode_arrow_rows(state, res, batch.get()) != 0) {
+        DB_WARNING("decode arrow rows fail, region_id:%ld, log_id:%lu", region_id, log_id);
+        return E_FATAL;
+    }
+    int64_t res_rows = res.row_values_size() + batch->size();
+    if (res_rows > 0) {
+        row_cnt += res_rows;
     }
-    // TODO reduce mem used by streaming
-    if ((!state->is_full_export) && (row_cnt > FLAGS_max_select_rows)) {
+    if (!state->is_full_export && row_cnt > FLAGS_max_select_rows) {
         DB_FATAL("_row_cnt:%ld > %ld max_select_rows", row_cnt.load(), FLAGS_max_select_rows);
         return E_BIG_SQL;
     }
-    std::shared_ptr<RowBatch> batch = std::make_shared<RowBatch>();
     std::vector<int64_t> ttl_batch;
     ttl_batch.reserve(100);
-    bool global_ddl_with_ttl = (res.row_values_size() > 0 && res.row_values_size() == res.ttl_timestamp_size()) ? true : false;
+    bool global_ddl_with_ttl = (res_rows > 0 && res_rows == res.ttl_timestamp_size()) ? true : false;
     int ttl_idx = 0;
-    for (auto& pb_row : res.row_values()) {
-        if (pb_row.tuple_values_size() != res.tuple_ids_size()) {
-            // brpc SelectiveChannel+backup_request有bug，pb的repeated字段merge到一起了
-            SQL_TRACE("backup_request size diff, tuple_values_size:%d tuple_ids_size:%d rows:%d", 
-                    pb_row.tuple_values_size(), res.tuple_ids_size(), res.row_values_size());
-            for (auto id : res.tuple_ids()) {
-                SQL_TRACE("tuple_id:%d  ", id);
-            }
-            return send_request(state, store_request, info, trace_node, old_region_id, region_id, log_id,
-                    retry_times + 1, start_seq_id, current_seq_id, op_type);
+    // arrow格式的行已经解码
+    for (batch->reset(); !batch->is_traverse_over(); batch->next()) {
+        if (0 != memory_limit_exceeded(state, batch->get_row().get())) {
+            return E_FATAL;
+        }
+        if (global_ddl_with_ttl) {
+            ttl_batch.emplace_back(res.ttl_timestamp(ttl_idx++));
         }
+    }
+    for (auto& pb_row : res.row_values()) {
         std::unique_ptr<MemRow> row = state->mem_row_desc()->fetch_mem_row();
         for (int i = 0; i < res.tuple_ids_size(); i++) {
             int32_t tuple_id = res.tuple_ids(i);
@@ -648,6 +765,15 @@ ErrorType FetcherStore::send_request(
         region_id_ttl_timestamp_batch[region_id] = ttl_batch;
         DB_DEBUG("region_id: %ld, ttl_timestamp_size: %ld", region_id, ttl_batch.size());
     }
+    if (res.cursor_id() != 0) {
+        std::shared_ptr<StoreCursor> cursor = std::make_shared<StoreCursor>();
+        cursor->info = info;
+        cursor->addr = remote_addr;
+        cursor->cursor_id = res.cursor_id();
+        cursor->active_time.reset();
+        BAIDU_SCOPED_LOCK(region_lock);
+        region_cursors[region_id] = cursor;
+    }
     if (res.has_cmsketch() && state->cmsketch != nullptr) {
         state->cmsketch->add_proto(res.cmsketch());
         DB_WARNING("region_id:%ld, cmsketch:%s", region_id, res.cmsketch().ShortDebugString().c_str());
@@ -668,8 +794,249 @@ ErrorType FetcherStore::send_request(
     return E_OK;
 }
 
+int FetcherStore::decode_arrow_rows(RuntimeState* state, const pb::StoreRes& res, RowBatch* batch) {
+    std::vector<const pb::TupleDescriptor*> tuples;
+    for (auto tuple_id : res.tuple_ids()) {
+        pb::TupleDescriptor* tuple = state->get_tuple_desc(tuple_id);
+        if (tuple == nullptr) {
+            DB_WARNING("tuple_id:%d not found", tuple_id);
+            return -1;
+        }
+        tuples.emplace_back(tuple);
+    }
+    ArrowRowCodec codec;
+    if (codec.init(tuples) != 0) {
+        return -1;
+    }
+    return codec.deserialize(res.arrow_rows(), state->mem_row_desc(), batch);
+}
+
+ErrorType FetcherStore::send_cursor_req(RuntimeState* state, StoreCursor* cursor, bool close,
+        pb::StoreRes& res, bool touch) {
+    int64_t region_id = cursor->info.region_id();
+    uint64_t log_id = state->log_id();
+    pb::StoreReq req;
+    req.set_op_type(pb::OP_SELECT);
+    req.set_region_id(region_id);
+    req.set_region_version(cursor->info.version());
+    req.set_log_id(log_id);
+    req.set_db_conn_id(state->client_conn()->get_global_conn_id());
+    req.set_sql_sign(state->sign);
+    req.set_select_without_leader(true);
+    req.set_select_chunk_bytes(chunk_bytes > 0 ? chunk_bytes : FLAGS_select_chunk_bytes);
+    req.set_cursor_id(cursor->cursor_id);
+    req.set_close_cursor(close);
+    req.set_touch_cursor(touch);
+    req.set_arrow_result(FLAGS_select_arrow_result);
+    // 续读会推进store上的游标，不是幂等的，失败不重试
+    brpc::ChannelOptions option;
+    option.max_retry = 0;
+    option.connect_timeout_ms = FLAGS_fetcher_connect_timeout;
+    option.timeout_ms = FLAGS_fetcher_request_timeout;
+    brpc::Channel channel;
+    if (channel.Init(cursor->addr.c_str(), &option) != 0) {
+        DB_WARNING("channel init failed, addr:%s, region_id: %ld, log_id:%lu",
+                cursor->addr.c_str(), region_id, log_id);
+        return E_FATAL;
+    }
+    brpc::Controller cntl;
+    cntl.set_log_id(log_id);
+    pb::StoreService_Stub(&channel).query(&cntl, &req, &res, NULL);
+    if (cntl.Failed()) {
+        DB_WARNING("cursor call failed region_id: %ld, addr:%s, errcode:%d, error:%s, log_id:%lu",
+                region_id, cursor->addr.c_str(), cntl.ErrorCode(), cntl.ErrorText().c_str(), log_id);
+        return E_FATAL;
+    }
+    if (res.errcode() != pb::SUCCESS) {
+        if (res.has_mysql_errcode()) {
+            BAIDU_SCOPED_LOCK(region_lock);
+            state->error_code = (MysqlErrCode)res.mysql_errcode();
+            state->error_msg.str(res.errmsg());
+        }
+        DB_WARNING("cursor errcode:%d, msg:%s, instance:%s region_id:%ld, log_id:%lu",
+                res.errcode(), res.errmsg().c_str(), cursor->addr.c_str(), region_id, log_id);
+        return E_FATAL;
+    }
+    return E_OK;
+}
+
+ErrorType FetcherStore::fetch_cursor(RuntimeState* state, StoreCursor* cursor, bool close) {
+    int64_t region_id = cursor->info.region_id();
+    uint64_t log_id = state->log_id();
+    pb::StoreRes res;
+    ErrorType ret = send_cursor_req(state, cursor, close, res);
+    if (close) {
+        cursor->cursor_id = 0;
+        return ret;
+    }
+    if (ret != E_OK) {
+        // 没收到响应时store上的游标可能还在，用原id尽力关闭，关不掉的等store超时清理;
+        // store返回错误时已经释放了游标
+        if (!res.has_errcode()) {
+            fetch_cursor(state, cursor, true);
+        }
+        cursor->cursor_id = 0;
+        return ret;
+    }
+    // 收到响应后才换成新id，后续处理失败要关闭新游标
+    cursor->cursor_id = res.cursor_id();
+    ret = E_OK;
+    std::shared_ptr<RowBatch> batch = std::make_shared<RowBatch>();
+    if (res.has_arrow_rows() && decode_arrow_rows(state, res, batch.get()) != 0) {
+        DB_WARNING("decode arrow rows fail, region_id:%ld, log_id:%lu", region_id, log_id);
+        ret = E_FATAL;
+    }
+    for (int r = 0; ret == E_OK && r < res.row_values_size(); r++) {
+        const pb::RowValue& pb_row = res.row_values(r);
+        if (pb_row.tuple_values_size() != res.tuple_ids_size()) {
+            DB_WARNING("tuple size diff, tuple_values_size:%d tuple_ids_size:%d region_id:%ld",
+                    pb_row.tuple_values_size(), res.tuple_ids_size(), region_id);
+            ret = E_FATAL;
+            break;
+        }
+        std::unique_ptr<MemRow> row = state->mem_row_desc()->fetch_mem_row();
+        for (int i = 0; i < res.tuple_ids_size(); i++) {
+            row->from_string(res.tuple_ids(i), pb_row.tuple_values(i));
+        }
+        batch->move_row(std::move(row));
+    }
+    if (ret == E_OK) {
+        row_cnt += batch->size();
+        if (!state->is_full_export && row_cnt > FLAGS_max_select_rows) {
+            DB_FATAL("_row_cnt:%ld > %ld max_select_rows", row_cnt.load(), FLAGS_max_select_rows);
+            ret = E_BIG_SQL;
+        }
+    }
+    if (ret != E_OK) {
+        if (cursor->cursor_id != 0) {
+            fetch_cursor(state, cursor, true);
+        }
+        return ret;
+    }
+    cursor->next_batch = batch;
+    cursor->scan_rows = res.scan_rows();
+    cursor->filter_rows = res.filter_rows();
+    return E_OK;
+}
+
+void FetcherStore::prefetch_cursor(RuntimeState* state, int64_t region_id, bool must) {
+    auto iter = region_cursors.find(region_id);
+    if (iter == region_cursors.end() || iter->second->in_flight) {
+        return;
+    }
+    // 后台预取的块数受限，多路归并时不会同时向所有region发请求并缓存下一块
+    if (!must && cursor_in_flight >= FLAGS_single_store_concurrency) {
+        return;
+    }
+    std::shared_ptr<StoreCursor> cursor = iter->second;
+    cursor->in_flight = true;
+    // store上游标的空闲时间从响应时开始，不早于发起时
+    cursor->active_time.reset();
+    ++cursor_in_flight;
+    cursor->cond.increase();
+    auto fetch_func = [this, state, cursor]() {
+        cursor->ret = fetch_cursor(state, cursor.get(), false);
+        cursor->cond.decrease_signal();
+    };
+    Bthread bth(&BTHREAD_ATTR_SMALL);
+    bth.run(fetch_func);
+}
+
+int FetcherStore::next_cursor_batch(RuntimeState* state, int64_t region_id,
+        std::shared_ptr<RowBatch>& batch) {
+    batch = nullptr;
+    auto iter = region_cursors.find(region_id);
+    if (iter == region_cursors.end()) {
+        return 0;
+    }
+    std::shared_ptr<StoreCursor> cursor = iter->second;
+    prefetch_cursor(state, region_id, true);
+    cursor->cond.wait();
+    cursor->in_flight = false;
+    --cursor_in_flight;
+    if (cursor->ret != E_OK) {
+        DB_WARNING("fetch cursor fail, region_id:%ld, log_id:%lu", region_id, state->log_id());
+        if (cursor->ret == E_BIG_SQL) {
+            BAIDU_SCOPED_LOCK(region_lock);
+            state->error_code = ER_SQL_TOO_BIG;
+            state->error_msg.str("sql too big");
+        }
+        // 出错的游标已经关闭，不再续读
+        region_cursors.erase(iter);
+        return -1;
+    }
+    batch = cursor->next_batch;
+    cursor->next_batch = nullptr;
+    state->set_num_scan_rows(state->num_scan_rows() + cursor->scan_rows);
+    state->set_num_filter_rows(state->num_filter_rows() + cursor->filter_rows);
+    if (cursor->cursor_id == 0) {
+        region_cursors.erase(iter);
+    } else {
+        // 上层处理这一块时，store继续执行下一块
+        prefetch_cursor(state, region_id);
+    }
+    return 0;
+}
+
+void FetcherStore::keepalive_cursors(RuntimeState* state) {
+    std::vector<std::shared_ptr<StoreCursor>> idle_cursors;
+    for (auto& pair : region_cursors) {
+        if (pair.second->active_time.get_time() > FLAGS_select_cursor_keepalive_ms * 1000LL) {
+            idle_cursors.emplace_back(pair.second);
+        }
+    }
+    if (idle_cursors.empty()) {
+        return;
+    }
+    ConcurrencyBthread con_bth(FLAGS_single_store_concurrency, &BTHREAD_ATTR_SMALL);
+    for (auto& cursor : idle_cursors) {
+        auto touch_func = [this, state, cursor]() {
+            // 预取的块仍然保留，in_flight不变，只是等响应返回后再保活
+            if (cursor->in_flight) {
+                cursor->cond.wait();
+            }
+            cursor->active_time.reset();
+            if (cursor->cursor_id == 0) {
+                return;
+            }
+            // 保活失败不影响当前查询，游标真的失效时续读会报错
+            pb::StoreRes res;
+            if (send_cursor_req(state, cursor.get(), false, res, true) != E_OK) {
+                DB_WARNING("touch cursor fail, region_id:%ld, log_id:%lu",
+                        cursor->info.region_id(), state->log_id());
+            }
+        };
+        con_bth.run(touch_func);
+    }
+    con_bth.join();
+}
+
+void FetcherStore::close_cursors(RuntimeState* state) {
+    if (region_cursors.empty()) {
+        return;
+    }
+    ConcurrencyBthread con_bth(FLAGS_single_store_concurrency, &BTHREAD_ATTR_SMALL);
+    for (auto& pair : region_cursors) {
+        std::shared_ptr<StoreCursor> cursor = pair.second;
+        auto close_func = [this, state, cursor]() {
+            if (cursor->in_flight) {
+                cursor->cond.wait();
+                cursor->in_flight = false;
+            }
+            if (cursor->cursor_id != 0) {
+                fetch_cursor(state, cursor.get(), true);
+            }
+        };
+        con_bth.run(close_func);
+    }
+    con_bth.join();
+    region_cursors.clear();
+    cursor_in_flight = 0;
+}
+
 int FetcherStore::memory_limit_exceeded(RuntimeState* state, MemRow* row) {
     if (row_cnt > FLAGS_db_row_number_to_check_memory) {
+        row->set_charged_size(row->used_size());
         if (0 != state->memory_limit_exceeded(row->used_size())) {
             BAIDU_SCOPED_LOCK(region_lock);
             state->error_code = ER_TOO_BIG_SELECT;
@@ -909,6 +1276,170 @@ ErrorType FetcherStore::write_binlog(RuntimeState* state,
     }
 }
 
+bool FetcherStore::use_multi_request(RuntimeState* state, ExecNode* store_request, pb::OpType op_type) {
+    // 事务请求依赖执行顺序；trace和代价采样需要单region统计；backup request需要SelectiveChannel
+    return FLAGS_fetcher_multi_region_request && op_type == pb::OP_SELECT && state->txn_id == 0
+        && store_request->get_trace() == nullptr && state->explain_type != ANALYZE_STATISTICS
+        && dynamic_timeout_ms <= 0;
+}
+
+void FetcherStore::send_multi_request(RuntimeState* state,
+                                      ExecNode* store_request,
+                                      const std::string& addr,
+                                      const std::vector<std::pair<pb::RegionInfo*, bool>>& infos,
+                                      uint64_t log_id,
+                                      int start_seq_id,
+                                      int current_seq_id) {
+    if (error != E_OK || state->is_cancelled()) {
+        return;
+    }
+    TimeCost cost;
+    pb::StoreMultiReq req;
+    pb::StoreMultiRes res;
+    bool plan_cached = false;
+    if (FLAGS_select_plan_cache) {
+        plan_cached = store_cached_plans().check(
+                cached_plan_key(addr, state->sign, state->tuples_sign())) == 0;
+    }
+    for (auto& pair : infos) {
+        pb::RegionInfo* info = pair.first;
+        pb::StoreReq* sub_req = req.add_requests();
+        build_request(state, store_request, *info, nullptr, info->region_id(), info->region_id(),
+                log_id, start_seq_id, current_seq_id, true, pb::OP_SELECT, *sub_req);
+        if (pair.second) {
+            sub_req->set_select_without_leader(true);
+        }
+        if (plan_cached) {
+            sub_req->clear_tuples();
+        }
+    }
+    // 失败的region退化为单region请求，复用其not leader、分裂等重试逻辑
+    std::vector<int> retry_idx;
+    brpc::ChannelOptions option;
+    option.max_retry = 1;
+    option.connect_timeout_ms = FLAGS_fetcher_connect_timeout;
+    option.timeout_ms = FLAGS_fetcher_request_timeout;
+    brpc::Channel channel;
+    brpc::Controller cntl;
+    cntl.set_log_id(log_id);
+    if (channel.Init(addr.c_str(), &option) != 0) {
+        DB_WARNING("channel init failed, addr:%s, log_id:%lu", addr.c_str(), log_id);
+        for (size_t i = 0; i < infos.size(); i++) {
+            retry_idx.emplace_back(i);
+        }
+    } else {
+        client_conn->insert_callid(addr, infos[0].first->region_id(), cntl.call_id());
+        pb::StoreService_Stub(&channel).query_multi(&cntl, &req, &res, NULL);
+        if (cntl.Failed() || res.errcode() != pb::SUCCESS
+                || res.responses_size() != req.requests_size()) {
+            DB_WARNING("query_multi failed, addr:%s, regions:%lu, errcode:%d, error:%s, res:%s, log_id:%lu",
+                    addr.c_str(), infos.size(), cntl.ErrorCode(), cntl.ErrorText().c_str(),
+                    pb::ErrCode_Name(res.errcode()).c_str(), log_id);
+            for (size_t i = 0; i < infos.size(); i++) {
+                retry_idx.emplace_back(i);
+            }
+        } else {
+            for (size_t i = 0; i < infos.size(); i++) {
+                pb::RegionInfo* info = infos[i].first;
+                const pb::StoreRes& sub_res = res.responses(i);
+                if (sub_res.errcode() == pb::PLAN_CACHE_MISS) {
+                    store_cached_plans().del(cached_plan_key(addr, state->sign, state->tuples_sign()));
+                }
+                if (sub_res.errcode() != pb::SUCCESS || !row_tuples_match(sub_res)) {
+                    DB_WARNING("region_id: %ld errcode:%s in query_multi, addr:%s, log_id:%lu",
+                            info->region_id(), pb::ErrCode_Name(sub_res.errcode()).c_str(),
+                            addr.c_str(), log_id);
+                    retry_idx.emplace_back(i);
+                    continue;
+                }
+                if (sub_res.plan_cached()) {
+                    store_cached_plans().add(cached_plan_key(addr, state->sign, state->tuples_sign()), true);
+                }
+                ErrorType ret = handle_response(state, *info, info->region_id(), log_id, pb::OP_SELECT,
+                        sub_res, addr);
+                if (ret != E_OK) {
+                    DB_WARNING("handle response failed, region_id: %ld, log_id:%lu", info->region_id(), log_id);
+                    error = ret;
+                    return;
+                }
+            }
+        }
+    }
+    if (cost.get_time() > FLAGS_print_time_us) {
+        DB_WARNING("query_multi addr:%s, regions:%lu, retry:%lu, time:%ld, log_id:%lu",
+                addr.c_str(), infos.size(), retry_idx.size(), cost.get_time(), log_id);
+    }
+    if (retry_idx.empty()) {
+        return;
+    }
+    ConcurrencyBthread retry_bth(FLAGS_single_store_concurrency, &BTHREAD_ATTR_SMALL);
+    for (int idx : retry_idx) {
+        pb::RegionInfo* info = infos[idx].first;
+        auto req_thread = [this, state, store_request, info, log_id, start_seq_id, current_seq_id]() {
+            int64_t region_id = info->region_id();
+            auto ret = send_request(state, store_request, *info, region_id, region_id, log_id,
+                    0, start_seq_id, current_seq_id, pb::OP_SELECT);
+            if (ret != E_OK) {
+                DB_WARNING("rpc error, region_id:%ld, log_id:%lu", region_id, log_id);
+                error = ret;
+            }
+        };
+        retry_bth.run(req_thread);
+    }
+    retry_bth.join();
+}
+
+void FetcherStore::send_multi_requests(RuntimeState* state,
+                                       ExecNode* store_request,
+                                       std::map<int64_t, pb::RegionInfo>& region_infos,
+                                       uint64_t log_id,
+                                       int start_seq_id,
+                                       int current_seq_id) {
+    // 按实际发往的实例分组，follower read时不一定是leader
+    std::map<std::string, std::vector<std::pair<pb::RegionInfo*, bool>>> addr_infos;
+    for (auto& pair : region_infos) {
+        pb::RegionInfo& info = pair.second;
+        if (info.leader() == "0.0.0.0:0" || info.leader() == "") {
+            info.set_leader(rand_peer(info));
+        }
+        std::string addr = info.leader();
+        std::string backup;
+        bool without_leader = choose_addr(state, info, pb::OP_SELECT, 0, addr, backup);
+        addr_infos[addr].emplace_back(&info, without_leader);
+    }
+    // 单store的region过多时拆成多个rpc，避免单个响应过大
+    std::vector<std::pair<std::string, std::vector<std::pair<pb::RegionInfo*, bool>>>> batches;
+    for (auto& pair : addr_infos) {
+        size_t batch_size = std::max(FLAGS_max_regions_per_multi_request, 1);
+        for (size_t i = 0; i < pair.second.size(); i += batch_size) {
+            size_t end = std::min(i + batch_size, pair.second.size());
+            batches.emplace_back(pair.first, std::vector<std::pair<pb::RegionInfo*, bool>>(
+                    pair.second.begin() + i, pair.second.begin() + end));
+        }
+    }
+    ConcurrencyBthread con_bth(batches.size(), &BTHREAD_ATTR_SMALL);
+    for (auto& batch : batches) {
+        auto& addr = batch.first;
+        auto& infos = batch.second;
+        auto req_thread = [this, state, store_request, &addr, &infos, log_id, start_seq_id, current_seq_id]() {
+            // store上只有一个region时不需要合并
+            if (infos.size() == 1) {
+                int64_t region_id = infos[0].first->region_id();
+                auto ret = send_request(state, store_request, *infos[0].first, region_id, region_id,
+                        log_id, 0, start_seq_id, current_seq_id, pb::OP_SELECT);
+                if (ret != E_OK) {
+                    DB_WARNING("rpc error, region_id:%ld, log_id:%lu", region_id, log_id);
+                    error = ret;
+                }
+                return;
+            }
+            send_multi_request(state, store_request, addr, infos, log_id, start_seq_id, current_seq_id);
+        };
+        con_bth.run(req_thread);
+    }
+    con_bth.join();
+}
+
 int FetcherStore::run(RuntimeState* state,
                     std::map<int64_t, pb::RegionInfo>& region_infos,
                     ExecNode* store_request,
@@ -923,6 +1454,7 @@ int FetcherStore::run(RuntimeState* state,
     start_key_sort.clear();
     split_start_key_sort.clear();
     no_copy_cache_plan_set.clear();
+    region_cursors.clear();
     error = E_OK;
     skip_region_set.clear();
     primary_timestamp_updated = false;
@@ -1047,7 +1579,10 @@ int FetcherStore::run(RuntimeState* state,
         }
         send_region_ids_map[pair.second.leader()].insert(trace);
     }
-    if (send_region_count == 1) {
+    if (send_region_count > 1 && use_multi_request(state, store_request, op_type)) {
+        // 同一store上的region合并为一次rpc
+        send_multi_requests(state, store_request, region_infos, log_id, start_seq_id, current_seq_id);
+    } else if (send_region_count == 1) {
         auto& trace = *send_region_ids_map.begin()->second.begin();
         int64_t region_id = trace->region_id;
         // 这两个资源后续不会分配新的，因此不需要加锁
@@ -30,6 +30,7 @@
 namespace baikaldb {
 
 DECLARE_int64(store_row_number_to_check_memory);
+DEFINE_bool(filter_use_vectorized_eval, true, "filter node evaluate conjuncts by column batch");
 
 int FilterNode::init(const pb::PlanNode& node) {
     int ret = 0;
@@ -553,7 +554,10 @@ void FilterNode::transfer_pb(int64_t region_id, pb::PlanNode* pb_node) {
 }
 
 inline bool FilterNode::need_copy(MemRow* row) {
-    for (auto conjunct : _pruned_conjuncts) {
+    if (!_selection.empty() && _selection[_child_row_batch.index()] == 0) {
+        return false;
+    }
+    for (auto conjunct : _row_conjuncts) {
         ExprValue value = conjunct->get_value(row);
         if (value.is_null() || value.get_numberic<bool>() == false) {
             return false;
@@ -593,6 +597,9 @@ int FilterNode::get_next(RuntimeState* state, RowBatch* batch, bool* eos) {
                     return ret;
                 }
                 //DB_WARNING_STATE(state, "_child_row_batch:%u %u", _child_row_batch.capacity(), _child_row_batch.size());
+                if (!_is_explain) {
+                    vectorized_filter();
+                }
                 //DB_NOTICE("scan cost:%ld", cost.get_time());
                 continue;
             }
@@ -616,6 +623,71 @@ int FilterNode::get_next(RuntimeState* state, RowBatch* batch, bool* eos) {
     return 0;
 }
 
+void FilterNode::init_vectorized_conjuncts() {
+    _vectorize_inited = true;
+    _vectorized_conjuncts.clear();
+    _row_conjuncts.clear();
+    _column_batch = ColumnBatch();
+    for (auto conjunct : _pruned_conjuncts) {
+        if (FLAGS_filter_use_vectorized_eval && conjunct->can_vectorize()) {
+            _vectorized_conjuncts.emplace_back(conjunct);
+        } else {
+            _row_conjuncts.emplace_back(conjunct);
+        }
+    }
+    std::vector<ExprNode*> slot_refs;
+    for (auto conjunct : _vectorized_conjuncts) {
+        conjunct->get_all_slot_refs(slot_refs);
+    }
+    for (auto slot_ref : slot_refs) {
+        if (_column_batch.add_column(slot_ref->tuple_id(), slot_ref->slot_id(),
+                    slot_ref->col_type()) < 0) {
+            _vectorized_conjuncts.clear();
+            _row_conjuncts = _pruned_conjuncts;
+            return;
+        }
+    }
+}
+
+void FilterNode::vectorized_filter() {
+    if (!_vectorize_inited) {
+        init_vectorized_conjuncts();
+    }
+    _selection.clear();
+    if (_vectorized_conjuncts.empty() || _child_row_batch.size() == 0) {
+        return;
+    }
+    // 批量计算失败时退化成全部逐行计算，结果不受影响
+    auto fallback = [this]() {
+        _selection.clear();
+        _vectorized_conjuncts.clear();
+        _row_conjuncts = _pruned_conjuncts;
+    };
+    size_t num_rows = _child_row_batch.size();
+    _column_batch.clear();
+    if (_column_batch.append_rows(&_child_row_batch) < 0) {
+        fallback();
+        return;
+    }
+    _selection.assign(num_rows, 1);
+    for (auto conjunct : _vectorized_conjuncts) {
+        const ColumnVector* value = conjunct->get_batch_value(&_column_batch);
+        if (value != nullptr && value->type() != pb::BOOL) {
+            value = value->cast_to(pb::BOOL, &_bool_value) < 0 ? nullptr : &_bool_value;
+        }
+        if (value == nullptr || value->size() != num_rows) {
+            DB_WARNING("vectorized eval fail, fallback to row eval");
+            fallback();
+            return;
+        }
+        const uint8_t* null_map = value->null_map();
+        const int64_t* data = value->int_data();
+        for (size_t i = 0; i < num_rows; i++) {
+            _selection[i] &= (null_map[i] == 0) & (data[i] != 0);
+        }
+    }
+}
+
 void FilterNode::memory_limit_release(RuntimeState* state, MemRow* row) {
     if (state->num_scan_rows() > FLAGS_store_row_number_to_check_memory) {
         state->memory_limit_release(row->used_size());
@@ -647,6 +719,11 @@ void FilterNode::remove_additional_predicate(std::vector<ExprNode*>& input_exprs
     _child_row_batch.clear();
     _child_row_idx = 0;
     _child_eos = false;
+    _vectorize_inited = false;
+    _vectorized_conjuncts.clear();
+    _row_conjuncts.clear();
+    _column_batch = ColumnBatch();
+    _selection.clear();
 }
 
 void FilterNode::close(RuntimeState* state) {
@@ -658,6 +735,11 @@ void FilterNode::close(RuntimeState* state) {
     _child_row_batch.clear();
     _child_row_idx = 0;
     _child_eos = false;
+    _vectorize_inited = false;
+    _vectorized_conjuncts.clear();
+    _row_conjuncts.clear();
+    _column_batch = ColumnBatch();
+    _selection.clear();
 }
 void FilterNode::show_explain(std::vector<std::map<std::string, std::string>>& output) {
     ExecNode::show_explain(output);
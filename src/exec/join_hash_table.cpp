@@ -0,0 +1,141 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "join_hash_table.h"
+#include "slot_ref.h"
+#include "mut_table_key.h"
+#include "column_batch.h"
+#include "runtime_filter.h"
+
+namespace baikaldb {
+// 两边的值编码成int64后相等当且仅当原值相等
+// TIME等类型的存储也是COL_INT，但编码与整数不同，类型规则与runtime filter相同
+static bool is_fixed_key_type(pb::PrimitiveType left, pb::PrimitiveType right) {
+    ColumnStorage storage = column_storage(left);
+    if (storage != COL_INT && storage != COL_UINT) {
+        return false;
+    }
+    return RuntimeFilter::type_match(left, right);
+}
+
+int JoinHashTable::init(const std::vector<ExprNode*>& build_slots,
+                        const std::vector<ExprNode*>& probe_slots) {
+    if (build_slots.size() != probe_slots.size() || build_slots.empty()) {
+        DB_WARNING("join slot size not match, build:%lu probe:%lu",
+                build_slots.size(), probe_slots.size());
+        return -1;
+    }
+    clear();
+    _build_slots = build_slots;
+    _probe_slots = probe_slots;
+    _fixed_key = build_slots.size() == 1 &&
+        is_fixed_key_type(build_slots[0]->col_type(), probe_slots[0]->col_type());
+    return 0;
+}
+
+bool JoinHashTable::encode_fixed_key(MemRow* row, const std::vector<ExprNode*>& slots,
+                                     int64_t* key) {
+    SlotRef* slot = static_cast<SlotRef*>(slots[0]);
+    ExprValue value = row->get_value(slot->tuple_id(), slot->slot_id());
+    if (value.is_null()) {
+        return false;
+    }
+    if (column_storage(value.type) == COL_UINT) {
+        *key = (int64_t)value.get_numberic<uint64_t>();
+    } else {
+        *key = value.get_numberic<int64_t>();
+    }
+    return true;
+}
+
+bool JoinHashTable::encode_string_key(MemRow* row, const std::vector<ExprNode*>& slots,
+                                      std::string* key) {
+    MutTableKey table_key;
+    for (auto& slot_expr : slots) {
+        SlotRef* slot = static_cast<SlotRef*>(slot_expr);
+        ExprValue value = row->get_value(slot->tuple_id(), slot->slot_id());
+        if (value.is_null()) {
+            return false;
+        }
+        table_key.append_value(value.cast_to(pb::STRING));
+    }
+    *key = table_key.data();
+    return true;
+}
+
+void JoinHashTable::build(const std::vector<MemRow*>& rows) {
+    size_t bucket = std::max(rows.size() * 2, (size_t)16);
+    if (_fixed_key && !_fixed_map.initialized()) {
+        _fixed_map.init(bucket);
+    } else if (!_fixed_key && !_string_map.initialized()) {
+        _string_map.init(bucket);
+    }
+    _rows.reserve(rows.size());
+    _next.reserve(rows.size());
+    // 倒序插入头部，链表上的顺序和输入一致
+    for (auto iter = rows.rbegin(); iter != rows.rend(); ++iter) {
+        MemRow* row = *iter;
+        int32_t* head = nullptr;
+        if (_fixed_key) {
+            int64_t key = 0;
+            if (!encode_fixed_key(row, _build_slots, &key)) {
+                continue;
+            }
+            head = _fixed_map.seek(key);
+            if (head == nullptr) {
+                head = &_fixed_map[key];
+                *head = -1;
+            }
+        } else {
+            if (!encode_string_key(row, _build_slots, &_key_buf)) {
+                continue;
+            }
+            head = _string_map.seek(_key_buf);
+            if (head == nullptr) {
+                head = &_string_map[_key_buf];
+                *head = -1;
+            }
+        }
+        _rows.emplace_back(row);
+        _next.emplace_back(*head);
+        *head = _rows.size() - 1;
+    }
+}
+
+int32_t JoinHashTable::probe(MemRow* row) {
+    int32_t* head = nullptr;
+    if (_fixed_key) {
+        int64_t key = 0;
+        if (!encode_fixed_key(row, _probe_slots, &key)) {
+            return -1;
+        }
+        head = _fixed_map.seek(key);
+    } else {
+        if (!encode_string_key(row, _probe_slots, &_key_buf)) {
+            return -1;
+        }
+        head = _string_map.seek(_key_buf);
+    }
+    return head == nullptr ? -1 : *head;
+}
+
+void JoinHashTable::clear() {
+    _fixed_map.clear();
+    _string_map.clear();
+    _rows.clear();
+    _next.clear();
+}
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
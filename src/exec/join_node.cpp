@@ -21,8 +21,16 @@
 #include "plan_router.h"
 #include "logical_planner.h"
 #include "literal.h"
+#include "column_batch.h"
 
 namespace baikaldb {
+DEFINE_bool(join_use_hash_table, true, "use compact JoinHashTable for hash join");
+DEFINE_int64(join_runtime_filter_min_rows, 10000,
+        "push range/bloom runtime filter instead of in condition when outer rows exceed, 0 means never");
+DEFINE_bool(join_push_runtime_filter, true, "send join bloom filter to store scan");
+DEFINE_int64(runtime_filter_max_push_bytes, 1024 * 1024,
+        "max bloom filter bytes sent to store with each request");
+
 int JoinNode::init(const pb::PlanNode& node) {
     int ret = 0;
     ret = Joiner::init(node);
@@ -32,6 +40,7 @@ int JoinNode::init(const pb::PlanNode& node) {
     } 
     const pb::JoinNode& join_node = node.derive_node().join_node();
     _join_type = join_node.join_type();
+    _join_algo = join_node.join_algo();
     
     for (auto& expr : join_node.conditions()) {
         ExprNode* condition = NULL;
@@ -207,12 +216,23 @@ int JoinNode::hash_join(RuntimeState* state) {
         _outer_table_is_null = true;
         return 0;
     }
-    construct_equal_values(_outer_tuple_data, _outer_equal_slot);
     std::vector<ExprNode*> in_exprs;
-    ret = construct_in_condition(_inner_equal_slot, _outer_join_values, in_exprs);
-    if (ret < 0) {
-        DB_WARNING("ExecNode::create in condition for right table fail");
-        return ret;
+    if (use_runtime_filter()) {
+        ret = construct_runtime_filters(in_exprs);
+        if (ret < 0) {
+            DB_WARNING("ExecNode::create runtime filter for right table fail");
+            return ret;
+        }
+        if (_outer_table_is_null) {
+            return 0;
+        }
+    } else {
+        construct_equal_values(_outer_tuple_data, _outer_equal_slot);
+        ret = construct_in_condition(_inner_equal_slot, _outer_join_values, in_exprs);
+        if (ret < 0) {
+            DB_WARNING("ExecNode::create in condition for right table fail");
+            return ret;
+        }
     }
 
     //表达式下推，下推的那个节点重新做索引选择，路由选择
@@ -239,14 +259,163 @@ int JoinNode::hash_join(RuntimeState* state) {
             DB_WARNING("fetcher inner node fail");
             return ret;
         }
-        construct_hash_map(_inner_tuple_data, _inner_equal_slot);
         _outer_iter = _outer_tuple_data.begin();
-    } else {
-        construct_hash_map(_outer_tuple_data, _outer_equal_slot);
     }
+    build_join_table();
+    return 0;
+}
+
+void JoinNode::build_join_table() {
+    // left/right join用inner表建表，outer表probe；inner join反之，inner表流式probe
+    bool build_inner = _join_type == pb::LEFT_JOIN || _join_type == pb::RIGHT_JOIN;
+    std::vector<MemRow*>& build_rows = build_inner ? _inner_tuple_data : _outer_tuple_data;
+    std::vector<ExprNode*>& build_slots = build_inner ? _inner_equal_slot : _outer_equal_slot;
+    std::vector<ExprNode*>& probe_slots = build_inner ? _outer_equal_slot : _inner_equal_slot;
+    _use_join_table = FLAGS_join_use_hash_table &&
+        _join_table.init(build_slots, probe_slots) == 0;
+    if (!_use_join_table) {
+        construct_hash_map(build_rows, build_slots);
+        return;
+    }
+    TimeCost cost;
+    _join_table.build(build_rows);
+    DB_DEBUG("build join table rows:%lu keys:%lu fixed_key:%d cost:%ld",
+            _join_table.size(), _join_table.key_count(), _join_table.is_fixed_key(),
+            cost.get_time());
+}
+
+bool JoinNode::use_runtime_filter() {
+    // join reorder认为inner表按索引查找更优
+    if (_join_algo == pb::JA_INDEX_LOOKUP || FLAGS_join_runtime_filter_min_rows <= 0) {
+        return false;
+    }
+    if (_join_algo != pb::JA_HASH_SCAN &&
+            (int64_t)_outer_tuple_data.size() < FLAGS_join_runtime_filter_min_rows) {
+        return false;
+    }
+    for (size_t i = 0; i < _inner_equal_slot.size(); i++) {
+        if (!RuntimeFilter::type_match(_inner_equal_slot[i]->col_type(),
+                _outer_equal_slot[i]->col_type())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// slot_ref op value
+static int create_range_condition(ExprNode* slot_ref, parser::FuncType op,
+        const ExprValue& value, std::vector<ExprNode*>& exprs) {
+    pb::Expr expr;
+    pb::ExprNode* fn_node = expr.add_nodes();
+    fn_node->set_node_type(pb::FUNCTION_CALL);
+    fn_node->set_col_type(pb::INVALID_TYPE);
+    fn_node->set_num_children(2);
+    pb::Function* func = fn_node->mutable_fn();
+    func->set_name(op == parser::FT_EQ ? "eq" : (op == parser::FT_GE ? "ge" : "le"));
+    func->set_fn_op(op);
+    pb::ExprNode* slot_node = expr.add_nodes();
+    slot_node->set_node_type(pb::SLOT_REF);
+    slot_node->set_col_type(slot_ref->col_type());
+    slot_node->set_num_children(0);
+    slot_node->mutable_derive_node()->set_tuple_id(static_cast<SlotRef*>(slot_ref)->tuple_id());
+    slot_node->mutable_derive_node()->set_slot_id(static_cast<SlotRef*>(slot_ref)->slot_id());
+    slot_node->mutable_derive_node()->set_field_id(static_cast<SlotRef*>(slot_ref)->field_id());
+    Literal literal(value);
+    literal.transfer_pb(expr.add_nodes());
+    ExprNode* conjunct = nullptr;
+    int ret = ExprNode::create_tree(expr, &conjunct);
+    if (ret < 0) {
+        DB_WARNING("create range condition fail");
+        return ret;
+    }
+    ret = conjunct->type_inferer();
+    if (ret < 0) {
+        ExprNode::destroy_tree(conjunct);
+        return ret;
+    }
+    exprs.emplace_back(conjunct);
     return 0;
 }
 
+int JoinNode::construct_runtime_filters(std::vector<ExprNode*>& filter_exprs) {
+    TimeCost cost;
+    _runtime_filters.clear();
+    _runtime_filters.resize(_inner_equal_slot.size());
+    for (size_t i = 0; i < _inner_equal_slot.size(); i++) {
+        RuntimeFilter& filter = _runtime_filters[i];
+        if (filter.init(_inner_equal_slot[i]->col_type(), _outer_tuple_data.size()) < 0) {
+            return -1;
+        }
+        SlotRef* outer_slot = static_cast<SlotRef*>(_outer_equal_slot[i]);
+        for (auto& mem_row : _outer_tuple_data) {
+            filter.insert(mem_row->get_value(outer_slot->tuple_id(), outer_slot->slot_id()));
+        }
+        if (filter.empty()) {
+            // 驱动表的key全是null，inner join一定没有结果；outer join不下推条件
+            if (_join_type == pb::INNER_JOIN) {
+                _outer_table_is_null = true;
+            }
+            _runtime_filters.clear();
+            return 0;
+        }
+    }
+    for (size_t i = 0; i < _inner_equal_slot.size(); i++) {
+        RuntimeFilter& filter = _runtime_filters[i];
+        int ret = 0;
+        if (filter.min_value().compare(filter.max_value()) == 0) {
+            ret = create_range_condition(_inner_equal_slot[i], parser::FT_EQ,
+                    filter.min_value(), filter_exprs);
+        } else {
+            ret = create_range_condition(_inner_equal_slot[i], parser::FT_GE,
+                    filter.min_value(), filter_exprs);
+            if (ret == 0) {
+                ret = create_range_condition(_inner_equal_slot[i], parser::FT_LE,
+                        filter.max_value(), filter_exprs);
+            }
+        }
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    push_runtime_filters();
+    DB_WARNING("construct runtime filter, outer rows:%lu filters:%lu cost:%ld",
+            _outer_tuple_data.size(), _runtime_filters.size(), cost.get_time());
+    return 0;
+}
+
+void JoinNode::push_runtime_filters() {
+    if (!FLAGS_join_push_runtime_filter) {
+        return;
+    }
+    std::vector<ExecNode*> scan_nodes;
+    _inner_node->get_node(pb::SCAN_NODE, scan_nodes);
+    for (auto exec_node : scan_nodes) {
+        RocksdbScanNode* scan_node = static_cast<RocksdbScanNode*>(exec_node);
+        if (scan_node->engine() == pb::INFORMATION_SCHEMA) {
+            continue;
+        }
+        for (size_t i = 0; i < _runtime_filters.size(); i++) {
+            SlotRef* slot = static_cast<SlotRef*>(_inner_equal_slot[i]);
+            // 太大的filter每个region都发一份，得不偿失，只在baikaldb上probe时用
+            if (slot->tuple_id() != scan_node->tuple_id() ||
+                    (int64_t)_runtime_filters[i].byte_size() > FLAGS_runtime_filter_max_push_bytes) {
+                continue;
+            }
+            scan_node->add_runtime_filter(slot->slot_id(), _runtime_filters[i]);
+        }
+    }
+}
+
+bool JoinNode::runtime_filter_pass(MemRow* probe_row) {
+    for (size_t i = 0; i < _runtime_filters.size(); i++) {
+        SlotRef* slot = static_cast<SlotRef*>(_inner_equal_slot[i]);
+        if (!_runtime_filters[i].may_contain(probe_row->get_value(slot->tuple_id(), slot->slot_id()))) {
+            return false;
+        }
+    }
+    return true;
+}
+
 int JoinNode::nested_loop_join(RuntimeState* state) {
     _mem_row_desc = state->mem_row_desc();
     SortNode* sort_node = static_cast<SortNode*>(_outer_node->get_node(pb::SORT_NODE));
@@ -337,6 +506,12 @@ int JoinNode::get_next(RuntimeState* state, RowBatch* batch, bool* eos) {
         return 0;
     }
     if (_use_hash_map) {
+        if (_use_join_table) {
+            if (_join_type == pb::INNER_JOIN) {
+                return get_next_via_join_table_inner(state, batch, eos);
+            }
+            return get_next_via_join_table_other(state, batch, eos);
+        }
         if (_join_type == pb::INNER_JOIN) {
             return get_next_for_hash_inner_join(state, batch, eos);
         }
@@ -503,6 +678,118 @@ int JoinNode::get_next_for_hash_inner_join(RuntimeState* state, RowBatch* batch,
     return 0;
 }
 
+int JoinNode::get_next_via_join_table_other(RuntimeState* state, RowBatch* batch, bool* eos) {
+    TimeCost get_next_time;
+    while (1) {
+        if (_outer_iter == _outer_tuple_data.end()) {
+            DB_WARNING("when join, outer iter is end, time_cost:%ld", get_next_time.get_time());
+            *eos = true;
+            return 0;
+        }
+        if (!_probe_started) {
+            _match_idx = _join_table.probe(*_outer_iter);
+            _probe_started = true;
+            if (_match_idx < 0) {
+                if (reached_limit()) {
+                    *eos = true;
+                    return 0;
+                }
+                if (batch->is_full()) {
+                    _probe_started = false;
+                    return 0;
+                }
+                //fill NULL
+                int ret = construct_null_result_batch(batch, *_outer_iter);
+                if (ret < 0) {
+                    DB_WARNING("construct result batch fail");
+                    return ret;
+                }
+                ++_num_rows_returned;
+            }
+        }
+        for (; _match_idx >= 0; _match_idx = _join_table.next(_match_idx)) {
+            if (reached_limit()) {
+                DB_WARNING("when join, reach limit size:%lu, time_cost:%ld",
+                            batch->size(), get_next_time.get_time());
+                *eos = true;
+                return 0;
+            }
+            if (batch->is_full()) {
+                return 0;
+            }
+            bool matched = false;
+            int ret = construct_result_batch(batch, *_outer_iter, _join_table.row(_match_idx), matched);
+            if (ret < 0) {
+                DB_WARNING("construct result batch fail");
+                return ret;
+            }
+            ++_num_rows_returned;
+        }
+        _probe_started = false;
+        ++_outer_iter;
+    }
+    return 0;
+}
+
+int JoinNode::get_next_via_join_table_inner(RuntimeState* state, RowBatch* batch, bool* eos) {
+    TimeCost get_next_time;
+    while (1) {
+        if (_inner_row_batch.is_traverse_over()) {
+            if (_child_eos) {
+                *eos = true;
+                DB_WARNING("when join, get next complete, child eos, time_cost:%ld",
+                            get_next_time.get_time());
+                return 0;
+            }
+            _inner_row_batch.clear();
+            int ret = _inner_node->get_next(state, &_inner_row_batch, &_child_eos);
+            if (ret < 0) {
+                DB_WARNING("_children get_next fail");
+                return ret;
+            }
+            continue;
+        }
+        MemRow* inner_mem_row = _inner_row_batch.get_row().get();
+        if (!_probe_started) {
+            _match_idx = -1;
+            if (runtime_filter_pass(inner_mem_row)) {
+                _match_idx = _join_table.probe(inner_mem_row);
+            }
+            _probe_started = true;
+        }
+        for (; _match_idx >= 0; _match_idx = _join_table.next(_match_idx)) {
+            if (reached_limit()) {
+                DB_WARNING("when join, reach limit size:%lu, time_cost:%ld",
+                            batch->size(), get_next_time.get_time());
+                *eos = true;
+                return 0;
+            }
+            if (batch->is_full()) {
+                return 0;
+            }
+            bool matched = false;
+            int ret = construct_result_batch(batch, _join_table.row(_match_idx), inner_mem_row, matched);
+            if (ret < 0) {
+                DB_WARNING("construct result batch fail");
+                return ret;
+            }
+            ++_num_rows_returned;
+        }
+        _probe_started = false;
+        _inner_row_batch.next();
+    }
+    return 0;
+}
+
+void JoinNode::close(RuntimeState* state) {
+    Joiner::close(state);
+    _join_table.clear();
+    _runtime_filters.clear();
+    _use_join_table = false;
+    _match_idx = -1;
+    _probe_started = false;
+}
+
 bool JoinNode::need_reorder(
         std::map<int32_t, ExecNode*>& tuple_join_child_map,
         std::map<int32_t, std::set<int32_t>>& tuple_equals_map, 
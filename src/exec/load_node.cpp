@@ -16,12 +16,14 @@
 #include "runtime_state.h"
 
 #include <algorithm>
+#include <deque>
 #include <iterator>
 #include <boost/algorithm/string.hpp>
 
 namespace baikaldb {
 
 DEFINE_uint64(row_batch_size, 200, "row_batch_size");
+DEFINE_int32(load_parse_concurrency, 4, "load data chunks parsed in parallel while inserting");
 
 int LoadNode::init(const pb::PlanNode& node) { 
     int ret = 0;
@@ -98,62 +100,120 @@ int LoadNode::open(RuntimeState* state) {
     if (0 != ignore_specified_lines(file, data_buffer.get(), BUFFER_SIZE)) {
         return -1;
     }
-    std::vector<std::string> row_lines;
-    row_lines.reserve(FLAGS_row_batch_size);
-    while (!_read_eof) {
+    // 流水线: 当前bthread按块读文件并按序插入，最多load_parse_concurrency个块在后台并行解析
+    // 插入某一块时后面的块已在解析，解析和插入互相重叠
+    std::deque<SmartLoadChunk> chunks;
+    ON_SCOPE_EXIT(([&chunks]() {
+        for (auto& chunk : chunks) {
+            chunk->parsed.wait();
+        }
+    }));
+    TimeCost load_time;
+    int64_t inserted_pos = _file_cur_pos;
+    while (!_read_eof || !chunks.empty()) {
         if (state->is_cancelled()) {
             DB_WARNING("load is cancelled, log_id: %lu", state->log_id());
             return 0;
         }
-        int64_t size = file.Read(_file_cur_pos, data_buffer.get(), BUFFER_SIZE);
-        if (size < 0) {
-            DB_WARNING("file: %s read failed", _data_path.c_str());
-            return -1;
-        } else if (size == 0) {
+        while (!_read_eof && chunks.size() < (size_t)std::max(FLAGS_load_parse_concurrency, 1)) {
+            SmartLoadChunk chunk;
+            if (0 != read_chunk(file, data_buffer.get(), chunk)) {
+                return -1;
+            }
+            if (chunk == nullptr) {
+                break;
+            }
+            chunk->parsed.increase();
+            Bthread bth(&BTHREAD_ATTR_SMALL);
+            bth.run([this, chunk]() {
+                parse_chunk(chunk);
+                chunk->parsed.decrease_signal();
+            });
+            chunks.emplace_back(chunk);
+        }
+        if (chunks.empty()) {
             break;
         }
-        MemBuf sbuf(data_buffer.get(), data_buffer.get() + size);
-        std::istream f(&sbuf);
-        while (!f.eof()) {
+        SmartLoadChunk chunk = chunks.front();
+        chunk->parsed.wait();
+        chunks.pop_front();
+        if (chunk->ret != 0) {
+            return -1;
+        }
+        for (auto& records : chunk->batches) {
             if (state->is_cancelled()) {
                 DB_WARNING("load is cancelled, log_id: %lu", state->log_id());
                 return 0;
             }
-            std::string line;
-            std::getline(f, line);
-            if (f.eof()) {
-                // 首行没读完整说明line size > _buf size 暂时不支持
-                if (!_has_get_line) {
-                    DB_FATAL("path: %s, line_size: %lu > buf_size: %ld", _data_path.c_str(), line.size(), BUFFER_SIZE);
-                    return -1;
-                }
-                if (_file_cur_pos + line.size() == _file_size) {
-                    _read_eof = true;
-                    DB_WARNING("path: %s, eof, pos: %ld line_size:%ld", _data_path.c_str(), _file_cur_pos, line.size());
-                }
-                break;
-            }
-
-            _has_get_line = true;
-            _buf_cur_pos += line.size() + 1;
-            _file_cur_pos += line.size() + 1;
-            if(line.size() > 0) {
-                row_lines.emplace_back(line);
-            }
-            if (row_lines.size() >= FLAGS_row_batch_size) {
-                if (0 != handle_lines(state, row_lines)) {
-                    return -1;
-                }
-                row_lines.clear();
+            if (0 != insert_records(state, records)) {
+                return -1;
             }
         }
+        inserted_pos += chunk->data.size();
+        DB_NOTICE("load progress path: %s, pos: %ld, file_size: %ld, percent: %ld%%, "
+                "affected_rows: %d, cost: %ld, log_id: %lu", _data_path.c_str(), inserted_pos, _file_size,
+                _file_size > 0 ? inserted_pos * 100 / _file_size : 100L, _affected_rows,
+                load_time.get_time(), state->log_id());
     }
-    if (row_lines.size() > 0) {
-        if (0 != handle_lines(state, row_lines)) {
+    return _affected_rows;
+}
+
+// 读取从_file_cur_pos开始的完整行，文件读完时chunk为nullptr
+int LoadNode::read_chunk(butil::File& file, char* data_buffer, SmartLoadChunk& chunk) {
+    int64_t size = file.Read(_file_cur_pos, data_buffer, BUFFER_SIZE);
+    if (size < 0) {
+        DB_WARNING("file: %s read failed", _data_path.c_str());
+        return -1;
+    } else if (size == 0) {
+        _read_eof = true;
+        return 0;
+    }
+    int64_t chunk_size = size;
+    if (_file_cur_pos + size < _file_size) {
+        const char* last_line_end = (const char*)memrchr(data_buffer, '\n', size);
+        if (last_line_end == nullptr) {
+            // 一行没读完整说明line size > _buf size 暂时不支持
+            DB_FATAL("path: %s, line_size > buf_size: %ld", _data_path.c_str(), BUFFER_SIZE);
             return -1;
         }
+        chunk_size = last_line_end - data_buffer + 1;
+    } else {
+        _read_eof = true;
+        DB_WARNING("path: %s, eof, pos: %ld size: %ld", _data_path.c_str(), _file_cur_pos, size);
+    }
+    chunk.reset(new LoadChunk);
+    chunk->data.assign(data_buffer, chunk_size);
+    _file_cur_pos += chunk_size;
+    _buf_cur_pos += chunk_size;
+    return 0;
+}
+
+void LoadNode::parse_chunk(const SmartLoadChunk& chunk) {
+    std::vector<std::string> row_lines;
+    row_lines.reserve(FLAGS_row_batch_size);
+    const std::string& data = chunk->data;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t line_end = data.find('\n', pos);
+        if (line_end == std::string::npos) {
+            line_end = data.size();
+        }
+        if (line_end > pos) {
+            row_lines.emplace_back(data, pos, line_end - pos);
+        }
+        pos = line_end + 1;
+        if (row_lines.size() >= FLAGS_row_batch_size || (pos >= data.size() && !row_lines.empty())) {
+            std::vector<SmartRecord> records;
+            if (0 != parse_lines(row_lines, records)) {
+                chunk->ret = -1;
+                return;
+            }
+            if (!records.empty()) {
+                chunk->batches.emplace_back(std::move(records));
+            }
+            row_lines.clear();
+        }
     }
-    return _affected_rows;
 }
 
 ExprValue LoadNode::create_field_value(FieldInfo& field_info, std::string& str_val, bool& is_legal) {
@@ -323,10 +383,8 @@ int LoadNode::fill_field_value(SmartRecord record, FieldInfo& field, ExprValue&
     return 0;
 }
 
-int LoadNode::handle_lines(RuntimeState* state, std::vector<std::string>& row_lines) {
-    std::string insert_values;
-    std::vector<SmartRecord> records;
-    TimeCost get_next_time;
+// 在后台bthread中执行，只读访问表信息
+int LoadNode::parse_lines(std::vector<std::string>& row_lines, std::vector<SmartRecord>& records) {
     records.reserve(row_lines.size());
     for (auto& line : row_lines) {
         std::vector<std::string> split_vec;
@@ -376,9 +434,11 @@ int LoadNode::handle_lines(RuntimeState* state, std::vector<std::string>& row_li
         records.emplace_back(row);
         //DB_WARNING("row %s", row->debug_string().c_str());
     }
-    if (records.size() == 0) {
-        return 0;
-    }
+    return 0;
+}
+
+int LoadNode::insert_records(RuntimeState* state, std::vector<SmartRecord>& records) {
+    TimeCost get_next_time;
     _insert_manager->set_records(records);
     int ret = _children[0]->open(state);
     _children[0]->reset(state);
@@ -529,6 +529,47 @@ int PacketNode::open_cmsketch(RuntimeState* state) {
     return 0;
 }
 
+// 多列组合值的distinct按采样计算，hash方式与store构建cmsketch一致
+void PacketNode::multi_column_distinct(RuntimeState* state,
+        std::vector<std::shared_ptr<RowBatch>>& batch_vector) {
+    std::map<int32_t, const pb::SlotDescriptor*> field_slot_map;
+    for (auto& slot : state->get_tuple_desc(0)->slots()) {
+        if (slot.has_field_id()) {
+            field_slot_map[slot.field_id()] = &slot;
+        }
+    }
+    for (auto& pair : state->cmsketch->multi_columns()) {
+        std::vector<const pb::SlotDescriptor*> slots;
+        for (auto field_id : pair.second.field_ids) {
+            if (field_slot_map.count(field_id) == 0) {
+                break;
+            }
+            slots.emplace_back(field_slot_map[field_id]);
+        }
+        if (slots.size() != pair.second.field_ids.size()) {
+            continue;
+        }
+        std::unordered_set<uint64_t> hashes;
+        for (auto& batch : batch_vector) {
+            for (batch->reset(); !batch->is_traverse_over(); batch->next()) {
+                uint64_t hash = 0;
+                for (auto slot : slots) {
+                    ExprValue value = batch->get_row()->get_value(0, slot->slot_id());
+                    uint64_t value_hash = 0;
+                    if (!value.is_null()) {
+                        value.cast_to(slot->slot_type());
+                        value_hash = value.hash();
+                    }
+                    hash = multi_column_hash(hash, value_hash);
+                }
+                hashes.insert(hash);
+            }
+            batch->reset();
+        }
+        state->cmsketch->set_multi_distinct(pair.first.first, pair.first.second, hashes.size());
+    }
+}
+
 int PacketNode::open_analyze(RuntimeState* state) {
     bool eos = false;
     int ret = 0;
@@ -577,6 +618,9 @@ int PacketNode::open_analyze(RuntimeState* state) {
         DB_FATAL("can`t find table_id");
         return -1;
     }
+    if (state->cmsketch != nullptr) {
+        multi_column_distinct(state, batch_vector);
+    }
     pb::Histogram* histogram = stat->mutable_histogram();
     PacketSample packet_sample(batch_vector, slot_order_exprs, state->get_tuple_desc(0));
     histogram->set_sample_rows(state->num_returned_rows());
@@ -467,11 +467,19 @@ int RocksdbScanNode::open(RuntimeState* state) {
         state->add_scan_index(id);
     }
 
+    ret = init_runtime_filters();
+    if (ret < 0) {
+        DB_WARNING_STATE(state, "init runtime filter fail");
+        return ret;
+    }
     if (!_use_get && _table_info->engine == pb::ROCKSDB_CSTORE && _index_id == _table_id) {
         std::unordered_set<int32_t> filt_field_ids;
         for (auto& expr : _index_conjuncts) {
             expr->get_all_field_ids(filt_field_ids);
         }
+        for (auto& rf : _runtime_filters) {
+            filt_field_ids.insert(rf.field_id);
+        }
         for (auto& iter : _field_ids) {
             if (filt_field_ids.count(iter.first)) {
                 _filt_field_ids.push_back(iter.first);
@@ -483,6 +491,42 @@ int RocksdbScanNode::open(RuntimeState* state) {
     return 0;
 }
 
+int RocksdbScanNode::init_runtime_filters() {
+    _runtime_filters.clear();
+    auto& scan_pb = _pb_node.derive_node().scan_node();
+    for (auto& pb_filter : scan_pb.runtime_filters()) {
+        ScanRuntimeFilter rf;
+        rf.slot_id = pb_filter.slot_id();
+        for (auto& slot : _tuple_desc->slots()) {
+            if (slot.slot_id() == rf.slot_id) {
+                rf.field_id = slot.field_id();
+                break;
+            }
+        }
+        if (rf.field_id == 0 || rf.filter.init_from_pb(pb_filter) < 0) {
+            // filter只用于预过滤，有问题时忽略不影响结果
+            DB_WARNING("ignore runtime filter, slot_id:%d", rf.slot_id);
+            continue;
+        }
+        rf.in_index = _is_covering_index || _index_slot_field_map.count(rf.slot_id) > 0;
+        _runtime_filters.emplace_back(std::move(rf));
+    }
+    return 0;
+}
+
+bool RocksdbScanNode::runtime_filter_pass(MemRow* row, bool check_index_slots,
+        bool check_other_slots) {
+    for (auto& rf : _runtime_filters) {
+        if ((rf.in_index && !check_index_slots) || (!rf.in_index && !check_other_slots)) {
+            continue;
+        }
+        if (!rf.filter.may_contain(row->get_value(_tuple_id, rf.slot_id))) {
+            return false;
+        }
+    }
+    return true;
+}
+
 int RocksdbScanNode::get_next(RuntimeState* state, RowBatch* batch, bool* eos) {  
     if (_is_explain) {
         // 生成一条临时数据跑通所有流程
@@ -542,6 +586,8 @@ void RocksdbScanNode::close(RuntimeState* state) {
     _query_words.clear();
     _match_modes.clear();
     _reverse_indexes.clear();
+    _runtime_filters.clear();
+    _pb_node.mutable_derive_node()->mutable_scan_node()->clear_runtime_filters();
 }
 
 int RocksdbScanNode::get_next_by_table_get(RuntimeState* state, RowBatch* batch, bool* eos) {
@@ -786,7 +832,13 @@ int RocksdbScanNode::index_ddl_work(RuntimeState* state, MemRow* row) {
 
 int RocksdbScanNode::memory_limit_exceeded(RuntimeState* state, RowBatch* batch) {
     if (_scan_rows > FLAGS_store_row_number_to_check_memory) {
-        if (0 != state->memory_limit_exceeded(batch->used_bytes_size())) {
+        int64_t used_bytes = 0;
+        for (size_t i = 0; i < batch->size(); i++) {
+            MemRow* row = batch->get_row(i).get();
+            row->set_charged_size(row->used_size());
+            used_bytes += row->used_size();
+        }
+        if (0 != state->memory_limit_exceeded(used_bytes)) {
             return -1;
         }
     }
@@ -849,7 +901,7 @@ int RocksdbScanNode::get_next_by_table_seek(RuntimeState* state, RowBatch* batch
             if (ret < 0) {
                 continue;
             }
-            if (!need_copy(row.get(), _index_conjuncts)) {
+            if (!need_copy(row.get(), _index_conjuncts) || !runtime_filter_pass(row.get(), true, true)) {
                 state->inc_num_filter_rows();
                 ++index_filter_cnt;
                 continue;
@@ -873,7 +925,7 @@ int RocksdbScanNode::get_next_by_table_seek(RuntimeState* state, RowBatch* batch
             // scan primary
             RowBatch row_batch;
             std::shared_ptr<FiltBitSet> filter;
-            if (_index_conjuncts.size() > 0) {
+            if (_index_conjuncts.size() > 0 || _runtime_filters.size() > 0) {
                 filter.reset(new FiltBitSet());
             }
             _table_iter->reset_primary_keys();
@@ -903,7 +955,8 @@ int RocksdbScanNode::get_next_by_table_seek(RuntimeState* state, RowBatch* batch
             if (filter != nullptr) {
                 for (row_batch.reset(); !row_batch.is_traverse_over(); row_batch.next()) {
                     std::unique_ptr<MemRow>& row = row_batch.get_row();
-                    if (!need_copy(row.get(), _index_conjuncts)) {
+                    if (!need_copy(row.get(), _index_conjuncts) ||
+                            !runtime_filter_pass(row.get(), true, true)) {
                         filter->set(row_batch.index());
                     }
                 }
@@ -1054,7 +1107,8 @@ int RocksdbScanNode::get_next_by_index_seek(RuntimeState* state, RowBatch* batch
             }
         }
         //DB_NOTICE("record_before:%s", record->debug_string().c_str());
-        if (!need_copy(row.get(), _index_conjuncts)) {
+        // 索引中的列直接过滤，减少反查主表
+        if (!need_copy(row.get(), _index_conjuncts) || !runtime_filter_pass(row.get(), true, false)) {
             state->inc_num_filter_rows();
             ++index_filter_cnt;
             continue;
@@ -1078,6 +1132,11 @@ int RocksdbScanNode::get_next_by_index_seek(RuntimeState* state, RowBatch* batch
                 row->set_value(slot.tuple_id(), slot.slot_id(),
                         record->get_value(field));
             }
+            if (!runtime_filter_pass(row.get(), false, true)) {
+                state->inc_num_filter_rows();
+                ++index_filter_cnt;
+                continue;
+            }
         }
         batch->move_row(std::move(row));
         ++_num_rows_returned;
@@ -465,6 +465,42 @@ int64_t ScanNode::pre_process_select_index() {
 
 }
 
+int64_t ScanNode::estimate_rows(int64_t* read_rows) {
+    SchemaFactory* factory = SchemaFactory::get_instance();
+    int64_t table_rows = factory->get_total_rows(_table_id);
+    if (factory->get_statistics_ptr(_table_id) == nullptr || table_rows <= 0) {
+        return -1;
+    }
+    *read_rows = table_rows;
+    auto& indexes = _pb_node.derive_node().scan_node().indexes();
+    if (indexes.size() == 0 || _paths.count(indexes(0).index_id()) == 0) {
+        return table_rows;
+    }
+    auto& path = _paths[indexes(0).index_id()];
+    path->calc_cost(nullptr, _filed_selectiy);
+    double other_selectivity = path->fields_to_selectivity(path->index_other_field_ids, _filed_selectiy) *
+        path->fields_to_selectivity(path->other_field_ids, _filed_selectiy);
+    *read_rows = std::max(path->index_read_rows, (int64_t)1);
+    return std::max((int64_t)(path->index_read_rows * other_selectivity), (int64_t)1);
+}
+
+bool ScanNode::has_index_prefix(int32_t field_id) {
+    for (auto& pair : _paths) {
+        auto& path = pair.second;
+        if (path->is_virtual || path->hint == AccessPath::IGNORE_INDEX || path->index_info_ptr == nullptr) {
+            continue;
+        }
+        if (path->index_type != pb::I_PRIMARY && path->index_type != pb::I_UNIQ &&
+                path->index_type != pb::I_KEY) {
+            continue;
+        }
+        if (!path->index_info_ptr->fields.empty() && path->index_info_ptr->fields[0].id == field_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
 int64_t ScanNode::select_index_in_baikaldb(const std::string& sample_sql) {
     pb::ScanNode* pb_scan_node = mutable_pb_node()->mutable_derive_node()->mutable_scan_node();
     _router_index_id = _table_id; 
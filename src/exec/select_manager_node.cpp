@@ -20,6 +20,10 @@
 #include "agg_node.h"
 
 namespace baikaldb {
+DECLARE_int64(select_chunk_bytes);
+DEFINE_int64(select_merge_chunk_bytes, 256 * 1024,
+        "chunk bytes per region when ordered select is merged as a stream, 0 to disable");
+
 int SelectManagerNode::open(RuntimeState* state) {
     START_LOCAL_TRACE(get_trace(), state->get_trace_cost(), OPEN_TRACE, ([state](TraceLocalNode& local_node) {
         local_node.set_scan_rows(state->num_scan_rows());
@@ -51,6 +55,14 @@ int SelectManagerNode::open(RuntimeState* state) {
     int64_t main_table_id = scan_node->table_id();
     //如果命中的不是全局二级索引，或者全局二级索引是covering_index, 则直接在主表或者索引表上做scan即可
     if (router_index_id == main_table_id || scan_node->covering_index()) {
+        // 不需要排序时按region顺序输出，store分块返回，边续读边输出
+        // 需要排序时各region结果已有序，用较小的块做流式多路归并，所有region的块同时驻留内存
+        if (_slot_order_exprs.empty()) {
+            _fetcher_store.enable_cursor = FLAGS_select_chunk_bytes > 0;
+        } else {
+            _fetcher_store.enable_cursor = FLAGS_select_merge_chunk_bytes > 0;
+            _fetcher_store.chunk_bytes = FLAGS_select_merge_chunk_bytes;
+        }
         ret = _fetcher_store.run(state, _region_infos, _children[0], client_conn->seq_id, client_conn->seq_id, pb::OP_SELECT);
     } else {
         ret = open_global_index(state, scan_node, router_index_id, main_table_id);
@@ -60,6 +72,20 @@ int SelectManagerNode::open(RuntimeState* state) {
                 state->txn_id, state->log_id());
         return ret;
     }
+    if (!_fetcher_store.region_cursors.empty() && !_slot_order_exprs.empty()) {
+        ret = open_merging(state);
+        if (ret < 0) {
+            return ret;
+        }
+        return _fetcher_store.affected_rows.load();
+    }
+    if (!_fetcher_store.region_cursors.empty()) {
+        _streaming = true;
+        for (auto& pair : _fetcher_store.start_key_sort) {
+            _stream_regions.emplace_back(pair.second);
+        }
+        return _fetcher_store.affected_rows.load();
+    }
     for (auto& pair : _fetcher_store.start_key_sort) {
         auto& batch = _fetcher_store.region_batch[pair.second];
         if (batch != nullptr && batch->size() != 0) {
@@ -142,7 +168,13 @@ int SelectManagerNode::get_next(RuntimeState* state, RowBatch* batch, bool* eos)
         return 0;
     }
     int ret = 0;
-    ret = _sorter->get_next(batch, eos);
+    if (_merging) {
+        ret = get_next_merging(state, batch, eos);
+    } else if (_streaming) {
+        ret = get_next_streaming(state, batch, eos);
+    } else {
+        ret = _sorter->get_next(batch, eos);
+    }
     if (ret < 0) {
         DB_WARNING("sort get_next fail");
         return ret;
@@ -156,6 +188,109 @@ int SelectManagerNode::get_next(RuntimeState* state, RowBatch* batch, bool* eos)
     return 0;
 }
 
+int SelectManagerNode::get_next_streaming(RuntimeState* state, RowBatch* batch, bool* eos) {
+    // 后面region的游标在首次请求时已经创建，按region顺序读到之前需要保活
+    _fetcher_store.keepalive_cursors(state);
+    while (_stream_idx < _stream_regions.size()) {
+        int64_t region_id = _stream_regions[_stream_idx];
+        std::shared_ptr<RowBatch> chunk;
+        if (!_stream_region_started) {
+            // 先输出首次请求返回的块，同时开始续读
+            _stream_region_started = true;
+            chunk = _fetcher_store.region_batch[region_id];
+            _fetcher_store.prefetch_cursor(state, region_id);
+        } else if (_fetcher_store.has_cursor(region_id)) {
+            if (_fetcher_store.next_cursor_batch(state, region_id, chunk) != 0) {
+                DB_WARNING("fetch cursor fail, region_id:%ld, log_id:%lu", region_id, state->log_id());
+                return -1;
+            }
+        } else {
+            ++_stream_idx;
+            _stream_region_started = false;
+            continue;
+        }
+        if (chunk != nullptr && chunk->size() > 0) {
+            batch->swap(*chunk);
+            return 0;
+        }
+    }
+    *eos = true;
+    return 0;
+}
+
+int SelectManagerNode::open_merging(RuntimeState* state) {
+    _merging = true;
+    for (auto& pair : _fetcher_store.start_key_sort) {
+        MergeStream stream;
+        stream.region_id = pair.second;
+        stream.chunk = _fetcher_store.region_batch[pair.second];
+        // 首块参与归并的同时开始续读下一块，每个region最多预取一块，
+        // 同时预取的region数受single_store_concurrency限制，其余的用到时再读
+        _fetcher_store.prefetch_cursor(state, stream.region_id);
+        if (stream.chunk == nullptr || stream.chunk->size() == 0) {
+            if (next_merge_chunk(state, stream) != 0) {
+                return -1;
+            }
+            if (stream.chunk == nullptr) {
+                continue;
+            }
+        }
+        stream.chunk->reset();
+        _merge_heap.emplace_back(stream);
+    }
+    std::make_heap(_merge_heap.begin(), _merge_heap.end(), merge_greater());
+    return 0;
+}
+
+int SelectManagerNode::next_merge_chunk(RuntimeState* state, MergeStream& stream) {
+    stream.chunk = nullptr;
+    while (_fetcher_store.has_cursor(stream.region_id)) {
+        std::shared_ptr<RowBatch> chunk;
+        if (_fetcher_store.next_cursor_batch(state, stream.region_id, chunk) != 0) {
+            DB_WARNING("fetch cursor fail, region_id:%ld, log_id:%lu", stream.region_id, state->log_id());
+            return -1;
+        }
+        if (chunk != nullptr && chunk->size() > 0) {
+            chunk->reset();
+            stream.chunk = chunk;
+            return 0;
+        }
+    }
+    return 0;
+}
+
+int SelectManagerNode::get_next_merging(RuntimeState* state, RowBatch* batch, bool* eos) {
+    // region区间不相交时(如按主键排序)会先读完一个region，其他游标和已预取的块要保活
+    _fetcher_store.keepalive_cursors(state);
+    auto greater = merge_greater();
+    while (!batch->is_full()) {
+        // 满足limit后不再消费，剩余游标在close时释放
+        if (_limit != -1 && _num_rows_returned + (int64_t)batch->size() >= _limit) {
+            return 0;
+        }
+        if (_merge_heap.empty()) {
+            *eos = true;
+            return 0;
+        }
+        std::pop_heap(_merge_heap.begin(), _merge_heap.end(), greater);
+        MergeStream& stream = _merge_heap.back();
+        batch->move_row(std::move(stream.chunk->get_row()));
+        stream.chunk->next();
+        if (stream.chunk->is_traverse_over()) {
+            // 当前块归并完，等待已预取的下一块
+            if (next_merge_chunk(state, stream) != 0) {
+                return -1;
+            }
+            if (stream.chunk == nullptr) {
+                _merge_heap.pop_back();
+                continue;
+            }
+        }
+        std::push_heap(_merge_heap.begin(), _merge_heap.end(), greater);
+    }
+    return 0;
+}
+
 int SelectManagerNode::open_global_index(RuntimeState* state, ExecNode* exec_node, 
         int64_t global_index_id, int64_t main_table_id) {
     RocksdbScanNode* scan_node = static_cast<RocksdbScanNode*>(exec_node);
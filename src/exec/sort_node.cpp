@@ -17,6 +17,8 @@
 #include "query_context.h"
 
 namespace baikaldb {
+DEFINE_bool(sort_use_topn, true, "sort node keeps only top limit rows when plan has limit");
+
 int SortNode::init(const pb::PlanNode& node) {
     int ret = 0;
     ret = ExecNode::init(node);
@@ -157,7 +159,11 @@ int SortNode::open(RuntimeState* state) {
     _mem_row_desc = state->mem_row_desc();
     _mem_row_compare = std::make_shared<MemRowCompare>(
             _slot_order_exprs, _is_asc, _is_null_first);
-    _sorter = std::make_shared<Sorter>(_mem_row_compare.get());
+    if (FLAGS_sort_use_topn && _limit > 0 && !_mem_row_compare->need_not_compare()) {
+        _topn_sorter = std::make_shared<TopNSorter>(_mem_row_compare.get(), _limit);
+    } else {
+        _sorter = std::make_shared<ExternalSorter>(_mem_row_compare.get(), _mem_row_desc, state);
+    }
 
     bool eos = false;
     int count = 0;
@@ -178,12 +184,31 @@ int SortNode::open(RuntimeState* state) {
         }
         count += batch->size();
         fill_tuple(batch.get());
-        _sorter->add_batch(batch);
+        if (_topn_sorter != nullptr) {
+            memory_limit_release(state, _topn_sorter->add_batch(batch.get()));
+            continue;
+        }
+        ret = _sorter->add_batch(batch);
+        if (ret < 0) {
+            DB_WARNING_STATE(state, "sorter add_batch fail, ret:%d", ret);
+            return ret;
+        }
     } while (!eos);
     //DB_WARNING_STATE(state, "sort_size:%d", count);
     TimeCost sort_time;
-    _sorter->sort();
-    LOCAL_TRACE_DESC <<  "sort time cost:" << sort_time.get_time() << " rows:" << count;  
+    if (_topn_sorter != nullptr) {
+        _topn_sorter->sort();
+        LOCAL_TRACE_DESC << "topn sort time cost:" << sort_time.get_time() << " rows:" << count
+            << " limit:" << _limit;
+        return 0;
+    }
+    ret = _sorter->sort();
+    if (ret < 0) {
+        DB_WARNING_STATE(state, "sorter sort fail, ret:%d", ret);
+        return ret;
+    }
+    LOCAL_TRACE_DESC <<  "sort time cost:" << sort_time.get_time() << " rows:" << count
+        << " spill runs:" << _sorter->run_count() << " spill bytes:" << _sorter->spill_bytes();
     return 0;
 }
 
@@ -206,7 +231,8 @@ int SortNode::get_next(RuntimeState* state, RowBatch* batch, bool* eos) {
     if (state->sort_use_index()) {
         ret = _children[0]->get_next(state, batch, eos);
     } else {
-        ret = _sorter->get_next(batch, eos);
+        ret = _topn_sorter != nullptr ? _topn_sorter->get_next(batch, eos) :
+            _sorter->get_next(batch, eos);
     }
     if (ret < 0) {
         DB_WARNING_STATE(state, "_sorter->get_next fail, ret:%d", ret);
@@ -231,6 +257,14 @@ void SortNode::close(RuntimeState* state) {
         expr->close();
     }
     _sorter = nullptr;
+    _topn_sorter = nullptr;
+}
+
+// size只包含上游计入过MemTracker的部分，db和store上都可以直接归还
+void SortNode::memory_limit_release(RuntimeState* state, int64_t size) {
+    if (size > 0) {
+        state->memory_limit_release(size);
+    }
 }
 
 int SortNode::fill_tuple(RowBatch* batch) {
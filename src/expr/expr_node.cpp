@@ -146,6 +146,15 @@ void ExprNode::get_all_slot_ids(std::unordered_set<int32_t>& slot_ids) {
     }
 }
 
+void ExprNode::get_all_slot_refs(std::vector<ExprNode*>& slot_refs) {
+    if (_node_type == pb::SLOT_REF) {
+        slot_refs.push_back(this);
+    }
+    for (auto& child : _children) {
+        child->get_all_slot_refs(slot_refs);
+    }
+}
+
 void ExprNode::replace_slot_ref_to_literal(const std::set<int64_t>& sign_set,
                 std::map<int64_t, std::vector<ExprNode*>>& literal_maps) {
     for (size_t i = 0; i < _children.size(); i++) {
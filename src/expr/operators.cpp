@@ -104,6 +104,85 @@ BINARY_OP_PREDICATE_ALL_TYPES_FN(le, <=);
 // && || ; not used, see predicate.h
 BINARY_OP_PREDICATE_FN(logic_and, bool, _u.bool_val, &&);
 BINARY_OP_PREDICATE_FN(logic_or, bool, _u.bool_val, ||);
+
+#define BINARY_OP_BATCH_FN(NAME, CTYPE, RTYPE, OP) \
+    void NAME##_batch(const CTYPE* left, const CTYPE* right, RTYPE* out, size_t n) { \
+        for (size_t i = 0; i < n; i++) { \
+            out[i] = left[i] OP right[i]; \
+        } \
+    }
+#define BINARY_OP_BATCH_ALL_TYPES_FN(NAME, OP) \
+    BINARY_OP_BATCH_FN(NAME, int64_t, int64_t, OP); \
+    BINARY_OP_BATCH_FN(NAME, uint64_t, uint64_t, OP); \
+    BINARY_OP_BATCH_FN(NAME, double, double, OP);
+#define BINARY_OP_PREDICATE_BATCH_ALL_TYPES_FN(NAME, OP) \
+    BINARY_OP_BATCH_FN(NAME, int64_t, int64_t, OP); \
+    BINARY_OP_BATCH_FN(NAME, uint64_t, int64_t, OP); \
+    BINARY_OP_BATCH_FN(NAME, double, int64_t, OP); \
+    BINARY_OP_BATCH_FN(NAME, std::string, int64_t, OP);
+// + - *
+BINARY_OP_BATCH_ALL_TYPES_FN(add, +);
+BINARY_OP_BATCH_ALL_TYPES_FN(minus, -);
+BINARY_OP_BATCH_ALL_TYPES_FN(multiplies, *);
+// == != > >= < <=
+BINARY_OP_PREDICATE_BATCH_ALL_TYPES_FN(eq, ==);
+BINARY_OP_PREDICATE_BATCH_ALL_TYPES_FN(ne, !=);
+BINARY_OP_PREDICATE_BATCH_ALL_TYPES_FN(gt, >);
+BINARY_OP_PREDICATE_BATCH_ALL_TYPES_FN(ge, >=);
+BINARY_OP_PREDICATE_BATCH_ALL_TYPES_FN(lt, <);
+BINARY_OP_PREDICATE_BATCH_ALL_TYPES_FN(le, <=);
+
+void divides_batch(const double* left, const double* right, double* out, uint8_t* null_map, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        null_map[i] |= (right[i] == 0);
+        out[i] = right[i] == 0 ? 0 : left[i] / right[i];
+    }
+}
+
+// 整数除0会触发SIGFPE，不能先算再置null
+#define MOD_BATCH_FN(CTYPE) \
+    void mod_batch(const CTYPE* left, const CTYPE* right, CTYPE* out, uint8_t* null_map, size_t n) { \
+        for (size_t i = 0; i < n; i++) { \
+            null_map[i] |= (right[i] == 0); \
+            out[i] = right[i] == 0 ? 0 : left[i] % right[i]; \
+        } \
+    }
+MOD_BATCH_FN(int64_t);
+MOD_BATCH_FN(uint64_t);
+
+void merge_null_batch(const uint8_t* left, const uint8_t* right, uint8_t* out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = left[i] | right[i];
+    }
+}
+
+// 任一侧为false则为false；否则任一侧为null则为null；否则为true
+void logic_and_batch(const int64_t* left, const uint8_t* left_null,
+        const int64_t* right, const uint8_t* right_null,
+        int64_t* out, uint8_t* out_null, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        uint8_t has_false = (!left_null[i] & !left[i]) | (!right_null[i] & !right[i]);
+        out_null[i] = (!has_false) & (left_null[i] | right_null[i]);
+        out[i] = (!has_false) & !(left_null[i] | right_null[i]);
+    }
+}
+
+// 任一侧为true则为true；否则任一侧为null则为null；否则为false
+void logic_or_batch(const int64_t* left, const uint8_t* left_null,
+        const int64_t* right, const uint8_t* right_null,
+        int64_t* out, uint8_t* out_null, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        uint8_t has_true = (!left_null[i] & (left[i] != 0)) | (!right_null[i] & (right[i] != 0));
+        out_null[i] = (!has_true) & (left_null[i] | right_null[i]);
+        out[i] = has_true;
+    }
+}
+
+void logic_not_batch(const int64_t* in, int64_t* out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = !in[i];
+    }
+}
 }
 
 /* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -14,6 +14,7 @@
 
 #include "predicate.h"
 #include "parser.h"
+#include "operators.h"
 
 namespace baikaldb {
 int InPredicate::open() {
@@ -371,6 +372,140 @@ ExprValue RegexpPredicate::get_value(MemRow* row) {
     return ret;
 }
 
+bool AndPredicate::can_vectorize() {
+    return _children.size() == 2 && _children[0]->can_vectorize() &&
+        _children[1]->can_vectorize();
+}
+
+const ColumnVector* AndPredicate::get_batch_value(ColumnBatch* batch) {
+    const ColumnVector* left = get_batch_child_value(0, batch, pb::BOOL);
+    const ColumnVector* right = get_batch_child_value(1, batch, pb::BOOL);
+    size_t n = batch->num_rows();
+    if (left == nullptr || right == nullptr || left->size() != n || right->size() != n) {
+        return nullptr;
+    }
+    _batch_value.init(pb::BOOL);
+    _batch_value.resize(n);
+    logic_and_batch(left->int_data(), left->null_map(), right->int_data(), right->null_map(),
+            _batch_value.mutable_int_data(), _batch_value.mutable_null_map(), n);
+    return &_batch_value;
+}
+
+bool OrPredicate::can_vectorize() {
+    return _children.size() == 2 && _children[0]->can_vectorize() &&
+        _children[1]->can_vectorize();
+}
+
+const ColumnVector* OrPredicate::get_batch_value(ColumnBatch* batch) {
+    const ColumnVector* left = get_batch_child_value(0, batch, pb::BOOL);
+    const ColumnVector* right = get_batch_child_value(1, batch, pb::BOOL);
+    size_t n = batch->num_rows();
+    if (left == nullptr || right == nullptr || left->size() != n || right->size() != n) {
+        return nullptr;
+    }
+    _batch_value.init(pb::BOOL);
+    _batch_value.resize(n);
+    logic_or_batch(left->int_data(), left->null_map(), right->int_data(), right->null_map(),
+            _batch_value.mutable_int_data(), _batch_value.mutable_null_map(), n);
+    return &_batch_value;
+}
+
+bool IsNullPredicate::can_vectorize() {
+    return _children.size() == 1 && _children[0]->can_vectorize();
+}
+
+const ColumnVector* IsNullPredicate::get_batch_value(ColumnBatch* batch) {
+    const ColumnVector* child = _children[0]->get_batch_value(batch);
+    size_t n = batch->num_rows();
+    if (child == nullptr || child->size() != n) {
+        return nullptr;
+    }
+    _batch_value.init(pb::BOOL);
+    _batch_value.resize(n);
+    const uint8_t* child_null = child->null_map();
+    int64_t* out = _batch_value.mutable_int_data();
+    for (size_t i = 0; i < n; i++) {
+        out[i] = child_null[i];
+    }
+    return &_batch_value;
+}
+
+bool NotPredicate::can_vectorize() {
+    return _children.size() == 1 && _children[0]->can_vectorize();
+}
+
+const ColumnVector* NotPredicate::get_batch_value(ColumnBatch* batch) {
+    const ColumnVector* child = get_batch_child_value(0, batch, pb::BOOL);
+    size_t n = batch->num_rows();
+    if (child == nullptr || child->size() != n) {
+        return nullptr;
+    }
+    _batch_value.init(pb::BOOL);
+    _batch_value.resize(n);
+    std::copy(child->null_map(), child->null_map() + n, _batch_value.mutable_null_map());
+    logic_not_batch(child->int_data(), _batch_value.mutable_int_data(), n);
+    return &_batch_value;
+}
+
+bool InPredicate::can_vectorize() {
+    if (_is_row_expr || _children.size() < 2 || !_children[0]->can_vectorize()) {
+        return false;
+    }
+    switch (_map_type) {
+        case pb::INT64:
+        case pb::TIMESTAMP:
+        case pb::DATETIME:
+        case pb::TIME:
+        case pb::DATE:
+        case pb::DOUBLE:
+        case pb::STRING:
+            return true;
+        default:
+            return false;
+    }
+}
+
+const ColumnVector* InPredicate::get_batch_value(ColumnBatch* batch) {
+    const ColumnVector* child = get_batch_child_value(0, batch, _map_type);
+    size_t n = batch->num_rows();
+    if (child == nullptr || child->size() != n) {
+        return nullptr;
+    }
+    _batch_value.init(pb::BOOL);
+    _batch_value.resize(n);
+    const uint8_t* child_null = child->null_map();
+    uint8_t* null_map = _batch_value.mutable_null_map();
+    int64_t* out = _batch_value.mutable_int_data();
+    // 未命中时和行式一致：有null常量则为null
+    uint8_t miss_null = _has_null ? 1 : 0;
+    for (size_t i = 0; i < n; i++) {
+        if (child_null[i] != 0) {
+            null_map[i] = 1;
+            continue;
+        }
+        bool hit = false;
+        switch (child->storage()) {
+            case COL_INT:
+                hit = _int_set.count(child->int_data()[i]) == 1;
+                break;
+            case COL_UINT:
+                hit = _int_set.count(static_cast<int64_t>(child->uint_data()[i])) == 1;
+                break;
+            case COL_DOUBLE:
+                hit = _double_set.count(child->double_data()[i]) == 1;
+                break;
+            case COL_STRING:
+                hit = _str_set.count(child->string_data()[i]) == 1;
+                break;
+            default:
+                return nullptr;
+        }
+        out[i] = hit;
+        null_map[i] = hit ? 0 : miss_null;
+    }
+    return &_batch_value;
+}
+
 }
 
 /* vim: set ts=4 sw=4 sts=4 tw=100 */
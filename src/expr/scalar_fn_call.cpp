@@ -17,6 +17,7 @@
 #include "row_expr.h"
 #include "literal.h"
 #include "parser.h"
+#include "operators.h"
 
 namespace baikaldb {
 int ScalarFnCall::init(const pb::ExprNode& node) {
@@ -205,5 +206,163 @@ ExprValue ScalarFnCall::get_value(MemRow* row) {
     }
     return _fn_call(args).cast_to(_col_type);
 }
+
+bool ScalarFnCall::can_vectorize() {
+    if (node_type() != pb::FUNCTION_CALL || _is_row_expr || _fn_call == NULL) {
+        return false;
+    }
+    switch (_fn.fn_op()) {
+        case parser::FT_EQ:
+        case parser::FT_NE:
+        case parser::FT_GT:
+        case parser::FT_GE:
+        case parser::FT_LT:
+        case parser::FT_LE:
+        case parser::FT_ADD:
+        case parser::FT_MINUS:
+        case parser::FT_MULTIPLIES:
+        case parser::FT_DIVIDES:
+        case parser::FT_MOD:
+            break;
+        default:
+            return false;
+    }
+    if (_children.size() != 2 || _fn.arg_types_size() != 2 ||
+            _fn.arg_types(0) != _fn.arg_types(1) ||
+            column_storage(_fn.arg_types(0)) == COL_INVALID ||
+            column_storage(_fn.return_type()) == COL_INVALID ||
+            column_storage(_col_type) == COL_INVALID) {
+        return false;
+    }
+    // 与get_batch_value支持的类型保持一致，否则整条sql的向量化过滤都会退化
+    ColumnStorage storage = column_storage(_fn.arg_types(0));
+    if (_fn.fn_op() == parser::FT_DIVIDES &&
+            (storage != COL_DOUBLE || column_storage(_fn.return_type()) != COL_DOUBLE)) {
+        return false;
+    }
+    if (_fn.fn_op() == parser::FT_MOD && storage != COL_INT && storage != COL_UINT) {
+        return false;
+    }
+    for (auto c : _children) {
+        if (!c->can_vectorize()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const ColumnVector* ScalarFnCall::get_batch_child_value(size_t idx, ColumnBatch* batch,
+        pb::PrimitiveType type) {
+    const ColumnVector* value = _children[idx]->get_batch_value(batch);
+    if (value == nullptr || value->can_share_storage(type)) {
+        return value;
+    }
+    if (_batch_args.size() <= idx) {
+        _batch_args.resize(idx + 1);
+    }
+    if (value->cast_to(type, &_batch_args[idx]) < 0) {
+        return nullptr;
+    }
+    return &_batch_args[idx];
+}
+
+const ColumnVector* ScalarFnCall::batch_result() {
+    if (_batch_value.can_share_storage(_col_type)) {
+        return &_batch_value;
+    }
+    if (_batch_value.cast_to(_col_type, &_batch_cast_value) < 0) {
+        return nullptr;
+    }
+    return &_batch_cast_value;
+}
+
+#define PREDICATE_BATCH_CASE(FT, NAME) \
+    case parser::FT: \
+        switch (storage) { \
+            case COL_INT: \
+                NAME##_batch(left->int_data(), right->int_data(), out, n); \
+                break; \
+            case COL_UINT: \
+                NAME##_batch(left->uint_data(), right->uint_data(), out, n); \
+                break; \
+            case COL_DOUBLE: \
+                NAME##_batch(left->double_data(), right->double_data(), out, n); \
+                break; \
+            case COL_STRING: \
+                NAME##_batch(left->string_data().data(), right->string_data().data(), out, n); \
+                break; \
+            default: \
+                return nullptr; \
+        } \
+        break;
+
+#define ARITHMETIC_BATCH_CASE(FT, NAME) \
+    case parser::FT: \
+        switch (storage) { \
+            case COL_INT: \
+                NAME##_batch(left->int_data(), right->int_data(), _batch_value.mutable_int_data(), n); \
+                break; \
+            case COL_UINT: \
+                NAME##_batch(left->uint_data(), right->uint_data(), _batch_value.mutable_uint_data(), n); \
+                break; \
+            case COL_DOUBLE: \
+                NAME##_batch(left->double_data(), right->double_data(), \
+                        _batch_value.mutable_double_data(), n); \
+                break; \
+            default: \
+                return nullptr; \
+        } \
+        break;
+
+const ColumnVector* ScalarFnCall::get_batch_value(ColumnBatch* batch) {
+    const ColumnVector* left = get_batch_child_value(0, batch, _fn.arg_types(0));
+    const ColumnVector* right = get_batch_child_value(1, batch, _fn.arg_types(1));
+    size_t n = batch->num_rows();
+    if (left == nullptr || right == nullptr || left->size() != n || right->size() != n) {
+        return nullptr;
+    }
+    ColumnStorage storage = column_storage(_fn.arg_types(0));
+    if (_batch_value.init(_fn.return_type()) < 0) {
+        return nullptr;
+    }
+    _batch_value.resize(n);
+    uint8_t* null_map = _batch_value.mutable_null_map();
+    merge_null_batch(left->null_map(), right->null_map(), null_map, n);
+    int64_t* out = _batch_value.mutable_int_data();
+    switch (_fn.fn_op()) {
+        PREDICATE_BATCH_CASE(FT_EQ, eq);
+        PREDICATE_BATCH_CASE(FT_NE, ne);
+        PREDICATE_BATCH_CASE(FT_GT, gt);
+        PREDICATE_BATCH_CASE(FT_GE, ge);
+        PREDICATE_BATCH_CASE(FT_LT, lt);
+        PREDICATE_BATCH_CASE(FT_LE, le);
+        ARITHMETIC_BATCH_CASE(FT_ADD, add);
+        ARITHMETIC_BATCH_CASE(FT_MINUS, minus);
+        ARITHMETIC_BATCH_CASE(FT_MULTIPLIES, multiplies);
+        case parser::FT_DIVIDES:
+            if (storage != COL_DOUBLE) {
+                return nullptr;
+            }
+            divides_batch(left->double_data(), right->double_data(),
+                    _batch_value.mutable_double_data(), null_map, n);
+            break;
+        case parser::FT_MOD:
+            if (storage == COL_INT) {
+                mod_batch(left->int_data(), right->int_data(),
+                        _batch_value.mutable_int_data(), null_map, n);
+            } else if (storage == COL_UINT) {
+                mod_batch(left->uint_data(), right->uint_data(),
+                        _batch_value.mutable_uint_data(), null_map, n);
+            } else {
+                return nullptr;
+            }
+            break;
+        default:
+            return nullptr;
+    }
+    return batch_result();
+}
+#undef PREDICATE_BATCH_CASE
+#undef ARITHMETIC_BATCH_CASE
 }
 /* vim: set ts=4 sw=4 sts=4 tw=100 */
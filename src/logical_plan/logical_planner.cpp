@@ -34,6 +34,7 @@
 #include "parser.h"
 #include "mysql_err_code.h"
 #include "physical_planner.h"
+#include "plan_cache.h"
 
 namespace bthread {
 DECLARE_int32(bthread_concurrency); //bthread.cpp
@@ -351,6 +352,11 @@ int LogicalPlanner::analyze(QueryContext* ctx) {
         return -1;
     }
 
+    // 简单select先查全局plan cache，命中后只需绑定常量
+    if (PlanCache::get_instance()->plan(ctx) == 0) {
+        make_stat_sign(ctx);
+        return 0;
+    }
     std::unique_ptr<LogicalPlanner> planner;
     switch (ctx->stmt_type) {
     case parser::NT_SELECT:
@@ -408,6 +414,11 @@ int LogicalPlanner::analyze(QueryContext* ctx) {
     }
     //ctx->succ_after_logical_plan = true;
     //ctx->is_full_export =false;
+    make_stat_sign(ctx);
+    return 0;
+}
+
+void LogicalPlanner::make_stat_sign(QueryContext* ctx) {
     ctx->stmt->set_print_sample(true);
     auto stat_info = &(ctx->stat_info);
     pb::OpType op_type = pb::OP_NONE;
@@ -432,7 +443,6 @@ int LogicalPlanner::analyze(QueryContext* ctx) {
         butil::MurmurHash3_x64_128(stat_info->sample_sql.str().c_str(), stat_info->sample_sql.str().size(), 0x1234, out);
         stat_info->sign = out[0];
     }
-    return 0;
 }
 
 int LogicalPlanner::gen_subquery_plan(parser::DmlNode* subquery, const SmartPlanTableCtx& plan_state,
@@ -2302,9 +2312,12 @@ int LogicalPlanner::create_term_slot_ref_node(
     return 0;
 }
 
-//TODO: primitive len for STRING, BOOL and NULL
 int LogicalPlanner::create_term_literal_node(const parser::LiteralExpr* literal, pb::Expr& expr) {
-    pb::ExprNode* node = expr.add_nodes();
+    return create_literal_pb(literal, expr.add_nodes());
+}
+
+//TODO: primitive len for STRING, BOOL and NULL
+int LogicalPlanner::create_literal_pb(const parser::LiteralExpr* literal, pb::ExprNode* node) {
     node->set_num_children(0);
 
     switch (literal->literal_type) {
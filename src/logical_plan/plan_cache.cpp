@@ -0,0 +1,251 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "plan_cache.h"
+#include "select_planner.h"
+#include "network_socket.h"
+#include "schema_factory.h"
+#include "exec_node.h"
+#include "literal.h"
+
+namespace baikaldb {
+DEFINE_int64(plan_cache_size, 10000, "max entries of instance-wide select plan cache, 0 to disable");
+DEFINE_int64(plan_cache_fail_retry_s, 300, "retry interval(s) for sql failed to generate plan template");
+
+// where中的常量按前序遍历收集，同一个key的sql遍历顺序相同
+static void collect_literals(parser::Node* node, std::vector<parser::LiteralExpr*>* literals) {
+    if (node == nullptr) {
+        return;
+    }
+    if (node->node_type == parser::NT_EXPR &&
+            static_cast<parser::ExprNode*>(node)->expr_type == parser::ET_LITETAL) {
+        literals->emplace_back(static_cast<parser::LiteralExpr*>(node));
+        return;
+    }
+    for (int i = 0; i < node->children.size(); i++) {
+        collect_literals(node->children[i], literals);
+    }
+}
+
+PlanCache::PlanCache() {
+    _cache.init(FLAGS_plan_cache_size);
+}
+
+bool PlanCache::is_cacheable(QueryContext* ctx) {
+    if (FLAGS_plan_cache_size <= 0) {
+        return false;
+    }
+    if (ctx->stmt_type != parser::NT_SELECT || ctx->mysql_cmd != COM_QUERY) {
+        return false;
+    }
+    if (ctx->is_explain || ctx->explain_type != EXPLAIN_NULL || ctx->is_complex) {
+        return false;
+    }
+    if (ctx->client_conn == nullptr || ctx->user_info == nullptr) {
+        return false;
+    }
+    parser::SelectStmt* select = static_cast<parser::SelectStmt*>(ctx->stmt);
+    return select->table_refs != nullptr;
+}
+
+std::string PlanCache::make_key(QueryContext* ctx, const std::vector<parser::LiteralExpr*>& literals) {
+    parser::SelectStmt* select = static_cast<parser::SelectStmt*>(ctx->stmt);
+    std::ostringstream os;
+    os << ctx->user_info->namespace_ << "\t" << ctx->cur_db << "\t" << ctx->charset << "\t";
+    // 只有where中的常量参数化，select/order by/limit等中的常量影响结果列名和计划
+    if (select->where != nullptr) {
+        select->where->set_print_sample(true);
+    }
+    os << select << "\t";
+    if (select->where != nullptr) {
+        select->where->set_print_sample(false);
+    }
+    // 常量类型影响类型推导，一并作为key
+    for (auto literal : literals) {
+        os << (char)('0' + literal->literal_type);
+    }
+    return os.str();
+}
+
+bool PlanCache::is_valid(QueryContext* ctx, const SmartCachedPlan& cached) {
+    SchemaFactory* factory = SchemaFactory::get_instance();
+    for (auto& pair : cached->tables) {
+        auto table_ptr = factory->get_table_info_ptr(pair.first);
+        if (table_ptr == nullptr || table_ptr->version != pair.second.second) {
+            return false;
+        }
+        // 降级路由由正常流程处理
+        if (table_ptr->have_backup && (table_ptr->need_read_backup || table_ptr->need_write_backup)) {
+            return false;
+        }
+        if (!ctx->user_info->allow_op(pb::OP_SELECT, pair.second.first, pair.first)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+SmartCachedPlan PlanCache::create_template(QueryContext* ctx,
+        std::vector<parser::LiteralExpr*>& literals) {
+    SmartCachedPlan cached = std::make_shared<CachedPlan>();
+    cached->create_time_us = butil::gettimeofday_us();
+    cached->num_params = literals.size();
+
+    std::shared_ptr<QueryContext> template_ctx(new (std::nothrow)QueryContext());
+    if (template_ctx.get() == nullptr) {
+        DB_WARNING("create template context failed");
+        return cached;
+    }
+    template_ctx->stmt = ctx->stmt;
+    template_ctx->stmt_type = ctx->stmt_type;
+    template_ctx->is_select = true;
+    template_ctx->cur_db = ctx->cur_db;
+    template_ctx->charset = ctx->charset;
+    template_ctx->user_info = ctx->user_info;
+    template_ctx->is_complex = ctx->is_complex;
+    template_ctx->client_conn = ctx->client_conn;
+    template_ctx->get_runtime_state()->set_client_conn(ctx->client_conn);
+    template_ctx->sql = ctx->sql;
+
+    // 常量原地替换成place holder，生成模板后恢复
+    std::vector<std::pair<parser::LiteralType, decltype(parser::LiteralExpr::_u)>> origin;
+    origin.reserve(literals.size());
+    for (size_t i = 0; i < literals.size(); i++) {
+        origin.emplace_back(literals[i]->literal_type, literals[i]->_u);
+        literals[i]->literal_type = parser::LT_PLACE_HOLDER;
+        literals[i]->_u.int64_val = i;
+    }
+    SelectPlanner planner(template_ctx.get());
+    int ret = planner.plan();
+    for (size_t i = 0; i < literals.size(); i++) {
+        literals[i]->literal_type = origin[i].first;
+        literals[i]->_u = origin[i].second;
+    }
+    if (ret != 0) {
+        DB_WARNING("gen plan template failed, sql: %s", ctx->sql.c_str());
+        return cached;
+    }
+    if (template_ctx->use_backup || template_ctx->has_information_schema ||
+            template_ctx->has_derived_table || template_ctx->is_full_export ||
+            !template_ctx->sub_query_plans.empty()) {
+        return cached;
+    }
+    // 每个常量在计划中只能出现一次，否则绑定不完整
+    if (template_ctx->create_plan_tree() < 0) {
+        return cached;
+    }
+    std::map<int, ExprNode*> placeholders;
+    template_ctx->root->find_place_holder(placeholders);
+    if (placeholders.size() != literals.size()) {
+        DB_WARNING("place holder size diff, %lu vs %lu, sql: %s",
+                placeholders.size(), literals.size(), ctx->sql.c_str());
+        return cached;
+    }
+    SchemaFactory* factory = SchemaFactory::get_instance();
+    for (auto& tuple : template_ctx->tuple_descs()) {
+        if (!tuple.has_table_id() || tuple.table_id() <= 0) {
+            continue;
+        }
+        auto table_ptr = factory->get_table_info_ptr(tuple.table_id());
+        if (table_ptr == nullptr) {
+            return cached;
+        }
+        cached->tables[tuple.table_id()] = std::make_pair(table_ptr->db_id, table_ptr->version);
+    }
+    cached->plan = template_ctx->plan;
+    cached->tuple_descs = template_ctx->tuple_descs();
+    cached->family = template_ctx->stat_info.family;
+    cached->table = template_ctx->stat_info.table;
+    cached->table_id = template_ctx->stat_info.table_id;
+    cached->valid = true;
+    return cached;
+}
+
+int PlanCache::bind(QueryContext* ctx, const SmartCachedPlan& cached,
+        const std::vector<parser::LiteralExpr*>& literals) {
+    std::vector<pb::ExprNode> params(literals.size());
+    for (size_t i = 0; i < literals.size(); i++) {
+        if (LogicalPlanner::create_literal_pb(literals[i], &params[i]) != 0) {
+            return -1;
+        }
+    }
+    ctx->plan = cached->plan;
+    if (ctx->create_plan_tree() < 0) {
+        DB_WARNING("create plan tree from cache failed, sql: %s", ctx->sql.c_str());
+        ExecNode::destroy_tree(ctx->root);
+        ctx->root = nullptr;
+        ctx->need_destroy_tree = false;
+        ctx->plan.Clear();
+        return -1;
+    }
+    ctx->root->find_place_holder(ctx->placeholders);
+    for (size_t idx = 0; idx < params.size(); ++idx) {
+        static_cast<Literal*>(ctx->placeholders[idx])->init(params[idx]);
+    }
+    ctx->mutable_tuple_descs()->assign(cached->tuple_descs.begin(), cached->tuple_descs.end());
+    SchemaFactory* factory = SchemaFactory::get_instance();
+    for (auto& pair : cached->tables) {
+        auto table_ptr = factory->get_table_info_ptr(pair.first);
+        if (table_ptr != nullptr && table_ptr->need_learner_backup) {
+            ctx->need_learner_backup = true;
+        }
+    }
+    ctx->is_select = true;
+    ctx->exec_prepared = true;
+    ctx->get_runtime_state()->set_single_sql_autocommit(ctx->client_conn->txn_id == 0);
+    ctx->stat_info.family = cached->family;
+    ctx->stat_info.table = cached->table;
+    ctx->stat_info.table_id = cached->table_id;
+    ctx->stat_info.hit_cache = true;
+    return 0;
+}
+
+int PlanCache::plan(QueryContext* ctx) {
+    if (!is_cacheable(ctx)) {
+        return -1;
+    }
+    parser::SelectStmt* select = static_cast<parser::SelectStmt*>(ctx->stmt);
+    std::vector<parser::LiteralExpr*> literals;
+    collect_literals(select->where, &literals);
+    for (auto literal : literals) {
+        if (literal->literal_type == parser::LT_PLACE_HOLDER) {
+            return -1;
+        }
+    }
+    std::string key = make_key(ctx, literals);
+    SmartCachedPlan cached;
+    if (_cache.find(key, &cached) == 0) {
+        if (!cached->valid) {
+            if (butil::gettimeofday_us() - cached->create_time_us <
+                    FLAGS_plan_cache_fail_retry_s * 1000 * 1000LL) {
+                return -1;
+            }
+            cached = nullptr;
+        } else if (!is_valid(ctx, cached)) {
+            // schema变更或权限变化，重新生成
+            cached = nullptr;
+        }
+    }
+    if (cached == nullptr) {
+        cached = create_template(ctx, literals);
+        _cache.add(key, cached);
+        if (!cached->valid || !is_valid(ctx, cached)) {
+            return -1;
+        }
+    }
+    return bind(ctx, cached, literals);
+}
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
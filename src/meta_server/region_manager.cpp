@@ -39,6 +39,12 @@ BAIDU_RPC_VALIDATE_GFLAG(balance_add_peer_num, brpc::PositiveInteger);
 #else
 BRPC_VALIDATE_GFLAG(balance_add_peer_num, brpc::PositiveInteger);
 #endif
+DEFINE_bool(leader_load_balance, true, "transfer leaders of hot regions by access load");
+DEFINE_int32(leader_load_hot_percent, 130, "store is hot when leader load exceeds average by this percent");
+DEFINE_int64(leader_load_min_qps, 1000, "store with leader load below this is never hot");
+DEFINE_int32(leader_load_dml_weight, 3, "one dml request counts as this many select requests");
+DEFINE_int64(leader_load_scan_rows_per_unit, 1000, "scan rows counted as one select request");
+DEFINE_int32(leader_load_max_transfer, 3, "max hot leaders transferred in one heartbeat");
 
 //增加或者更新region信息
 //如果是增加，则需要更新表信息, 只有leader的上报会调用该接口
@@ -972,6 +978,171 @@ void RegionManager::leader_load_balance_on_pk_prefix(const std::string& instance
     }
 }
 
+static int64_t leader_region_load(const pb::LeaderHeartBeat& leader_region) {
+    int64_t load = leader_region.select_qps() + leader_region.dml_qps() * FLAGS_leader_load_dml_weight;
+    if (FLAGS_leader_load_scan_rows_per_unit > 0) {
+        load += leader_region.scan_rows_per_second() / FLAGS_leader_load_scan_rows_per_unit;
+    }
+    return load;
+}
+
+int64_t RegionManager::get_average_leader_load(const std::string& resource_tag,
+                                               std::unordered_map<std::string, int64_t>* instance_loads) {
+    // 超过3个心跳周期未更新的实例不参与计算
+    int64_t expire_time = butil::gettimeofday_us() - 3 * FLAGS_store_heart_beat_interval_us;
+    int64_t total_load = 0;
+    int64_t instance_count = 0;
+    BAIDU_SCOPED_LOCK(_count_mutex);
+    for (auto& pair : _instance_leader_load) {
+        if (pair.second.resource_tag != resource_tag || pair.second.timestamp < expire_time) {
+            continue;
+        }
+        total_load += pair.second.load;
+        ++instance_count;
+        if (instance_loads != nullptr) {
+            (*instance_loads)[pair.first] = pair.second.load;
+        }
+    }
+    if (instance_count == 0) {
+        return -1;
+    }
+    return total_load / instance_count;
+}
+
+bool RegionManager::is_leader_load_hot(const std::string& instance) {
+    std::string resource_tag;
+    int64_t load = 0;
+    {
+        BAIDU_SCOPED_LOCK(_count_mutex);
+        auto iter = _instance_leader_load.find(instance);
+        if (iter == _instance_leader_load.end()) {
+            return false;
+        }
+        resource_tag = iter->second.resource_tag;
+        load = iter->second.load;
+    }
+    if (load < FLAGS_leader_load_min_qps) {
+        return false;
+    }
+    int64_t average_load = get_average_leader_load(resource_tag, nullptr);
+    return average_load >= 0 && load > average_load * FLAGS_leader_load_hot_percent / 100;
+}
+
+// 按访问负载迁移leader，负载由leader心跳上报的select/dml qps和扫描行数加权得到，
+// store只上报迁移leader后会跟着转移的负载，follower读的select不计入
+// 负载高于平均值一定比例的store，把最热的leader迁到负载最低的peer上，且迁移后目标不能比源更热
+// 单个region自身过热时迁leader只是转移热点，交给store按负载分裂
+void RegionManager::leader_load_balance_on_hot(const std::string& instance,
+            const pb::StoreHeartBeatRequest* request,
+            bool can_transfer,
+            std::set<int64_t>& trans_leader_region_ids,
+            pb::StoreHeartBeatResponse* response) {
+    std::string resource_tag = request->instance_info().resource_tag();
+    std::vector<std::pair<int64_t, const pb::LeaderHeartBeat*>> region_loads;
+    int64_t instance_load = 0;
+    for (auto& leader_region : request->leader_regions()) {
+        int64_t load = leader_region_load(leader_region);
+        if (load <= 0) {
+            continue;
+        }
+        instance_load += load;
+        region_loads.emplace_back(load, &leader_region);
+    }
+    {
+        BAIDU_SCOPED_LOCK(_count_mutex);
+        InstanceLeaderLoad& instance_leader_load = _instance_leader_load[instance];
+        instance_leader_load.resource_tag = resource_tag;
+        instance_leader_load.load = instance_load;
+        instance_leader_load.timestamp = butil::gettimeofday_us();
+    }
+    if (!can_transfer || !FLAGS_leader_load_balance || instance_load < FLAGS_leader_load_min_qps) {
+        return;
+    }
+    std::unordered_map<std::string, int64_t> instance_loads;
+    int64_t average_load = get_average_leader_load(resource_tag, &instance_loads);
+    if (average_load < 0 || instance_load <= average_load * FLAGS_leader_load_hot_percent / 100) {
+        return;
+    }
+    DB_WARNING("instance: %s is hot, resource_tag: %s, leader_load: %ld, average_load: %ld",
+                instance.c_str(), resource_tag.c_str(), instance_load, average_load);
+    std::sort(region_loads.begin(), region_loads.end(),
+            [](const std::pair<int64_t, const pb::LeaderHeartBeat*>& left,
+               const std::pair<int64_t, const pb::LeaderHeartBeat*>& right) {
+                return left.first > right.first;
+            });
+    int32_t transfer_count = 0;
+    for (auto& region_load : region_loads) {
+        if (transfer_count >= FLAGS_leader_load_max_transfer || instance_load <= average_load) {
+            break;
+        }
+        int64_t load = region_load.first;
+        const pb::LeaderHeartBeat& leader_region = *region_load.second;
+        int64_t table_id = leader_region.region().table_id();
+        int64_t region_id = leader_region.region().region_id();
+        if (trans_leader_region_ids.count(region_id) > 0) {
+            continue;
+        }
+        if (load > average_load) {
+            DB_WARNING("hot region_id: %ld, table_id: %ld, load: %ld, select_qps: %ld, dml_qps: %ld, "
+                        "scan_rows_per_second: %ld, average_load: %ld, instance: %s",
+                        region_id, table_id, load, leader_region.select_qps(), leader_region.dml_qps(),
+                        leader_region.scan_rows_per_second(), average_load, instance.c_str());
+            continue;
+        }
+        int64_t replica_num = 0;
+        if (TableManager::get_instance()->get_replica_num(table_id, replica_num) < 0) {
+            continue;
+        }
+        if (leader_region.status() != pb::IDLE || leader_region.region().peers_size() < replica_num) {
+            continue;
+        }
+        std::string main_logical_room;
+        TableManager::get_instance()->get_main_logical_room(table_id, main_logical_room);
+        int64_t min_peer_load = INT_FAST64_MAX;
+        std::string transfer_to_peer;
+        for (auto& peer : leader_region.region().peers()) {
+            if (peer == instance || instance_loads.count(peer) == 0) {
+                continue;
+            }
+            if (ClusterManager::get_instance()->get_instance_status(peer) != pb::NORMAL) {
+                continue;
+            }
+            if (!main_logical_room.empty() 
+                    && ClusterManager::get_instance()->get_logical_room(peer) != main_logical_room) {
+                continue;
+            }
+            int64_t peer_load = instance_loads[peer];
+            // 迁移后目标的负载要低于源，避免来回迁移
+            if (peer_load + load < instance_load - load && peer_load < min_peer_load) {
+                transfer_to_peer = peer;
+                min_peer_load = peer_load;
+            }
+        }
+        if (transfer_to_peer.empty()) {
+            continue;
+        }
+        // 不带table_id，store不受按表迁移数量的限制
+        pb::TransLeaderRequest transfer_request;
+        transfer_request.set_region_id(region_id);
+        transfer_request.set_old_leader(instance);
+        transfer_request.set_new_leader(transfer_to_peer);
+        *(response->add_trans_leader()) = transfer_request;
+        trans_leader_region_ids.insert(region_id);
+        instance_loads[transfer_to_peer] += load;
+        instance_load -= load;
+        ++transfer_count;
+        add_leader_count(transfer_to_peer, table_id);
+        {
+            // 目标的下次心跳前先按预估值计算，避免多个热点store同时迁到同一个peer
+            BAIDU_SCOPED_LOCK(_count_mutex);
+            _instance_leader_load[transfer_to_peer].load += load;
+            _instance_leader_load[instance].load -= load;
+        }
+        DB_WARNING("instance: %s region_id: %ld load: %ld do hot leader transfer transfer_request: %s",
+                instance.c_str(), region_id, load, transfer_request.ShortDebugString().c_str());
+    }
+}
+
 void RegionManager::leader_load_balance(bool whether_can_decide,
             bool load_balance,
             const pb::StoreHeartBeatRequest* request,
@@ -1008,6 +1179,10 @@ void RegionManager::leader_load_balance(bool whether_can_decide,
     
     leader_main_logical_room_check(request, response, trans_leader_region_ids);
 
+    leader_load_balance_on_hot(instance, request,
+                               whether_can_decide && load_balance && instance_status == pb::NORMAL,
+                               trans_leader_region_ids, response);
+
     if (!request->need_leader_balance() && 
             instance_status != pb::MIGRATE && instance_status != pb::SLOW) {
         return;
@@ -1146,6 +1321,10 @@ void RegionManager::leader_load_balance(bool whether_can_decide,
             if (!main_logical_room.empty() && logical_room != main_logical_room) {
                 continue;
             }
+            // 按数量均衡时不把leader迁到负载已经过高的store
+            if (instance_status == pb::NORMAL && is_leader_load_hot(peer)) {
+                continue;
+            }
             int64_t peer_leader_count_on_table = get_leader_count(peer, table_id);
             // 选leader少的peer
             if (peer_leader_count_on_table < leader_count_for_transfer_peer) {
@@ -1530,6 +1709,11 @@ void RegionManager::update_leader_status(const pb::StoreHeartBeatRequest* reques
         region_state.timestamp = timestamp;
         region_state.status = pb::NORMAL;
         _region_state_map.set(region_id, region_state);
+        // 全局索引region的修改在主表region上已经计数
+        if (leader_region.modified_rows() > 0 && (!leader_region.region().has_main_table_id()
+                    || leader_region.region().main_table_id() == table_id)) {
+            TableManager::get_instance()->add_modified_rows(table_id, leader_region.modified_rows());
+        }
         if (leader_region.peers_status_size() > 0) {
             auto& region_info = leader_region.region();
             if (region_info.has_start_key() && region_info.has_end_key()
@@ -31,6 +31,11 @@ DEFINE_int32(learner_region_replica_num, 1, "learner region replica num, default
 DEFINE_int32(region_region_size, 100 * 1024 * 1024, "region size, default:100M");
 DEFINE_int64(table_tombstone_gc_time_s, 3600 * 24 * 2, "time interval to clear table_tombstone. default(2d)");
 DEFINE_uint64(statistics_heart_beat_bytesize, 256 * 1024 * 1024, "default(256M)");
+DEFINE_bool(auto_analyze, true, "auto refresh statistics when too many rows modified");
+DEFINE_double(auto_analyze_modified_ratio, 0.2, "modified rows / row count to trigger auto analyze");
+DEFINE_int64(auto_analyze_min_modified_rows, 100000, "min modified rows to trigger auto analyze");
+DEFINE_int32(auto_analyze_max_concurrent, 1, "max tables doing auto analyze in cluster");
+DEFINE_int64(auto_analyze_timeout_s, 3600, "reassign auto analyze task after timeout(s)");
 
 void TableTimer::run() {
     DB_NOTICE("Table Timer run.");
@@ -751,6 +756,8 @@ void TableManager::update_statistics(const pb::MetaManagerRequest& request,
     {
         BAIDU_SCOPED_LOCK(_table_mutex);
         _table_info_map[table_id].statistics_version = version;
+        _table_info_map[table_id].modified_rows = 0;
+        _table_info_map[table_id].analyze_address.clear();
     }
     std::vector<pb::Statistics> st_infos{stat_pb};
     put_incremental_statistics_info(apply_index, st_infos);
@@ -1270,6 +1277,70 @@ void TableManager::check_update_statistics(const pb::BaikalOtherHeartBeatRequest
     }
 }
 
+void TableManager::assign_auto_analyze(const pb::BaikalOtherHeartBeatRequest* request,
+        pb::BaikalOtherHeartBeatResponse* response, const std::string& address) {
+    if (!FLAGS_auto_analyze || !request->can_do_analyze()) {
+        return;
+    }
+    int64_t now = butil::gettimeofday_us();
+    int64_t timeout_us = FLAGS_auto_analyze_timeout_s * 1000 * 1000LL;
+    std::vector<std::pair<int64_t, int64_t>> candidates; // table_id => modified_rows
+    {
+        BAIDU_SCOPED_LOCK(_table_mutex);
+        int doing_cnt = 0;
+        for (auto& pair : _table_info_map) {
+            TableMem& table_mem = pair.second;
+            if (!table_mem.analyze_address.empty()) {
+                if (now - table_mem.analyze_assign_time < timeout_us) {
+                    // 已分配给该baikaldb的任务还在执行，不重复分配
+                    if (table_mem.analyze_address == address) {
+                        return;
+                    }
+                    ++doing_cnt;
+                    continue;
+                }
+                DB_WARNING("auto analyze timeout, table_id:%ld, address:%s",
+                        pair.first, table_mem.analyze_address.c_str());
+                table_mem.analyze_address.clear();
+            }
+            if (table_mem.is_global_index || table_mem.modified_rows < FLAGS_auto_analyze_min_modified_rows) {
+                continue;
+            }
+            if (table_mem.schema_pb.engine() != pb::ROCKSDB &&
+                    table_mem.schema_pb.engine() != pb::ROCKSDB_CSTORE) {
+                continue;
+            }
+            candidates.emplace_back(pair.first, table_mem.modified_rows);
+        }
+        if (doing_cnt >= FLAGS_auto_analyze_max_concurrent) {
+            return;
+        }
+    }
+    // 修改最多的表优先
+    std::sort(candidates.begin(), candidates.end(),
+            [](const std::pair<int64_t, int64_t>& l, const std::pair<int64_t, int64_t>& r) {
+                return l.second > r.second;
+            });
+    for (auto& pair : candidates) {
+        int64_t row_count = get_row_count(pair.first);
+        if (pair.second < row_count * FLAGS_auto_analyze_modified_ratio) {
+            continue;
+        }
+        BAIDU_SCOPED_LOCK(_table_mutex);
+        auto iter = _table_info_map.find(pair.first);
+        if (iter == _table_info_map.end() || !iter->second.analyze_address.empty()) {
+            continue;
+        }
+        iter->second.analyze_address = address;
+        iter->second.analyze_assign_time = now;
+        response->add_analyze_table_ids(pair.first);
+        DB_NOTICE("assign auto analyze, table_id:%ld, modified_rows:%ld, row_count:%ld, address:%s",
+                pair.first, pair.second, row_count, address.c_str());
+        // 每次心跳只分配一个表，控制后台收集的资源占用
+        return;
+    }
+}
+
 int TableManager::get_statistics(const int64_t table_id, pb::Statistics& stat_pb) {
 
     std::string stat_value;
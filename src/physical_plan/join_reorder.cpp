@@ -13,12 +13,59 @@
 // limitations under the License.
 
 #include "join_reorder.h"
+#include <cfloat>
 #include "exec_node.h"
 #include "join_node.h"
 #include "scan_node.h"
 #include "query_context.h"
+#include "scalar_fn_call.h"
+#include "slot_ref.h"
+#include "schema_factory.h"
 
 namespace baikaldb {
+DEFINE_bool(join_reorder_by_cost, true, "reorder inner join by statistics cost");
+DEFINE_int32(join_reorder_dp_max_tables, 8, "max tables to enumerate join order by dp, greedy if more");
+
+// 估算列的distinct值，没有统计信息返回-1
+static double field_ndv(int64_t table_id, int32_t field_id) {
+    SmartStatistics stat = SchemaFactory::get_instance()->get_statistics_ptr(table_id);
+    if (stat == nullptr) {
+        return -1;
+    }
+    int64_t distinct_cnt = stat->get_distinct_cnt(field_id);
+    if (distinct_cnt <= 0) {
+        return -1;
+    }
+    int64_t sample_cnt = stat->get_sample_cnt();
+    int64_t total_rows = stat->total_rows();
+    // 采样中大部分值不重复，认为distinct随总行数线性增长
+    if (sample_cnt > 0 && total_rows > sample_cnt && distinct_cnt * 2 >= sample_cnt) {
+        return distinct_cnt * 1.0 * total_rows / sample_cnt;
+    }
+    return distinct_cnt;
+}
+
+static void collect_equal_slots(ExprNode* expr, std::vector<std::pair<SlotRef*, SlotRef*>>& slots) {
+    if (expr->node_type() != pb::FUNCTION_CALL
+            || static_cast<ScalarFnCall*>(expr)->fn().fn_op() != parser::FT_EQ
+            || expr->children_size() != 2) {
+        return;
+    }
+    ExprNode* left = expr->children(0);
+    ExprNode* right = expr->children(1);
+    if (left->is_row_expr() && right->is_row_expr()) {
+        for (size_t i = 0; i < left->children_size() && i < right->children_size(); i++) {
+            if (left->children(i)->node_type() == pb::SLOT_REF
+                    && right->children(i)->node_type() == pb::SLOT_REF) {
+                slots.emplace_back(static_cast<SlotRef*>(left->children(i)),
+                        static_cast<SlotRef*>(right->children(i)));
+            }
+        }
+    } else if (left->node_type() == pb::SLOT_REF && right->node_type() == pb::SLOT_REF) {
+        slots.emplace_back(static_cast<SlotRef*>(left), static_cast<SlotRef*>(right));
+    }
+}
+
 int JoinReorder::analyze(QueryContext* ctx) {
     JoinNode* join = static_cast<JoinNode*>(ctx->root->get_node(pb::JOIN_NODE));
     if (join == nullptr) {
@@ -32,6 +79,60 @@ int JoinReorder::analyze(QueryContext* ctx) {
     if (!join->need_reorder(tuple_join_child_map, tuple_equals_map, tuple_order, conditions)) {
         return 0;
     }
+    std::vector<int32_t> tuple_reorder;
+    std::vector<pb::JoinAlgorithm> join_algos;
+    bool by_cost = FLAGS_join_reorder_by_cost &&
+        reorder_by_cost(tuple_join_child_map, conditions, tuple_reorder, join_algos);
+    if (!by_cost) {
+        tuple_reorder.clear();
+        if (!reorder_by_rule(tuple_join_child_map, tuple_equals_map, tuple_order, tuple_reorder)) {
+            return 0;
+        }
+        join_algos.assign(tuple_reorder.size(), pb::JA_AUTO);
+    }
+    // 创建新的join节点
+    ExecNode* last_node = tuple_join_child_map[tuple_reorder[0]];
+    for (size_t i = 1; i < tuple_reorder.size(); i++) {
+        pb::PlanNode pb;
+        pb.set_node_type(pb::JOIN_NODE);
+        pb.set_limit(-1);
+        pb.set_is_explain(ctx->is_explain);
+        pb.set_num_children(2);
+        pb::JoinNode* pb_join = pb.mutable_derive_node()->mutable_join_node();
+        pb_join->set_join_type(pb::INNER_JOIN);
+        pb_join->set_join_algo(join_algos[i]);
+        for (size_t j = 0; j < i; j++) {
+            pb_join->add_left_tuple_ids(tuple_reorder[j]);
+        }
+        pb_join->add_right_tuple_ids(tuple_reorder[i]);
+        JoinNode* join_node = new JoinNode;
+        join_node->init(pb);
+        join_node->add_child(last_node);
+        join_node->add_child(tuple_join_child_map[tuple_reorder[i]]);
+        last_node = join_node;
+    }
+    last_node->predicate_pushdown(conditions);
+    if (!conditions.empty()) {
+        DB_FATAL("join reorder predicate_pushdown fail, size:%lu", conditions.size());
+        return -1;
+    }
+    DB_WARNING("join has reordered, by_cost:%d", by_cost);
+    //pb::Plan plan;
+    //ExecNode::create_pb_plan(&plan, ctx->root);
+    //DB_NOTICE("before: %s", plan.DebugString().c_str());
+    join->get_parent()->replace_child(join, last_node);
+    join->reorder_clear();
+    delete join;
+    //pb::Plan plan2;
+    //ExecNode::create_pb_plan(&plan2, ctx->root);
+    //DB_NOTICE("after: %s", plan2.DebugString().c_str());
+    return 0;
+}
+
+bool JoinReorder::reorder_by_rule(std::map<int32_t, ExecNode*>& tuple_join_child_map,
+        std::map<int32_t, std::set<int32_t>>& tuple_equals_map,
+        std::vector<int32_t>& tuple_order,
+        std::vector<int32_t>& tuple_reorder) {
     ScanNode* first_node = static_cast<ScanNode*>(
             tuple_join_child_map[tuple_order[0]]->get_node(pb::SCAN_NODE));
     bool first_has_index = false;
@@ -56,12 +157,11 @@ int JoinReorder::analyze(QueryContext* ctx) {
     }
     // 第一驱动表有索引并且符合等值join的暂不做reorder
     if (first_has_index && is_equal_join) {
-        return 0;
+        return false;
     }
 
     // do reorder
     // 选出有index的tuple
-    std::vector<int32_t> tuple_reorder;
     for (auto& pair : tuple_join_child_map) {
         int32_t tuple_id = pair.first;
         ScanNode* scan_node = static_cast<ScanNode*>(
@@ -74,7 +174,7 @@ int JoinReorder::analyze(QueryContext* ctx) {
     }
     if (tuple_reorder.empty()) {
         if (is_equal_join) {
-            return 0;
+            return false;
         }
         tuple_reorder.push_back(tuple_order[0]);
         tuple_equals_map.erase(tuple_order[0]);
@@ -96,49 +196,237 @@ int JoinReorder::analyze(QueryContext* ctx) {
         if (select_tuple == -1) {
             // no equal join
             DB_WARNING("has no equal condition in join");
-            return 0;
+            return false;
         }
         tuple_reorder.push_back(select_tuple);
         tuple_equals_map.erase(select_tuple);
     }
-    // 创建新的join节点
-    ExecNode* last_node = tuple_join_child_map[tuple_reorder[0]];
-    for (size_t i = 1; i < tuple_reorder.size(); i++) {
-        pb::PlanNode pb;
-        pb.set_node_type(pb::JOIN_NODE);
-        pb.set_limit(-1);
-        pb.set_is_explain(ctx->is_explain);
-        pb.set_num_children(2);
-        pb::JoinNode* pb_join = pb.mutable_derive_node()->mutable_join_node();
-        pb_join->set_join_type(pb::INNER_JOIN);
-        for (size_t j = 0; j < i; j++) {
-            pb_join->add_left_tuple_ids(tuple_reorder[j]);
+    return true;
+}
+
+bool JoinReorder::reorder_by_cost(std::map<int32_t, ExecNode*>& tuple_join_child_map,
+        std::vector<ExprNode*>& conditions,
+        std::vector<int32_t>& tuple_reorder,
+        std::vector<pb::JoinAlgorithm>& join_algos) {
+    _relations.clear();
+    _edges.clear();
+    _adjacent.clear();
+    if (tuple_join_child_map.size() < 2 || tuple_join_child_map.size() > 32) {
+        return false;
+    }
+    std::map<int32_t, int> tuple_idx;
+    for (auto& pair : tuple_join_child_map) {
+        Relation rel;
+        rel.tuple_id = pair.first;
+        rel.scan_node = static_cast<ScanNode*>(pair.second->get_node(pb::SCAN_NODE));
+        int64_t read_rows = 0;
+        int64_t rows = rel.scan_node->estimate_rows(&read_rows);
+        if (rows < 0) {
+            // 任意一个表没有统计信息都退回基于规则的reorder
+            return false;
         }
-        pb_join->add_right_tuple_ids(tuple_reorder[i]);
-        JoinNode* join_node = new JoinNode;
-        join_node->init(pb);
-        join_node->add_child(last_node);
-        join_node->add_child(tuple_join_child_map[tuple_reorder[i]]);
-        last_node = join_node;
+        rel.rows = rows;
+        rel.read_rows = read_rows;
+        tuple_idx[rel.tuple_id] = _relations.size();
+        _relations.emplace_back(rel);
     }
-    last_node->predicate_pushdown(conditions);
-    if (!conditions.empty()) {
-        DB_FATAL("join reorder predicate_pushdown fail, size:%lu", conditions.size());
-        return -1;
+    int n = _relations.size();
+    _adjacent.assign(n, 0);
+    for (auto expr : conditions) {
+        std::vector<std::pair<SlotRef*, SlotRef*>> slots;
+        collect_equal_slots(expr, slots);
+        for (auto& pair : slots) {
+            auto left_iter = tuple_idx.find(pair.first->tuple_id());
+            auto right_iter = tuple_idx.find(pair.second->tuple_id());
+            if (left_iter == tuple_idx.end() || right_iter == tuple_idx.end()
+                    || left_iter->second == right_iter->second) {
+                continue;
+            }
+            EqualEdge edge;
+            edge.left = left_iter->second;
+            edge.right = right_iter->second;
+            edge.left_field = pair.first->field_id();
+            edge.right_field = pair.second->field_id();
+            // 等值连接选择率取1/max(ndv)，没有列统计时用表行数近似
+            double left_ndv = field_ndv(_relations[edge.left].scan_node->table_id(), edge.left_field);
+            double right_ndv = field_ndv(_relations[edge.right].scan_node->table_id(), edge.right_field);
+            if (left_ndv <= 0) {
+                left_ndv = SchemaFactory::get_instance()->get_total_rows(
+                        _relations[edge.left].scan_node->table_id());
+            }
+            if (right_ndv <= 0) {
+                right_ndv = SchemaFactory::get_instance()->get_total_rows(
+                        _relations[edge.right].scan_node->table_id());
+            }
+            edge.selectivity = 1.0 / std::max(std::max(left_ndv, right_ndv), 1.0);
+            _adjacent[edge.left] |= (1U << edge.right);
+            _adjacent[edge.right] |= (1U << edge.left);
+            _edges.emplace_back(edge);
+        }
     }
-    DB_WARNING("join has reordered");
-    //pb::Plan plan;
-    //ExecNode::create_pb_plan(&plan, ctx->root);
-    //DB_NOTICE("before: %s", plan.DebugString().c_str());
-    join->get_parent()->replace_child(join, last_node);
-    join->reorder_clear();
-    delete join;
-    //pb::Plan plan2;
-    //ExecNode::create_pb_plan(&plan2, ctx->root);
-    //DB_NOTICE("after: %s", plan2.DebugString().c_str());
-    return 0;
+    // join图不连通时存在笛卡尔积，不做reorder
+    uint32_t full = (n == 32) ? UINT32_MAX : ((1U << n) - 1);
+    uint32_t reached = 1;
+    uint32_t last = 0;
+    while (reached != last) {
+        last = reached;
+        for (int i = 0; i < n; i++) {
+            if (reached & (1U << i)) {
+                reached |= _adjacent[i];
+            }
+        }
+    }
+    if (reached != full) {
+        DB_WARNING("join graph not connected, skip cost reorder");
+        return false;
+    }
+    JoinPlan best;
+    enumerate(best);
+    if (best.order.size() != (size_t)n) {
+        return false;
+    }
+    for (size_t i = 0; i < best.order.size(); i++) {
+        tuple_reorder.push_back(_relations[best.order[i]].tuple_id);
+        join_algos.push_back(best.algos[i]);
+    }
+    DB_NOTICE("join reorder by cost, tables:%d cost:%f rows:%f", n, best.cost, best.rows);
+    return true;
 }
 
+void JoinReorder::enumerate(JoinPlan& best) {
+    int n = _relations.size();
+    best.cost = DBL_MAX;
+    if (n <= FLAGS_join_reorder_dp_max_tables && n <= 16) {
+        dp_enumerate(best);
+    } else {
+        greedy_enumerate(best);
+    }
+}
+
+double JoinReorder::join_step(const JoinPlan& plan, uint32_t mask, int next,
+        double* rows, pb::JoinAlgorithm* algo) {
+    Relation& rel = _relations[next];
+    double selectivity = 1.0;
+    bool connected = false;
+    bool has_index = false;
+    for (auto& edge : _edges) {
+        int32_t field_id = 0;
+        if (edge.left == next && (mask & (1U << edge.right))) {
+            field_id = edge.left_field;
+        } else if (edge.right == next && (mask & (1U << edge.left))) {
+            field_id = edge.right_field;
+        } else {
+            continue;
+        }
+        connected = true;
+        selectivity *= edge.selectivity;
+        if (!has_index && rel.scan_node->has_index_prefix(field_id)) {
+            has_index = true;
+        }
+    }
+    *rows = std::max(plan.rows * rel.rows * selectivity, 1.0);
+    // 扫描内表后做hash join，代价为内表读取行数加上外表行数
+    double scan_cost = rel.read_rows + plan.rows;
+    if (!connected) {
+        *algo = pb::JA_AUTO;
+        return scan_cost + *rows;
+    }
+    if (has_index) {
+        // 按外表的key回查内表索引
+        double lookup_cost = plan.rows * AccessPath::INDEX_SEEK_FACTOR +
+            *rows * AccessPath::TABLE_GET_FACTOR;
+        if (lookup_cost < scan_cost) {
+            *algo = pb::JA_INDEX_LOOKUP;
+            return lookup_cost + *rows;
+        }
+    }
+    *algo = pb::JA_HASH_SCAN;
+    return scan_cost + *rows;
+}
+
+void JoinReorder::dp_enumerate(JoinPlan& best) {
+    int n = _relations.size();
+    std::vector<JoinPlan> plans(1U << n);
+    for (auto& plan : plans) {
+        plan.cost = DBL_MAX;
+    }
+    for (int i = 0; i < n; i++) {
+        JoinPlan& plan = plans[1U << i];
+        plan.cost = _relations[i].read_rows;
+        plan.rows = _relations[i].rows;
+        plan.order.push_back(i);
+        plan.algos.push_back(pb::JA_AUTO);
+    }
+    // 子集按数值递增，扩展后的集合一定更大，保证先算完再使用
+    for (uint32_t mask = 1; mask < plans.size(); mask++) {
+        const JoinPlan& plan = plans[mask];
+        if (plan.order.empty()) {
+            continue;
+        }
+        for (int next = 0; next < n; next++) {
+            if ((mask & (1U << next)) || (_adjacent[next] & mask) == 0) {
+                continue;
+            }
+            double rows = 0;
+            pb::JoinAlgorithm algo = pb::JA_AUTO;
+            double cost = plan.cost + join_step(plan, mask, next, &rows, &algo);
+            JoinPlan& target = plans[mask | (1U << next)];
+            if (cost < target.cost) {
+                target.cost = cost;
+                target.rows = rows;
+                target.order = plan.order;
+                target.order.push_back(next);
+                target.algos = plan.algos;
+                target.algos.push_back(algo);
+            }
+        }
+    }
+    best = plans.back();
+}
+
+void JoinReorder::greedy_enumerate(JoinPlan& best) {
+    int n = _relations.size();
+    // 每个表都尝试作为驱动表，每步选代价最小的相连表
+    for (int start = 0; start < n; start++) {
+        JoinPlan plan;
+        plan.cost = _relations[start].read_rows;
+        plan.rows = _relations[start].rows;
+        plan.order.push_back(start);
+        plan.algos.push_back(pb::JA_AUTO);
+        uint32_t mask = 1U << start;
+        for (int step = 1; step < n; step++) {
+            int select = -1;
+            double select_cost = DBL_MAX;
+            double select_rows = 0;
+            pb::JoinAlgorithm select_algo = pb::JA_AUTO;
+            for (int next = 0; next < n; next++) {
+                if ((mask & (1U << next)) || (_adjacent[next] & mask) == 0) {
+                    continue;
+                }
+                double rows = 0;
+                pb::JoinAlgorithm algo = pb::JA_AUTO;
+                double cost = join_step(plan, mask, next, &rows, &algo);
+                if (cost < select_cost) {
+                    select = next;
+                    select_cost = cost;
+                    select_rows = rows;
+                    select_algo = algo;
+                }
+            }
+            if (select == -1) {
+                break;
+            }
+            plan.cost += select_cost;
+            plan.rows = select_rows;
+            plan.order.push_back(select);
+            plan.algos.push_back(select_algo);
+            mask |= 1U << select;
+        }
+        if (plan.order.size() == (size_t)n && plan.cost < best.cost) {
+            best = plan;
+        }
+    }
+}
 }
 
 /* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -18,6 +18,7 @@ namespace baikaldb {
 DEFINE_int32(cmsketch_depth, 5, "cmsketch_depth");
 DEFINE_int32(cmsketch_width, 2048, "cmsketch_width");
 DEFINE_int32(sample_rows, 1000000, "sample rows 100w");
+DEFINE_int32(multi_column_max_prefix, 3, "max index prefix length to collect multi-column statistics, 0 to disable");
 int PhysicalPlanner::analyze(QueryContext* ctx) {
     int ret = 0;
     for (auto sub_query_ctx : ctx->sub_query_plans) {
@@ -129,6 +130,7 @@ int PhysicalPlanner::execute(QueryContext* ctx, DataBuffer* send_buf) {
         //如果为analyze模式需要初始化cmsketch
         state.cmsketch = std::make_shared<CMsketch>(FLAGS_cmsketch_depth, FLAGS_cmsketch_width);
         state.cmsketch->set_sample_rows(FLAGS_sample_rows);
+        state.cmsketch->set_multi_column_max_prefix(FLAGS_multi_column_max_prefix);
         //为了获取准确的行数，给meta发请求
         int64_t table_rows = get_table_rows(ctx);
         if (table_rows < 0) {
@@ -118,15 +118,38 @@ bool DataBuffer::byte_array_append_len(const uint8_t *data, size_t len) {
 }
 
 bool DataBuffer::append_text_value(const ExprValue& value) {
-    do {
-        // string长度太长，单独处理
-        if (value.is_string()) {
-            return pack_length_coded_string(value.str_val, false);
-        } else if (value.is_datetime() || value.is_timestamp() || 
-                value.is_date() || value.is_time()) {
-            return pack_length_coded_string(value.get_string(), false);
+    // string长度太长，单独处理
+    if (value.is_string()) {
+        return pack_length_coded_string(value.str_val, false);
+    }
+    // 其他类型文本长度有上限，预留好空间后直接格式化到buffer中，避免临时string和重试
+    if (!byte_array_append_size(MAX_TEXT_VALUE_LEN, 1)) {
+        DB_FATAL("byte_array_append_size fail");
+        return false;
+    }
+    if (value.is_datetime() || value.is_timestamp() || value.is_date() || value.is_time()) {
+        char* buf = (char*)_data + _size + 1;
+        size_t len = 0;
+        switch (value.type) {
+            case pb::DATETIME:
+                len = datetime_to_str(value._u.uint64_val, buf);
+                break;
+            case pb::TIMESTAMP:
+                len = timestamp_to_str(value._u.uint32_val, buf);
+                break;
+            case pb::DATE:
+                len = date_to_str(value._u.uint32_val, buf);
+                break;
+            default:
+                len = time_to_str(value._u.int32_val, buf);
+                break;
         }
-        
+        // byte_array_append_length_coded_binary(len < 251LL)
+        _data[_size] = (uint8_t)(len & 0xff);
+        _size += len + 1;
+        return true;
+    }
+    do {
         char* buf = (char*)_data + _size;
         if (_capacity < _size) {
             DB_FATAL("_capacity:%zu < size:%zu", _capacity, _size);
@@ -19,6 +19,9 @@
 #include "packet_node.h"
 
 namespace baikaldb {
+DEFINE_int64(max_write_bytes_per_event, 16 * 1024 * 1024LL,
+        "max bytes written to one client per epoll event, "
+        "remaining result is sent on next EPOLLOUT");
 
 MysqlWrapper::MysqlWrapper() {
     _err_handler = MysqlErrHandler::get_instance();
@@ -598,32 +601,38 @@ int MysqlWrapper::real_write(SmartSocket sock) {
         }
         return RET_SUCCESS;
     }
-    int real_write = we_want;
-    if (we_want > (int)MAX_WRITE_QUERY_RESULT_PACKET_LEN) {
-        real_write = MAX_WRITE_QUERY_RESULT_PACKET_LEN;
-    }
-    int len = write(sock->fd, sock->send_buf->_data + sock->send_buf_offset, real_write);
-    if (0 < len) {
-        sock->send_buf_offset += len;
-    } else if (len == 0) {
-        return RET_SHUTDOWN;
-    } else {
-        switch (errno) {
-            case EAGAIN:
-                ret = RET_WAIT_FOR_EVENT;
-                break;
-            case EINTR:
-                ret = RET_WAIT_FOR_EVENT;
-                break;
-            default:
-                ret = RET_SHUTDOWN;
-                break;
+    // 按MAX_WRITE_QUERY_RESULT_PACKET_LEN分片连续写，直到socket写满或达到本次事件的上限，
+    // 减少大结果集在epoll上的往返次数
+    int64_t written = 0;
+    while (we_want > 0) {
+        int real_write = we_want;
+        if (we_want > (int)MAX_WRITE_QUERY_RESULT_PACKET_LEN) {
+            real_write = MAX_WRITE_QUERY_RESULT_PACKET_LEN;
+        }
+        int len = write(sock->fd, sock->send_buf->_data + sock->send_buf_offset, real_write);
+        if (0 < len) {
+            sock->send_buf_offset += len;
+            we_want -= len;
+            written += len;
+        } else if (len == 0) {
+            return RET_SHUTDOWN;
+        } else {
+            switch (errno) {
+                case EAGAIN:
+                    ret = RET_WAIT_FOR_EVENT;
+                    break;
+                case EINTR:
+                    ret = RET_WAIT_FOR_EVENT;
+                    break;
+                default:
+                    ret = RET_SHUTDOWN;
+                    break;
+            }
+            return ret;
+        }
+        if (we_want > 0 && (len < real_write || written >= FLAGS_max_write_bytes_per_event)) {
+            return RET_WAIT_FOR_EVENT;
         }
-        return ret;
-    }
-    if (len < real_write || we_want > (int)MAX_WRITE_QUERY_RESULT_PACKET_LEN) {
-        ret = RET_WAIT_FOR_EVENT;
-        return RET_WAIT_FOR_EVENT;
     }
     sock->send_buf->byte_array_clear();
     sock->self_buf->byte_array_clear();
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "network_server.h"
+#include "task_manager.h"
 #ifdef BAIDU_INTERNAL
 #include <baidu/rpc/channel.h>
 #else
@@ -50,6 +51,7 @@ DEFINE_bool(insert_agg_sql, false, "whether insert agg_sql");
 DEFINE_int32(batch_insert_agg_sql_size, 50, "batch size for insert");
 DEFINE_int32(batch_insert_sign_sql_interval_us, 10 * 60 * 1000 * 1000, "batch_insert_sign_sql_interval_us default 10min");
 DECLARE_int32(baikal_heartbeat_interval_us);
+DECLARE_bool(enable_auto_analyze);
 
 static const std::string instance_table_name = "INTERNAL.baikaldb.__baikaldb_instance";
 
@@ -639,6 +641,7 @@ void NetworkServer::construct_other_heart_beat_request(pb::BaikalOtherHeartBeatR
         }
     };
     factory->schema_info_scope_read(schema_read_recallback);
+    request.set_can_do_analyze(FLAGS_enable_auto_analyze);
 }
 
 void NetworkServer::process_other_heart_beat_response(const pb::BaikalOtherHeartBeatResponse& response) {
@@ -646,6 +649,13 @@ void NetworkServer::process_other_heart_beat_response(const pb::BaikalOtherHeart
     if (response.statistics().size() > 0) {
         factory->update_statistics(response.statistics());
     }
+    for (auto table_id : response.analyze_table_ids()) {
+        // 后台执行，成功后meta会清零修改行数
+        Bthread bth;
+        bth.run([table_id]() {
+            TaskManager::get_instance()->process_analyze_work(table_id);
+        });
+    }
 }
 
 void NetworkServer::connection_timeout_check() {
@@ -3,10 +3,12 @@
 #include "network_socket.h"
 #include "ddl_work_planner.h"
 #include "network_server.h"
+#include "logical_planner.h"
 
 namespace baikaldb {
 
 DEFINE_int32(worker_number, 20, "baikaldb worker number.");
+DEFINE_bool(enable_auto_analyze, true, "accept auto analyze task from meta");
  
 int TaskManager::init() {
     _workers.run([this](){
@@ -117,4 +119,48 @@ void TaskManager::process_ddl_work(pb::RegionDdlWork work) {
     DB_NOTICE("ddl work %s finish ok!", work.ShortDebugString().c_str());
 }
 
+void TaskManager::process_analyze_work(int64_t table_id) {
+    SmartTable table_ptr = SchemaFactory::get_instance()->get_table_info_ptr(table_id);
+    if (table_ptr == nullptr) {
+        DB_WARNING("table not exist, table_id:%ld", table_id);
+        return;
+    }
+    std::string db = table_ptr->name.substr(0, table_ptr->name.find('.'));
+    TimeCost cost;
+    SmartSocket client(new NetworkSocket);
+    // 内部用户，只有该表的读权限
+    std::shared_ptr<UserInfo> user_info(new UserInfo);
+    user_info->username = "auto_analyze";
+    user_info->namespace_ = table_ptr->namespace_;
+    user_info->table[table_id] = pb::READ;
+    client->user_info = user_info;
+    client->current_db = db;
+    client->server_instance_id = NetworkServer::get_instance()->get_instance_id();
+    QueryContext* ctx = client->query_ctx.get();
+    ctx->client_conn = client.get();
+    ctx->get_runtime_state()->set_client_conn(client.get());
+    ctx->user_info = user_info;
+    ctx->cur_db = db;
+    ctx->charset = client->charset_name;
+    ctx->mysql_cmd = COM_QUERY;
+    ctx->sql = "explain format = 'analyze' select * from `" + db + "`.`" + table_ptr->short_name + "`";
+    int ret = LogicalPlanner::analyze(ctx);
+    if (ret == 0) {
+        ret = ctx->create_plan_tree();
+    }
+    if (ret == 0) {
+        ret = PhysicalPlanner::analyze(ctx);
+    }
+    if (ret == 0) {
+        ret = PhysicalPlanner::execute(ctx, client->send_buf);
+    }
+    if (ret < 0) {
+        DB_WARNING("auto analyze fail, table_id:%ld, sql:%s, time_cost:%ld",
+                table_id, ctx->sql.c_str(), cost.get_time());
+        return;
+    }
+    DB_NOTICE("auto analyze success, table_id:%ld, sample_rows:%ld, scan_rows:%ld, time_cost:%ld",
+            table_id, ctx->stat_info.num_returned_rows, ctx->stat_info.num_scan_rows, cost.get_time());
+}
+
 } // namespace baikaldb
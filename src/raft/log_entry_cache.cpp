@@ -0,0 +1,236 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "log_entry_cache.h"
+#ifdef BAIDU_INTERNAL
+#include <raft/local_storage.pb.h>
+#else
+#include <braft/local_storage.pb.h>
+#endif
+
+namespace baikaldb {
+DEFINE_int64(raft_log_cache_region_max_bytes, 4 * 1024 * 1024LL,
+        "max bytes of cached raft log tail per region, 0 to disable");
+DEFINE_int64(raft_log_cache_region_max_entries, 4096, "max cached raft log entries per region");
+DEFINE_int64(raft_log_cache_total_max_bytes, 1024 * 1024 * 1024LL,
+        "max bytes of cached raft log tail of all regions");
+
+static int64_t entry_bytes(const braft::LogEntry* entry) {
+    return sizeof(braft::LogEntry) + entry->data.size();
+}
+
+void RegionLogCache::append(const std::vector<braft::LogEntry*>& entries) {
+    LogEntryCache* log_cache = LogEntryCache::get_instance();
+    if (!log_cache->enabled()) {
+        return;
+    }
+    std::lock_guard<bthread::Mutex> lock(_mutex);
+    for (auto entry : entries) {
+        // 不连续说明之前有日志没进缓存，重新开始缓存
+        if (!_entries.empty() && entry->id.index != _entries.back()->id.index + 1) {
+            while (!_entries.empty()) {
+                pop_front();
+            }
+        }
+        _entries.emplace_back(entry);
+        _bytes += entry_bytes(entry);
+        log_cache->add_bytes(entry_bytes(entry));
+    }
+    // 总量超限时只淘汰到本region的份额，不能因为其他region占用把自己淘汰空
+    // 超出份额的region在下次append时淘汰，总量随之回落
+    int64_t share_bytes = log_cache->over_limit() ? log_cache->region_share_bytes() : INT64_MAX;
+    while (!_entries.empty() && ((int64_t)_entries.size() > FLAGS_raft_log_cache_region_max_entries
+            || _bytes > FLAGS_raft_log_cache_region_max_bytes || _bytes > share_bytes)) {
+        pop_front();
+    }
+}
+
+// 调用方持有_mutex
+void RegionLogCache::pop_front() {
+    int64_t bytes = entry_bytes(_entries.front().get());
+    _bytes -= bytes;
+    LogEntryCache::get_instance()->add_bytes(-bytes);
+    _entries.pop_front();
+}
+
+braft::LogEntry* RegionLogCache::get_entry(int64_t index) {
+    LogEntryCache* log_cache = LogEntryCache::get_instance();
+    {
+        std::lock_guard<bthread::Mutex> lock(_mutex);
+        if (!_entries.empty() && index >= _entries.front()->id.index
+                && index <= _entries.back()->id.index) {
+            braft::LogEntry* entry = _entries[index - _entries.front()->id.index].get();
+            entry->AddRef();
+            log_cache->hit(1);
+            return entry;
+        }
+    }
+    log_cache->miss(1);
+    return NULL;
+}
+
+void RegionLogCache::truncate_prefix(int64_t first_index_kept) {
+    std::lock_guard<bthread::Mutex> lock(_mutex);
+    while (!_entries.empty() && _entries.front()->id.index < first_index_kept) {
+        pop_front();
+    }
+}
+
+void RegionLogCache::truncate_suffix(int64_t last_index_kept) {
+    std::lock_guard<bthread::Mutex> lock(_mutex);
+    while (!_entries.empty() && _entries.back()->id.index > last_index_kept) {
+        int64_t bytes = entry_bytes(_entries.back().get());
+        _bytes -= bytes;
+        LogEntryCache::get_instance()->add_bytes(-bytes);
+        _entries.pop_back();
+    }
+}
+
+void RegionLogCache::clear() {
+    std::lock_guard<bthread::Mutex> lock(_mutex);
+    while (!_entries.empty()) {
+        pop_front();
+    }
+}
+
+int RegionLogCache::scan(int64_t start_index, int64_t end_index, const ScanFunc& func) {
+    LogEntryCache* log_cache = LogEntryCache::get_instance();
+    std::vector<scoped_refptr<braft::LogEntry>> entries;
+    int64_t last_index = 0;
+    {
+        std::lock_guard<bthread::Mutex> lock(_mutex);
+        if (_entries.empty() || start_index < _entries.front()->id.index) {
+            log_cache->miss(1);
+            return -2;
+        }
+        last_index = _entries.back()->id.index;
+        int64_t first_index = _entries.front()->id.index;
+        for (int64_t index = start_index; index <= end_index && index <= last_index; ++index) {
+            entries.emplace_back(_entries[index - first_index]);
+        }
+    }
+    log_cache->hit(1);
+    int64_t next_index = start_index;
+    for (auto& entry : entries) {
+        next_index = entry->id.index + 1;
+        LogHead head(entry->id.term, entry->type);
+        // 多数日志只有一个block，直接引用不拷贝
+        std::string buf;
+        rocksdb::Slice data;
+        if (entry->type == braft::ENTRY_TYPE_DATA) {
+            if (entry->data.backing_block_num() == 1) {
+                auto block = entry->data.backing_block(0);
+                data = rocksdb::Slice(block.data(), block.size());
+            } else {
+                buf = entry->data.to_string();
+                data = rocksdb::Slice(buf);
+            }
+        } else if (entry->type == braft::ENTRY_TYPE_CONFIGURATION && entry->peers != nullptr) {
+            braft::ConfigurationPBMeta meta;
+            for (auto& peer : *entry->peers) {
+                meta.add_peers(peer.to_string());
+            }
+            if (entry->old_peers != nullptr) {
+                for (auto& peer : *entry->old_peers) {
+                    meta.add_old_peers(peer.to_string());
+                }
+            }
+            meta.SerializeToString(&buf);
+            data = rocksdb::Slice(buf);
+        }
+        int ret = func(entry->id.index, head, data);
+        if (ret < 0) {
+            return -1;
+        }
+        if (ret > 0) {
+            break;
+        }
+    }
+    if (entries.empty()) {
+        next_index = std::max(start_index, last_index + 1);
+    }
+    return next_index <= last_index ? 1 : 0;
+}
+
+LogEntryCache::LogEntryCache() :
+        _cache_bytes("raft_log_cache_bytes"),
+        _hit_minute("raft_log_cache_hit_minute", &_hit_count, 60),
+        _miss_minute("raft_log_cache_miss_minute", &_miss_count, 60),
+        _hit_ratio("raft_log_cache_hit_ratio", get_hit_ratio, this) {
+}
+
+double LogEntryCache::get_hit_ratio(void* arg) {
+    LogEntryCache* cache = static_cast<LogEntryCache*>(arg);
+    int64_t hit = cache->_hit_minute.get_value();
+    int64_t total = hit + cache->_miss_minute.get_value();
+    return total == 0 ? 0 : (double)hit / total;
+}
+
+bool LogEntryCache::enabled() const {
+    return FLAGS_raft_log_cache_region_max_bytes > 0;
+}
+
+bool LogEntryCache::over_limit() const {
+    return _total_bytes.load() > FLAGS_raft_log_cache_total_max_bytes;
+}
+
+int64_t LogEntryCache::region_share_bytes() const {
+    return FLAGS_raft_log_cache_total_max_bytes / std::max(_region_num.load(), (int64_t)1);
+}
+
+std::shared_ptr<RegionLogCache> LogEntryCache::register_region(int64_t region_id) {
+    std::shared_ptr<RegionLogCache> cache = std::make_shared<RegionLogCache>();
+    std::lock_guard<bthread::Mutex> lock(_mutex);
+    _region_caches[region_id] = cache;
+    _region_num = _region_caches.size();
+    return cache;
+}
+
+void LogEntryCache::unregister_region(int64_t region_id,
+        const std::shared_ptr<RegionLogCache>& cache) {
+    std::lock_guard<bthread::Mutex> lock(_mutex);
+    auto iter = _region_caches.find(region_id);
+    if (iter != _region_caches.end() && iter->second == cache) {
+        _region_caches.erase(iter);
+        _region_num = _region_caches.size();
+    }
+}
+
+void LogEntryCache::remove_region(int64_t region_id) {
+    std::shared_ptr<RegionLogCache> cache;
+    {
+        std::lock_guard<bthread::Mutex> lock(_mutex);
+        auto iter = _region_caches.find(region_id);
+        if (iter == _region_caches.end()) {
+            return;
+        }
+        cache = iter->second;
+        _region_caches.erase(iter);
+        _region_num = _region_caches.size();
+    }
+    cache->clear();
+}
+
+std::shared_ptr<RegionLogCache> LogEntryCache::get_region(int64_t region_id) {
+    std::lock_guard<bthread::Mutex> lock(_mutex);
+    auto iter = _region_caches.find(region_id);
+    if (iter == _region_caches.end()) {
+        return nullptr;
+    }
+    return iter->second;
+}
+
+} // namespace baikaldb
+
+/* vim: set expandtab ts=4 sw=4 sts=4 tw=100: */
@@ -14,100 +14,137 @@
 
 #include "log_entry_reader.h"
 #include "my_raft_log_storage.h"
+#include "segment_log_storage.h"
+#include "log_entry_cache.h"
 #include "common.h"
 #include "table_key.h"
 #include "mut_table_key.h"
 #include "proto/store.interface.pb.h"
 
 namespace baikaldb {
-int LogEntryReader::read_log_entry(int64_t region_id, int64_t log_index, std::string& log_entry) {
-    MutTableKey log_data_key;
-    log_data_key.append_i64(region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY).append_i64(log_index);
-    std::string log_value;
-    rocksdb::ReadOptions options;
-    auto status = _rocksdb->get(options, _log_cf, rocksdb::Slice(log_data_key.data()), &log_value);
-    if (!status.ok()) {
-        DB_FATAL("read log entry fail, region_id: %ld, log_index: %ld", region_id, log_index);
-        return -1;
+static bool is_txn_op(pb::OpType op_type, bool include_kv_batch) {
+    switch (op_type) {
+        case pb::OP_INSERT:
+        case pb::OP_DELETE:
+        case pb::OP_UPDATE:
+        case pb::OP_PREPARE:
+        case pb::OP_ROLLBACK:
+        case pb::OP_COMMIT:
+        case pb::OP_SELECT_FOR_UPDATE:
+            return true;
+        case pb::OP_KV_BATCH:
+            return include_kv_batch;
+        default:
+            return false;
     }
-    rocksdb::Slice slice(log_value);
-    LogHead head(slice);
-    if (head.type != braft::ENTRY_TYPE_DATA) {
-        DB_FATAL("log entry is not data, log_index:%ld, region_id: %ld", log_index, region_id);
-        return -1;
-    }
-    slice.remove_prefix(MyRaftLogStorage::LOG_HEAD_SIZE);
-    log_entry.assign(slice.data(), slice.size());
-    return 0;
 }
 
-int LogEntryReader::read_log_entry(int64_t region_id, int64_t start_log_index, int64_t end_log_index, std::set<uint64_t>& txn_ids, std::map<int64_t, std::string>& log_entrys) {
-    if (txn_ids.empty()) {
-        return 0;
+int LogEntryReader::scan_log_entry(int64_t region_id, int64_t start_log_index, int64_t end_log_index,
+        const ScanFunc& func) {
+    // 最近追加的日志(分裂追日志、事务回放)优先从内存读
+    auto cache = LogEntryCache::get_instance()->get_region(region_id);
+    if (cache != nullptr) {
+        int ret = cache->scan(start_log_index, end_log_index, func);
+        if (ret != -2) {
+            return ret;
+        }
     }
-    if (start_log_index > end_log_index) {
-        DB_FATAL("region_id:%ld, start_log_index:%ld, end_log_index:%ld", region_id, start_log_index, end_log_index);
-        return -1;
+    SegmentLogEngine* engine = SegmentLogEngine::get_instance();
+    if (engine->is_init() && engine->has_region(region_id)) {
+        return engine->scan(region_id, start_log_index, end_log_index, func);
     }
-    TimeCost cost;
-    std::string log_entry;
     MutTableKey log_data_key;
     MutTableKey prefix;
-    MutTableKey end_key;
     log_data_key.append_i64(region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY).append_i64(start_log_index);
     prefix.append_i64(region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY);
-    end_key.append_i64(region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY).append_i64(end_log_index + 1);
-    std::string log_value;
     rocksdb::ReadOptions options;
-    rocksdb::Slice upper_bound_slice = end_key.data();
-    options.iterate_upper_bound = &upper_bound_slice;
     options.prefix_same_as_start = true;
     options.total_order_seek = false;
     options.fill_cache = false;
     std::unique_ptr<rocksdb::Iterator> iter(_rocksdb->new_iterator(options, _log_cf));
-    iter->Seek(log_data_key.data());
-    for (; iter->Valid(); iter->Next()) {
+    for (iter->Seek(log_data_key.data()); iter->Valid(); iter->Next()) {
         if (!iter->key().starts_with(prefix.data())) {
-            DB_WARNING("read end info, region_id: %ld, key:%s", region_id, iter->key().ToString(true).c_str());
-            break;
+            return 0;
         }
         int64_t log_index = TableKey(iter->key()).extract_i64(sizeof(int64_t) + 1);
         if (log_index > end_log_index) {
-            DB_WARNING("region_id:%ld, log_index:%ld, end_log_index:%ld", region_id, log_index, end_log_index);
-            break;
+            return 1;
         }
         rocksdb::Slice value_slice(iter->value());
+        if (value_slice.size() < MyRaftLogStorage::LOG_HEAD_SIZE) {
+            DB_FATAL("log entry is corrupted, region_id: %ld, log_index: %ld", region_id, log_index);
+            return -1;
+        }
         LogHead head(value_slice);
-        value_slice.remove_prefix(MyRaftLogStorage::LOG_HEAD_SIZE); 
+        value_slice.remove_prefix(MyRaftLogStorage::LOG_HEAD_SIZE);
+        int ret = func(log_index, head, value_slice);
+        if (ret < 0) {
+            return -1;
+        }
+        if (ret > 0) {
+            iter->Next();
+            return iter->Valid() && iter->key().starts_with(prefix.data()) ? 1 : 0;
+        }
+    }
+    return 0;
+}
+
+int LogEntryReader::read_log_entry(int64_t region_id, int64_t log_index, std::string& log_entry) {
+    bool found = false;
+    int ret = scan_log_entry(region_id, log_index, log_index,
+            [&](int64_t index, const LogHead& head, const rocksdb::Slice& data) {
+        if (index != log_index) {
+            return 1;
+        }
+        if (head.type != braft::ENTRY_TYPE_DATA) {
+            DB_FATAL("log entry is not data, log_index:%ld, region_id: %ld", log_index, region_id);
+            return -1;
+        }
+        log_entry.assign(data.data(), data.size());
+        found = true;
+        return 1;
+    });
+    if (ret < 0 || !found) {
+        DB_FATAL("read log entry fail, region_id: %ld, log_index: %ld", region_id, log_index);
+        return -1;
+    }
+    return 0;
+}
+
+int LogEntryReader::read_log_entry(int64_t region_id, int64_t start_log_index, int64_t end_log_index, std::set<uint64_t>& txn_ids, std::map<int64_t, std::string>& log_entrys) {
+    if (txn_ids.empty()) {
+        return 0;
+    }
+    if (start_log_index > end_log_index) {
+        DB_FATAL("region_id:%ld, start_log_index:%ld, end_log_index:%ld", region_id, start_log_index, end_log_index);
+        return -1;
+    }
+    TimeCost cost;
+    int ret = scan_log_entry(region_id, start_log_index, end_log_index,
+            [&](int64_t log_index, const LogHead& head, const rocksdb::Slice& data) {
         if (head.type != braft::ENTRY_TYPE_DATA) {
             DB_WARNING("log entry is not data, region_id: %ld head.type: %d", region_id, head.type);
-            continue;
+            return 0;
         }
         pb::StoreReq store_req;
-        if (!store_req.ParseFromArray(value_slice.data(), value_slice.size())) {
+        if (!store_req.ParseFromArray(data.data(), data.size())) {
             DB_FATAL("Fail to parse request fail, region_id: %ld", region_id);
             return -1;
         }
-
-        if (store_req.op_type() != pb::OP_INSERT
-            && store_req.op_type() != pb::OP_DELETE
-            && store_req.op_type() != pb::OP_UPDATE
-            && store_req.op_type() != pb::OP_PREPARE
-            && store_req.op_type() != pb::OP_ROLLBACK
-            && store_req.op_type() != pb::OP_COMMIT
-            && store_req.op_type() != pb::OP_SELECT_FOR_UPDATE
-            && store_req.op_type() != pb::OP_KV_BATCH) {
-            //DB_WARNING("log entry is not txn, region_id: %ld head.type: %d", region_id, store_req.op_type());
-            continue;
+        if (!is_txn_op(store_req.op_type(), true)) {
+            return 0;
         }
-
         if (store_req.txn_infos_size() > 0) {
             uint64_t txn_id = store_req.txn_infos(0).txn_id();
             if (txn_ids.count(txn_id) == 1) {
-                log_entrys[log_index] = value_slice.ToString();
+                log_entrys[log_index] = data.ToString();
                 DB_WARNING("read txn log entry region_id:%ld, log_index:%ld, txn_id:%ld", region_id, log_index, txn_id);
             }
         }
+        return 0;
+    });
+    if (ret < 0) {
+        return -1;
     }
     DB_WARNING("read txn log entry region_id:%ld, time_cost:%ld", region_id, cost.get_time());
     return 0;
@@ -119,64 +156,31 @@ int LogEntryReader::read_txn_last_log_entry(int64_t region_id, int64_t start_log
         return 0;
     }
     TimeCost cost;
-    std::string log_entry;
-    MutTableKey log_data_key;
-    MutTableKey prefix;
-    MutTableKey end_key;
-    log_data_key.append_i64(region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY).append_i64(start_log_index);
-    prefix.append_i64(region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY);
-    end_key.append_i64(region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY).append_i64(end_log_index + 1);
-    std::string log_value;
-    rocksdb::ReadOptions options;
-    rocksdb::Slice upper_bound_slice = end_key.data();
-    options.iterate_upper_bound = &upper_bound_slice;
-    options.prefix_same_as_start = true;
-    options.total_order_seek = false;
-    options.fill_cache = false;
-    std::map<int64_t, uint64_t> log_index_txn_map;
-    std::unique_ptr<rocksdb::Iterator> iter(_rocksdb->new_iterator(options, _log_cf));
-    iter->Seek(log_data_key.data());
-    for (; iter->Valid(); iter->Next()) {
-        if (!iter->key().starts_with(prefix.data())) {
-            DB_WARNING("read end info, region_id: %ld, key:%s", region_id, iter->key().ToString(true).c_str());
-            break;
-        }
-        int64_t log_index = TableKey(iter->key()).extract_i64(sizeof(int64_t) + 1);
-        if (log_index > end_log_index) {
-            DB_WARNING("region_id:%ld, log_index:%ld, end_log_index:%ld", region_id, log_index, end_log_index);
-            break;
-        }
-        rocksdb::Slice value_slice(iter->value());
-        LogHead head(value_slice);
-        value_slice.remove_prefix(MyRaftLogStorage::LOG_HEAD_SIZE); 
+    int ret = scan_log_entry(region_id, start_log_index, end_log_index,
+            [&](int64_t log_index, const LogHead& head, const rocksdb::Slice& data) {
         if (head.type != braft::ENTRY_TYPE_DATA) {
             DB_WARNING("log entry is not data, region_id: %ld head.type: %d", region_id, head.type);
-            continue;
+            return 0;
         }
         pb::StoreReq store_req;
-        if (!store_req.ParseFromArray(value_slice.data(), value_slice.size())) {
+        if (!store_req.ParseFromArray(data.data(), data.size())) {
             DB_FATAL("Fail to parse request fail, region_id: %ld", region_id);
             return -1;
         }
-
-        if (store_req.op_type() != pb::OP_INSERT
-            && store_req.op_type() != pb::OP_DELETE
-            && store_req.op_type() != pb::OP_UPDATE
-            && store_req.op_type() != pb::OP_PREPARE
-            && store_req.op_type() != pb::OP_ROLLBACK
-            && store_req.op_type() != pb::OP_COMMIT
-            && store_req.op_type() != pb::OP_SELECT_FOR_UPDATE) {
-            //DB_WARNING("log entry is not txn, region_id: %ld head.type: %d", region_id, store_req.op_type());
-            continue;
+        if (!is_txn_op(store_req.op_type(), false)) {
+            return 0;
         }
-
         if (store_req.txn_infos_size() > 0) {
             uint64_t txn_id = store_req.txn_infos(0).txn_id();
             if (txn_ids.count(txn_id) == 1) {
-                log_entrys[txn_id] = value_slice.ToString();
+                log_entrys[txn_id] = data.ToString();
                 DB_WARNING("read txn log entry region_id:%ld, log_index:%ld, txn_id:%ld", region_id, log_index, txn_id);
             }
         }
+        return 0;
+    });
+    if (ret < 0) {
+        return -1;
     }
     DB_WARNING("read txn log entry region_id:%ld, time_cost:%ld", region_id, cost.get_time());
     return 0;
@@ -17,6 +17,7 @@
 #include "raft_log_compaction_filter.h"
 #include "can_add_peer_setter.h"
 #include "concurrency.h"
+#include "log_entry_cache.h"
 #include "proto/store.interface.pb.h"
 namespace baikaldb {
 DECLARE_int32(rocksdb_cost_sample);
@@ -58,6 +59,9 @@ MyRaftLogStorage::MyRaftLogStorage(
 }
 
 MyRaftLogStorage::~MyRaftLogStorage() {
+    if (_cache != nullptr) {
+        LogEntryCache::get_instance()->unregister_region(_region_id, _cache);
+    }
     bthread_mutex_destroy(&_mutex);
 }
 
@@ -232,6 +236,7 @@ int MyRaftLogStorage::init(braft::ConfigurationManager* configuration_manager) {
     }
     _first_log_index.store(first_log_index);
     _last_log_index.store(last_log_index);
+    _cache = LogEntryCache::get_instance()->register_region(_region_id);
     RaftLogCompactionFilter::get_instance()->update_first_index_map(_region_id, first_log_index);
     DB_WARNING("region_id: %ld, first_log_index:%ld, last_log_index:%ld, time_cost: %ld",
                     _region_id, _first_log_index.load(), _last_log_index.load(), time_cost.get_time());
@@ -273,6 +278,12 @@ int MyRaftLogStorage::get_binlog_entry(rocksdb::Slice& raftlog_value_slice, std:
 }
 
 braft::LogEntry* MyRaftLogStorage::get_entry(const int64_t index) {
+    if (_cache != nullptr) {
+        braft::LogEntry* entry = _cache->get_entry(index);
+        if (entry != NULL) {
+            return entry;
+        }
+    }
     char buf[LOG_DATA_KEY_SIZE];
     _encode_log_data_key(buf, LOG_DATA_KEY_SIZE, index);
     std::string value;
@@ -442,6 +453,9 @@ int MyRaftLogStorage::append_entries(const std::vector<braft::LogEntry*>& entrie
         }
         _last_log_index.fetch_add(entries.size());
     }
+    if (_cache != nullptr) {
+        _cache->append(entries);
+    }
     //DB_WARNING("append_entry, entries.size:%ld, time_cost:%ld, region_id: %ld",
     //            entries.size(), time_cost.get_time(), _region_id);
     return (int)entries.size();
@@ -462,6 +476,9 @@ int MyRaftLogStorage::truncate_prefix(const int64_t first_index_kept) {
         std::unique_lock<bthread_mutex_t> lck(_mutex);
         _term_map.truncate_prefix(first_index_kept);
     }
+    if (_cache != nullptr) {
+        _cache->truncate_prefix(first_index_kept);
+    }
     CanAddPeerSetter::get_instance()->set_can_add_peer(_region_id);
     //write first_log_index to rocksdb, real delete when compaction
     char key_buf[LOG_META_KEY_SIZE]; 
@@ -521,6 +538,9 @@ int MyRaftLogStorage::truncate_suffix(const int64_t last_index_kept) {
     _term_map.truncate_suffix(last_index_kept);
     _last_log_index.store(last_index_kept);
     lck.unlock();
+    if (_cache != nullptr) {
+        _cache->truncate_suffix(last_index_kept);
+    }
     DB_WARNING("Truncating region_id: %ld to last index kept:%ld from last log index:%ld",
             _region_id, last_index_kept, _last_log_index.load()); 
     // delete from rocksdb
@@ -549,6 +569,9 @@ int  MyRaftLogStorage::reset(const int64_t next_log_index) {
                 _region_id, next_log_index);
     truncate_prefix(next_log_index);
     truncate_suffix(next_log_index - 1);
+    if (_cache != nullptr) {
+        _cache->clear();
+    }
     BAIDU_SCOPED_LOCK(_mutex);
     _term_map.reset();
     return 0;
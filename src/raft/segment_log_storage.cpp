@@ -0,0 +1,1231 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "segment_log_storage.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <boost/lexical_cast.hpp>
+#ifdef BAIDU_INTERNAL
+#include <base/crc32c.h>
+#include <base/file_util.h>
+#include <base/raw_pack.h>
+#include <raft/local_storage.pb.h>
+#else
+#include <butil/crc32c.h>
+#include <butil/file_util.h>
+#include <butil/raw_pack.h>
+#include <braft/local_storage.pb.h>
+#endif
+#include "mut_table_key.h"
+#include "table_key.h"
+#include "raft_log_compaction_filter.h"
+#include "can_add_peer_setter.h"
+#include "log_entry_cache.h"
+
+namespace baikaldb {
+DEFINE_string(raft_log_segment_path, "./raft_log_segment", "segment raft log path");
+DEFINE_int64(raft_log_segment_max_size, 256 * 1024 * 1024LL, "max size of one raft log segment");
+DEFINE_int32(raft_log_segment_max_num, 32,
+        "rewrite live logs in the oldest segment when segment num exceeds this");
+DEFINE_int64(raft_log_segment_max_batch_bytes, 4 * 1024 * 1024LL,
+        "max bytes of one group commit write");
+DEFINE_bool(raft_log_segment_sync, true, "fdatasync after each group commit write");
+DEFINE_int32(raft_log_segment_gc_interval_s, 10, "segment gc interval(s)");
+
+static const int64_t REWRITE_BATCH_NUM = 1000;
+static const size_t RECOVER_READ_SIZE = 4 * 1024 * 1024;
+
+static uint32_t iobuf_crc(const butil::IOBuf& buf) {
+    uint32_t crc = 0;
+    for (size_t i = 0; i < buf.backing_block_num(); ++i) {
+        auto block = buf.backing_block(i);
+        crc = butil::crc32c::Extend(crc, block.data(), block.size());
+    }
+    return crc;
+}
+
+static void pack_header(char* buf, const LogRecord& record) {
+    butil::RawPacker(buf)
+            .pack32(record.data.size())
+            .pack32(iobuf_crc(record.data))
+            .pack32(record.kind)
+            .pack32(record.type)
+            .pack64(record.region_id)
+            .pack64(record.index)
+            .pack64(record.term);
+    const size_t crc_pos = LogRecord::HEADER_SIZE - sizeof(uint32_t);
+    butil::RawPacker(buf + crc_pos).pack32(butil::crc32c::Value(buf, crc_pos));
+}
+
+// header crc不对返回-1
+static int unpack_header(const char* buf, LogRecord* record, uint32_t* data_len, uint32_t* data_crc) {
+    const size_t crc_pos = LogRecord::HEADER_SIZE - sizeof(uint32_t);
+    uint32_t header_crc = 0;
+    butil::RawUnpacker(buf + crc_pos).unpack32(header_crc);
+    if (header_crc != butil::crc32c::Value(buf, crc_pos)) {
+        return -1;
+    }
+    uint32_t kind = 0;
+    uint32_t type = 0;
+    butil::RawUnpacker(buf)
+            .unpack32(*data_len)
+            .unpack32(*data_crc)
+            .unpack32(kind)
+            .unpack32(type)
+            .unpack64((uint64_t&)record->region_id)
+            .unpack64((uint64_t&)record->index)
+            .unpack64((uint64_t&)record->term);
+    record->kind = kind;
+    record->type = type;
+    return 0;
+}
+
+static ssize_t pread_full(int fd, char* buf, size_t count, off_t offset) {
+    size_t done = 0;
+    while (done < count) {
+        ssize_t n = pread(fd, buf + done, count - done, offset + done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        done += n;
+    }
+    return done;
+}
+
+static int fsync_dir(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    int ret = fsync(fd);
+    ::close(fd);
+    return ret;
+}
+
+SegmentLogEngine::Segment::~Segment() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+int SegmentLogEngine::open_segment(int64_t id, SmartSegment* segment) {
+    char name[64];
+    snprintf(name, sizeof(name), "segment_%020ld", id);
+    SmartSegment seg = std::make_shared<Segment>();
+    seg->id = id;
+    seg->path = _path + "/" + name;
+    seg->fd = ::open(seg->path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (seg->fd < 0) {
+        DB_FATAL("open segment fail, path: %s, err: %s", seg->path.c_str(), strerror(errno));
+        return -1;
+    }
+    seg->size = lseek(seg->fd, 0, SEEK_END);
+    if (seg->size < 0) {
+        DB_FATAL("seek segment fail, path: %s, err: %s", seg->path.c_str(), strerror(errno));
+        return -1;
+    }
+    *segment = seg;
+    return 0;
+}
+
+int SegmentLogEngine::init() {
+    std::lock_guard<bthread::Mutex> lock(_init_mutex);
+    if (_is_init) {
+        return 0;
+    }
+    TimeCost cost;
+    _path = FLAGS_raft_log_segment_path;
+    butil::File::Error error;
+    if (!butil::CreateDirectoryAndGetError(butil::FilePath(_path), &error, true)) {
+        DB_FATAL("create segment path fail, path: %s, err: %d", _path.c_str(), error);
+        return -1;
+    }
+    std::vector<int64_t> ids;
+    DIR* dir = opendir(_path.c_str());
+    if (dir == nullptr) {
+        DB_FATAL("open segment path fail, path: %s", _path.c_str());
+        return -1;
+    }
+    struct dirent* ent = nullptr;
+    while ((ent = readdir(dir)) != nullptr) {
+        int64_t id = 0;
+        char tail = 0;
+        if (sscanf(ent->d_name, "segment_%ld%c", &id, &tail) == 1) {
+            ids.push_back(id);
+        }
+    }
+    closedir(dir);
+    std::sort(ids.begin(), ids.end());
+
+    std::lock_guard<bthread::Mutex> index_lock(_index_mutex);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        SmartSegment segment;
+        if (open_segment(ids[i], &segment) != 0) {
+            return -1;
+        }
+        _segments[segment->id] = segment;
+        if (recover_segment(segment, i == ids.size() - 1) != 0) {
+            return -1;
+        }
+    }
+    int64_t active_id = ids.empty() ? 1 : ids.back() + 1;
+    if (open_segment(active_id, &_active) != 0) {
+        return -1;
+    }
+    _segments[active_id] = _active;
+    fsync_dir(_path);
+    _gc_bth.run([this]() {gc_segments();});
+    _is_init = true;
+    DB_WARNING("segment log engine init success, path: %s, segment_num: %lu, region_num: %lu, "
+            "time_cost: %ld", _path.c_str(), _segments.size(), _region_logs.size(), cost.get_time());
+    return 0;
+}
+
+// 只有最后一个segment可能有写了一半的记录，截断即可
+int SegmentLogEngine::recover_segment(const SmartSegment& segment, bool is_last) {
+    std::string buf;
+    int64_t buf_start = 0;
+    auto fill = [&](int64_t offset, size_t len) -> bool {
+        if (offset >= buf_start && offset + (int64_t)len <= buf_start + (int64_t)buf.size()) {
+            return true;
+        }
+        buf.resize(std::max(len, RECOVER_READ_SIZE));
+        ssize_t n = pread_full(segment->fd, &buf[0], buf.size(), offset);
+        buf.resize(n < 0 ? 0 : n);
+        buf_start = offset;
+        return buf.size() >= len;
+    };
+    int64_t offset = 0;
+    int64_t count = 0;
+    while (offset < segment->size) {
+        if (!fill(offset, LogRecord::HEADER_SIZE)) {
+            break;
+        }
+        LogRecord record;
+        uint32_t data_len = 0;
+        uint32_t data_crc = 0;
+        if (unpack_header(buf.data() + (offset - buf_start), &record, &data_len, &data_crc) != 0) {
+            break;
+        }
+        const int64_t record_size = LogRecord::HEADER_SIZE + data_len;
+        if (offset + record_size > segment->size) {
+            break;
+        }
+        if (is_last) {
+            if (!fill(offset, record_size)) {
+                break;
+            }
+            const char* data = buf.data() + (offset - buf_start) + LogRecord::HEADER_SIZE;
+            if (butil::crc32c::Value(data, data_len) != data_crc) {
+                break;
+            }
+        }
+        record.location.segment_id = segment->id;
+        record.location.offset = offset;
+        record.location.data_len = data_len;
+        record.location.type = record.type;
+        record.location.term = record.term;
+        apply_record(record, true);
+        offset += record_size;
+        ++count;
+    }
+    if (offset < segment->size) {
+        if (!is_last) {
+            DB_FATAL("segment is corrupted, path: %s, offset: %ld, size: %ld",
+                    segment->path.c_str(), offset, segment->size);
+            return -1;
+        }
+        DB_WARNING("truncate broken tail, path: %s, offset: %ld, size: %ld",
+                segment->path.c_str(), offset, segment->size);
+        if (ftruncate(segment->fd, offset) != 0) {
+            DB_FATAL("truncate segment fail, path: %s, err: %s",
+                    segment->path.c_str(), strerror(errno));
+            return -1;
+        }
+        segment->size = offset;
+    }
+    DB_WARNING("recover segment: %s, record_num: %ld, size: %ld",
+            segment->path.c_str(), count, segment->size);
+    return 0;
+}
+
+void SegmentLogEngine::close() {
+    if (!_is_init) {
+        return;
+    }
+    _shutdown = true;
+    _gc_bth.join();
+    DB_WARNING("segment log engine gc bth join");
+}
+
+SegmentLogEngine::SegmentLogEngine() :
+        _group_writer([this](std::vector<AppendTask*>& batch) {
+                    write_batch(batch);
+                },
+                [](size_t count, int64_t bytes) {
+                    return bytes > FLAGS_raft_log_segment_max_batch_bytes;
+                },
+                [](const AppendTask* task) {
+                    return task->bytes;
+                }) {}
+
+std::shared_ptr<bthread::Mutex> SegmentLogEngine::region_write_mutex(int64_t region_id) {
+    std::lock_guard<bthread::Mutex> lock(_region_mutex);
+    auto& mutex = _region_write_mutex[region_id];
+    if (mutex == nullptr) {
+        mutex = std::make_shared<bthread::Mutex>();
+    }
+    return mutex;
+}
+
+int SegmentLogEngine::append(int64_t region_id, std::vector<LogRecord>& records) {
+    auto mutex = region_write_mutex(region_id);
+    std::lock_guard<bthread::Mutex> lock(*mutex);
+    return append_records(records);
+}
+
+// 写盘期间到达的各region请求合并进下一批，批次大小受raft_log_segment_max_batch_bytes限制
+int SegmentLogEngine::append_records(std::vector<LogRecord>& records) {
+    if (records.empty()) {
+        return 0;
+    }
+    AppendTask task;
+    task.records = &records;
+    for (auto& record : records) {
+        task.bytes += LogRecord::HEADER_SIZE + record.data.size();
+    }
+    _group_writer.run(&task);
+    return task.ret;
+}
+
+void SegmentLogEngine::write_batch(std::vector<AppendTask*>& batch) {
+    TimeCost cost;
+    int ret = write_records(batch);
+    _write_time_cost << cost.get_time();
+    _write_batch_size << batch.size();
+    // 一批共用一次fdatasync，结果相同
+    for (auto task : batch) {
+        task->ret = ret;
+    }
+}
+
+// 只有写者线程访问_active的写入位置
+int SegmentLogEngine::write_records(std::vector<AppendTask*>& batch) {
+    int64_t bytes = 0;
+    for (auto task : batch) {
+        bytes += task->bytes;
+    }
+    SmartSegment active;
+    {
+        std::lock_guard<bthread::Mutex> lock(_index_mutex);
+        active = _active;
+    }
+    if (active->size > 0 && active->size + bytes > FLAGS_raft_log_segment_max_size) {
+        if (FLAGS_raft_log_segment_sync && fdatasync(active->fd) != 0) {
+            DB_FATAL("sync segment fail, path: %s, err: %s", active->path.c_str(), strerror(errno));
+            return -1;
+        }
+        SmartSegment next;
+        if (open_segment(active->id + 1, &next) != 0) {
+            return -1;
+        }
+        fsync_dir(_path);
+        {
+            std::lock_guard<bthread::Mutex> lock(_index_mutex);
+            _segments[next->id] = next;
+            _active = next;
+        }
+        DB_WARNING("roll segment, new segment: %s", next->path.c_str());
+        active = next;
+    }
+    // header和data共享block，不拷贝data
+    butil::IOBuf buf;
+    int64_t offset = active->size;
+    for (auto task : batch) {
+        for (auto& record : *task->records) {
+            char header[LogRecord::HEADER_SIZE];
+            pack_header(header, record);
+            buf.append(header, sizeof(header));
+            buf.append(record.data);
+            record.location.segment_id = active->id;
+            record.location.offset = offset;
+            record.location.data_len = record.data.size();
+            record.location.type = record.type;
+            record.location.term = record.term;
+            offset += LogRecord::HEADER_SIZE + record.data.size();
+        }
+    }
+    int64_t write_offset = active->size;
+    while (!buf.empty()) {
+        ssize_t n = buf.pcut_into_file_descriptor(active->fd, write_offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            DB_FATAL("write segment fail, path: %s, err: %s", active->path.c_str(), strerror(errno));
+            if (ftruncate(active->fd, active->size) != 0) {
+                DB_FATAL("truncate segment fail, path: %s", active->path.c_str());
+            }
+            return -1;
+        }
+        write_offset += n;
+    }
+    if (FLAGS_raft_log_segment_sync && fdatasync(active->fd) != 0) {
+        DB_FATAL("sync segment fail, path: %s, err: %s", active->path.c_str(), strerror(errno));
+        return -1;
+    }
+    std::lock_guard<bthread::Mutex> lock(_index_mutex);
+    active->size = write_offset;
+    for (auto task : batch) {
+        for (auto& record : *task->records) {
+            apply_record(record, false);
+        }
+    }
+    return 0;
+}
+
+void SegmentLogEngine::release_location(const LogLocation& location) {
+    auto iter = _segments.find(location.segment_id);
+    if (iter != _segments.end()) {
+        --iter->second->live_count;
+    }
+}
+
+void SegmentLogEngine::remove_locations(RegionLog& log, size_t pos) {
+    for (size_t i = pos; i < log.locations.size(); ++i) {
+        release_location(log.locations[i]);
+    }
+    if (pos < log.locations.size()) {
+        log.locations.resize(pos);
+    }
+}
+
+// 调用方持有_index_mutex
+void SegmentLogEngine::apply_record(const LogRecord& record, bool recovering) {
+    const int64_t index = record.index;
+    switch (record.kind) {
+        case LogRecord::ENTRY: {
+            RegionLog& log = _region_logs[record.region_id];
+            if (log.locations.empty() || index < log.first_index || index > log.last_index() + 1) {
+                remove_locations(log, 0);
+                log.first_index = index;
+            } else if (index <= log.last_index()) {
+                remove_locations(log, index - log.first_index);
+            }
+            log.locations.push_back(record.location);
+            ++_segments[record.location.segment_id]->live_count;
+            break;
+        }
+        case LogRecord::REWRITE: {
+            // 运行时gc持有region写锁，index一定在范围内
+            // 重放时较老的segment可能已删除，重写记录倒序写入，缺失的前缀从前面补齐
+            RegionLog& log = _region_logs[record.region_id];
+            if (!log.locations.empty() && index >= log.first_index && index <= log.last_index()) {
+                LogLocation& location = log.locations[index - log.first_index];
+                release_location(location);
+                location = record.location;
+            } else if (!log.locations.empty() && index == log.first_index - 1) {
+                log.locations.push_front(record.location);
+                log.first_index = index;
+            } else if (!log.locations.empty() && index == log.last_index() + 1) {
+                log.locations.push_back(record.location);
+            } else {
+                if (!recovering) {
+                    DB_FATAL("rewrite out of range, region_id: %ld, index: %ld",
+                            record.region_id, index);
+                }
+                remove_locations(log, 0);
+                log.first_index = index;
+                log.locations.push_back(record.location);
+            }
+            ++_segments[record.location.segment_id]->live_count;
+            break;
+        }
+        case LogRecord::TRUNCATE_SUFFIX: {
+            auto iter = _region_logs.find(record.region_id);
+            if (iter == _region_logs.end()) {
+                break;
+            }
+            RegionLog& log = iter->second;
+            if (index < log.last_index()) {
+                remove_locations(log, std::max(index + 1 - log.first_index, (int64_t)0));
+            }
+            break;
+        }
+        case LogRecord::REMOVE_REGION: {
+            auto iter = _region_logs.find(record.region_id);
+            if (iter != _region_logs.end()) {
+                remove_locations(iter->second, 0);
+                _region_logs.erase(iter);
+            }
+            break;
+        }
+        default:
+            DB_FATAL("unknown record kind: %d, region_id: %ld", record.kind, record.region_id);
+            break;
+    }
+}
+
+int SegmentLogEngine::truncate_suffix(int64_t region_id, int64_t last_index_kept) {
+    std::vector<LogRecord> records(1);
+    records[0].kind = LogRecord::TRUNCATE_SUFFIX;
+    records[0].region_id = region_id;
+    records[0].index = last_index_kept;
+    return append(region_id, records);
+}
+
+void SegmentLogEngine::truncate_prefix(int64_t region_id, int64_t first_index_kept) {
+    auto mutex = region_write_mutex(region_id);
+    std::lock_guard<bthread::Mutex> region_lock(*mutex);
+    std::lock_guard<bthread::Mutex> lock(_index_mutex);
+    auto iter = _region_logs.find(region_id);
+    if (iter == _region_logs.end()) {
+        return;
+    }
+    RegionLog& log = iter->second;
+    while (!log.locations.empty() && log.first_index < first_index_kept) {
+        release_location(log.locations.front());
+        log.locations.pop_front();
+        ++log.first_index;
+    }
+    if (log.locations.empty()) {
+        log.first_index = first_index_kept;
+    }
+}
+
+int SegmentLogEngine::remove_region(int64_t region_id) {
+    std::vector<LogRecord> records(1);
+    records[0].kind = LogRecord::REMOVE_REGION;
+    records[0].region_id = region_id;
+    int ret = append(region_id, records);
+    if (ret == 0) {
+        // 其他地方都在_region_mutex下取锁，只剩map持有时可以安全删除
+        std::lock_guard<bthread::Mutex> lock(_region_mutex);
+        auto iter = _region_write_mutex.find(region_id);
+        if (iter != _region_write_mutex.end() && iter->second.use_count() == 1) {
+            _region_write_mutex.erase(iter);
+        }
+    }
+    return ret;
+}
+
+bool SegmentLogEngine::has_region(int64_t region_id) {
+    std::lock_guard<bthread::Mutex> lock(_index_mutex);
+    return _region_logs.count(region_id) == 1;
+}
+
+int SegmentLogEngine::attach_region(int64_t region_id, int64_t first_log_index,
+        std::vector<LogLocation>* locations) {
+    std::lock_guard<bthread::Mutex> lock(_index_mutex);
+    auto iter = _region_logs.find(region_id);
+    if (iter == _region_logs.end()) {
+        return 0;
+    }
+    RegionLog& log = iter->second;
+    if (!log.locations.empty() && log.first_index > first_log_index) {
+        DB_FATAL("Found a hole in region_id: %ld, first_log_index: %ld, segment first index: %ld",
+                region_id, first_log_index, log.first_index);
+        return -1;
+    }
+    while (!log.locations.empty() && log.first_index < first_log_index) {
+        release_location(log.locations.front());
+        log.locations.pop_front();
+        ++log.first_index;
+    }
+    if (log.locations.empty()) {
+        log.first_index = first_log_index;
+    }
+    locations->assign(log.locations.begin(), log.locations.end());
+    return 0;
+}
+
+void SegmentLogEngine::drop_unknown_regions(const std::set<int64_t>& region_ids) {
+    std::vector<int64_t> drop_region_ids;
+    {
+        std::lock_guard<bthread::Mutex> lock(_index_mutex);
+        for (auto& pair : _region_logs) {
+            if (region_ids.count(pair.first) == 0) {
+                drop_region_ids.push_back(pair.first);
+            }
+        }
+    }
+    for (auto region_id : drop_region_ids) {
+        DB_WARNING("drop raft log of unknown region_id: %ld", region_id);
+        remove_region(region_id);
+    }
+}
+
+int SegmentLogEngine::read_location(int64_t region_id, int64_t index, const LogLocation& location,
+        const SmartSegment& segment, butil::IOBuf* data) {
+    const size_t size = LogRecord::HEADER_SIZE + location.data_len;
+    butil::IOPortal portal;
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = portal.pappend_from_file_descriptor(segment->fd,
+                location.offset + done, size - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            DB_FATAL("read segment fail, path: %s, err: %s", segment->path.c_str(), strerror(errno));
+            return -1;
+        }
+        if (n == 0) {
+            DB_FATAL("read segment eof, path: %s, offset: %ld", segment->path.c_str(), location.offset);
+            return -1;
+        }
+        done += n;
+    }
+    char header[LogRecord::HEADER_SIZE];
+    portal.cutn(header, sizeof(header));
+    LogRecord record;
+    uint32_t data_len = 0;
+    uint32_t data_crc = 0;
+    if (unpack_header(header, &record, &data_len, &data_crc) != 0
+            || record.region_id != region_id || record.index != index
+            || data_len != location.data_len) {
+        DB_FATAL("log record is corrupted, region_id: %ld, index: %ld, path: %s, offset: %ld",
+                region_id, index, segment->path.c_str(), location.offset);
+        return -1;
+    }
+    if (iobuf_crc(portal) != data_crc) {
+        DB_FATAL("log data crc mismatch, region_id: %ld, index: %ld, path: %s, offset: %ld",
+                region_id, index, segment->path.c_str(), location.offset);
+        return -1;
+    }
+    data->swap(portal);
+    return 0;
+}
+
+int SegmentLogEngine::read(int64_t region_id, int64_t index, LogLocation* location,
+        butil::IOBuf* data) {
+    SmartSegment segment;
+    {
+        std::lock_guard<bthread::Mutex> lock(_index_mutex);
+        auto iter = _region_logs.find(region_id);
+        if (iter == _region_logs.end()) {
+            return -1;
+        }
+        RegionLog& log = iter->second;
+        if (log.locations.empty() || index < log.first_index || index > log.last_index()) {
+            return -1;
+        }
+        *location = log.locations[index - log.first_index];
+        auto seg_iter = _segments.find(location->segment_id);
+        if (seg_iter == _segments.end()) {
+            DB_FATAL("segment not found, region_id: %ld, index: %ld, segment_id: %ld",
+                    region_id, index, location->segment_id);
+            return -1;
+        }
+        segment = seg_iter->second;
+    }
+    // segment被gc删除后fd在最后一个引用释放时才关闭，可以继续读
+    return read_location(region_id, index, *location, segment, data);
+}
+
+int SegmentLogEngine::scan(int64_t region_id, int64_t start_index, int64_t end_index,
+        const ScanFunc& func) {
+    int64_t index = start_index;
+    int64_t last_index = 0;
+    {
+        std::lock_guard<bthread::Mutex> lock(_index_mutex);
+        auto iter = _region_logs.find(region_id);
+        if (iter == _region_logs.end() || iter->second.locations.empty()) {
+            return 0;
+        }
+        index = std::max(index, iter->second.first_index);
+        last_index = iter->second.last_index();
+    }
+    for (; index <= end_index && index <= last_index; ++index) {
+        LogLocation location;
+        butil::IOBuf data;
+        if (read(region_id, index, &location, &data) != 0) {
+            DB_WARNING("read log entry fail, region_id: %ld, index: %ld", region_id, index);
+            return -1;
+        }
+        std::string value = data.to_string();
+        int ret = func(index, LogHead(location.term, location.type), rocksdb::Slice(value));
+        if (ret < 0) {
+            return -1;
+        }
+        if (ret > 0) {
+            ++index;
+            break;
+        }
+    }
+    return index <= last_index ? 1 : 0;
+}
+
+// 重写记录从last_index倒序写入，保证删除老segment后重放结果不变
+// 每批只在读和写期间持有region写锁，批次之间该region可以正常追加日志
+// 批次之间可能发生truncate，每批按当前索引重新确定范围:
+// 新追加的日志已在新segment中不需要重写；truncate_suffix后从保留的最后一条继续；
+// truncate_prefix掉的日志不再需要重写
+int SegmentLogEngine::rewrite_region(int64_t region_id) {
+    auto mutex = region_write_mutex(region_id);
+    int64_t next_index = INT64_MAX;
+    int64_t count = 0;
+    int64_t batch_num = 0;
+    while (!_shutdown) {
+        std::lock_guard<bthread::Mutex> region_lock(*mutex);
+        int64_t first_index = 0;
+        {
+            std::lock_guard<bthread::Mutex> lock(_index_mutex);
+            auto iter = _region_logs.find(region_id);
+            if (iter == _region_logs.end() || iter->second.locations.empty()) {
+                break;
+            }
+            first_index = iter->second.first_index;
+            next_index = std::min(next_index, iter->second.last_index());
+        }
+        if (next_index < first_index) {
+            break;
+        }
+        std::vector<LogRecord> records;
+        int64_t bytes = 0;
+        for (; next_index >= first_index && (int64_t)records.size() < REWRITE_BATCH_NUM
+                && bytes < FLAGS_raft_log_segment_max_batch_bytes; --next_index) {
+            LogLocation location;
+            LogRecord record;
+            if (read(region_id, next_index, &location, &record.data) != 0) {
+                return -1;
+            }
+            record.kind = LogRecord::REWRITE;
+            record.type = location.type;
+            record.region_id = region_id;
+            record.index = next_index;
+            record.term = location.term;
+            bytes += LogRecord::HEADER_SIZE + record.data.size();
+            records.emplace_back(record);
+        }
+        if (append_records(records) != 0) {
+            return -1;
+        }
+        count += records.size();
+        ++batch_num;
+    }
+    DB_WARNING("rewrite raft log, region_id: %ld, count: %ld, batch_num: %ld",
+            region_id, count, batch_num);
+    return 0;
+}
+
+void SegmentLogEngine::gc_segments() {
+    while (!_shutdown) {
+        bthread_usleep_fast_shutdown(FLAGS_raft_log_segment_gc_interval_s * 1000 * 1000LL, _shutdown);
+        if (_shutdown) {
+            break;
+        }
+        gc_once();
+    }
+}
+
+void SegmentLogEngine::gc_once() {
+    // 只能从最老的segment开始删，否则被删除的TRUNCATE/REMOVE记录会在重放时丢失
+    std::vector<SmartSegment> drop_segments;
+    int64_t oldest_id = 0;
+    size_t segment_num = 0;
+    {
+        std::lock_guard<bthread::Mutex> lock(_index_mutex);
+        while (!_segments.empty()) {
+            SmartSegment oldest = _segments.begin()->second;
+            if (oldest == _active || oldest->live_count > 0) {
+                break;
+            }
+            drop_segments.push_back(oldest);
+            _segments.erase(_segments.begin());
+        }
+        oldest_id = _segments.begin()->first;
+        segment_num = _segments.size();
+    }
+    for (auto& segment : drop_segments) {
+        if (unlink(segment->path.c_str()) != 0) {
+            DB_WARNING("unlink segment fail, path: %s, err: %s",
+                    segment->path.c_str(), strerror(errno));
+        } else {
+            DB_WARNING("remove segment: %s", segment->path.c_str());
+        }
+    }
+    if (segment_num <= (size_t)FLAGS_raft_log_segment_max_num) {
+        return;
+    }
+    // 长期不做snapshot的region会让最老的segment一直无法删除，把这些region的日志重写到新segment
+    std::vector<int64_t> region_ids;
+    {
+        std::lock_guard<bthread::Mutex> lock(_index_mutex);
+        for (auto& pair : _region_logs) {
+            for (auto& location : pair.second.locations) {
+                if (location.segment_id == oldest_id) {
+                    region_ids.push_back(pair.first);
+                    break;
+                }
+            }
+        }
+    }
+    for (auto region_id : region_ids) {
+        if (_shutdown) {
+            break;
+        }
+        if (rewrite_region(region_id) != 0) {
+            DB_WARNING("rewrite raft log fail, region_id: %ld", region_id);
+            break;
+        }
+    }
+}
+
+static int parse_segment_log_uri(const std::string& uri, int64_t* region_id) {
+    size_t pos = uri.find("id=");
+    if (pos == 0 || pos == std::string::npos) {
+        return -1;
+    }
+    try {
+        *region_id = boost::lexical_cast<int64_t>(uri.substr(pos + 3));
+    } catch (boost::bad_lexical_cast&) {
+        return -1;
+    }
+    return 0;
+}
+
+braft::LogStorage* SegmentLogStorage::new_instance(const std::string& uri) const {
+    RocksWrapper* rocksdb = RocksWrapper::get_instance();
+    if (rocksdb == NULL) {
+        DB_FATAL("rocksdb is not set");
+        return NULL;
+    }
+    int64_t region_id = 0;
+    if (parse_segment_log_uri(uri, &region_id) != 0) {
+        DB_FATAL("parse uri fail, uri:%s", uri.c_str());
+        return NULL;
+    }
+    rocksdb::ColumnFamilyHandle* raftlog_handle = rocksdb->get_raft_log_handle();
+    if (raftlog_handle == NULL) {
+        DB_FATAL("get raft log handle from rocksdb fail,uri:%s, region_id: %ld",
+                uri.c_str(), region_id);
+        return NULL;
+    }
+    if (SegmentLogEngine::get_instance()->init() != 0) {
+        DB_FATAL("segment log engine init fail, region_id: %ld", region_id);
+        return NULL;
+    }
+    braft::LogStorage* instance = new(std::nothrow) SegmentLogStorage(region_id, rocksdb, raftlog_handle);
+    if (instance == NULL) {
+        DB_FATAL("new log_storage instance fail, region_id: %ld", region_id);
+    }
+    RaftLogCompactionFilter::get_instance()->update_first_index_map(region_id, 0);
+    return instance;
+}
+
+SegmentLogStorage::~SegmentLogStorage() {
+    if (_cache != nullptr) {
+        LogEntryCache::get_instance()->unregister_region(_region_id, _cache);
+    }
+}
+
+std::string SegmentLogStorage::log_meta_key() {
+    MutTableKey key;
+    key.append_i64(_region_id).append_u8(MyRaftLogStorage::LOG_META_IDENTIFY);
+    return key.data();
+}
+
+int SegmentLogStorage::load_first_log_index(int64_t* first_log_index) {
+    std::string key = log_meta_key();
+    std::string value;
+    rocksdb::Status status = _db->get(rocksdb::ReadOptions(), _raftlog_handle, key, &value);
+    if (status.IsNotFound()) {
+        *first_log_index = 1;
+        rocksdb::WriteOptions write_option;
+        write_option.sync = true;
+        status = _db->put(write_option, _raftlog_handle, key,
+                rocksdb::Slice((char*)first_log_index, sizeof(int64_t)));
+        if (!status.ok()) {
+            DB_WARNING("update first log index to rocksdb fail, region_id: %ld, err_mes:%s",
+                    _region_id, status.ToString().c_str());
+            return -1;
+        }
+        return 0;
+    }
+    if (!status.ok() || value.size() != sizeof(int64_t)) {
+        DB_FATAL("read log meta info from rocksdb wrong, region_id: %ld, err_mes:%s",
+                _region_id, status.ToString().c_str());
+        return -1;
+    }
+    *first_log_index = *(int64_t*)value.data();
+    DB_WARNING("region_id: %ld is old, first_log_index:%ld", _region_id, *first_log_index);
+    return 0;
+}
+
+// raft_log_cf中还有该region的日志(从myraftlog切换过来)，整体搬到segment后再删除
+// 中途失败重启后会重新迁移
+int SegmentLogStorage::migrate_from_rocksdb(int64_t first_log_index) {
+    TimeCost cost;
+    MutTableKey start_key;
+    MutTableKey end_key;
+    start_key.append_i64(_region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY)
+            .append_i64(first_log_index);
+    end_key.append_i64(_region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY + 1);
+    rocksdb::ReadOptions opt;
+    opt.prefix_same_as_start = true;
+    opt.total_order_seek = false;
+    opt.fill_cache = false;
+    std::unique_ptr<rocksdb::Iterator> iter(_db->new_iterator(opt, _raftlog_handle));
+    iter->Seek(start_key.data());
+    if (!iter->Valid() || !iter->key().starts_with(rocksdb::Slice(start_key.data().data(),
+            MyRaftLogStorage::LOG_META_KEY_SIZE))) {
+        return 0;
+    }
+    if (_engine->remove_region(_region_id) != 0) {
+        return -1;
+    }
+    int64_t expected_index = first_log_index;
+    int64_t count = 0;
+    std::vector<LogRecord> records;
+    for (; iter->Valid(); iter->Next()) {
+        rocksdb::Slice key = iter->key();
+        if (!key.starts_with(rocksdb::Slice(start_key.data().data(),
+                MyRaftLogStorage::LOG_META_KEY_SIZE))) {
+            break;
+        }
+        int64_t index = TableKey(key).extract_i64(sizeof(int64_t) + 1);
+        rocksdb::Slice value = iter->value();
+        if (index != expected_index || value.size() < MyRaftLogStorage::LOG_HEAD_SIZE) {
+            DB_FATAL("Found a hole in region_id: %ld, expected_index:%ld, real_index:%ld",
+                    _region_id, expected_index, index);
+            return -1;
+        }
+        LogHead head(value);
+        value.remove_prefix(MyRaftLogStorage::LOG_HEAD_SIZE);
+        records.emplace_back();
+        LogRecord& record = records.back();
+        record.type = head.type;
+        record.region_id = _region_id;
+        record.index = index;
+        record.term = head.term;
+        record.data.append(value.data(), value.size());
+        if (records.size() >= 1000) {
+            if (_engine->append(_region_id, records) != 0) {
+                return -1;
+            }
+            records.clear();
+        }
+        ++expected_index;
+        ++count;
+    }
+    if (!iter->status().ok()) {
+        DB_FATAL("Fail to iterate rocksdb, region_id: %ld", _region_id);
+        return -1;
+    }
+    if (!records.empty() && _engine->append(_region_id, records) != 0) {
+        return -1;
+    }
+    // segment已经落盘，删除rocksdb中的日志
+    MutTableKey remove_start;
+    remove_start.append_i64(_region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY);
+    auto status = _db->remove_range(rocksdb::WriteOptions(), _raftlog_handle,
+            remove_start.data(), end_key.data(), true);
+    if (!status.ok()) {
+        DB_WARNING("remove migrated log fail, region_id: %ld, err_mes:%s",
+                _region_id, status.ToString().c_str());
+        return -1;
+    }
+    DB_WARNING("migrate raft log from rocksdb, region_id: %ld, first_log_index: %ld, count: %ld, "
+            "time_cost: %ld", _region_id, first_log_index, count, cost.get_time());
+    return 0;
+}
+
+int SegmentLogStorage::init(braft::ConfigurationManager* configuration_manager) {
+    TimeCost time_cost;
+    int64_t first_log_index = 1;
+    if (load_first_log_index(&first_log_index) != 0) {
+        return -1;
+    }
+    if (migrate_from_rocksdb(first_log_index) != 0) {
+        return -1;
+    }
+    std::vector<LogLocation> locations;
+    if (_engine->attach_region(_region_id, first_log_index, &locations) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < locations.size(); ++i) {
+        int64_t index = first_log_index + i;
+        if (_term_map.append(braft::LogId(index, locations[i].term)) != 0) {
+            DB_FATAL("fail to append term_map, region_id: %ld, index:%ld, term:%ld",
+                    _region_id, index, locations[i].term);
+            return -1;
+        }
+        if (locations[i].type != braft::ENTRY_TYPE_CONFIGURATION) {
+            continue;
+        }
+        LogLocation location;
+        butil::IOBuf data;
+        scoped_refptr<braft::LogEntry> entry = new braft::LogEntry();
+        entry->id = braft::LogId(index, locations[i].term);
+        if (_engine->read(_region_id, index, &location, &data) != 0
+                || parse_meta(entry, data) != 0) {
+            DB_FATAL("Fail to parse meta at index:%ld, region_id: %ld", index, _region_id);
+            return -1;
+        }
+        braft::ConfigurationEntry conf_entry;
+        conf_entry.id = entry->id;
+        conf_entry.conf = *(entry->peers);
+        if (entry->old_peers) {
+            conf_entry.old_conf = *(entry->old_peers);
+        }
+        configuration_manager->add(conf_entry);
+    }
+    _first_log_index.store(first_log_index);
+    _last_log_index.store(first_log_index + (int64_t)locations.size() - 1);
+    _cache = LogEntryCache::get_instance()->register_region(_region_id);
+    RaftLogCompactionFilter::get_instance()->update_first_index_map(_region_id, first_log_index);
+    DB_WARNING("region_id: %ld, first_log_index:%ld, last_log_index:%ld, time_cost: %ld",
+            _region_id, _first_log_index.load(), _last_log_index.load(), time_cost.get_time());
+    return 0;
+}
+
+int SegmentLogStorage::parse_meta(braft::LogEntry* entry, const butil::IOBuf& data) {
+    braft::ConfigurationPBMeta meta;
+    butil::IOBufAsZeroCopyInputStream wrapper(data);
+    if (!meta.ParseFromZeroCopyStream(&wrapper)) {
+        DB_FATAL("Fail to parse ConfigurationPBMeta, region_id: %ld", _region_id);
+        return -1;
+    }
+    entry->peers = new std::vector<braft::PeerId>;
+    for (int j = 0; j < meta.peers_size(); ++j) {
+        entry->peers->push_back(braft::PeerId(meta.peers(j)));
+    }
+    if (meta.old_peers_size() > 0) {
+        entry->old_peers = new std::vector<braft::PeerId>;
+        for (int i = 0; i < meta.old_peers_size(); i++) {
+            entry->old_peers->push_back(braft::PeerId(meta.old_peers(i)));
+        }
+    }
+    return 0;
+}
+
+braft::LogEntry* SegmentLogStorage::get_entry(const int64_t index) {
+    if (_cache != nullptr) {
+        braft::LogEntry* entry = _cache->get_entry(index);
+        if (entry != NULL) {
+            return entry;
+        }
+    }
+    LogLocation location;
+    butil::IOBuf data;
+    if (_engine->read(_region_id, index, &location, &data) != 0) {
+        DB_WARNING("get index:%ld from segment fail, region_id: %ld", index, _region_id);
+        return NULL;
+    }
+    braft::LogEntry* entry = new braft::LogEntry;
+    entry->AddRef();
+    entry->type = (braft::EntryType)location.type;
+    entry->id = braft::LogId(index, location.term);
+    switch (entry->type) {
+        case braft::ENTRY_TYPE_DATA:
+            entry->data.swap(data);
+            break;
+        case braft::ENTRY_TYPE_CONFIGURATION:
+            if (parse_meta(entry, data) != 0) {
+                entry->Release();
+                entry = NULL;
+            }
+            break;
+        case braft::ENTRY_TYPE_NO_OP:
+            if (!data.empty()) {
+                DB_FATAL("Data of NO_OP must be empty, log index:%ld of region id:%ld ",
+                        index, _region_id);
+                entry->Release();
+                entry = NULL;
+            }
+            break;
+        default:
+            DB_FATAL("Unknown entry type, log index:%ld of region id:%ld", index, _region_id);
+            entry->Release();
+            entry = NULL;
+            break;
+    }
+    return entry;
+}
+
+int64_t SegmentLogStorage::get_term(const int64_t index) {
+    std::lock_guard<bthread::Mutex> lock(_mutex);
+    if (index < _first_log_index.load() || index > _last_log_index.load()) {
+        return 0;
+    }
+    return _term_map.get_term(index);
+}
+
+int SegmentLogStorage::build_record(const braft::LogEntry* entry, LogRecord* record) {
+    record->kind = LogRecord::ENTRY;
+    record->type = entry->type;
+    record->region_id = _region_id;
+    record->index = entry->id.index;
+    record->term = entry->id.term;
+    switch (entry->type) {
+        case braft::ENTRY_TYPE_DATA:
+            record->data = entry->data;
+            break;
+        case braft::ENTRY_TYPE_CONFIGURATION: {
+            braft::ConfigurationPBMeta meta;
+            for (auto& peer : *entry->peers) {
+                meta.add_peers(peer.to_string());
+            }
+            if (entry->old_peers) {
+                for (auto& peer : *entry->old_peers) {
+                    meta.add_old_peers(peer.to_string());
+                }
+            }
+            butil::IOBufAsZeroCopyOutputStream wrapper(&record->data);
+            if (!meta.SerializeToZeroCopyStream(&wrapper)) {
+                DB_FATAL("Fail to serialize meta, region_id: %ld", _region_id);
+                return -1;
+            }
+            break;
+        }
+        case braft::ENTRY_TYPE_NO_OP:
+            break;
+        default:
+            DB_FATAL("Unknown type:%d, region_id: %ld", entry->type, _region_id);
+            return -1;
+    }
+    return 0;
+}
+
+int SegmentLogStorage::append_entry(const braft::LogEntry* entry) {
+    std::vector<braft::LogEntry*> entries;
+    entries.push_back(const_cast<braft::LogEntry*>(entry));
+    return append_entries(entries, nullptr) == 1 ? 0 : -1;
+}
+
+int SegmentLogStorage::append_entries(const std::vector<braft::LogEntry*>& entries,
+        braft::IOMetric* metric) {
+    if (entries.empty()) {
+        return 0;
+    }
+    if (_last_log_index.load() + 1 != entries.front()->id.index) {
+        DB_FATAL("There's gap betwenn appending entries and _last_log_index,"
+                " last_log_index: %ld, entry_log_index: %ld, term:%ld region_id: %ld",
+                _last_log_index.load(), entries.front()->id.index,
+                entries.front()->id.term, _region_id);
+        return -1;
+    }
+    // 与rocksdb写入共用统计
+    TimeCost time_cost;
+    std::vector<LogRecord> records(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (build_record(entries[i], &records[i]) != 0) {
+            return -1;
+        }
+    }
+    if (_engine->append(_region_id, records) != 0) {
+        DB_FATAL("Fail to write segment, region_id: %ld", _region_id);
+        return -1;
+    }
+    RocksdbVars::get_instance()->rocksdb_put_time << time_cost.get_time();
+    RocksdbVars::get_instance()->rocksdb_put_count << 1;
+    {
+        std::lock_guard<bthread::Mutex> lock(_mutex);
+        for (auto entry : entries) {
+            if (_term_map.append(entry->id) != 0) {
+                DB_FATAL("Fail to update _term_map, region_id: %ld", _region_id);
+                _term_map.truncate_suffix(_last_log_index.load());
+                return -1;
+            }
+        }
+        _last_log_index.fetch_add(entries.size());
+    }
+    if (_cache != nullptr) {
+        _cache->append(entries);
+    }
+    return (int)entries.size();
+}
+
+int SegmentLogStorage::truncate_prefix(const int64_t first_index_kept) {
+    if (first_index_kept <= _first_log_index.load()) {
+        return 0;
+    }
+    DB_WARNING("Truncating region_id: %ld to first index kept:%ld from first log index:%ld",
+            _region_id, first_index_kept, _first_log_index.load());
+    _first_log_index.store(first_index_kept);
+    if (first_index_kept > _last_log_index.load()) {
+        _last_log_index.store(first_index_kept - 1);
+    }
+    {
+        std::lock_guard<bthread::Mutex> lock(_mutex);
+        _term_map.truncate_prefix(first_index_kept);
+    }
+    if (_cache != nullptr) {
+        _cache->truncate_prefix(first_index_kept);
+    }
+    CanAddPeerSetter::get_instance()->set_can_add_peer(_region_id);
+    // segment按first_log_index裁剪，先持久化，否则segment删除后重启会出现空洞
+    rocksdb::WriteOptions write_option;
+    write_option.sync = true;
+    auto status = _db->put(write_option, _raftlog_handle, log_meta_key(),
+            rocksdb::Slice((char*)&first_index_kept, sizeof(int64_t)));
+    if (!status.ok()) {
+        DB_WARNING("update first log index to rocksdb fail, region_id: %ld, err_mes:%s",
+                _region_id, status.ToString().c_str());
+        return -1;
+    }
+    _engine->truncate_prefix(_region_id, first_index_kept);
+    return 0;
+}
+
+int SegmentLogStorage::truncate_suffix(const int64_t last_index_kept) {
+    std::unique_lock<bthread::Mutex> lck(_mutex);
+    const int64_t last_log_index = _last_log_index.load();
+    if (last_index_kept >= last_log_index) {
+        return 0;
+    }
+    _term_map.truncate_suffix(last_index_kept);
+    _last_log_index.store(last_index_kept);
+    lck.unlock();
+    if (_cache != nullptr) {
+        _cache->truncate_suffix(last_index_kept);
+    }
+    DB_WARNING("Truncating region_id: %ld to last index kept:%ld from last log index:%ld",
+            _region_id, last_index_kept, last_log_index);
+    if (_engine->truncate_suffix(_region_id, last_index_kept) != 0) {
+        DB_FATAL("Fail to truncate segment, region_id: %ld", _region_id);
+        return -1;
+    }
+    return 0;
+}
+
+int SegmentLogStorage::reset(const int64_t next_log_index) {
+    DB_WARNING("Reseting region_id: %ld to next log index :%ld", _region_id, next_log_index);
+    if (truncate_prefix(next_log_index) != 0) {
+        return -1;
+    }
+    if (truncate_suffix(next_log_index - 1) != 0) {
+        return -1;
+    }
+    if (_cache != nullptr) {
+        _cache->clear();
+    }
+    std::lock_guard<bthread::Mutex> lock(_mutex);
+    _term_map.reset();
+    return 0;
+}
+
+} // namespace baikaldb
+
+/* vim: set expandtab ts=4 sw=4 sts=4 tw=100: */
@@ -0,0 +1,188 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "arrow_row_codec.h"
+#ifdef SNAPPY
+#undef SNAPPY
+#endif
+#ifdef LZ4
+#undef LZ4
+#endif
+#ifdef ZSTD
+#undef ZSTD
+#endif
+#include <arrow/api.h>
+#include <arrow/buffer.h>
+#include <arrow/io/memory.h>
+#include <arrow/ipc/reader.h>
+#include <arrow/ipc/writer.h>
+#include "mem_row_descriptor.h"
+
+namespace baikaldb {
+static std::shared_ptr<arrow::DataType> arrow_type(ColumnStorage storage) {
+    switch (storage) {
+        case COL_INT:
+            return arrow::int64();
+        case COL_UINT:
+            return arrow::uint64();
+        case COL_DOUBLE:
+            return arrow::float64();
+        default:
+            return arrow::binary();
+    }
+}
+
+template <typename Builder, typename T>
+static arrow::Status build_array(const T* data, size_t size, const std::vector<uint8_t>& valid,
+        std::shared_ptr<arrow::Array>* out) {
+    Builder builder(arrow::default_memory_pool());
+    auto status = builder.AppendValues(data, size, valid.data());
+    if (!status.ok()) {
+        return status;
+    }
+    return builder.Finish(out);
+}
+
+int ArrowRowCodec::init(const std::vector<const pb::TupleDescriptor*>& tuples) {
+    std::vector<std::shared_ptr<arrow::Field>> fields;
+    for (auto tuple : tuples) {
+        for (auto& slot : tuple->slots()) {
+            int idx = _columns.add_column(tuple->tuple_id(), slot.slot_id(), slot.slot_type());
+            if (idx < 0) {
+                return -1;
+            }
+            std::string name = std::to_string(tuple->tuple_id()) + "_" +
+                std::to_string(slot.slot_id());
+            fields.emplace_back(arrow::field(name, arrow_type(column_storage(slot.slot_type()))));
+        }
+    }
+    _schema = std::make_shared<arrow::Schema>(fields);
+    return 0;
+}
+
+int ArrowRowCodec::serialize(std::string* out) {
+    size_t num_rows = _columns.num_rows();
+    std::vector<std::shared_ptr<arrow::Array>> arrays;
+    std::vector<uint8_t> valid(num_rows);
+    for (size_t i = 0; i < _columns.num_columns(); i++) {
+        ColumnVector* col = _columns.column(i);
+        const uint8_t* null_map = col->null_map();
+        for (size_t row = 0; row < num_rows; row++) {
+            valid[row] = !null_map[row];
+        }
+        std::shared_ptr<arrow::Array> array;
+        arrow::Status status;
+        switch (col->storage()) {
+            case COL_INT:
+                status = build_array<arrow::Int64Builder>(col->int_data(), num_rows, valid, &array);
+                break;
+            case COL_UINT:
+                status = build_array<arrow::UInt64Builder>(col->uint_data(), num_rows, valid, &array);
+                break;
+            case COL_DOUBLE:
+                status = build_array<arrow::DoubleBuilder>(col->double_data(), num_rows, valid, &array);
+                break;
+            default: {
+                arrow::BinaryBuilder builder(arrow::default_memory_pool());
+                const std::vector<std::string>& data = col->string_data();
+                for (size_t row = 0; row < num_rows && status.ok(); row++) {
+                    if (valid[row]) {
+                        status = builder.Append(data[row]);
+                    } else {
+                        status = builder.AppendNull();
+                    }
+                }
+                if (status.ok()) {
+                    status = builder.Finish(&array);
+                }
+                break;
+            }
+        }
+        if (!status.ok()) {
+            DB_WARNING("build arrow array fail: %s", status.ToString().c_str());
+            return -1;
+        }
+        arrays.emplace_back(array);
+    }
+    auto record_batch = arrow::RecordBatch::Make(_schema, num_rows, arrays);
+    std::shared_ptr<arrow::Buffer> buffer;
+    auto status = arrow::ipc::SerializeRecordBatch(*record_batch, arrow::default_memory_pool(), &buffer);
+    if (!status.ok()) {
+        DB_WARNING("serialize record batch fail: %s", status.ToString().c_str());
+        return -1;
+    }
+    out->assign((const char*)buffer->data(), buffer->size());
+    _columns.clear();
+    return 0;
+}
+
+int ArrowRowCodec::deserialize(const std::string& in, MemRowDescriptor* desc, RowBatch* batch) {
+    // BufferReader不拷贝数据，数组直接指向in
+    arrow::io::BufferReader reader((const uint8_t*)in.data(), in.size());
+    std::shared_ptr<arrow::RecordBatch> record_batch;
+    auto status = arrow::ipc::ReadRecordBatch(_schema, nullptr, &reader, &record_batch);
+    if (!status.ok()) {
+        DB_WARNING("read record batch fail: %s", status.ToString().c_str());
+        return -1;
+    }
+    if ((size_t)record_batch->num_columns() != _columns.num_columns()) {
+        DB_WARNING("column size diff, %d vs %lu", record_batch->num_columns(), _columns.num_columns());
+        return -1;
+    }
+    size_t num_rows = record_batch->num_rows();
+    _columns.resize(num_rows);
+    for (size_t i = 0; i < _columns.num_columns(); i++) {
+        ColumnVector* col = _columns.column(i);
+        const arrow::Array* array = record_batch->column(i).get();
+        uint8_t* null_map = col->mutable_null_map();
+        for (size_t row = 0; row < num_rows; row++) {
+            null_map[row] = array->IsNull(row);
+        }
+        switch (col->storage()) {
+            case COL_INT:
+                memcpy(col->mutable_int_data(),
+                        static_cast<const arrow::Int64Array*>(array)->raw_values(),
+                        num_rows * sizeof(int64_t));
+                break;
+            case COL_UINT:
+                memcpy(col->mutable_uint_data(),
+                        static_cast<const arrow::UInt64Array*>(array)->raw_values(),
+                        num_rows * sizeof(uint64_t));
+                break;
+            case COL_DOUBLE:
+                memcpy(col->mutable_double_data(),
+                        static_cast<const arrow::DoubleArray*>(array)->raw_values(),
+                        num_rows * sizeof(double));
+                break;
+            default: {
+                auto binary = static_cast<const arrow::BinaryArray*>(array);
+                std::vector<std::string>* data = col->mutable_string_data();
+                for (size_t row = 0; row < num_rows; row++) {
+                    if (!null_map[row]) {
+                        int32_t len = 0;
+                        const uint8_t* ptr = binary->GetValue(row, &len);
+                        (*data)[row].assign((const char*)ptr, len);
+                    }
+                }
+                break;
+            }
+        }
+    }
+    int ret = _columns.to_row_batch(desc, batch);
+    _columns.clear();
+    return ret;
+}
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -0,0 +1,415 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "column_batch.h"
+#include "expr_node.h"
+#include "message_helper.h"
+#include "mem_row_descriptor.h"
+
+namespace baikaldb {
+using google::protobuf::FieldDescriptor;
+using google::protobuf::Message;
+using google::protobuf::Reflection;
+
+// 字段的原始类型，和MessageHelper::get_value返回的类型一致
+static pb::PrimitiveType field_primitive_type(const FieldDescriptor* field) {
+    switch (field->cpp_type()) {
+        case FieldDescriptor::CPPTYPE_INT32:
+            return pb::INT32;
+        case FieldDescriptor::CPPTYPE_UINT32:
+            return pb::UINT32;
+        case FieldDescriptor::CPPTYPE_INT64:
+            return pb::INT64;
+        case FieldDescriptor::CPPTYPE_UINT64:
+            return pb::UINT64;
+        case FieldDescriptor::CPPTYPE_FLOAT:
+            return pb::FLOAT;
+        case FieldDescriptor::CPPTYPE_DOUBLE:
+            return pb::DOUBLE;
+        case FieldDescriptor::CPPTYPE_BOOL:
+            return pb::BOOL;
+        case FieldDescriptor::CPPTYPE_STRING:
+            return pb::STRING;
+        default:
+            return pb::INVALID_TYPE;
+    }
+}
+
+void ColumnVector::append_null() {
+    _null_map.push_back(1);
+    switch (_storage) {
+        case COL_INT:
+            _int_data.push_back(0);
+            break;
+        case COL_UINT:
+            _uint_data.push_back(0);
+            break;
+        case COL_DOUBLE:
+            _double_data.push_back(0);
+            break;
+        case COL_STRING:
+            _string_data.emplace_back();
+            break;
+        default:
+            break;
+    }
+}
+
+void ColumnVector::append_value(const ExprValue& value) {
+    if (value.is_null()) {
+        append_null();
+        return;
+    }
+    ExprValue tmp = value;
+    tmp.cast_to(_type);
+    switch (_storage) {
+        case COL_INT:
+            append_int(tmp.get_numberic<int64_t>());
+            break;
+        case COL_UINT:
+            append_uint(tmp.get_numberic<uint64_t>());
+            break;
+        case COL_DOUBLE:
+            append_double(tmp.get_numberic<double>());
+            break;
+        case COL_STRING:
+            append_string(tmp.str_val);
+            break;
+        default:
+            append_null();
+            break;
+    }
+}
+
+void ColumnVector::append_field(const Message* tuple, const FieldDescriptor* field) {
+    const Reflection* reflection = tuple->GetReflection();
+    if (!reflection->HasField(*tuple, field)) {
+        append_null();
+        return;
+    }
+    pb::PrimitiveType field_type = field_primitive_type(field);
+    // cast到列类型不会改变值时直接取，否则走ExprValue保证和SlotRef结果一致
+    bool direct = column_storage(field_type) == _storage &&
+        (_storage == COL_STRING || get_num_size(field_type) <= get_num_size(_type));
+    if (!direct) {
+        append_value(MessageHelper::get_value(field, const_cast<Message*>(tuple)));
+        return;
+    }
+    switch (field->cpp_type()) {
+        case FieldDescriptor::CPPTYPE_INT32:
+            append_int(reflection->GetInt32(*tuple, field));
+            break;
+        case FieldDescriptor::CPPTYPE_INT64:
+            append_int(reflection->GetInt64(*tuple, field));
+            break;
+        case FieldDescriptor::CPPTYPE_BOOL:
+            append_int(reflection->GetBool(*tuple, field));
+            break;
+        case FieldDescriptor::CPPTYPE_UINT32:
+            append_uint(reflection->GetUInt32(*tuple, field));
+            break;
+        case FieldDescriptor::CPPTYPE_UINT64:
+            append_uint(reflection->GetUInt64(*tuple, field));
+            break;
+        case FieldDescriptor::CPPTYPE_FLOAT:
+            append_double(reflection->GetFloat(*tuple, field));
+            break;
+        case FieldDescriptor::CPPTYPE_DOUBLE:
+            append_double(reflection->GetDouble(*tuple, field));
+            break;
+        case FieldDescriptor::CPPTYPE_STRING: {
+            std::string tmp;
+            append_string(reflection->GetStringReference(*tuple, field, &tmp));
+            break;
+        }
+        default:
+            append_null();
+            break;
+    }
+}
+
+ExprValue ColumnVector::get_value(size_t idx) const {
+    if (idx >= size() || is_null(idx)) {
+        return ExprValue::Null();
+    }
+    ExprValue value(_type);
+    switch (_type) {
+        case pb::BOOL:
+            value._u.bool_val = _int_data[idx];
+            break;
+        case pb::INT8:
+            value._u.int8_val = _int_data[idx];
+            break;
+        case pb::INT16:
+            value._u.int16_val = _int_data[idx];
+            break;
+        case pb::INT32:
+        case pb::TIME:
+            value._u.int32_val = _int_data[idx];
+            break;
+        case pb::INT64:
+            value._u.int64_val = _int_data[idx];
+            break;
+        case pb::UINT8:
+            value._u.uint8_val = _uint_data[idx];
+            break;
+        case pb::UINT16:
+            value._u.uint16_val = _uint_data[idx];
+            break;
+        case pb::UINT32:
+        case pb::DATE:
+        case pb::TIMESTAMP:
+            value._u.uint32_val = _uint_data[idx];
+            break;
+        case pb::UINT64:
+        case pb::DATETIME:
+            value._u.uint64_val = _uint_data[idx];
+            break;
+        case pb::FLOAT:
+            value._u.float_val = _double_data[idx];
+            break;
+        case pb::DOUBLE:
+            value._u.double_val = _double_data[idx];
+            break;
+        case pb::STRING:
+        case pb::HEX:
+            value.str_val = _string_data[idx];
+            break;
+        default:
+            return ExprValue::Null();
+    }
+    return value;
+}
+
+static bool is_pure_numeric(pb::PrimitiveType type) {
+    return type == pb::BOOL || is_int(type) || is_double(type);
+}
+
+bool ColumnVector::can_share_storage(pb::PrimitiveType type) const {
+    if (type == _type) {
+        return true;
+    }
+    return column_storage(type) == _storage && is_pure_numeric(_type) &&
+        (type == pb::INT64 || type == pb::UINT64 || type == pb::DOUBLE);
+}
+
+template <typename SRC, typename DST>
+static void cast_numeric(const SRC* in, DST* out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = static_cast<DST>(in[i]);
+    }
+}
+
+template <typename SRC>
+static void cast_numeric_to_bool(const SRC* in, int64_t* out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (in[i] != 0);
+    }
+}
+
+int ColumnVector::cast_to(pb::PrimitiveType type, ColumnVector* out) const {
+    if (out->init(type) < 0) {
+        return -1;
+    }
+    size_t n = size();
+    // 同类型，或者纯数值转成64位数值/bool，按列直接转换
+    bool direct = (type == _type) || (is_pure_numeric(_type) &&
+        (type == pb::INT64 || type == pb::UINT64 || type == pb::DOUBLE || type == pb::BOOL));
+    if (!direct) {
+        out->reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            out->append_value(get_value(i));
+        }
+        return 0;
+    }
+    out->resize(n);
+    std::copy(_null_map.begin(), _null_map.end(), out->_null_map.begin());
+    if (type == _type) {
+        out->_int_data = _int_data;
+        out->_uint_data = _uint_data;
+        out->_double_data = _double_data;
+        out->_string_data = _string_data;
+        out->_used_size = _used_size;
+        return 0;
+    }
+    if (type == pb::BOOL) {
+        switch (_storage) {
+            case COL_INT:
+                cast_numeric_to_bool(_int_data.data(), out->mutable_int_data(), n);
+                break;
+            case COL_UINT:
+                cast_numeric_to_bool(_uint_data.data(), out->mutable_int_data(), n);
+                break;
+            case COL_DOUBLE:
+                cast_numeric_to_bool(_double_data.data(), out->mutable_int_data(), n);
+                break;
+            default:
+                return -1;
+        }
+        return 0;
+    }
+#define CAST_COLUMN(DST_DATA) \
+    switch (_storage) { \
+        case COL_INT: \
+            cast_numeric(_int_data.data(), out->DST_DATA(), n); \
+            break; \
+        case COL_UINT: \
+            cast_numeric(_uint_data.data(), out->DST_DATA(), n); \
+            break; \
+        case COL_DOUBLE: \
+            cast_numeric(_double_data.data(), out->DST_DATA(), n); \
+            break; \
+        default: \
+            return -1; \
+    }
+    switch (out->storage()) {
+        case COL_INT:
+            CAST_COLUMN(mutable_int_data);
+            break;
+        case COL_UINT:
+            CAST_COLUMN(mutable_uint_data);
+            break;
+        case COL_DOUBLE:
+            CAST_COLUMN(mutable_double_data);
+            break;
+        default:
+            return -1;
+    }
+#undef CAST_COLUMN
+    return 0;
+}
+
+int ColumnBatch::add_column(int32_t tuple_id, int32_t slot_id, pb::PrimitiveType type) {
+    auto key = std::make_pair(tuple_id, slot_id);
+    auto iter = _column_idx.find(key);
+    if (iter != _column_idx.end()) {
+        if (_columns[iter->second].column.type() != type) {
+            DB_WARNING("column type conflict, tuple_id:%d slot_id:%d type:%d vs %d",
+                    tuple_id, slot_id, _columns[iter->second].column.type(), type);
+            return -1;
+        }
+        return iter->second;
+    }
+    if (column_storage(type) == COL_INVALID) {
+        return -1;
+    }
+    ColumnSlot col;
+    col.tuple_id = tuple_id;
+    col.slot_id = slot_id;
+    col.column.init(type);
+    // 已有数据时，新列补齐null
+    for (size_t i = 0; i < _num_rows; i++) {
+        col.column.append_null();
+    }
+    _columns.push_back(std::move(col));
+    _column_idx[key] = _columns.size() - 1;
+    return _columns.size() - 1;
+}
+
+int ColumnBatch::add_slot_ref_columns(const std::vector<ExprNode*>& exprs) {
+    _expr_columns.clear();
+    for (auto expr : exprs) {
+        if (!expr->is_slot_ref()) {
+            return -1;
+        }
+        int idx = add_column(expr->tuple_id(), expr->slot_id(), expr->col_type());
+        if (idx < 0) {
+            return -1;
+        }
+        _expr_columns.push_back(idx);
+    }
+    return 0;
+}
+
+int ColumnBatch::append_row(MemRow* row) {
+    for (auto& col : _columns) {
+        Message* tuple = row->get_tuple(col.tuple_id);
+        if (tuple == nullptr) {
+            col.column.append_null();
+            continue;
+        }
+        const google::protobuf::Descriptor* descriptor = tuple->GetDescriptor();
+        if (col.field == nullptr || col.field->containing_type() != descriptor) {
+            if (col.slot_id < 1 || col.slot_id > descriptor->field_count()) {
+                DB_WARNING("invalid slot_id:%d tuple_id:%d", col.slot_id, col.tuple_id);
+                return -1;
+            }
+            col.field = descriptor->field(col.slot_id - 1);
+        }
+        col.column.append_field(tuple, col.field);
+    }
+    ++_num_rows;
+    return 0;
+}
+
+int ColumnBatch::append_rows(RowBatch* batch) {
+    reserve(_num_rows + batch->size());
+    for (size_t i = 0; i < batch->size(); i++) {
+        int ret = append_row(batch->get_row(i).get());
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+int ColumnBatch::to_row(size_t idx, MemRow* row) {
+    if (idx >= _num_rows) {
+        return -1;
+    }
+    for (auto& col : _columns) {
+        int ret = row->set_value(col.tuple_id, col.slot_id, col.column.get_value(idx));
+        if (ret < 0) {
+            DB_WARNING("set_value fail, tuple_id:%d slot_id:%d", col.tuple_id, col.slot_id);
+            return ret;
+        }
+    }
+    return 0;
+}
+
+int ColumnBatch::to_row_batch(MemRowDescriptor* desc, RowBatch* batch) {
+    for (size_t i = 0; i < _num_rows; i++) {
+        std::unique_ptr<MemRow> row = desc->fetch_mem_row();
+        int ret = to_row(i, row.get());
+        if (ret < 0) {
+            return ret;
+        }
+        batch->move_row(std::move(row));
+    }
+    return 0;
+}
+
+int64_t ColumnBatch::compare_row(size_t left, size_t right,
+        const std::vector<bool>& is_asc, const std::vector<bool>& is_null_first) const {
+    for (size_t i = 0; i < _expr_columns.size(); i++) {
+        const ColumnVector& column = _columns[_expr_columns[i]].column;
+        bool left_null = column.is_null(left);
+        bool right_null = column.is_null(right);
+        if (left_null && right_null) {
+            continue;
+        } else if (left_null) {
+            return is_null_first[i] ? -1 : 1;
+        } else if (right_null) {
+            return is_null_first[i] ? 1 : -1;
+        }
+        int64_t comp = column.compare(left, right);
+        if (comp != 0) {
+            return is_asc[i] ? comp : -comp;
+        }
+    }
+    return 0;
+}
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -0,0 +1,317 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "external_sorter.h"
+#include <boost/filesystem.hpp>
+#include <google/protobuf/io/coded_stream.h>
+#include "runtime_state.h"
+
+namespace baikaldb {
+DEFINE_int64(sort_spill_memory_bytes, 2147483648LL,
+        "sort memory budget per query, sorted runs spill to disk when exceeded, 0 means never spill");
+DEFINE_string(sort_spill_dir, "./sort_spill", "dir for sort spill files");
+DEFINE_int32(sort_spill_io_buffer_bytes, 1048576, "read/write buffer size of each sort spill file");
+
+static void append_varint32(std::string* out, uint32_t value) {
+    uint8_t buf[5];
+    uint8_t* end = google::protobuf::io::CodedOutputStream::WriteVarint32ToArray(value, buf);
+    out->append((char*)buf, end - buf);
+}
+
+int SortRunWriter::open(const std::string& path) {
+    _fs.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!_fs.is_open()) {
+        DB_WARNING("open sort spill file fail, path:%s", path.c_str());
+        return -1;
+    }
+    _buf.reserve(FLAGS_sort_spill_io_buffer_bytes);
+    return 0;
+}
+
+int SortRunWriter::append(MemRow* row) {
+    _row_buf.clear();
+    for (int32_t tuple_id = 0; tuple_id < row->tuple_size(); tuple_id++) {
+        auto tuple = row->get_tuple(tuple_id);
+        if (tuple == nullptr) {
+            continue;
+        }
+        append_varint32(&_row_buf, tuple->ByteSizeLong());
+        tuple->AppendToString(&_row_buf);
+    }
+    append_varint32(&_buf, _row_buf.size());
+    _buf.append(_row_buf);
+    ++_num_rows;
+    if ((int64_t)_buf.size() >= FLAGS_sort_spill_io_buffer_bytes) {
+        return flush();
+    }
+    return 0;
+}
+
+int SortRunWriter::flush() {
+    if (_buf.empty()) {
+        return 0;
+    }
+    _fs.write(_buf.data(), _buf.size());
+    if (!_fs.good()) {
+        DB_WARNING("write sort spill file fail, size:%lu", _buf.size());
+        return -1;
+    }
+    _file_size += _buf.size();
+    _buf.clear();
+    return 0;
+}
+
+int SortRunWriter::close() {
+    if (!_fs.is_open()) {
+        return 0;
+    }
+    int ret = flush();
+    _fs.close();
+    return ret;
+}
+
+int SortRunReader::open(const std::string& path, MemRowDescriptor* desc) {
+    _desc = desc;
+    _io_buf.reset(new char[FLAGS_sort_spill_io_buffer_bytes]);
+    _fs.rdbuf()->pubsetbuf(_io_buf.get(), FLAGS_sort_spill_io_buffer_bytes);
+    _fs.open(path, std::ios::in | std::ios::binary);
+    if (!_fs.is_open()) {
+        DB_WARNING("open sort spill file fail, path:%s", path.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+int SortRunReader::read_varint32(uint32_t* value) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        int c = _fs.get();
+        if (c == std::char_traits<char>::eof()) {
+            // 只允许在行边界结束
+            return shift == 0 ? 1 : -1;
+        }
+        result |= (uint32_t)(c & 0x7F) << shift;
+        if ((c & 0x80) == 0) {
+            *value = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int SortRunReader::next(std::unique_ptr<MemRow>* row) {
+    row->reset();
+    uint32_t row_len = 0;
+    int ret = read_varint32(&row_len);
+    if (ret == 1) {
+        return 0;
+    }
+    if (ret < 0) {
+        DB_WARNING("read sort spill file fail");
+        return -1;
+    }
+    _buf.resize(row_len);
+    _fs.read(&_buf[0], row_len);
+    if ((uint32_t)_fs.gcount() != row_len) {
+        DB_WARNING("sort spill file truncated, expect:%u read:%ld", row_len, _fs.gcount());
+        return -1;
+    }
+    std::unique_ptr<MemRow> tmp = _desc->fetch_mem_row();
+    google::protobuf::io::CodedInputStream input((const uint8_t*)_buf.data(), row_len);
+    for (int32_t tuple_id = 0; tuple_id < tmp->tuple_size(); tuple_id++) {
+        auto tuple = tmp->get_tuple(tuple_id);
+        if (tuple == nullptr) {
+            continue;
+        }
+        uint32_t tuple_len = 0;
+        if (!input.ReadVarint32(&tuple_len)) {
+            DB_WARNING("decode sort spill row fail, tuple_id:%d", tuple_id);
+            return -1;
+        }
+        int pos = input.CurrentPosition();
+        if (pos + tuple_len > row_len ||
+                !tuple->ParseFromArray(_buf.data() + pos, tuple_len)) {
+            DB_WARNING("decode sort spill row fail, tuple_id:%d", tuple_id);
+            return -1;
+        }
+        input.Skip(tuple_len);
+        tmp->update_used_size(tuple_len);
+    }
+    *row = std::move(tmp);
+    return 0;
+}
+
+ExternalSorter::~ExternalSorter() {
+    _readers.clear();
+    for (auto& path : _run_files) {
+        boost::system::error_code ec;
+        boost::filesystem::remove(path, ec);
+        if (ec) {
+            DB_WARNING("remove sort spill file fail, path:%s", path.c_str());
+        }
+    }
+}
+
+int ExternalSorter::add_batch(std::shared_ptr<RowBatch>& batch) {
+    int64_t used_bytes = batch->used_bytes_size();
+    _mem_batches.push_back(batch);
+    _mem_bytes += used_bytes;
+    if (FLAGS_sort_spill_memory_bytes > 0 && _mem_bytes > FLAGS_sort_spill_memory_bytes &&
+            !_comp->need_not_compare()) {
+        return spill_run();
+    }
+    return 0;
+}
+
+int ExternalSorter::spill_run() {
+    TimeCost cost;
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(FLAGS_sort_spill_dir, ec);
+    std::string path = FLAGS_sort_spill_dir + "/sort_" + std::to_string(_state->log_id()) + "_" +
+        std::to_string(butil::gettimeofday_us()) + "_" + std::to_string(butil::fast_rand()) +
+        "_" + std::to_string(_run_files.size());
+    // 先记录文件名，失败时析构函数也能清理
+    _run_files.push_back(path);
+    // 只归还上游计入过MemTracker的部分
+    int64_t charged_bytes = 0;
+    for (auto& batch : _mem_batches) {
+        for (size_t i = 0; i < batch->size(); i++) {
+            charged_bytes += batch->get_row(i)->release_charged_size();
+        }
+    }
+    Sorter sorter(_comp);
+    for (auto& batch : _mem_batches) {
+        sorter.add_batch(batch);
+    }
+    sorter.sort();
+    SortRunWriter writer;
+    if (writer.open(path) < 0) {
+        return -1;
+    }
+    bool eos = false;
+    while (!eos) {
+        RowBatch batch;
+        int ret = sorter.get_next(&batch, &eos);
+        if (ret < 0) {
+            return ret;
+        }
+        for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
+            ret = writer.append(batch.get_row().get());
+            if (ret < 0) {
+                return ret;
+            }
+        }
+    }
+    if (writer.close() < 0) {
+        return -1;
+    }
+    _mem_batches.clear();
+    // 落盘后的数据不再占用内存，归还给MemTracker
+    _state->memory_limit_release(charged_bytes);
+    _spill_rows += writer.num_rows();
+    _spill_bytes += writer.file_size();
+    DB_WARNING("log_id:%lu sort spill run:%lu rows:%ld mem_bytes:%ld file_bytes:%ld cost:%ld",
+            _state->log_id(), _run_files.size(), writer.num_rows(), _mem_bytes,
+            writer.file_size(), cost.get_time());
+    _mem_bytes = 0;
+    return 0;
+}
+
+int ExternalSorter::sort() {
+    _mem_sorter = std::make_shared<Sorter>(_comp);
+    for (auto& batch : _mem_batches) {
+        _mem_sorter->add_batch(batch);
+    }
+    _mem_batches.clear();
+    _mem_sorter->sort();
+    if (_run_files.empty()) {
+        return 0;
+    }
+    _readers.clear();
+    for (auto& path : _run_files) {
+        std::unique_ptr<SortRunReader> reader(new SortRunReader);
+        if (reader->open(path, _desc) < 0) {
+            return -1;
+        }
+        _readers.push_back(std::move(reader));
+    }
+    _mem_eos = _mem_sorter->batch_size() == 0;
+    _cur_rows.clear();
+    _cur_rows.resize(_readers.size() + 1);
+    for (size_t i = 0; i < _cur_rows.size(); i++) {
+        if (fetch_next(i) < 0) {
+            return -1;
+        }
+    }
+    _loser_tree.init(_cur_rows.size(), [this](int left, int right) {
+        return source_less(left, right);
+    });
+    return 0;
+}
+
+int ExternalSorter::fetch_next(size_t idx) {
+    if (idx < _readers.size()) {
+        return _readers[idx]->next(&_cur_rows[idx]);
+    }
+    _cur_rows[idx].reset();
+    while (_mem_batch.is_traverse_over()) {
+        if (_mem_eos) {
+            return 0;
+        }
+        _mem_batch.clear();
+        int ret = _mem_sorter->get_next(&_mem_batch, &_mem_eos);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    _cur_rows[idx] = std::move(_mem_batch.get_row());
+    _mem_batch.next();
+    return 0;
+}
+
+bool ExternalSorter::source_less(int left, int right) {
+    MemRow* left_row = _cur_rows[left].get();
+    MemRow* right_row = _cur_rows[right].get();
+    if (left_row == nullptr) {
+        return false;
+    }
+    if (right_row == nullptr) {
+        return true;
+    }
+    int64_t cmp = _comp->compare(left_row, right_row);
+    // 相等时按路号，保证是全序
+    return cmp < 0 || (cmp == 0 && left < right);
+}
+
+int ExternalSorter::get_next(RowBatch* batch, bool* eos) {
+    if (_run_files.empty()) {
+        return _mem_sorter->get_next(batch, eos);
+    }
+    while (!batch->is_full()) {
+        int idx = _loser_tree.top();
+        if (idx < 0 || _cur_rows[idx] == nullptr) {
+            *eos = true;
+            return 0;
+        }
+        batch->move_row(std::move(_cur_rows[idx]));
+        if (fetch_next(idx) < 0) {
+            return -1;
+        }
+        _loser_tree.adjust(idx);
+    }
+    return 0;
+}
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
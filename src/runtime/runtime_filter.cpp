@@ -0,0 +1,147 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime_filter.h"
+#include "column_batch.h"
+#include "key_encoder.h"
+
+namespace baikaldb {
+DEFINE_int32(runtime_filter_bits_per_key, 10, "bloom filter bits per key of join runtime filter");
+DEFINE_int64(runtime_filter_max_bits, 64 * 1024 * 1024, "max bloom filter bits of join runtime filter");
+
+int RuntimeFilter::init(pb::PrimitiveType type, int64_t expected_cnt) {
+    if (column_storage(type) == COL_INVALID) {
+        return -1;
+    }
+    _type = type;
+    int64_t bits_per_key = std::max(FLAGS_runtime_filter_bits_per_key, 1);
+    int64_t num_bits = std::max(expected_cnt, (int64_t)1) * bits_per_key;
+    num_bits = std::min(num_bits, FLAGS_runtime_filter_max_bits);
+    num_bits = std::max(num_bits, (int64_t)64);
+    _bits.assign((num_bits + 63) / 64, 0);
+    _num_bits = _bits.size() * 64;
+    // k = bits_per_key * ln2 时误判率最低
+    _num_hashes = std::min(std::max((int32_t)(bits_per_key * 0.69), 1), 30);
+    _num_values = 0;
+    _min_value = ExprValue::Null();
+    _max_value = ExprValue::Null();
+    return 0;
+}
+
+bool RuntimeFilter::type_match(pb::PrimitiveType left, pb::PrimitiveType right) {
+    if (left == right) {
+        return column_storage(left) != COL_INVALID;
+    }
+    return (is_signed(left) && is_signed(right)) || (is_uint(left) && is_uint(right));
+}
+
+uint64_t RuntimeFilter::value_hash(const ExprValue& value) const {
+    ExprValue tmp = value;
+    switch (column_storage(_type)) {
+        case COL_INT:
+            tmp.cast_to(pb::INT64);
+            break;
+        case COL_UINT:
+            tmp.cast_to(pb::UINT64);
+            break;
+        case COL_DOUBLE:
+            tmp.cast_to(pb::DOUBLE);
+            break;
+        default:
+            tmp.cast_to(pb::STRING);
+            break;
+    }
+    return tmp.hash();
+}
+
+void RuntimeFilter::insert(const ExprValue& value) {
+    if (value.is_null() || _num_bits == 0) {
+        return;
+    }
+    uint64_t h = value_hash(value);
+    uint64_t delta = (h >> 33) | (h << 31);
+    for (int32_t i = 0; i < _num_hashes; i++) {
+        uint64_t pos = h % _num_bits;
+        _bits[pos >> 6] |= (1ULL << (pos & 63));
+        h += delta;
+    }
+    ExprValue tmp = value;
+    tmp.cast_to(_type);
+    if (_min_value.is_null() || tmp.compare(_min_value) < 0) {
+        _min_value = tmp;
+    }
+    if (_max_value.is_null() || tmp.compare(_max_value) > 0) {
+        _max_value = tmp;
+    }
+    ++_num_values;
+}
+
+void RuntimeFilter::to_pb(int32_t slot_id, pb::RuntimeFilter* pb_filter) const {
+    pb_filter->set_slot_id(slot_id);
+    pb_filter->set_col_type(_type);
+    pb_filter->set_num_hashes(_num_hashes);
+    pb_filter->set_num_values(_num_values);
+    std::string* bits = pb_filter->mutable_bloom_bits();
+    bits->resize(byte_size());
+    for (size_t i = 0; i < _bits.size(); i++) {
+        uint64_t word = KeyEncoder::to_endian_u64(_bits[i]);
+        memcpy(&(*bits)[i * sizeof(uint64_t)], &word, sizeof(uint64_t));
+    }
+}
+
+int RuntimeFilter::init_from_pb(const pb::RuntimeFilter& pb_filter) {
+    const std::string& bits = pb_filter.bloom_bits();
+    if (column_storage(pb_filter.col_type()) == COL_INVALID || bits.empty() ||
+            bits.size() % sizeof(uint64_t) != 0 || pb_filter.num_hashes() <= 0) {
+        DB_WARNING("invalid runtime filter, slot_id:%d type:%d size:%lu",
+                pb_filter.slot_id(), pb_filter.col_type(), bits.size());
+        return -1;
+    }
+    _type = pb_filter.col_type();
+    _num_hashes = pb_filter.num_hashes();
+    _num_values = pb_filter.num_values();
+    _bits.resize(bits.size() / sizeof(uint64_t));
+    for (size_t i = 0; i < _bits.size(); i++) {
+        uint64_t word = 0;
+        memcpy(&word, &bits[i * sizeof(uint64_t)], sizeof(uint64_t));
+        _bits[i] = KeyEncoder::to_endian_u64(word);
+    }
+    _num_bits = _bits.size() * 64;
+    // 反序列化的filter没有范围信息，视为非空
+    if (_num_values == 0) {
+        _num_values = 1;
+    }
+    _min_value = ExprValue::Null();
+    _max_value = ExprValue::Null();
+    return 0;
+}
+
+bool RuntimeFilter::may_contain(const ExprValue& value) const {
+    if (value.is_null() || _num_values == 0) {
+        return false;
+    }
+    uint64_t h = value_hash(value);
+    uint64_t delta = (h >> 33) | (h << 31);
+    for (int32_t i = 0; i < _num_hashes; i++) {
+        uint64_t pos = h % _num_bits;
+        if ((_bits[pos >> 6] & (1ULL << (pos & 63))) == 0) {
+            return false;
+        }
+        h += delta;
+    }
+    return true;
+}
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -24,14 +24,20 @@ int RuntimeState::init(const pb::StoreReq& req,
         const pb::Plan& plan, 
         const RepeatedPtrField<pb::TupleDescriptor>& tuples,
         TransactionPool* pool,
-        bool store_compute_separate, bool is_binlog_region) {
-    for (auto& tuple : tuples) {
-        if (tuple.tuple_id() >= (int)_tuple_descs.size()) {
-            _tuple_descs.resize(tuple.tuple_id() + 1);
+        bool store_compute_separate, bool is_binlog_region,
+        const SmartPreparedTuples& prepared) {
+    if (prepared != nullptr) {
+        _tuple_descs = prepared->tuple_descs;
+        _shared_mem_row_desc = prepared->mem_row_desc;
+    } else {
+        for (auto& tuple : tuples) {
+            if (tuple.tuple_id() >= (int)_tuple_descs.size()) {
+                _tuple_descs.resize(tuple.tuple_id() + 1);
+            }
+            _tuple_descs[tuple.tuple_id()] = tuple;
         }
-        _tuple_descs[tuple.tuple_id()] = tuple;
     }
-    if (_tuple_descs.size() > 0) {
+    if (_tuple_descs.size() > 0 && _shared_mem_row_desc == nullptr) {
         int ret = _mem_row_desc.init(_tuple_descs);
         if (ret < 0) {
             DB_WARNING("_mem_row_desc init fail");
@@ -13,8 +13,33 @@
 // limitations under the License.
 
 #include "sorter.h"
+#include "column_batch.h"
 
 namespace baikaldb {
+DEFINE_bool(sort_by_column_batch, true, "materialize slot_ref sort keys into columns before sorting");
+
+void Sorter::sort_batch(RowBatch* batch) {
+    if (FLAGS_sort_by_column_batch && batch->size() > 1) {
+        // 排序列都是slot_ref时先物化成列，比较时不再走反射
+        ColumnBatch keys;
+        if (keys.add_slot_ref_columns(_comp->slot_order_exprs()) == 0 &&
+                keys.append_rows(batch) == 0) {
+            std::vector<size_t> order(batch->size());
+            for (size_t i = 0; i < order.size(); i++) {
+                order[i] = i;
+            }
+            std::vector<bool>& is_asc = _comp->is_asc();
+            std::vector<bool>& is_null_first = _comp->is_null_first();
+            std::sort(order.begin(), order.end(), [&](size_t left, size_t right) {
+                return keys.compare_row(left, right, is_asc, is_null_first) < 0;
+            });
+            batch->reorder(order);
+            return;
+        }
+    }
+    batch->sort(_comp);
+}
+
 int Sorter::get_next(RowBatch* batch, bool* eos) {
     if (_min_heap.size() == 0) {
         *eos = true;
@@ -56,7 +81,7 @@ void Sorter::sort() {
         return;
     }
     if (_min_heap.size() == 1) {
-        _min_heap[0]->sort(_comp);
+        sort_batch(_min_heap[0].get());
     } else if (_min_heap.size() > 1) {
         multi_sort();
         make_heap();
@@ -82,7 +107,7 @@ void Sorter::multi_sort() {
     for (size_t i = 0; i < _min_heap.size(); i++) {
         Bthread bth(&BTHREAD_ATTR_SMALL);
         bth.run([this, i, &cond]() {
-            _min_heap[i]->sort(_comp);
+            sort_batch(_min_heap[i].get());
             cond.decrease_signal();
         });
     }
@@ -113,6 +138,46 @@ void Sorter::shiftdown(size_t index) {
     }
 }
 
+int64_t TopNSorter::add_batch(RowBatch* batch) {
+    auto less = _comp->get_less_func();
+    int64_t release_size = 0;
+    for (batch->reset(); !batch->is_traverse_over(); batch->next()) {
+        std::unique_ptr<MemRow>& row = batch->get_row();
+        if ((int64_t)_rows.size() < _limit) {
+            _rows.push_back(std::move(row));
+            std::push_heap(_rows.begin(), _rows.end(), less);
+            continue;
+        }
+        // 大部分行只需要和堆顶比较一次
+        if (!less(row, _rows[0])) {
+            release_size += row->release_charged_size();
+            continue;
+        }
+        std::pop_heap(_rows.begin(), _rows.end(), less);
+        release_size += _rows.back()->release_charged_size();
+        _rows.back() = std::move(row);
+        std::push_heap(_rows.begin(), _rows.end(), less);
+    }
+    batch->clear();
+    return release_size;
+}
+
+void TopNSorter::sort() {
+    std::sort_heap(_rows.begin(), _rows.end(), _comp->get_less_func());
+    _idx = 0;
+}
+
+int TopNSorter::get_next(RowBatch* batch, bool* eos) {
+    while (_idx < _rows.size()) {
+        if (batch->is_full()) {
+            return 0;
+        }
+        batch->move_row(std::move(_rows[_idx++]));
+    }
+    *eos = true;
+    return 0;
+}
+
 }
 
 /* vim: set ts=4 sw=4 sts=4 tw=100 */
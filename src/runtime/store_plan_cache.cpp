@@ -0,0 +1,72 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "store_plan_cache.h"
+#include "common.h"
+
+namespace baikaldb {
+DEFINE_int64(store_plan_cache_size, 10000, "max entries of select tuple desc cache on store");
+
+StorePlanCache::StorePlanCache() {
+    _cache.init(FLAGS_store_plan_cache_size);
+}
+
+std::string StorePlanCache::make_key(uint64_t sql_sign, uint64_t tuples_sign) {
+    std::string key;
+    key.append((const char*)&sql_sign, sizeof(sql_sign));
+    key.append((const char*)&tuples_sign, sizeof(tuples_sign));
+    return key;
+}
+
+SmartPreparedTuples StorePlanCache::get(uint64_t sql_sign, uint64_t tuples_sign) {
+    SmartPreparedTuples prepared;
+    if (_cache.find(make_key(sql_sign, tuples_sign), &prepared) != 0) {
+        return nullptr;
+    }
+    return prepared;
+}
+
+SmartPreparedTuples StorePlanCache::prepare(uint64_t sql_sign, uint64_t tuples_sign,
+        const google::protobuf::RepeatedPtrField<pb::TupleDescriptor>& tuples) {
+    if (tuples.size() == 0) {
+        return nullptr;
+    }
+    SmartPreparedTuples prepared = std::make_shared<PreparedTuples>();
+    for (auto& tuple : tuples) {
+        if (tuple.tuple_id() >= (int)prepared->tuple_descs.size()) {
+            prepared->tuple_descs.resize(tuple.tuple_id() + 1);
+        }
+        prepared->tuple_descs[tuple.tuple_id()] = tuple;
+    }
+    prepared->mem_row_desc = std::make_shared<MemRowDescriptor>();
+    if (prepared->mem_row_desc->init(prepared->tuple_descs) < 0) {
+        DB_WARNING("mem_row_desc init fail, sql_sign: %lu", sql_sign);
+        return nullptr;
+    }
+    _cache.add(make_key(sql_sign, tuples_sign), prepared);
+    return prepared;
+}
+
+uint64_t make_tuples_sign(const std::vector<pb::TupleDescriptor>& tuples) {
+    std::string buf;
+    for (auto& tuple : tuples) {
+        if (tuple.has_tuple_id()) {
+            tuple.AppendToString(&buf);
+        }
+    }
+    return make_sign(buf);
+}
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -16,11 +16,34 @@
 #include "meta_server_interact.hpp"
 
 namespace baikaldb {
+DEFINE_int32(tso_batch_max_count, 256, "max concurrent get_tso merged into one tso rpc, 1 to disable");
+
+// 同一时刻只有一个rpc，rpc期间到达的请求合并进下一批
+GroupExecutor<TsoFetcher::TsoWaiter> TsoFetcher::_group_fetcher(TsoFetcher::fetch_batch,
+        [](size_t count, int64_t weight) {
+            return count > (size_t)FLAGS_tso_batch_max_count;
+        });
 
 int64_t TsoFetcher::get_tso() {
+    if (FLAGS_tso_batch_max_count <= 1) {
+        return gen_tso(1);
+    }
+    TsoWaiter waiter;
+    _group_fetcher.run(&waiter);
+    return waiter.timestamp;
+}
+
+void TsoFetcher::fetch_batch(std::vector<TsoWaiter*>& batch) {
+    int64_t timestamp = gen_tso(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        batch[i]->timestamp = timestamp < 0 ? timestamp : timestamp + i;
+    }
+}
+
+int64_t TsoFetcher::gen_tso(int64_t count) {
     pb::TsoRequest request;
     request.set_op_type(pb::OP_GEN_TSO);
-    request.set_count(1);
+    request.set_count(count);
     pb::TsoResponse response;
     int retry_time = 0;
     int ret = 0;
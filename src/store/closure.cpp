@@ -92,6 +92,9 @@ void DMLClosure::Run() {
                     remote_side.c_str());
     }
     if (region != nullptr) {
+        if (op_type == pb::OP_BULK_INGEST) {
+            region->reset_region_status();
+        }
         region->real_writing_decrease();
     }
     delete this;
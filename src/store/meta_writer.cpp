@@ -147,6 +147,13 @@ int MetaWriter::update_apply_index(int64_t region_id, int64_t applied_index, int
     }
     return 0; 
 }
+int MetaWriter::update_apply_index_and_num_table_lines(int64_t region_id, int64_t applied_index,
+            int64_t data_index, int64_t num_table_lines) {
+    rocksdb::WriteBatch batch;
+    batch.Put(_meta_cf, applied_index_key(region_id), encode_applied_index(applied_index, data_index));
+    batch.Put(_meta_cf, num_table_lines_key(region_id), encode_num_table_lines(num_table_lines));
+    return write_batch(&batch, region_id);
+}
 int MetaWriter::write_pre_commit(int64_t region_id, uint64_t txn_id, int64_t num_table_lines,
                                  int64_t applied_index) {
     if (applied_index == 0) {
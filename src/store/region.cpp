@@ -17,6 +17,7 @@
 #include <fstream>
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
+#include <rocksdb/sst_file_reader.h>
 #include "table_key.h"
 #include "runtime_state.h"
 #include "mem_row_descriptor.h"
@@ -32,6 +33,8 @@
 #include "closure.h"
 #include "rapidjson/rapidjson.h"
 #include "qos.h"
+#include "arrow_row_codec.h"
+#include "store_plan_cache.h"
 #ifdef BAIDU_INTERNAL
 #include <base/files/file.h>
 #else
@@ -54,6 +57,10 @@ DEFINE_bool(use_fulltext_wordweight_segment, true, "load wordweight dict");
 DEFINE_bool(use_fulltext_wordseg_wordrank_segment, true, "load wordseg wordrank dict");
 DEFINE_int32(election_timeout_ms, 1000, "raft election timeout(ms)");
 DEFINE_int32(skew, 5, "split skew, default : 45% - 55%");
+DEFINE_int64(load_split_qps, 3000, "split region by load when key access qps exceeds this, 0 to disable");
+DEFINE_int32(load_split_hot_windows, 3, "split by load after region stays hot for this many check windows");
+DEFINE_int64(load_split_min_lines, 10000, "region with fewer lines never splits by load");
+DEFINE_int32(load_split_min_samples, 64, "min sampled keys to pick a load split key");
 DEFINE_int32(reverse_level2_len, 5000, "reverse index level2 length, default : 5000");
 DEFINE_string(raftlog_uri, "myraftlog://my_raft_log?id=", "raft log uri");
 DEFINE_string(binlog_uri, "mybinlog://my_bin_log?id=", "bin log uri");
@@ -90,6 +97,9 @@ DECLARE_int64(min_split_lines);
 DECLARE_bool(use_approximate_size);
 DECLARE_bool(use_approximate_size_to_split);
 DECLARE_bool(open_service_write_concurrency);
+DEFINE_int64(select_cursor_idle_timeout_ms, 60 * 1000, "select cursor released after idle timeout");
+DEFINE_int32(max_select_cursors_per_region, 64, "max select cursors kept by one region");
+DECLARE_int64(store_plan_cache_size);
 //const size_t  Region::REGION_MIN_KEY_SIZE = sizeof(int64_t) * 2 + sizeof(uint8_t);
 const uint8_t Region::PRIMARY_INDEX_FLAG = 0x01;                                   
 const uint8_t Region::SECOND_INDEX_FLAG = 0x02;
@@ -137,6 +147,7 @@ int Region::init(bool new_region, int32_t snapshot_times) {
     _meta_writer = MetaWriter::get_instance();
     TimeCost time_cost;
     _resource.reset(new RegionResource);
+    _resource->access_sampler = std::make_shared<AccessKeySampler>();
     //如果是新建region需要
     if (new_region) {
         std::string snapshot_path_str(FLAGS_snapshot_uri, FLAGS_snapshot_uri.find("//") + 2);
@@ -781,6 +792,11 @@ void Region::exec_in_txn_query(google::protobuf::RpcController* controller,
             ret = select(*request, *response);
             int64_t select_cost = cost.get_time();
             Store::get_instance()->select_time_cost << select_cost;
+            // 允许follower读的select不会随leader迁移，只统计必须由leader处理的
+            if (!request->select_without_leader()) {
+                _num_select_requests++;
+                _num_scan_rows += response->scan_rows();
+            }
             if (select_cost > FLAGS_print_time_us) {
                 //担心ByteSizeLong对性能有影响，先对耗时长的，返回行多的请求做压缩
                 if (response->affected_rows() > 1024) {
@@ -974,6 +990,11 @@ void Region::exec_out_txn_query(google::protobuf::RpcController* controller,
             select(*request, *response);
             int64_t select_cost = cost.get_time();
             Store::get_instance()->select_time_cost << select_cost;
+            // 允许follower读的select不会随leader迁移，只统计必须由leader处理的
+            if (!request->select_without_leader()) {
+                _num_select_requests++;
+                _num_scan_rows += response->scan_rows();
+            }
             if (select_cost > FLAGS_print_time_us) {
                 //担心ByteSizeLong对性能有影响，先对耗时长的，返回行多的请求做压缩
                 if (response->affected_rows() > 1024) {
@@ -1385,6 +1406,11 @@ void Region::query(google::protobuf::RpcController* controller,
         exec_txn_complete(controller, request, response, done_guard.release());
         return;
     }
+    // 续读只依赖游标中的快照，不再校验leader和版本
+    if (request->op_type() == pb::OP_SELECT && request->has_cursor_id()) {
+        exec_out_txn_query(controller, request, response, done_guard.release());
+        return;
+    }
     const auto& remote_side_tmp = butil::endpoint2str(cntl->remote_side());
     const char* remote_side = remote_side_tmp.c_str();
     if (!is_leader()) {
@@ -1395,6 +1421,7 @@ void Region::query(google::protobuf::RpcController* controller,
         response->set_leader(butil::endpoint2str(get_leader()).c_str());
         //为了性能，支持非一致性读
         if (!request->select_without_leader() || _shutdown || !_init_success || 
+            _region_status == pb::STATUS_ERROR ||
             (is_learner() && !learner_ready_for_read())) {
             response->set_errcode(pb::NOT_LEADER);
             response->set_errmsg("not leader");
@@ -1469,7 +1496,18 @@ void Region::query(google::protobuf::RpcController* controller,
         }
         case pb::OP_ADD_VERSION_FOR_SPLIT_REGION:
         case pb::OP_UPDATE_PRIMARY_TIMESTAMP:
+        case pb::OP_BULK_INGEST:
         case pb::OP_NONE: {
+            // 状态在DMLClosure中重置
+            const pb::StoreReq* raft_request = request;
+            pb::StoreReq ingest_request;
+            if (request->op_type() == pb::OP_BULK_INGEST) {
+                ingest_request = *request;
+                if (check_bulk_ingest(&ingest_request, response) != 0) {
+                    return;
+                }
+                raft_request = &ingest_request;
+            }
             if (request->op_type() == pb::OP_NONE) {
                 if (_split_param.split_slow_down) {
                     DB_WARNING("region is spliting, slow down time:%ld, region_id: %ld, remote_side: %s",
@@ -1488,7 +1526,7 @@ void Region::query(google::protobuf::RpcController* controller,
             }
             butil::IOBuf data;
             butil::IOBufAsZeroCopyOutputStream wrapper(&data);
-            if (!request->SerializeToZeroCopyStream(&wrapper)) {
+            if (!raft_request->SerializeToZeroCopyStream(&wrapper)) {
                 cntl->SetFailed(brpc::EREQUEST, "Fail to serialize request");
                 return;
             }
@@ -1798,6 +1836,8 @@ void Region::dml_2pc(const pb::StoreReq& request,
     }
     if (/*txn_info.autocommit() && */(op_type == pb::OP_UPDATE || op_type == pb::OP_INSERT || op_type == pb::OP_DELETE)) {
         txn->dml_num_affected_rows = affected_rows;
+        _num_modified_rows += affected_rows;
+        _num_dml_requests++;
     }
     response.set_affected_rows(affected_rows);
     if (state.last_insert_id != INT64_MIN) {
@@ -2036,6 +2076,10 @@ void Region::dml_1pc(const pb::StoreReq& request, pb::OpType op_type,
         }
         root->close(&state);
         ExecNode::destroy_tree(root);
+        if (ret > 0) {
+            _num_modified_rows += ret;
+        }
+        _num_dml_requests++;
     }
     if (op_type != pb::OP_TRUNCATE_TABLE) {
         txn->num_increase_rows += state.num_increase_rows();
@@ -2208,7 +2252,12 @@ int Region::select(const pb::StoreReq& request, pb::StoreRes& response) {
         DB_WARNING("sign: %lu, reject", sign);
         return -1;
     }
-    int ret = select(request, request.plan(), request.tuples(), response);
+    int ret = 0;
+    if (request.has_cursor_id()) {
+        ret = select_cursor(request, response);
+    } else {
+        ret = select(request, request.plan(), request.tuples(), response);
+    }
     StoreQos::get_instance()->destroy_bthread_local();
     return ret;
 }
@@ -2252,10 +2301,29 @@ int Region::select(const pb::StoreReq& request,
         db_conn_id = butil::fast_rand();
     }
     
+    // 带tuples_sign的select复用缓存的tuple desc，baikaldb收到plan_cached后可以不再发送tuples
+    SmartPreparedTuples prepared;
+    if (request.has_tuples_sign() && FLAGS_store_plan_cache_size > 0) {
+        auto plan_cache = StorePlanCache::get_instance();
+        prepared = plan_cache->get(request.sql_sign(), request.tuples_sign());
+        if (prepared == nullptr) {
+            prepared = plan_cache->prepare(request.sql_sign(), request.tuples_sign(), tuples);
+        }
+        if (prepared != nullptr) {
+            response.set_plan_cached(true);
+        }
+    }
+    if (prepared == nullptr && tuples.size() == 0 && request.has_tuples_sign()) {
+        response.set_errcode(pb::PLAN_CACHE_MISS);
+        response.set_errmsg("plan cache miss");
+        DB_WARNING("plan cache miss, region_id: %ld, sql_sign: %lu, tuples_sign: %lu",
+                _region_id, request.sql_sign(), request.tuples_sign());
+        return -1;
+    }
     SmartState state_ptr = std::make_shared<RuntimeState>();
     RuntimeState& state = *state_ptr;
     state.set_resource(get_resource());
-    ret = state.init(request, plan, tuples, &_txn_pool, false, _is_binlog_region);
+    ret = state.init(request, plan, tuples, &_txn_pool, false, _is_binlog_region, prepared);
     if (ret < 0) {
         response.set_errcode(pb::EXEC_FAIL);
         response.set_errmsg("RuntimeState init fail");
@@ -2362,10 +2430,21 @@ int Region::select(const pb::StoreReq& request,
         }
     }
     
+    // 非事务的普通select可以分块返回，没读完的plan保存成游标
+    bool use_cursor = request.select_chunk_bytes() > 0 && is_new_txn && !is_trace &&
+        !request.has_analyze_info();
+    if (use_cursor) {
+        BAIDU_SCOPED_LOCK(_select_cursor_lock);
+        use_cursor = (int64_t)_select_cursors.size() < FLAGS_max_select_cursors_per_region;
+    }
+    bool eos = true;
     if (request.has_analyze_info()) {
         rows = select_sample(state, root, request.analyze_info(), response);
+    } else if (use_cursor) {
+        rows = select_normal(state, root, response, request.select_chunk_bytes(), &eos,
+                request.arrow_result());
     } else {
-        rows = select_normal(state, root, response);
+        rows = select_normal(state, root, response, 0, nullptr, request.arrow_result());
     }
     if (rows < 0) {
         root->close(&state);
@@ -2381,6 +2460,21 @@ int Region::select(const pb::StoreReq& request,
         return -1;
     }
 
+    if (!eos) {
+        SmartSelectCursor cursor = std::make_shared<SelectCursor>();
+        cursor->state = state_ptr;
+        cursor->root = root;
+        cursor->scan_rows = state.num_scan_rows();
+        cursor->filter_rows = state.num_filter_rows();
+        // 临时事务由游标负责回滚
+        auto_rollback.release();
+        response.set_cursor_id(add_select_cursor(cursor));
+        response.set_errcode(pb::SUCCESS);
+        response.set_affected_rows(rows);
+        response.set_scan_rows(state.num_scan_rows());
+        response.set_filter_rows(state.num_filter_rows());
+        return 0;
+    }
     //DB_NOTICE("select rows:%d", rows);
     root->close(&state);
     ExecNode::destroy_tree(root);
@@ -2397,11 +2491,141 @@ int Region::select(const pb::StoreReq& request,
     return 0;
 }
 
-int Region::select_normal(RuntimeState& state, ExecNode* root, pb::StoreRes& response) {
+int Region::select_cursor(const pb::StoreReq& request, pb::StoreRes& response) {
+    if (request.touch_cursor()) {
+        // baikaldb还在消费其他region时保活，游标id不变
+        if (touch_select_cursor(request.cursor_id()) != 0) {
+            response.set_errcode(pb::EXEC_FAIL);
+            response.set_errmsg("select cursor not exist");
+            DB_WARNING("touch select cursor not exist, region_id: %ld, cursor_id: %lu, log_id: %lu",
+                    _region_id, request.cursor_id(), request.log_id());
+            return -1;
+        }
+        response.set_errcode(pb::SUCCESS);
+        response.set_cursor_id(request.cursor_id());
+        return 0;
+    }
+    SmartSelectCursor cursor = take_select_cursor(request.cursor_id());
+    if (cursor == nullptr) {
+        response.set_errcode(pb::EXEC_FAIL);
+        response.set_errmsg("select cursor not exist");
+        DB_WARNING("select cursor not exist, region_id: %ld, cursor_id: %lu, log_id: %lu",
+                _region_id, request.cursor_id(), request.log_id());
+        return -1;
+    }
+    if (request.close_cursor()) {
+        // cursor析构时关闭plan并回滚临时事务
+        response.set_errcode(pb::SUCCESS);
+        return 0;
+    }
+    RuntimeState& state = *cursor->state;
+    for (auto& tuple : state.tuple_descs()) {
+        if (tuple.has_tuple_id()) {
+            response.add_tuple_ids(tuple.tuple_id());
+        }
+    }
+    int64_t chunk_bytes = request.select_chunk_bytes();
+    bool eos = false;
+    int rows = select_normal(state, cursor->root, response, chunk_bytes, &eos,
+            request.arrow_result());
+    if (rows < 0) {
+        response.set_errcode(pb::EXEC_FAIL);
+        if (state.error_code != ER_ERROR_FIRST) {
+            response.set_mysql_errcode(state.error_code);
+            response.set_errmsg(state.error_msg.str());
+        } else {
+            response.set_errmsg("plan exec failed");
+        }
+        DB_FATAL("plan exec fail, region_id: %ld, cursor_id: %lu", _region_id, request.cursor_id());
+        return -1;
+    }
+    response.set_errcode(pb::SUCCESS);
+    response.set_affected_rows(rows);
+    // 只返回本次的增量
+    response.set_scan_rows(state.num_scan_rows() - cursor->scan_rows);
+    response.set_filter_rows(state.num_filter_rows() - cursor->filter_rows);
+    cursor->scan_rows = state.num_scan_rows();
+    cursor->filter_rows = state.num_filter_rows();
+    if (!eos) {
+        response.set_cursor_id(add_select_cursor(cursor));
+    }
+    return 0;
+}
+
+uint64_t Region::add_select_cursor(SmartSelectCursor cursor) {
+    cursor->idle_time.reset();
+    BAIDU_SCOPED_LOCK(_select_cursor_lock);
+    // 随机id，避免store重启后误续读到别的查询
+    uint64_t cursor_id = butil::fast_rand();
+    while (cursor_id == 0 || _select_cursors.count(cursor_id) > 0) {
+        cursor_id = butil::fast_rand();
+    }
+    _select_cursors[cursor_id] = cursor;
+    return cursor_id;
+}
+
+SmartSelectCursor Region::take_select_cursor(uint64_t cursor_id) {
+    BAIDU_SCOPED_LOCK(_select_cursor_lock);
+    auto iter = _select_cursors.find(cursor_id);
+    if (iter == _select_cursors.end()) {
+        return nullptr;
+    }
+    SmartSelectCursor cursor = iter->second;
+    _select_cursors.erase(iter);
+    return cursor;
+}
+
+int Region::touch_select_cursor(uint64_t cursor_id) {
+    BAIDU_SCOPED_LOCK(_select_cursor_lock);
+    auto iter = _select_cursors.find(cursor_id);
+    if (iter == _select_cursors.end()) {
+        return -1;
+    }
+    iter->second->idle_time.reset();
+    return 0;
+}
+
+void Region::clear_select_cursors(bool force) {
+    std::vector<SmartSelectCursor> expired;
+    {
+        BAIDU_SCOPED_LOCK(_select_cursor_lock);
+        for (auto iter = _select_cursors.begin(); iter != _select_cursors.end();) {
+            if (force || iter->second->idle_time.get_time() >
+                    FLAGS_select_cursor_idle_timeout_ms * 1000LL) {
+                DB_WARNING("select cursor expired, region_id: %ld, cursor_id: %lu",
+                        _region_id, iter->first);
+                expired.emplace_back(iter->second);
+                iter = _select_cursors.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+    }
+    // 在锁外关闭plan
+    expired.clear();
+}
+
+int Region::select_normal(RuntimeState& state, ExecNode* root, pb::StoreRes& response,
+        int64_t max_bytes, bool* is_eos, bool arrow_result) {
     bool eos = false;
     int rows = 0;
     int ret = 0;
+    int64_t bytes = 0;
     MemRowDescriptor* mem_row_desc = state.mem_row_desc();
+    std::unique_ptr<ArrowRowCodec> codec;
+    if (arrow_result) {
+        std::vector<const pb::TupleDescriptor*> tuples;
+        for (auto& tuple : state.tuple_descs()) {
+            if (tuple.has_tuple_id()) {
+                tuples.emplace_back(&tuple);
+            }
+        }
+        // 有不支持的类型时退回pb行格式
+        codec.reset(new ArrowRowCodec);
+        if (codec->init(tuples) != 0) {
+            codec.reset();
+        }
+    }
 
     while (!eos) {
         RowBatch batch;
@@ -2430,18 +2654,39 @@ int Region::select_normal(RuntimeState& state, ExecNode* root, pb::StoreRes& res
                 DB_FATAL("row is null; region_id: %ld, rows:%d", _region_id, rows);
                 continue;
             }
-            pb::RowValue* row_value = response.add_row_values();
-            for (const auto& iter : mem_row_desc->id_tuple_mapping()) {
-                std::string* tuple_value = row_value->add_tuple_values();
-                row->to_string(iter.first, tuple_value);
+            if (codec != nullptr) {
+                if (codec->append_row(row) != 0) {
+                    DB_FATAL("append row to arrow codec fail, region_id: %ld", _region_id);
+                    return -1;
+                }
+            } else {
+                pb::RowValue* row_value = response.add_row_values();
+                for (const auto& iter : mem_row_desc->id_tuple_mapping()) {
+                    std::string* tuple_value = row_value->add_tuple_values();
+                    row->to_string(iter.first, tuple_value);
+                    bytes += tuple_value->size();
+                }
             }
 
             if (global_ddl_with_ttl) {
                 response.add_ttl_timestamp(state.ttl_timestamp_vec[ttl_idx - 1]);
             }
         }
+        if (codec != nullptr) {
+            bytes = codec->used_size();
+        }
+        // 按batch粒度截断，剩余的行下次续读
+        if (max_bytes > 0 && bytes >= max_bytes) {
+            break;
+        }
+    }
+    if (codec != nullptr && codec->serialize(response.mutable_arrow_rows()) != 0) {
+        DB_FATAL("serialize arrow rows fail, region_id: %ld", _region_id);
+        return -1;
+    }
+    if (is_eos != nullptr) {
+        *is_eos = eos;
     }
-
     return rows;
 }
 
@@ -2468,6 +2713,51 @@ int Region::select_sample(RuntimeState& state, ExecNode* root, const pb::Analyze
         return -1;
     }
     CMsketch cmsketch(analyze_info.depth(), analyze_info.width());
+    // 索引前缀的多列统计，相同的前缀只收集一次
+    struct MultiPrefix {
+        int64_t index_id = 0;
+        std::vector<std::vector<int32_t>> prefix_field_ids; // 第i项为前i+2列
+        std::vector<int32_t> slot_ids;
+        std::vector<pb::PrimitiveType> slot_types;
+    };
+    std::vector<MultiPrefix> multi_prefixes;
+    auto table_ptr = _factory->get_table_info_ptr(tuple_desc->table_id());
+    if (analyze_info.multi_column_max_prefix() >= 2 && table_ptr != nullptr) {
+        std::map<int32_t, const pb::SlotDescriptor*> field_slot_map;
+        for (auto& slot : tuple_desc->slots()) {
+            if (slot.has_field_id()) {
+                field_slot_map[slot.field_id()] = &slot;
+            }
+        }
+        std::set<std::vector<int32_t>> prefix_set;
+        for (auto index_id : table_ptr->indices) {
+            auto index_ptr = _factory->get_index_info_ptr(index_id);
+            if (index_ptr == nullptr || (index_ptr->type != pb::I_PRIMARY
+                        && index_ptr->type != pb::I_UNIQ && index_ptr->type != pb::I_KEY)) {
+                continue;
+            }
+            MultiPrefix multi;
+            multi.index_id = index_id;
+            std::vector<int32_t> field_ids;
+            for (auto& field : index_ptr->fields) {
+                if ((int)field_ids.size() >= analyze_info.multi_column_max_prefix()
+                        || field_slot_map.count(field.id) == 0) {
+                    break;
+                }
+                field_ids.emplace_back(field.id);
+                multi.slot_ids.emplace_back(field_slot_map[field.id]->slot_id());
+                multi.slot_types.emplace_back(field_slot_map[field.id]->slot_type());
+                if (field_ids.size() >= 2 && prefix_set.count(field_ids) == 0) {
+                    prefix_set.insert(field_ids);
+                    multi.prefix_field_ids.resize(field_ids.size() - 1);
+                    multi.prefix_field_ids.back() = field_ids;
+                }
+            }
+            if (!multi.prefix_field_ids.empty()) {
+                multi_prefixes.emplace_back(multi);
+            }
+        }
+    }
 
     while (!eos) {
         RowBatch batch;
@@ -2489,6 +2779,22 @@ int Region::select_sample(RuntimeState& state, ExecNode* root, const pb::Analyze
                 value.cast_to(slot.slot_type());
                 cmsketch.set_value(slot.field_id(), value.hash());
             }
+            for (auto& multi : multi_prefixes) {
+                uint64_t hash = 0;
+                for (size_t i = 0; i < multi.slot_ids.size() && i <= multi.prefix_field_ids.size(); i++) {
+                    ExprValue value = batch.get_row()->get_value(0, multi.slot_ids[i]);
+                    uint64_t value_hash = 0;
+                    if (!value.is_null()) {
+                        value.cast_to(multi.slot_types[i]);
+                        value_hash = value.hash();
+                    }
+                    hash = multi_column_hash(hash, value_hash);
+                    // 被其他索引收集过的前缀为空
+                    if (i >= 1 && !multi.prefix_field_ids[i - 1].empty()) {
+                        cmsketch.set_multi_value(multi.index_id, multi.prefix_field_ids[i - 1], hash);
+                    }
+                }
+            }
             count++;
             if (count <= sample_cnt) {
                 sample_batch.move_row(std::move(batch.get_row()));
@@ -2602,6 +2908,14 @@ void Region::construct_heart_beat_request(pb::StoreHeartBeatRequest& request, bo
     if (is_leader() && _node.list_peers(&peers).ok()) {
         pb::LeaderHeartBeat* leader_heart = request.add_leader_regions();
         leader_heart->set_status(_region_control.get_status());
+        leader_heart->set_modified_rows(_num_modified_rows.exchange(0));
+        int64_t load_stat_us = _load_stat_time.get_time();
+        if (load_stat_us > 0) {
+            leader_heart->set_select_qps(_num_select_requests.exchange(0) * 1000000L / load_stat_us);
+            leader_heart->set_dml_qps(_num_dml_requests.exchange(0) * 1000000L / load_stat_us);
+            leader_heart->set_scan_rows_per_second(_num_scan_rows.exchange(0) * 1000000L / load_stat_us);
+        }
+        _load_stat_time.reset();
         pb::RegionInfo* leader_region =  leader_heart->mutable_region();
         copy_region(leader_region);
         leader_region->set_status(_region_control.get_status());
@@ -2786,6 +3100,12 @@ void Region::do_apply(int64_t term, int64_t index, const pb::StoreReq& request,
             _meta_writer->update_apply_index(_region_id, _applied_index, _data_index);
             break;
         }
+        case pb::OP_BULK_INGEST: {
+            // apply_index在apply_bulk_ingest中和行数一起落盘；
+            // 本peer数据不一致时不推进apply_index，由on_apply回滚该日志
+            apply_bulk_ingest(request, done);
+            break;
+        }
         //split的各类请求传进的来的done类型各不相同，不走下边的if(done)逻辑，直接处理完成，然后continue
         case pb::OP_NONE: {
             _meta_writer->update_apply_index(_region_id, _applied_index, _data_index);
@@ -2912,6 +3232,14 @@ void Region::on_apply(braft::Iterator& iter) {
             }
         } else {
             do_apply(term, index, *request, done);
+            if (_region_status == pb::STATUS_ERROR) {
+                // 回滚后raft进入error状态，不再提供服务，由meta替换该peer后通过snapshot重建
+                // 该日志的done由braft以error状态回调
+                DB_FATAL("rollback log and stop apply, index: %ld, region_id: %ld", index, _region_id);
+                done_guard.release();
+                iter.set_error_and_rollback();
+                return;
+            }
         }
         if (done != nullptr) {
             braft::run_closure_in_bthread(done_guard.release());
@@ -3815,6 +4143,13 @@ void Region::on_shutdown() {
 void Region::on_leader_start(int64_t term) {
     DB_WARNING("leader start at term:%ld, region_id: %ld", term, _region_id);
     _not_leader_alarm.set_leader_start();
+    // follower期间apply累计的修改行数已由原leader上报
+    _num_modified_rows = 0;
+    _num_select_requests = 0;
+    _num_dml_requests = 0;
+    _num_scan_rows = 0;
+    _load_stat_time.reset();
+    get_resource()->access_sampler->reset();
     _region_info.set_leader(butil::endpoint2str(get_leader()).c_str());
     if (!_is_binlog_region) {
         auto clear_applying_txn_fun = [this] {
@@ -4753,7 +5088,7 @@ void Region::start_process_split(const pb::RegionSplitResponse& split_response,
         baikaldb::Store::get_instance()->sub_split_num();
         return;
     }
-    if (!tail_split && split_key.compare(get_end_key()) > 0) {
+    if (!tail_split && !get_end_key().empty() && split_key.compare(get_end_key()) > 0) {
         baikaldb::Store::get_instance()->sub_split_num();
         return;
     }
@@ -5897,35 +6232,25 @@ void Region::complete_split() {
 }
 
 void Region::print_log_entry(const int64_t start_index, const int64_t end_index) {
-    MutTableKey log_data_key;
-    log_data_key.append_i64(_region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY).append_i64(start_index);
-    rocksdb::ReadOptions read_options;
-    read_options.prefix_same_as_start = true;
-    read_options.total_order_seek = false;
-    read_options.fill_cache = false;
-    std::unique_ptr<rocksdb::Iterator> iter(_rocksdb->new_iterator(read_options, RocksWrapper::RAFT_LOG_CF));
-    iter->Seek(log_data_key.data());
-    for (int i = 0; iter->Valid() && i < 100; iter->Next(), i++) {
-        TableKey key(iter->key());
-        int64_t log_index = key.extract_i64(sizeof(int64_t) + 1);
-        if (log_index > end_index) {
-            break;
+    int count = 0;
+    LogEntryReader::get_instance()->scan_log_entry(_region_id, start_index, end_index,
+            [&](int64_t log_index, const LogHead& head, const rocksdb::Slice& data) {
+        if (++count > 100) {
+            return 1;
         }
-        rocksdb::Slice value_slice(iter->value());
-        LogHead head(iter->value());
-        value_slice.remove_prefix(MyRaftLogStorage::LOG_HEAD_SIZE);
         if ((braft::EntryType)head.type != braft::ENTRY_TYPE_DATA) {
             DB_FATAL("log entry is not data, log_index:%ld, region_id: %ld", log_index, _region_id);
-            continue;
+            return 0;
         }
         pb::StoreReq store_req;
-        if (!store_req.ParseFromArray(value_slice.data(), value_slice.size())) {
+        if (!store_req.ParseFromArray(data.data(), data.size())) {
             DB_FATAL("Fail to parse request fail, split fail, region_id: %ld", _region_id);
-            continue;
+            return 0;
         }
         DB_WARNING("region: %ld, log_index: %ld, term: %ld, req: %s",
                 _region_id, log_index, head.term, store_req.ShortDebugString().c_str());
-    }
+        return 0;
+    });
 }
 
 int Region::get_log_entry_for_split(const int64_t split_start_index, 
@@ -5940,26 +6265,15 @@ int Region::get_log_entry_for_split(const int64_t split_start_index,
     batch_request.set_region_id(_split_param.new_region_id);
     batch_request.set_resend_start_pos(0);
     butil::IOBuf attachment_data;
-    MutTableKey log_data_key;
-    log_data_key.append_i64(_region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY).append_i64(split_start_index);
-    rocksdb::ReadOptions read_options;
-    read_options.prefix_same_as_start = true;
-    read_options.total_order_seek = false;
-    read_options.fill_cache = false;
-    std::unique_ptr<rocksdb::Iterator> iter(_rocksdb->new_iterator(read_options, RocksWrapper::RAFT_LOG_CF));
-    iter->Seek(log_data_key.data());
-    // 小batch发送
-    for (int i = 0; iter->Valid() && i < 10000; iter->Next(), i++) {
-        TableKey key(iter->key());
-        int64_t log_index = key.extract_i64(sizeof(int64_t) + 1);
+    // 小batch发送，每次最多10000条
+    int ret = LogEntryReader::get_instance()->scan_log_entry(_region_id, split_start_index,
+            split_start_index + 9999,
+            [&](int64_t log_index, const LogHead& head, const rocksdb::Slice& data) {
         if (log_index != start_index) {
             DB_FATAL("log index not continueous, start_index:%ld, log_index:%ld, region_id: %ld", 
                     start_index, log_index, _region_id);
             return -1;
         }
-        rocksdb::Slice value_slice(iter->value());
-        LogHead head(iter->value());
-        value_slice.remove_prefix(MyRaftLogStorage::LOG_HEAD_SIZE); 
         if (head.term != expected_term) {
             DB_FATAL("term not equal to expect_term, term:%ld, expect_term:%ld, region_id: %ld", 
                       head.term, expected_term, _region_id);
@@ -5967,11 +6281,11 @@ int Region::get_log_entry_for_split(const int64_t split_start_index,
         }
         if ((braft::EntryType)head.type != braft::ENTRY_TYPE_DATA) {
             DB_FATAL("log entry is not data, log_index:%ld, region_id: %ld", log_index, _region_id);
-            continue;
+            return 0;
         }
         // TODO 后续上线可以不序列化反序列化
         pb::StoreReq store_req;
-        if (!store_req.ParseFromArray(value_slice.data(), value_slice.size())) {
+        if (!store_req.ParseFromArray(data.data(), data.size())) {
             DB_FATAL("Fail to parse request fail, split fail, region_id: %ld", _region_id);
             return -1;
         }
@@ -5992,14 +6306,14 @@ int Region::get_log_entry_for_split(const int64_t split_start_index,
         store_req.set_region_id(_split_param.new_region_id);
         store_req.set_region_version(0);
 
-        butil::IOBuf data;
-        butil::IOBufAsZeroCopyOutputStream wrapper(&data);
+        butil::IOBuf buf;
+        butil::IOBufAsZeroCopyOutputStream wrapper(&buf);
         if (!store_req.SerializeToZeroCopyStream(&wrapper)) {
             return -1;
         }
 
-        batch_request.add_request_lens(data.size());
-        attachment_data.append(data);
+        batch_request.add_request_lens(buf.size());
+        attachment_data.append(buf);
         if (batch_request.request_lens_size() == FLAGS_split_send_log_batch_size) {
             requests.emplace_back(batch_request);
             attachment_datas.emplace_back(attachment_data);
@@ -6007,6 +6321,10 @@ int Region::get_log_entry_for_split(const int64_t split_start_index,
             attachment_data.clear();
         }
         ++start_index;
+        return 0;
+    });
+    if (ret < 0) {
+        return -1;
     }
     if (batch_request.request_lens_size() > 0) {
         requests.emplace_back(batch_request);
@@ -6018,8 +6336,8 @@ int Region::get_log_entry_for_split(const int64_t split_start_index,
             " applied_index:%ld, _real_writing_cond: %d",
             cost.get_time(), _region_id, split_start_index, split_end_index,
             ori_apply_index, _applied_index, _real_writing_cond.count());
-    // ture还有数据，false没数据了
-    return iter->Valid() ? 1 : 0;
+    // 1还有数据，0没数据了
+    return ret;
 }
 
 void Region::adjust_num_table_lines() {
@@ -6178,6 +6496,47 @@ int Region::get_split_key(std::string& split_key, int64_t& split_key_term) {
     return 0;
 }
 
+int Region::get_load_split_key(std::string& split_key, int64_t& split_key_term) {
+    std::vector<std::string> keys;
+    int64_t window_us = 0;
+    int64_t access_count = get_resource()->access_sampler->swap_window(&keys, &window_us);
+    if (FLAGS_load_split_qps <= 0 || window_us <= 0) {
+        return -1;
+    }
+    int64_t qps = access_count * 1000000L / window_us;
+    if (qps < FLAGS_load_split_qps || _num_table_lines.load() < FLAGS_load_split_min_lines) {
+        _load_split_hot_windows = 0;
+        return -1;
+    }
+    if (++_load_split_hot_windows < FLAGS_load_split_hot_windows) {
+        return -1;
+    }
+    _load_split_hot_windows = 0;
+    // 只保留region范围内的key，等于start_key的key不能作为分裂点
+    std::string start_key = get_start_key();
+    std::string end_key = get_end_key();
+    auto iter = std::remove_if(keys.begin(), keys.end(), [&start_key, &end_key](const std::string& key) {
+        return key <= start_key || (!end_key.empty() && key >= end_key);
+    });
+    keys.erase(iter, keys.end());
+    if (keys.size() < (size_t)FLAGS_load_split_min_samples) {
+        DB_WARNING("region_id: %ld qps: %ld, too few samples: %lu to split by load",
+                _region_id, qps, keys.size());
+        return -1;
+    }
+    // 采样按访问次数加权，中位数两侧的访问量大致相同
+    std::sort(keys.begin(), keys.end());
+    split_key = keys[keys.size() / 2];
+    // 拿到term,之后开始分裂会校验term
+    braft::NodeStatus s;
+    _node.get_status(&s);
+    split_key_term = s.term;
+    DB_WARNING("table_id: %ld, region_id: %ld, split by load, qps: %ld, samples: %lu, split_key: %s",
+            get_global_index_id(), _region_id, qps, keys.size(),
+            rocksdb::Slice(split_key).ToString(true).c_str());
+    return 0;
+}
+
 int Region::add_reverse_index(int64_t table_id, int64_t index_id) {
     if (_is_global_index || table_id != get_table_id()) {
         return 0;
@@ -6529,4 +6888,296 @@ void Region::process_upload_sst_streaming(brpc::Controller* cntl, bool ingest_st
 
 }
 
+std::string Region::bulk_load_sst_path(const std::string& load_id) {
+    // 使用FLAGS_db_path，保证ingest能move成功
+    return FLAGS_db_path + "/region_bulk_load_sst." + std::to_string(_region_id) + "." + load_id;
+}
+
+void Region::process_bulk_load(brpc::Controller* cntl,
+    const pb::BulkLoadRequest* request,
+    pb::StoreRes* response) {
+    if (_shutdown || !_init_success) {
+        response->set_errcode(pb::EXEC_FAIL);
+        response->set_errmsg("region is shutdown or not init");
+        DB_WARNING("region[%ld] is shutdown or not init.", _region_id);
+        return;
+    }
+    _multi_thread_cond.increase();
+    ON_SCOPE_EXIT([this]() {
+        _multi_thread_cond.decrease_signal();
+    });
+    const std::string& load_id = request->load_id();
+    if (load_id.empty() || load_id.find('/') != std::string::npos || load_id.find("..") != std::string::npos) {
+        response->set_errcode(pb::INPUT_PARAM_ERROR);
+        response->set_errmsg("invalid load_id");
+        DB_WARNING("invalid load_id: %s, region_id: %ld", load_id.c_str(), _region_id);
+        return;
+    }
+    std::string path = bulk_load_sst_path(load_id);
+    boost::system::error_code ec;
+    int64_t file_size = boost::filesystem::file_size(path, ec);
+    if (ec) {
+        file_size = -1;
+    }
+    response->set_errcode(pb::SUCCESS);
+    switch (request->op()) {
+        case pb::BULK_LOAD_UPLOAD: {
+            // 按offset追加，断点续传时offset需与已有文件大小一致
+            if (request->offset() != 0 && request->offset() != file_size) {
+                response->set_errcode(pb::INPUT_PARAM_ERROR);
+                response->set_errmsg("offset not match file size");
+                DB_WARNING("bulk load offset: %ld not match file size: %ld, path: %s, region_id: %ld",
+                        request->offset(), file_size, path.c_str(), _region_id);
+                return;
+            }
+            std::ios::openmode mode = std::ios::out | std::ios::binary;
+            mode |= request->offset() == 0 ? std::ios::trunc : std::ios::app;
+            std::ofstream os(path, mode);
+            os << cntl->request_attachment();
+            os.close();
+            if (!os) {
+                response->set_errcode(pb::EXEC_FAIL);
+                response->set_errmsg("write file fail");
+                DB_FATAL("write bulk load file fail, path: %s, region_id: %ld", path.c_str(), _region_id);
+                return;
+            }
+            break;
+        }
+        case pb::BULK_LOAD_CHECK: {
+            if (file_size != request->file_size()) {
+                response->set_errcode(pb::EXEC_FAIL);
+                response->set_errmsg("file size not match");
+                DB_WARNING("bulk load file size: %ld, expect: %ld, path: %s, region_id: %ld",
+                        file_size, request->file_size(), path.c_str(), _region_id);
+                return;
+            }
+            break;
+        }
+        case pb::BULK_LOAD_CLEAR: {
+            butil::DeleteFile(butil::FilePath(path), false);
+            break;
+        }
+        default:
+            response->set_errcode(pb::UNSUPPORT_REQ_TYPE);
+            response->set_errmsg("unsupport bulk load op");
+            return;
+    }
+    DB_NOTICE("bulk load op: %s, load_id: %s, offset: %ld, size: %lu, region_id: %ld",
+            pb::BulkLoadOp_Name(request->op()).c_str(), load_id.c_str(),
+            request->offset(), cntl->request_attachment().size(), _region_id);
+}
+
+int Region::check_bulk_ingest(pb::StoreReq* request, pb::StoreRes* response) {
+    pb::RegionStatus expected_status = pb::IDLE;
+    if (!_region_control.compare_exchange_strong(expected_status, pb::DOING)) {
+        response->set_errcode(pb::EXEC_FAIL);
+        response->set_errmsg("region status is not idle");
+        DB_WARNING("region status is not idle, can not bulk ingest, region_id: %ld", _region_id);
+        return -1;
+    }
+    ScopeGuard reset_status_guard([this]() {
+        reset_region_status();
+    });
+    // 所有peer(包括learner)都有文件才发起raft，避免数据不一致
+    std::vector<std::string> peers;
+    {
+        std::lock_guard<std::mutex> lock(_region_lock);
+        for (auto& peer : _region_info.peers()) {
+            peers.emplace_back(peer);
+        }
+        for (auto& learner : _region_info.learners()) {
+            peers.emplace_back(learner);
+        }
+    }
+    pb::BulkLoadRequest check_request;
+    check_request.set_region_id(_region_id);
+    check_request.set_op(pb::BULK_LOAD_CHECK);
+    check_request.set_load_id(request->bulk_load_id());
+    check_request.set_file_size(request->bulk_load_size());
+    for (auto& peer : peers) {
+        pb::StoreRes check_response;
+        StoreInteract store_interact(peer);
+        if (store_interact.send_request("bulk_load", check_request, check_response) != 0) {
+            response->set_errcode(pb::EXEC_FAIL);
+            response->set_errmsg("bulk load file not ready on " + peer);
+            DB_WARNING("bulk load file not ready on peer: %s, load_id: %s, region_id: %ld",
+                    peer.c_str(), request->bulk_load_id().c_str(), _region_id);
+            return -1;
+        }
+    }
+    if (check_bulk_load_sst(bulk_load_sst_path(request->bulk_load_id()),
+            request->mutable_bulk_load_smallest_key(), request->mutable_bulk_load_largest_key()) != 0) {
+        response->set_errcode(pb::EXEC_FAIL);
+        response->set_errmsg("region not empty or sst out of region");
+        return -1;
+    }
+    reset_status_guard.release();
+    return 0;
+}
+
+int Region::check_bulk_load_sst(const std::string& path, std::string* smallest_key,
+        std::string* largest_key) {
+    if (_num_table_lines > 0) {
+        DB_WARNING("region not empty, num_table_lines: %ld, region_id: %ld",
+                _num_table_lines.load(), _region_id);
+        return -1;
+    }
+    rocksdb::Options options = _rocksdb->get_options(_data_cf);
+    rocksdb::SstFileReader reader(options);
+    auto status = reader.Open(path);
+    if (!status.ok()) {
+        DB_WARNING("SstFileReader open fail %s, Error %s, region_id: %ld",
+                path.c_str(), status.ToString().c_str(), _region_id);
+        return -1;
+    }
+    rocksdb::ReadOptions sst_read_options;
+    sst_read_options.total_order_seek = true;
+    sst_read_options.fill_cache = false;
+    std::unique_ptr<rocksdb::Iterator> sst_iter(reader.NewIterator(sst_read_options));
+    sst_iter->SeekToFirst();
+    if (!sst_iter->Valid()) {
+        return 0;
+    }
+    std::string smallest = sst_iter->key().ToString();
+    sst_iter->SeekToLast();
+    std::string largest = sst_iter->key().ToString();
+    MutTableKey region_prefix;
+    region_prefix.append_i64(_region_id);
+    if (!rocksdb::Slice(smallest).starts_with(region_prefix.data())
+            || !rocksdb::Slice(largest).starts_with(region_prefix.data())) {
+        DB_WARNING("sst key not belong to region, path: %s, region_id: %ld", path.c_str(), _region_id);
+        return -1;
+    }
+    // region区间按本region的索引(主表为主键，全局索引region为索引key)划分，
+    // 局部索引随主键路由，只检查该索引的首尾key
+    MutTableKey index_prefix;
+    index_prefix.append_i64(_region_id).append_i64(get_table_id());
+    MutTableKey next_index_prefix;
+    next_index_prefix.append_i64(_region_id).append_i64(get_table_id() + 1);
+    std::string start_key = get_start_key();
+    std::string end_key = get_end_key();
+    sst_iter->Seek(index_prefix.data());
+    if (sst_iter->Valid() && sst_iter->key().starts_with(index_prefix.data())) {
+        std::string first_key = sst_iter->key().ToString().substr(index_prefix.size());
+        sst_iter->SeekForPrev(next_index_prefix.data());
+        std::string last_key = sst_iter->key().ToString().substr(index_prefix.size());
+        if (first_key < start_key || (!end_key.empty() && last_key >= end_key)) {
+            DB_WARNING("sst key out of region range, first_key: %s, last_key: %s, start_key: %s, "
+                    "end_key: %s, path: %s, region_id: %ld",
+                    rocksdb::Slice(first_key).ToString(true).c_str(),
+                    rocksdb::Slice(last_key).ToString(true).c_str(),
+                    rocksdb::Slice(start_key).ToString(true).c_str(),
+                    rocksdb::Slice(end_key).ToString(true).c_str(), path.c_str(), _region_id);
+            return -1;
+        }
+    }
+    // 同一key ingest后seqno更大，会覆盖已有数据，因此区间内不能有数据
+    rocksdb::ReadOptions read_options;
+    read_options.prefix_same_as_start = false;
+    read_options.total_order_seek = true;
+    read_options.fill_cache = false;
+    std::unique_ptr<rocksdb::Iterator> iter(_rocksdb->new_iterator(read_options, _data_cf));
+    iter->Seek(smallest);
+    if (iter->Valid() && iter->key().compare(largest) <= 0) {
+        DB_WARNING("sst overlap with exist key: %s, path: %s, region_id: %ld",
+                iter->key().ToString(true).c_str(), path.c_str(), _region_id);
+        return -1;
+    }
+    if (smallest_key != nullptr) {
+        *smallest_key = smallest;
+    }
+    if (largest_key != nullptr) {
+        *largest_key = largest;
+    }
+    return 0;
+}
+
+bool Region::bulk_ingest_applied(const pb::StoreReq& request) {
+    const std::string& smallest = request.bulk_load_smallest_key();
+    const std::string& largest = request.bulk_load_largest_key();
+    MutTableKey region_prefix;
+    region_prefix.append_i64(_region_id);
+    if (smallest.empty() || !rocksdb::Slice(smallest).starts_with(region_prefix.data())
+            || !rocksdb::Slice(largest).starts_with(region_prefix.data())) {
+        return false;
+    }
+    // ingest前区间内没有数据，ingest是原子的，首尾key都在说明已经ingest
+    rocksdb::ReadOptions read_options;
+    read_options.fill_cache = false;
+    std::string value;
+    return _rocksdb->get(read_options, _data_cf, smallest, &value).ok()
+        && _rocksdb->get(read_options, _data_cf, largest, &value).ok();
+}
+
+int Region::apply_bulk_ingest(const pb::StoreReq& request, braft::Closure* done) {
+    TimeCost cost;
+    std::string path = bulk_load_sst_path(request.bulk_load_id());
+    // apply_index落盘后才删除，重启重放时据此区分文件丢失和已经ingest
+    ON_SCOPE_EXIT(([path]() {
+        butil::DeleteFile(butil::FilePath(path), false);
+    }));
+    pb::StoreRes res;
+    res.set_errcode(pb::SUCCESS);
+    int ret = 0;
+    bool ingested = false;
+    boost::system::error_code ec;
+    int64_t file_size = boost::filesystem::file_size(path, ec);
+    if (ec || file_size != request.bulk_load_size()) {
+        if (get_version() == 0) {
+            // 分裂时新region回放到该日志，文件不存在，分裂失败后重试
+            DB_WARNING("region_id: %ld replay bulk ingest, fail split", _region_id);
+            _async_apply_param.apply_log_failed = true;
+            res.set_errcode(pb::EXEC_FAIL);
+            res.set_errmsg("bulk load file not exist");
+        } else if (bulk_ingest_applied(request)) {
+            // move_files在ingest成功后删除源文件，上次在写apply_index前重启
+            DB_WARNING("bulk load already ingested, load_id: %s, region_id: %ld, applied_index: %ld",
+                    request.bulk_load_id().c_str(), _region_id, _applied_index);
+            ingested = true;
+        } else {
+            // 校验后peer发生变更或文件被删除，该peer数据与leader不一致，不能继续提供服务
+            DB_FATAL("bulk load file: %s size: %ld not match: %ld, region_id: %ld",
+                    path.c_str(), file_size, request.bulk_load_size(), _region_id);
+            _region_status = pb::STATUS_ERROR;
+            res.set_errcode(pb::EXEC_FAIL);
+            res.set_errmsg("bulk load file not exist");
+            ret = -1;
+        }
+    } else if (check_bulk_load_sst(path) != 0) {
+        // 各peer数据一致，校验结果相同，都放弃本次导入
+        res.set_errcode(pb::EXEC_FAIL);
+        res.set_errmsg("region not empty or sst out of region");
+    } else if (RegionControl::ingest_data_sst(path, _region_id, true) != 0) {
+        DB_FATAL("bulk ingest fail, path: %s, region_id: %ld", path.c_str(), _region_id);
+        res.set_errcode(pb::EXEC_FAIL);
+        res.set_errmsg("ingest sst fail");
+    } else {
+        ingested = true;
+    }
+    if (ingested) {
+        _num_table_lines += request.num_increase_rows();
+        res.set_affected_rows(request.num_increase_rows());
+        DB_NOTICE("bulk ingest success, load_id: %s, size: %ld, lines: %ld, num_table_lines: %ld, "
+                "cost: %ld, region_id: %ld, applied_index: %ld",
+                request.bulk_load_id().c_str(), file_size, request.num_increase_rows(),
+                _num_table_lines.load(), cost.get_time(), _region_id, _applied_index);
+    }
+    if (ret == 0) {
+        _data_index = _applied_index;
+        _meta_writer->update_apply_index_and_num_table_lines(_region_id, _applied_index,
+                _data_index, _num_table_lines.load());
+    }
+    if (done != nullptr) {
+        ((DMLClosure*)done)->applied_index = _applied_index;
+        ((DMLClosure*)done)->response->set_errcode(res.errcode());
+        if (res.has_errmsg()) {
+            ((DMLClosure*)done)->response->set_errmsg(res.errmsg());
+        }
+        if (res.has_affected_rows()) {
+            ((DMLClosure*)done)->response->set_affected_rows(res.affected_rows());
+        }
+    }
+    return ret;
+}
+
 } // end of namespace
@@ -20,6 +20,8 @@
 #include "region.h"
 #include "mut_table_key.h"
 #include "my_raft_log_storage.h"
+#include "segment_log_storage.h"
+#include "log_entry_cache.h"
 #include "closure.h"
 #include "raft_control.h"
 
@@ -128,6 +130,13 @@ int RegionControl::remove_log_entry(int64_t drop_region_id) {
             status.code(), status.ToString().c_str(), drop_region_id);
         return -1;
     }
+    LogEntryCache::get_instance()->remove_region(drop_region_id);
+    SegmentLogEngine* engine = SegmentLogEngine::get_instance();
+    if (engine->is_init() && engine->has_region(drop_region_id)
+            && engine->remove_region(drop_region_id) != 0) {
+        DB_WARNING("remove segment raft log fail, region_id: %ld", drop_region_id);
+        return -1;
+    }
     DB_WARNING("remove raft log entry, region_id: %ld, cost: %ld", drop_region_id, cost.get_time());
     MutTableKey log_data_key;
     log_data_key.append_i64(drop_region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY).append_i64(1);
@@ -25,6 +25,7 @@
 #include "closure.h"
 #include "my_raft_log_storage.h"
 #include "log_entry_reader.h"
+#include "segment_log_storage.h"
 #include "rocksdb/cache.h"
 #include "rocksdb/utilities/write_batch_with_index.h"
 #include "concurrency.h"
@@ -37,6 +38,7 @@ DECLARE_int64(store_heart_beat_interval_us);
 DECLARE_int32(balance_periodicity);
 DECLARE_string(stable_uri);
 DECLARE_string(snapshot_uri);
+DECLARE_string(raftlog_uri);
 DEFINE_int64(reverse_merge_interval_us, 2 * 1000 * 1000,  "reverse_merge_interval(2 s)");
 DEFINE_int64(ttl_remove_interval_s, 24 * 3600,  "ttl_remove_interval_s(24h)");
 DEFINE_int64(delay_remove_region_interval_s, 600,  "delay_remove_region_interval");
@@ -57,6 +59,7 @@ DEFINE_int64(binlog_timeout_check_ms, 10 * 1000LL,
 DEFINE_int64(binlog_fake_ms, 30 * 1000LL,
             "fake binlog interval, default(30s)");
 DECLARE_int64(flush_memtable_interval_us);
+DECLARE_int64(print_time_us);
 DEFINE_int32(max_split_concurrency, 2, "max split region concurrency, default:2");
 DEFINE_int64(none_region_merge_interval_us, 5 * 60 * 1000 * 1000LL, 
              "none region merge interval, default(5 min)");
@@ -72,6 +75,7 @@ DEFINE_int64(rocks_cf_flush_remove_range_times, 10, "rocks_cf_flush_remove_range
 DEFINE_int64(rocks_force_flush_max_wals, 100, "rocks_force_flush_max_wals, default(100)");
 DEFINE_string(network_segment, "", "network segment of store set by user");
 DEFINE_string(container_id, "", "container_id for zoombie instance");
+DEFINE_int32(query_multi_concurrency, 10, "max concurrent regions of one query_multi request");
 
 Store::~Store() {
     bthread_mutex_destroy(&_param_mutex);
@@ -109,6 +113,12 @@ int Store::init_before_listen(std::vector<std::int64_t>& init_region_ids) {
         DB_FATAL("rocksdb init failed: code:%d", res);
         return -1;
     }
+    // segment中的日志需要在region删除和初始化之前恢复
+    if (boost::starts_with(FLAGS_raftlog_uri, "mysegmentlog")
+            && SegmentLogEngine::get_instance()->init() != 0) {
+        DB_FATAL("segment log engine init failed");
+        return -1;
+    }
     // init val 
     _factory = SchemaFactory::get_instance();
     std::vector<rocksdb::Transaction*> recovered_txns;
@@ -211,6 +221,10 @@ int Store::init_before_listen(std::vector<std::int64_t>& init_region_ids) {
         init_region_ids.push_back(region_id);
     }
     int64_t new_region_process_time = step_time_cost.get_time();
+    if (SegmentLogEngine::get_instance()->is_init()) {
+        SegmentLogEngine::get_instance()->drop_unknown_regions(
+                std::set<int64_t>(init_region_ids.begin(), init_region_ids.end()));
+    }
     ret = _meta_writer->parse_doing_snapshot(doing_snapshot_regions);
     if (ret < 0) {
         DB_FATAL("read doing snapshot regions from rocksdb fail");
@@ -506,6 +520,62 @@ void Store::query(google::protobuf::RpcController* controller,
                   done_guard.release());
 }
 
+void Store::query_multi(google::protobuf::RpcController* controller,
+                  const pb::StoreMultiReq* request,
+                  pb::StoreMultiRes* response,
+                  google::protobuf::Closure* done) {
+    brpc::ClosureGuard done_guard(done);
+    brpc::Controller* cntl =
+            static_cast<brpc::Controller*>(controller);
+    uint64_t log_id = 0;
+    const auto& remote_side_tmp = butil::endpoint2str(cntl->remote_side());
+    const char* remote_side = remote_side_tmp.c_str();
+    if (cntl->has_log_id()) {
+        log_id = cntl->log_id();
+    }
+    // 事务和写请求依赖执行顺序，只合并非事务select
+    for (auto& req : request->requests()) {
+        if (req.op_type() != pb::OP_SELECT ||
+                (req.txn_infos_size() > 0 && req.txn_infos(0).txn_id() != 0)) {
+            response->set_errcode(pb::UNSUPPORT_REQ_TYPE);
+            response->set_errmsg("only select without txn supported");
+            DB_WARNING("unsupported request, region_id: %ld, op_type: %s, logid:%lu, remote_side: %s",
+                    req.region_id(), pb::OpType_Name(req.op_type()).c_str(), log_id, remote_side);
+            return;
+        }
+    }
+    for (int i = 0; i < request->requests_size(); i++) {
+        response->add_responses();
+    }
+    TimeCost cost;
+    ConcurrencyBthread query_bth(FLAGS_query_multi_concurrency, &BTHREAD_ATTR_SMALL);
+    for (int i = 0; i < request->requests_size(); i++) {
+        const pb::StoreReq* req = &request->requests(i);
+        pb::StoreRes* res = response->mutable_responses(i);
+        auto query_fn = [this, controller, req, res, log_id, remote_side]() {
+            SmartRegion region = get_region(req->region_id());
+            if (region == nullptr || region->removed()) {
+                res->set_errcode(pb::REGION_NOT_EXIST);
+                res->set_errmsg("region_id not exist in store");
+                DB_WARNING("region_id: %ld not exist in store, logid:%lu, remote_side: %s",
+                        req->region_id(), log_id, remote_side);
+                return;
+            }
+            BthreadCond cond;
+            cond.increase();
+            region->query(controller, req, res, new MultiQueryClosure(cond));
+            cond.wait();
+        };
+        query_bth.run(query_fn);
+    }
+    query_bth.join();
+    response->set_errcode(pb::SUCCESS);
+    if (cost.get_time() > FLAGS_print_time_us) {
+        DB_WARNING("query_multi regions: %d, time: %ld, logid:%lu, remote_side: %s",
+                request->requests_size(), cost.get_time(), log_id, remote_side);
+    }
+}
+
 void Store::query_binlog(google::protobuf::RpcController* controller,
                   const pb::StoreReq* request,
                   pb::StoreRes* response,
@@ -1348,6 +1418,10 @@ void Store::whether_split_thread() {
                         process_split_request(ptr_region->get_global_index_id(), region_ids[i], false, split_key, split_key_term);
                         continue;
                     }
+                } else if (0 == ptr_region->get_load_split_key(split_key, split_key_term)) {
+                    //访问热点按负载分裂，尾region也在访问中位数处分裂
+                    process_split_request(ptr_region->get_global_index_id(), region_ids[i], false, split_key, split_key_term);
+                    continue;
                 }
             }
             
@@ -1805,4 +1879,21 @@ void Store::backup(google::protobuf::RpcController* controller,
         DB_WARNING("unknown sst backup streaming op.");
     }
 }
+
+void Store::bulk_load(google::protobuf::RpcController* controller,
+    const pb::BulkLoadRequest* request,
+    pb::StoreRes* response,
+    google::protobuf::Closure* done) {
+    brpc::ClosureGuard done_guard(done);
+    brpc::Controller* cntl = static_cast<brpc::Controller*>(controller);
+    int64_t region_id = request->region_id();
+    SmartRegion region = get_region(region_id);
+    if (region == nullptr) {
+        response->set_errcode(pb::REGION_NOT_EXIST);
+        response->set_errmsg("region_id not exist in store");
+        DB_WARNING("bulk load no region in store, region_id: %ld", region_id);
+        return;
+    }
+    region->process_bulk_load(cntl, request, response);
+}
 } //namespace
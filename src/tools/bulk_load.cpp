@@ -0,0 +1,550 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// 离线批量导入，绕过raft逐行写入
+// 1、按region区间切分输入，主键和局部索引按主键路由，全局索引按索引key路由，落到各region的临时文件
+// 2、逐个region排序后生成sst
+// 3、sst上传到region所有peer，再由leader发起OP_BULK_INGEST，各peer在状态机中ingest
+// 要求导入期间region不分裂不合并(version变化的region导入失败，需重新执行)，重复key直接报错
+#include <stdio.h>
+#include <fstream>
+#include <string>
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <gflags/gflags.h>
+#include "common.h"
+#include "schema_factory.h"
+#include "meta_server_interact.hpp"
+#include "store_interact.hpp"
+#include "mut_table_key.h"
+#include "table_record.h"
+#include "sst_file_writer.h"
+
+namespace baikaldb {
+DEFINE_string(namespace_name, "FENGCHAO", "FENGCHAO");
+DEFINE_string(database, "", "database");
+DEFINE_string(table_name, "", "table_name");
+DEFINE_string(input_file, "", "input file, one row per line, all fields in table order");
+DEFINE_string(delimiter, "\t", "field delimiter");
+DEFINE_string(work_dir, "./bulk_load_data", "dir for partitioned data and sst files");
+DEFINE_string(load_id, "", "load id, default current timestamp");
+DEFINE_int64(upload_chunk_size, 32 * 1024 * 1024LL, "upload chunk size");
+DEFINE_int32(bulk_load_concurrency, 8, "concurrent regions when upload and ingest");
+DEFINE_int32(bulk_load_request_timeout_ms, 600 * 1000, "timeout of upload and ingest request");
+
+const size_t SPILL_BUFFER_SIZE = 1024 * 1024;
+
+struct RegionTarget {
+    pb::RegionInfo info;
+    std::string spill_path;
+    std::string sst_path;
+    std::string buf; // 待追加到spill文件的kv
+    int64_t num_lines = 0; // region所属索引的行数，ingest后累加到num_table_lines
+    int64_t file_size = 0;
+};
+
+class BulkLoader {
+public:
+    int init();
+    // 输入按region切分到spill文件
+    int partition();
+    // 逐个region排序生成sst，有重复key则整体失败，不做任何ingest
+    int build_sst();
+    int upload_and_ingest();
+
+private:
+    RegionTarget* route(int64_t index_id, const std::string& key);
+    int parse_line(std::string& line, SmartRecord record);
+    int add_row(SmartRecord record);
+    void append_kv(RegionTarget* region, const std::string& key, const std::string& value);
+    int flush(RegionTarget* region);
+    int write_sst(RegionTarget* region);
+    int upload(RegionTarget* region, const std::string& peer);
+    int ingest(RegionTarget* region);
+    void clear(RegionTarget* region);
+
+    SchemaFactory* _factory = nullptr;
+    int64_t _table_id = 0;
+    TableInfo _table_info;
+    IndexInfo _pk_info;
+    std::vector<IndexInfo> _indexes; // 二级索引
+    std::string _load_id;
+    int64_t _num_rows = 0;
+    // index_id => start_key => region，主表的region也存放局部索引
+    std::map<int64_t, std::map<std::string, RegionTarget*>> _index_regions;
+    std::map<int64_t, std::unique_ptr<RegionTarget>> _regions;
+};
+
+int BulkLoader::init() {
+    _factory = SchemaFactory::get_instance();
+    if (_factory->init() != 0) {
+        DB_FATAL("SchemaFactory init failed");
+        return -1;
+    }
+    MetaServerInteract interact;
+    if (interact.init() != 0) {
+        DB_FATAL("meta server interact init failed");
+        return -1;
+    }
+    pb::QueryRequest request;
+    request.set_op_type(pb::QUERY_SCHEMA);
+    request.set_namespace_name(FLAGS_namespace_name);
+    request.set_database(FLAGS_database);
+    request.set_table_name(FLAGS_table_name);
+    pb::QueryResponse response;
+    if (interact.send_request("query", request, response) != 0) {
+        DB_FATAL("query schema fail, err:%s", response.errmsg().c_str());
+        return -1;
+    }
+    if (response.schema_infos_size() != 1) {
+        DB_FATAL("has no schemainfo");
+        return -1;
+    }
+    const pb::SchemaInfo& schema_info = response.schema_infos(0);
+    _factory->update_table(schema_info);
+    _table_id = schema_info.table_id();
+    _table_info = _factory->get_table_info(_table_id);
+    if (_table_info.id == -1) {
+        DB_FATAL("get table info fail, table_id: %ld", _table_id);
+        return -1;
+    }
+    if (_table_info.partition_num > 1 || _table_info.engine != pb::ROCKSDB
+            || _table_info.ttl_info.ttl_duration_s > 0) {
+        DB_FATAL("only support rocksdb table without partition and ttl, table_id: %ld", _table_id);
+        return -1;
+    }
+    for (auto index_id : _table_info.indices) {
+        IndexInfo index_info = _factory->get_index_info(index_id);
+        if (index_info.state != pb::IS_PUBLIC) {
+            DB_FATAL("index: %ld is not public", index_id);
+            return -1;
+        }
+        if (index_info.type == pb::I_PRIMARY) {
+            _pk_info = index_info;
+        } else if (index_info.type == pb::I_KEY || index_info.type == pb::I_UNIQ) {
+            _indexes.emplace_back(index_info);
+        } else {
+            DB_FATAL("unsupport index type: %s, index: %ld",
+                    pb::IndexType_Name(index_info.type).c_str(), index_id);
+            return -1;
+        }
+    }
+    _load_id = FLAGS_load_id.empty() ? std::to_string(butil::gettimeofday_us()) : FLAGS_load_id;
+    boost::filesystem::create_directories(FLAGS_work_dir);
+    for (auto& region_info : response.region_infos()) {
+        int64_t region_id = region_info.region_id();
+        // sst的seqno大于已有数据，只能导入空表，否则会覆盖已有的行且索引不一致
+        if (region_info.num_table_lines() > 0) {
+            DB_FATAL("region not empty, num_table_lines: %ld, region_id: %ld",
+                    region_info.num_table_lines(), region_id);
+            return -1;
+        }
+        std::unique_ptr<RegionTarget> region(new RegionTarget);
+        region->info = region_info;
+        region->spill_path = FLAGS_work_dir + "/" + std::to_string(region_id) + ".kv";
+        region->sst_path = FLAGS_work_dir + "/" + std::to_string(region_id) + ".sst";
+        std::remove(region->spill_path.c_str());
+        _index_regions[region_info.table_id()][region_info.start_key()] = region.get();
+        _regions[region_id] = std::move(region);
+    }
+    // 区间必须连续，否则有数据无法路由
+    for (auto& pair : _index_regions) {
+        std::string last_end_key;
+        for (auto& kv : pair.second) {
+            if (kv.first != last_end_key) {
+                DB_FATAL("region range not continuous, index: %ld, region_id: %ld",
+                        pair.first, kv.second->info.region_id());
+                return -1;
+            }
+            last_end_key = kv.second->info.end_key();
+        }
+        if (!last_end_key.empty()) {
+            DB_FATAL("region range not continuous, index: %ld", pair.first);
+            return -1;
+        }
+    }
+    DB_NOTICE("table_id: %ld, region size: %lu, load_id: %s",
+            _table_id, _regions.size(), _load_id.c_str());
+    return 0;
+}
+
+RegionTarget* BulkLoader::route(int64_t index_id, const std::string& key) {
+    auto iter = _index_regions.find(index_id);
+    if (iter == _index_regions.end() || iter->second.empty()) {
+        return nullptr;
+    }
+    auto region_iter = iter->second.upper_bound(key);
+    if (region_iter == iter->second.begin()) {
+        return nullptr;
+    }
+    --region_iter;
+    const std::string& end_key = region_iter->second->info.end_key();
+    if (!end_key.empty() && key >= end_key) {
+        return nullptr;
+    }
+    return region_iter->second;
+}
+
+int BulkLoader::parse_line(std::string& line, SmartRecord record) {
+    std::vector<std::string> split_vec;
+    boost::split(split_vec, line, boost::is_any_of(FLAGS_delimiter));
+    if (split_vec.size() != _table_info.fields.size()) {
+        DB_FATAL("size diffrent %lu %lu, line: %s",
+                split_vec.size(), _table_info.fields.size(), line.c_str());
+        return -1;
+    }
+    for (size_t i = 0; i < split_vec.size(); i++) {
+        auto& field = _table_info.fields[i];
+        ExprValue value = field.default_expr_value;
+        if (field.default_value == "(current_timestamp())") {
+            value = ExprValue::Now();
+            value.cast_to(field.type);
+        }
+        if (split_vec[i] != "\\N" && split_vec[i] != "NULL") {
+            value = ExprValue(pb::STRING);
+            value.str_val = split_vec[i];
+            value.cast_to(field.type);
+        }
+        if (value.is_null()) {
+            if (!field.can_null) {
+                DB_FATAL("field: %s can not be null, line: %s", field.name.c_str(), line.c_str());
+                return -1;
+            }
+            continue;
+        }
+        if (0 != record->set_value(record->get_field_by_tag(field.id), value)) {
+            DB_FATAL("fill value failed, field: %s, line: %s", field.name.c_str(), line.c_str());
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int BulkLoader::add_row(SmartRecord record) {
+    MutTableKey pk;
+    if (0 != pk.append_index(_pk_info, record.get(), -1, false)) {
+        DB_FATAL("Fail to append_index, tab: %ld", _pk_info.id);
+        return -1;
+    }
+    RegionTarget* region = route(_table_id, pk.data());
+    if (region == nullptr) {
+        DB_FATAL("no region for primary key, tab: %ld", _table_id);
+        return -1;
+    }
+    // 与Transaction::put_secondary一致，需在put_primary清理主键字段前编码
+    for (auto& index : _indexes) {
+        MutTableKey index_key;
+        if (0 != index_key.append_index(index, record.get(), -1, false)) {
+            DB_FATAL("Fail to append_index, tab: %ld", index.id);
+            return -1;
+        }
+        MutTableKey pk_key;
+        if (0 != record->encode_primary_key(index, pk_key, -1)) {
+            DB_FATAL("Fail to encode_primary_key, tab: %ld", index.id);
+            return -1;
+        }
+        std::string value;
+        if (index.type == pb::I_KEY) {
+            index_key.append_index(pk_key.data());
+        } else {
+            value = pk_key.data();
+        }
+        RegionTarget* index_region = region;
+        if (index.is_global) {
+            index_region = route(index.id, index_key.data());
+            if (index_region == nullptr) {
+                DB_FATAL("no region for global index key, index: %ld", index.id);
+                return -1;
+            }
+            index_region->num_lines++;
+        }
+        MutTableKey key;
+        key.append_i64(index_region->info.region_id()).append_i64(index.id);
+        key.append_index(index_key.data());
+        append_kv(index_region, key.data(), value);
+        if (index_region->buf.size() > SPILL_BUFFER_SIZE && flush(index_region) != 0) {
+            return -1;
+        }
+    }
+    MutTableKey key;
+    key.append_i64(region->info.region_id()).append_i64(_pk_info.id);
+    if (0 != key.append_index(_pk_info, record.get(), -1, true)) {
+        DB_FATAL("Fail to append_index, tab: %ld", _pk_info.id);
+        return -1;
+    }
+    std::string value;
+    if (0 != record->encode(value)) {
+        DB_FATAL("encode record failed, tab: %ld", _pk_info.id);
+        return -1;
+    }
+    append_kv(region, key.data(), value);
+    region->num_lines++;
+    if (region->buf.size() > SPILL_BUFFER_SIZE && flush(region) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+void BulkLoader::append_kv(RegionTarget* region, const std::string& key, const std::string& value) {
+    uint32_t key_size = key.size();
+    uint32_t value_size = value.size();
+    region->buf.append((const char*)&key_size, sizeof(key_size));
+    region->buf.append(key);
+    region->buf.append((const char*)&value_size, sizeof(value_size));
+    region->buf.append(value);
+}
+
+int BulkLoader::flush(RegionTarget* region) {
+    if (region->buf.empty()) {
+        return 0;
+    }
+    std::ofstream os(region->spill_path, std::ios::out | std::ios::binary | std::ios::app);
+    os.write(region->buf.data(), region->buf.size());
+    os.close();
+    if (!os) {
+        DB_FATAL("write spill file fail, path: %s", region->spill_path.c_str());
+        return -1;
+    }
+    region->buf.clear();
+    return 0;
+}
+
+int BulkLoader::partition() {
+    std::ifstream fp(FLAGS_input_file);
+    if (!fp) {
+        DB_FATAL("open input file fail, path: %s", FLAGS_input_file.c_str());
+        return -1;
+    }
+    TimeCost cost;
+    std::string line;
+    while (std::getline(fp, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        SmartRecord record = _factory->new_record(_table_id);
+        if (record == nullptr || parse_line(line, record) != 0 || add_row(record) != 0) {
+            return -1;
+        }
+        if (++_num_rows % 1000000 == 0) {
+            DB_NOTICE("partition rows: %ld, cost: %ld", _num_rows, cost.get_time());
+        }
+    }
+    for (auto& pair : _regions) {
+        if (flush(pair.second.get()) != 0) {
+            return -1;
+        }
+    }
+    DB_NOTICE("partition done, rows: %ld, cost: %ld", _num_rows, cost.get_time());
+    return 0;
+}
+
+int BulkLoader::write_sst(RegionTarget* region) {
+    std::ifstream fp(region->spill_path, std::ios::in | std::ios::binary);
+    if (!fp) {
+        DB_FATAL("open spill file fail, path: %s", region->spill_path.c_str());
+        return -1;
+    }
+    // region大小受分裂控制，单个region的数据可以放入内存
+    std::vector<std::pair<std::string, std::string>> kvs;
+    uint32_t size = 0;
+    while (fp.read((char*)&size, sizeof(size))) {
+        std::pair<std::string, std::string> kv;
+        kv.first.resize(size);
+        fp.read(&kv.first[0], size);
+        fp.read((char*)&size, sizeof(size));
+        kv.second.resize(size);
+        fp.read(&kv.second[0], size);
+        if (!fp) {
+            DB_FATAL("spill file corrupted, path: %s", region->spill_path.c_str());
+            return -1;
+        }
+        kvs.emplace_back(std::move(kv));
+    }
+    fp.close();
+    std::sort(kvs.begin(), kvs.end());
+    rocksdb::Options options;
+    options.prefix_extractor.reset(rocksdb::NewFixedPrefixTransform(sizeof(int64_t) * 2));
+    std::unique_ptr<SstFileWriter> writer(new SstFileWriter(options));
+    auto s = writer->open(region->sst_path);
+    if (!s.ok()) {
+        DB_FATAL("open sst file fail, path: %s, err: %s", region->sst_path.c_str(), s.ToString().c_str());
+        return -1;
+    }
+    for (size_t i = 0; i < kvs.size(); i++) {
+        if (i > 0 && kvs[i].first == kvs[i - 1].first) {
+            DB_FATAL("duplicate key in input, region_id: %ld, key: %s", region->info.region_id(),
+                    rocksdb::Slice(kvs[i].first).ToString(true).c_str());
+            return -1;
+        }
+        s = writer->put(kvs[i].first, kvs[i].second);
+        if (!s.ok()) {
+            DB_FATAL("write sst fail, path: %s, err: %s", region->sst_path.c_str(), s.ToString().c_str());
+            return -1;
+        }
+    }
+    s = writer->finish();
+    if (!s.ok()) {
+        DB_FATAL("finish sst fail, path: %s, err: %s", region->sst_path.c_str(), s.ToString().c_str());
+        return -1;
+    }
+    region->file_size = boost::filesystem::file_size(region->sst_path);
+    std::remove(region->spill_path.c_str());
+    DB_NOTICE("write sst done, region_id: %ld, keys: %lu, lines: %ld, size: %ld",
+            region->info.region_id(), kvs.size(), region->num_lines, region->file_size);
+    return 0;
+}
+
+int BulkLoader::build_sst() {
+    TimeCost cost;
+    for (auto& pair : _regions) {
+        RegionTarget* region = pair.second.get();
+        if (!boost::filesystem::exists(region->spill_path)) {
+            continue;
+        }
+        if (write_sst(region) != 0) {
+            return -1;
+        }
+    }
+    DB_NOTICE("build sst done, cost: %ld", cost.get_time());
+    return 0;
+}
+
+int BulkLoader::upload(RegionTarget* region, const std::string& peer) {
+    std::ifstream fp(region->sst_path, std::ios::in | std::ios::binary);
+    if (!fp) {
+        DB_FATAL("open sst file fail, path: %s", region->sst_path.c_str());
+        return -1;
+    }
+    StoreReqOptions req_options;
+    req_options.request_timeout = FLAGS_bulk_load_request_timeout_ms;
+    StoreInteract store_interact(peer, req_options);
+    std::string buf(FLAGS_upload_chunk_size, '\0');
+    int64_t offset = 0;
+    while (offset < region->file_size) {
+        fp.read(&buf[0], buf.size());
+        int64_t read_size = fp.gcount();
+        if (read_size <= 0) {
+            DB_FATAL("read sst file fail, path: %s", region->sst_path.c_str());
+            return -1;
+        }
+        pb::BulkLoadRequest request;
+        request.set_region_id(region->info.region_id());
+        request.set_op(pb::BULK_LOAD_UPLOAD);
+        request.set_load_id(_load_id);
+        request.set_offset(offset);
+        pb::StoreRes response;
+        butil::IOBuf attachment;
+        attachment.append(buf.data(), read_size);
+        if (store_interact.send_request(butil::fast_rand(), "bulk_load", request, response, &attachment) != 0) {
+            DB_FATAL("upload fail, peer: %s, region_id: %ld, offset: %ld",
+                    peer.c_str(), region->info.region_id(), offset);
+            return -1;
+        }
+        offset += read_size;
+    }
+    return 0;
+}
+
+int BulkLoader::ingest(RegionTarget* region) {
+    pb::StoreReq request;
+    request.set_op_type(pb::OP_BULK_INGEST);
+    request.set_region_id(region->info.region_id());
+    request.set_region_version(region->info.version());
+    request.set_bulk_load_id(_load_id);
+    request.set_bulk_load_size(region->file_size);
+    request.set_num_increase_rows(region->num_lines);
+    pb::StoreRes response;
+    StoreReqOptions req_options;
+    req_options.request_timeout = FLAGS_bulk_load_request_timeout_ms;
+    StoreInteract store_interact(region->info.leader(), req_options);
+    if (store_interact.send_request_for_leader(butil::fast_rand(), "query", request, response) != 0) {
+        DB_FATAL("ingest fail, region_id: %ld, err: %s",
+                region->info.region_id(), response.ShortDebugString().c_str());
+        return -1;
+    }
+    return 0;
+}
+
+void BulkLoader::clear(RegionTarget* region) {
+    pb::BulkLoadRequest request;
+    request.set_region_id(region->info.region_id());
+    request.set_op(pb::BULK_LOAD_CLEAR);
+    request.set_load_id(_load_id);
+    for (auto& peer : region->info.peers()) {
+        pb::StoreRes response;
+        StoreInteract(peer).send_request("bulk_load", request, response);
+    }
+    for (auto& peer : region->info.learners()) {
+        pb::StoreRes response;
+        StoreInteract(peer).send_request("bulk_load", request, response);
+    }
+}
+
+int BulkLoader::upload_and_ingest() {
+    TimeCost cost;
+    std::atomic<int64_t> success_count{0};
+    std::vector<int64_t> failed_regions;
+    bthread::Mutex mutex;
+    ConcurrencyBthread bths(FLAGS_bulk_load_concurrency);
+    for (auto& pair : _regions) {
+        RegionTarget* region = pair.second.get();
+        if (region->file_size == 0) {
+            continue;
+        }
+        bths.run([this, region, &success_count, &failed_regions, &mutex]() {
+            int ret = 0;
+            for (auto& peer : region->info.peers()) {
+                if (ret == 0) {
+                    ret = upload(region, peer);
+                }
+            }
+            for (auto& peer : region->info.learners()) {
+                if (ret == 0) {
+                    ret = upload(region, peer);
+                }
+            }
+            if (ret == 0) {
+                ret = ingest(region);
+            }
+            if (ret != 0) {
+                clear(region);
+                BAIDU_SCOPED_LOCK(mutex);
+                failed_regions.emplace_back(region->info.region_id());
+                return;
+            }
+            std::remove(region->sst_path.c_str());
+            success_count++;
+        });
+    }
+    bths.join();
+    DB_NOTICE("bulk load done, load_id: %s, rows: %ld, success regions: %ld, failed regions: %lu, cost: %ld",
+            _load_id.c_str(), _num_rows, success_count.load(), failed_regions.size(), cost.get_time());
+    for (auto region_id : failed_regions) {
+        // sst保留在work_dir中，version变化的region需重新切分
+        DB_FATAL("bulk load failed region_id: %ld", region_id);
+    }
+    return failed_regions.empty() ? 0 : -1;
+}
+} // namespace baikaldb
+
+int main(int argc, char** argv) {
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    baikaldb::BulkLoader loader;
+    if (loader.init() != 0 || loader.partition() != 0 || loader.build_sst() != 0) {
+        return -1;
+    }
+    return loader.upload_and_ingest();
+}
+
+/* vim: set expandtab ts=4 sw=4 sts=4 tw=100: */
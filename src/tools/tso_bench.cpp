@@ -0,0 +1,84 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// 压测meta leader的tso吞吐
+// 默认每个bthread直接发rpc，每次申请tso_bench_count个，用于测量rpc上限
+// tso_bench_use_fetcher=true时走TsoFetcher的合并逻辑，用于观察合并后的rpc数和延迟
+#include <atomic>
+#include <stdio.h>
+#include <gflags/gflags.h>
+#include "common.h"
+#include "meta_server_interact.hpp"
+#include "binlog_context.h"
+
+namespace baikaldb {
+DEFINE_int32(tso_bench_concurrency, 64, "concurrent bthreads");
+DEFINE_int32(tso_bench_seconds, 30, "bench duration(s)");
+DEFINE_int64(tso_bench_count, 1, "tso count per rpc when not using fetcher");
+DEFINE_bool(tso_bench_use_fetcher, false, "get tso through TsoFetcher");
+
+int tso_bench() {
+    if (MetaServerInteract::get_tso_instance()->init() != 0) {
+        DB_FATAL("meta server interact init failed");
+        return -1;
+    }
+    std::atomic<int64_t> tso_count{0};
+    std::atomic<int64_t> fail_count{0};
+    LatencyOnly latency;
+    std::atomic<bool> stop{false};
+    int64_t end_time = butil::gettimeofday_us() + FLAGS_tso_bench_seconds * 1000 * 1000LL;
+    ConcurrencyBthread bths(FLAGS_tso_bench_concurrency);
+    for (int i = 0; i < FLAGS_tso_bench_concurrency; i++) {
+        bths.run([&]() {
+            while (!stop && butil::gettimeofday_us() < end_time) {
+                TimeCost cost;
+                int64_t count = FLAGS_tso_bench_use_fetcher ? 1 : FLAGS_tso_bench_count;
+                int64_t tso = FLAGS_tso_bench_use_fetcher ?
+                        TsoFetcher::get_tso() : TsoFetcher::gen_tso(count);
+                latency << cost.get_time();
+                if (tso < 0) {
+                    fail_count++;
+                    continue;
+                }
+                tso_count += count;
+            }
+        });
+    }
+    int64_t last_count = 0;
+    while (butil::gettimeofday_us() < end_time) {
+        bthread_usleep(1000 * 1000LL);
+        int64_t cur_count = tso_count.load();
+        printf("tso/s: %ld, latency(us): %ld, fail: %ld\n",
+                cur_count - last_count, latency.latency(), fail_count.load());
+        last_count = cur_count;
+    }
+    stop = true;
+    bths.join();
+    printf("concurrency: %d, seconds: %d, use_fetcher: %d, count_per_rpc: %ld, total tso: %ld, "
+            "tso/s: %ld, fail: %ld\n",
+            FLAGS_tso_bench_concurrency, FLAGS_tso_bench_seconds, FLAGS_tso_bench_use_fetcher,
+            FLAGS_tso_bench_count, tso_count.load(),
+            tso_count.load() / std::max(FLAGS_tso_bench_seconds, 1),
+            fail_count.load());
+    return 0;
+}
+} // namespace baikaldb
+
+int main(int argc, char** argv) {
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    google::SetCommandLineOption("flagfile", "conf/gflags.conf");
+    return baikaldb::tso_bench();
+}
+
+/* vim: set expandtab ts=4 sw=4 sts=4 tw=100: */
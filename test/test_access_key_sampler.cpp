@@ -0,0 +1,71 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include "access_key_sampler.h"
+#include "mut_table_key.h"
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+namespace baikaldb {
+static std::string make_key(int64_t pk) {
+    MutTableKey key;
+    key.append_i64(1).append_i64(2).append_i64(pk);
+    return key.data();
+}
+
+TEST(test_access_key_sampler, case_all) {
+    FLAGS_load_split_sample_interval = 1;
+    FLAGS_load_split_sample_keys = 100;
+    AccessKeySampler sampler;
+    // 只有region_id + index_id前缀的key只计数不采样
+    MutTableKey prefix;
+    prefix.append_i64(1).append_i64(2);
+    sampler.sample(prefix.data());
+    for (int64_t i = 0; i < 1000; i++) {
+        sampler.sample(make_key(i % 10));
+    }
+    std::vector<std::string> keys;
+    int64_t window_us = 0;
+    EXPECT_EQ(1001, sampler.swap_window(&keys, &window_us));
+    EXPECT_EQ(100, keys.size());
+    for (auto& key : keys) {
+        EXPECT_EQ(sizeof(int64_t), key.size());
+    }
+    EXPECT_EQ(0, sampler.swap_window(&keys, &window_us));
+    EXPECT_EQ(0, keys.size());
+
+    // 90%的访问落在pk 100上，中位数应为热点key
+    FLAGS_load_split_sample_keys = 1000;
+    for (int64_t i = 0; i < 10000; i++) {
+        sampler.sample(make_key(i % 10 == 0 ? i : 100));
+    }
+    sampler.swap_window(&keys, &window_us);
+    std::sort(keys.begin(), keys.end());
+    MutTableKey hot_key;
+    hot_key.append_i64(100);
+    EXPECT_EQ(hot_key.data(), keys[keys.size() / 2]);
+
+    sampler.sample(make_key(1));
+    sampler.reset();
+    EXPECT_EQ(0, sampler.swap_window(&keys, &window_us));
+}
+} // namespace baikaldb
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
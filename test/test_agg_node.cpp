@@ -0,0 +1,214 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <iostream>
+#include <map>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "agg_node.h"
+#include "runtime_state.h"
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+namespace baikaldb {
+DECLARE_int32(agg_parallel_partitions);
+DECLARE_int32(agg_parallel_chunk_rows);
+DECLARE_bool(agg_enable_spill);
+DECLARE_int64(agg_spill_memory_bytes);
+DECLARE_int32(agg_spill_partitions);
+DECLARE_string(sort_spill_dir);
+
+// 按batch吐出预先生成的行
+class MockScanNode : public ExecNode {
+public:
+    MockScanNode(MemRowDescriptor* desc, int batch_cnt, int batch_rows) {
+        for (int b = 0; b < batch_cnt; b++) {
+            std::shared_ptr<RowBatch> batch = std::make_shared<RowBatch>();
+            for (int i = 0; i < batch_rows; i++) {
+                std::unique_ptr<MemRow> row = desc->fetch_mem_row();
+                int64_t id = b * batch_rows + i;
+                ExprValue k(pb::INT64);
+                k._u.int64_val = (id * 7919) % 997;
+                row->set_value(0, 1, k);
+                ExprValue v(pb::INT64);
+                v._u.int64_val = id;
+                row->set_value(0, 2, v);
+                batch->move_row(std::move(row));
+            }
+            _batches.push_back(batch);
+        }
+    }
+    virtual int open(RuntimeState* state) {
+        return 0;
+    }
+    virtual int get_next(RuntimeState* state, RowBatch* batch, bool* eos) {
+        if (_idx < _batches.size()) {
+            auto& src = _batches[_idx++];
+            for (src->reset(); !src->is_traverse_over(); src->next()) {
+                batch->move_row(std::move(src->get_row()));
+            }
+        }
+        *eos = _idx >= _batches.size();
+        return 0;
+    }
+
+private:
+    std::vector<std::shared_ptr<RowBatch>> _batches;
+    size_t _idx = 0;
+};
+
+// tuple 0: (INT64 k, INT64 v), tuple 1: (count(v), sum(v))
+static int init_desc(MemRowDescriptor* desc) {
+    std::vector<pb::TupleDescriptor> tuple_desc;
+    for (int t = 0; t < 2; t++) {
+        pb::TupleDescriptor tuple;
+        tuple.set_tuple_id(t);
+        tuple.set_table_id(t + 1);
+        for (int i = 0; i < 2; i++) {
+            pb::SlotDescriptor* slot = tuple.add_slots();
+            slot->set_slot_id(i + 1);
+            slot->set_slot_type(pb::INT64);
+            slot->set_tuple_id(t);
+        }
+        tuple_desc.push_back(tuple);
+    }
+    return desc->init(tuple_desc);
+}
+
+static void add_slot_ref(pb::Expr* expr, int32_t tuple_id, int32_t slot_id) {
+    pb::ExprNode* node = expr->add_nodes();
+    node->set_node_type(pb::SLOT_REF);
+    node->set_col_type(pb::INT64);
+    node->set_num_children(0);
+    node->mutable_derive_node()->set_tuple_id(tuple_id);
+    node->mutable_derive_node()->set_slot_id(slot_id);
+}
+
+static void add_agg_func(pb::AggNode* agg, const std::string& name, int32_t slot_id) {
+    pb::Expr* expr = agg->add_agg_funcs();
+    pb::ExprNode* node = expr->add_nodes();
+    node->set_node_type(pb::AGG_EXPR);
+    node->set_col_type(pb::INT64);
+    node->set_num_children(1);
+    node->mutable_fn()->set_name(name);
+    node->mutable_fn()->set_fn_op(0);
+    node->mutable_derive_node()->set_tuple_id(1);
+    node->mutable_derive_node()->set_slot_id(slot_id);
+    node->mutable_derive_node()->set_intermediate_slot_id(slot_id);
+    add_slot_ref(expr, 0, 2);
+}
+
+// select k, count(v), sum(v) from t group by k
+// other_bytes为其他算子计入MemTracker的内存，落盘不能归还
+static void run_agg(std::map<int64_t, std::pair<int64_t, int64_t>>* result,
+        int64_t other_bytes = 0) {
+    RuntimeState state;
+    ASSERT_EQ(0, init_desc(state.mem_row_desc()));
+    if (other_bytes > 0) {
+        ASSERT_EQ(0, state.memory_limit_exceeded(other_bytes));
+    }
+    pb::PlanNode pb_node;
+    pb_node.set_node_type(pb::AGG_NODE);
+    pb_node.set_num_children(1);
+    pb_node.set_limit(-1);
+    pb::AggNode* pb_agg = pb_node.mutable_derive_node()->mutable_agg_node();
+    add_slot_ref(pb_agg->add_group_exprs(), 0, 1);
+    add_agg_func(pb_agg, "count", 1);
+    add_agg_func(pb_agg, "sum", 2);
+    pb_agg->set_agg_tuple_id(1);
+
+    AggNode agg;
+    ASSERT_EQ(0, agg.init(pb_node));
+    agg.add_child(new MockScanNode(state.mem_row_desc(), 30, 200));
+    ASSERT_EQ(0, agg.open(&state));
+    bool eos = false;
+    while (!eos) {
+        RowBatch batch;
+        ASSERT_EQ(0, agg.get_next(&state, &batch, &eos));
+        for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
+            MemRow* row = batch.get_row().get();
+            int64_t k = row->get_value(0, 1).get_numberic<int64_t>();
+            EXPECT_EQ(0u, result->count(k));
+            (*result)[k] = std::make_pair(row->get_value(1, 1).get_numberic<int64_t>(),
+                    row->get_value(1, 2).get_numberic<int64_t>());
+        }
+    }
+    EXPECT_GE(state.used_bytes(), other_bytes);
+    agg.close(&state);
+}
+
+static void expect_same(const std::map<int64_t, std::pair<int64_t, int64_t>>& expect,
+        const std::map<int64_t, std::pair<int64_t, int64_t>>& result) {
+    ASSERT_EQ(expect.size(), result.size());
+    int64_t total = 0;
+    for (auto& pair : expect) {
+        auto iter = result.find(pair.first);
+        ASSERT_TRUE(iter != result.end());
+        EXPECT_EQ(pair.second, iter->second);
+        total += iter->second.first;
+    }
+    EXPECT_EQ(30 * 200, total);
+}
+
+static void run_in_memory(std::map<int64_t, std::pair<int64_t, int64_t>>* result) {
+    FLAGS_agg_parallel_partitions = 1;
+    FLAGS_agg_enable_spill = false;
+    run_agg(result);
+    FLAGS_agg_enable_spill = true;
+}
+
+TEST(test_agg_node, spill_same_as_memory) {
+    std::map<int64_t, std::pair<int64_t, int64_t>> expect;
+    run_in_memory(&expect);
+    EXPECT_EQ(997u, expect.size());
+
+    FLAGS_sort_spill_dir = "./agg_spill_test";
+    FLAGS_agg_spill_memory_bytes = 1;
+    FLAGS_agg_spill_partitions = 4;
+    std::map<int64_t, std::pair<int64_t, int64_t>> result;
+    // 输入行没有计入MemTracker
+    run_agg(&result, 1000000);
+    expect_same(expect, result);
+    // 每个分区输出后删除文件
+    boost::filesystem::directory_iterator end;
+    EXPECT_TRUE(boost::filesystem::directory_iterator(FLAGS_sort_spill_dir) == end);
+    FLAGS_agg_spill_memory_bytes = 2147483648LL;
+}
+
+TEST(test_agg_node, parallel_same_as_serial) {
+    std::map<int64_t, std::pair<int64_t, int64_t>> expect;
+    run_in_memory(&expect);
+
+    FLAGS_agg_parallel_partitions = 4;
+    FLAGS_agg_parallel_chunk_rows = 1000;
+    std::map<int64_t, std::pair<int64_t, int64_t>> result;
+    run_agg(&result);
+    expect_same(expect, result);
+
+    // 并行聚合同时落盘
+    FLAGS_sort_spill_dir = "./agg_spill_test";
+    FLAGS_agg_spill_memory_bytes = 1;
+    result.clear();
+    run_agg(&result);
+    expect_same(expect, result);
+    FLAGS_agg_spill_memory_bytes = 2147483648LL;
+    FLAGS_agg_parallel_partitions = 8;
+}
+
+}  // namespace baikaldb
@@ -0,0 +1,288 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#include "region.h"
+#include "meta_writer.h"
+#include "mut_table_key.h"
+#include "sst_file_writer.h"
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+namespace baikaldb {
+DECLARE_string(db_path);
+
+static const int64_t INDEX_ID = 1;
+static const std::string WORK_DIR = "./bulk_load_test";
+
+static std::string pk_key(int64_t pk) {
+    MutTableKey key;
+    key.append_i64(pk);
+    return key.data();
+}
+
+static std::string data_key(int64_t region_id, int64_t pk) {
+    MutTableKey key;
+    key.append_i64(region_id).append_i64(INDEX_ID);
+    key.append_index(pk_key(pk));
+    return key.data();
+}
+
+// 模拟导入工具生成[begin, end)的sst，返回文件内容
+static std::string write_sst(int64_t region_id, int64_t begin, int64_t end) {
+    std::string path = WORK_DIR + "/" + std::to_string(region_id) + ".sst";
+    rocksdb::Options options;
+    options.prefix_extractor.reset(rocksdb::NewFixedPrefixTransform(sizeof(int64_t) * 2));
+    SstFileWriter writer(options);
+    EXPECT_TRUE(writer.open(path).ok());
+    for (int64_t pk = begin; pk < end; pk++) {
+        EXPECT_TRUE(writer.put(data_key(region_id, pk), "value").ok());
+    }
+    EXPECT_TRUE(writer.finish().ok());
+    std::ifstream fp(path, std::ios::in | std::ios::binary);
+    std::stringstream ss;
+    ss << fp.rdbuf();
+    return ss.str();
+}
+
+class RegionBulkLoadTest : public testing::Test {
+protected:
+    static void SetUpTestCase() {
+        FLAGS_db_path = "./rocks_bulk_load";
+        boost::filesystem::remove_all(FLAGS_db_path);
+        boost::filesystem::remove_all(WORK_DIR);
+        boost::filesystem::create_directories(WORK_DIR);
+        RocksWrapper* rocksdb = RocksWrapper::get_instance();
+        ASSERT_EQ(0, rocksdb->init(FLAGS_db_path));
+        MetaWriter::get_instance()->init(rocksdb, rocksdb->get_meta_info_handle());
+    }
+    void TearDown() override {
+        for (auto& region : _regions) {
+            // raft node没有init，不需要shutdown
+            region->_shutdown = true;
+        }
+        _regions.clear();
+    }
+    // 不启动raft，只初始化bulk load用到的成员，没有其他peer
+    Region* new_region(int64_t region_id, const std::string& start_key = "",
+            const std::string& end_key = "") {
+        pb::RegionInfo info;
+        info.set_region_id(region_id);
+        info.set_table_id(INDEX_ID);
+        info.set_start_key(start_key);
+        info.set_end_key(end_key);
+        info.set_version(1);
+        info.set_status(pb::IDLE);
+        braft::PeerId peer_id;
+        peer_id.parse("127.0.0.1:8110:0");
+        std::shared_ptr<Region> region = std::make_shared<Region>(RocksWrapper::get_instance(),
+                SchemaFactory::get_instance(), "127.0.0.1:8110", "bulk_load_test",
+                peer_id, info, region_id);
+        region->_data_cf = RocksWrapper::get_instance()->get_data_handle();
+        region->_meta_writer = MetaWriter::get_instance();
+        region->_init_success = true;
+        _regions.push_back(region);
+        return region.get();
+    }
+    pb::ErrCode bulk_load(Region* region, pb::BulkLoadOp op, const std::string& load_id,
+            int64_t offset, const std::string& data, int64_t file_size = 0) {
+        brpc::Controller cntl;
+        cntl.request_attachment().append(data);
+        pb::BulkLoadRequest request;
+        request.set_region_id(region->get_region_id());
+        request.set_op(op);
+        request.set_load_id(load_id);
+        request.set_offset(offset);
+        request.set_file_size(file_size);
+        pb::StoreRes response;
+        region->process_bulk_load(&cntl, &request, &response);
+        return response.errcode();
+    }
+    // 分两块上传
+    void upload(Region* region, const std::string& load_id, const std::string& data) {
+        size_t half = data.size() / 2;
+        ASSERT_EQ(pb::SUCCESS, bulk_load(region, pb::BULK_LOAD_UPLOAD, load_id, 0,
+                data.substr(0, half)));
+        ASSERT_EQ(pb::SUCCESS, bulk_load(region, pb::BULK_LOAD_UPLOAD, load_id, half,
+                data.substr(half)));
+    }
+    pb::StoreReq ingest_request(const std::string& load_id, int64_t size, int64_t rows) {
+        pb::StoreReq request;
+        request.set_op_type(pb::OP_BULK_INGEST);
+        request.set_region_id(0);
+        request.set_region_version(1);
+        request.set_bulk_load_id(load_id);
+        request.set_bulk_load_size(size);
+        request.set_num_increase_rows(rows);
+        return request;
+    }
+    // leader校验通过后状态为DOING，正常由raft回调重置；request中记录sst的key区间
+    int check_ingest(Region* region, pb::StoreReq& request) {
+        pb::StoreRes response;
+        int ret = region->check_bulk_ingest(&request, &response);
+        if (ret == 0) {
+            region->reset_region_status();
+        }
+        return ret;
+    }
+    int apply_ingest(Region* region, const pb::StoreReq& request) {
+        return region->apply_bulk_ingest(request, nullptr);
+    }
+    void put_row(int64_t region_id, int64_t pk) {
+        RocksWrapper* rocksdb = RocksWrapper::get_instance();
+        ASSERT_TRUE(rocksdb->put(rocksdb::WriteOptions(), rocksdb->get_data_handle(),
+                data_key(region_id, pk), "exist").ok());
+    }
+    static int64_t count_rows(int64_t region_id) {
+        RocksWrapper* rocksdb = RocksWrapper::get_instance();
+        rocksdb::ReadOptions read_options;
+        read_options.prefix_same_as_start = false;
+        read_options.total_order_seek = true;
+        std::unique_ptr<rocksdb::Iterator> iter(rocksdb->new_iterator(read_options,
+                rocksdb->get_data_handle()));
+        MutTableKey prefix;
+        prefix.append_i64(region_id);
+        int64_t count = 0;
+        for (iter->Seek(prefix.data());
+                iter->Valid() && iter->key().starts_with(prefix.data()); iter->Next()) {
+            ++count;
+        }
+        return count;
+    }
+    std::vector<std::shared_ptr<Region>> _regions;
+};
+
+TEST_F(RegionBulkLoadTest, upload_check_ingest) {
+    Region* region = new_region(101);
+    std::string data = write_sst(101, 0, 10);
+    int64_t size = data.size();
+    upload(region, "load1", data);
+    // 续传的offset必须等于已上传的大小
+    EXPECT_EQ(pb::INPUT_PARAM_ERROR, bulk_load(region, pb::BULK_LOAD_UPLOAD, "load1", 1, "x"));
+    EXPECT_EQ(pb::INPUT_PARAM_ERROR, bulk_load(region, pb::BULK_LOAD_UPLOAD, "../load1", 0, "x"));
+    EXPECT_EQ(pb::EXEC_FAIL, bulk_load(region, pb::BULK_LOAD_CHECK, "load1", 0, "", size + 1));
+    EXPECT_EQ(pb::SUCCESS, bulk_load(region, pb::BULK_LOAD_CHECK, "load1", 0, "", size));
+
+    pb::StoreReq request = ingest_request("load1", size, 10);
+    ASSERT_EQ(0, check_ingest(region, request));
+    ASSERT_EQ(0, apply_ingest(region, request));
+    EXPECT_EQ(10, region->get_num_table_lines());
+    EXPECT_EQ(10, count_rows(101));
+    EXPECT_EQ(pb::STATUS_NORMAL, region->region_status());
+    // ingest后文件被move或删除
+    EXPECT_FALSE(boost::filesystem::exists(region->bulk_load_sst_path("load1")));
+}
+
+TEST_F(RegionBulkLoadTest, refuse_non_empty_region) {
+    Region* region = new_region(102);
+    std::string data = write_sst(102, 0, 10);
+    upload(region, "load1", data);
+    pb::StoreReq request = ingest_request("load1", data.size(), 10);
+    ASSERT_EQ(0, check_ingest(region, request));
+    ASSERT_EQ(0, apply_ingest(region, request));
+
+    // 区间不重叠也拒绝导入已有数据的region
+    data = write_sst(102, 100, 110);
+    upload(region, "load2", data);
+    request = ingest_request("load2", data.size(), 10);
+    EXPECT_EQ(-1, check_ingest(region, request));
+    // 各peer apply时同样放弃，数据不变
+    EXPECT_EQ(0, apply_ingest(region, request));
+    EXPECT_EQ(10, region->get_num_table_lines());
+    EXPECT_EQ(10, count_rows(102));
+    EXPECT_FALSE(boost::filesystem::exists(region->bulk_load_sst_path("load2")));
+}
+
+TEST_F(RegionBulkLoadTest, refuse_overlap) {
+    Region* region = new_region(103);
+    // num_table_lines为0，但区间内已有key
+    put_row(103, 5);
+    std::string data = write_sst(103, 0, 10);
+    upload(region, "load1", data);
+    pb::StoreReq request = ingest_request("load1", data.size(), 10);
+    EXPECT_EQ(-1, check_ingest(region, request));
+    EXPECT_EQ(0, apply_ingest(region, request));
+    EXPECT_EQ(1, count_rows(103));
+
+    // sst的key不属于本region
+    data = write_sst(104, 0, 10);
+    upload(region, "load2", data);
+    request = ingest_request("load2", data.size(), 10);
+    EXPECT_EQ(-1, check_ingest(region, request));
+    EXPECT_EQ(0, count_rows(104));
+
+    // 已有key在sst区间之外可以导入
+    data = write_sst(103, 10, 20);
+    upload(region, "load3", data);
+    request = ingest_request("load3", data.size(), 10);
+    ASSERT_EQ(0, check_ingest(region, request));
+    ASSERT_EQ(0, apply_ingest(region, request));
+    EXPECT_EQ(11, count_rows(103));
+}
+
+TEST_F(RegionBulkLoadTest, refuse_out_of_range) {
+    Region* region = new_region(106, pk_key(100), pk_key(200));
+    std::string data = write_sst(106, 150, 250);
+    upload(region, "load1", data);
+    pb::StoreReq request = ingest_request("load1", data.size(), 100);
+    EXPECT_EQ(-1, check_ingest(region, request));
+
+    data = write_sst(106, 50, 150);
+    upload(region, "load2", data);
+    request = ingest_request("load2", data.size(), 100);
+    EXPECT_EQ(-1, check_ingest(region, request));
+
+    data = write_sst(106, 100, 200);
+    upload(region, "load3", data);
+    request = ingest_request("load3", data.size(), 100);
+    ASSERT_EQ(0, check_ingest(region, request));
+    ASSERT_EQ(0, apply_ingest(region, request));
+    EXPECT_EQ(100, count_rows(106));
+}
+
+TEST_F(RegionBulkLoadTest, replay_after_ingest) {
+    Region* region = new_region(107);
+    std::string data = write_sst(107, 0, 10);
+    upload(region, "load1", data);
+    pb::StoreReq request = ingest_request("load1", data.size(), 10);
+    ASSERT_EQ(0, check_ingest(region, request));
+    ASSERT_EQ(0, apply_ingest(region, request));
+    // 模拟ingest后、行数和apply_index落盘前重启：文件已被移走，重放视为成功
+    region->_num_table_lines = 0;
+    EXPECT_EQ(0, apply_ingest(region, request));
+    EXPECT_EQ(pb::STATUS_NORMAL, region->region_status());
+    EXPECT_EQ(10, region->get_num_table_lines());
+    EXPECT_EQ(10, count_rows(107));
+}
+
+TEST_F(RegionBulkLoadTest, missing_file_stop_serving) {
+    Region* region = new_region(105);
+    std::string data = write_sst(105, 0, 10);
+    // 文件未上传时leader不会发起ingest
+    pb::StoreReq request = ingest_request("load1", data.size(), 10);
+    EXPECT_EQ(-1, check_ingest(region, request));
+    // 校验后文件丢失的peer进入error状态
+    EXPECT_EQ(-1, apply_ingest(region, request));
+    EXPECT_EQ(pb::STATUS_ERROR, region->region_status());
+    EXPECT_EQ(0, count_rows(105));
+}
+
+}  // namespace baikaldb
@@ -25,6 +25,7 @@
 #include "proto/meta.interface.pb.h"
 #include "cmsketch.h"
 #include "histogram.h"
+#include "statistics.h"
 #include <vector>
 DEFINE_int32(test_total , 10 * 10000, "num");
 DEFINE_int32(test_depth , 5, "num");
@@ -406,6 +407,34 @@ int main(int argc, char* argv[]) {
 
     }
 
+    // 多列统计：city完全由province决定，组合选择率应接近1/100而不是1/100*1/10
+    {
+        baikaldb::CMsketch cmsketch(FLAGS_test_depth, FLAGS_test_width);
+        std::vector<int32_t> field_ids = {1, 2};
+        for (int i = 0; i < 10000; i++) {
+            int city = i % 100;
+            int province = city / 10;
+            uint64_t hash = baikaldb::multi_column_hash(0, province);
+            hash = baikaldb::multi_column_hash(hash, city);
+            cmsketch.set_multi_value(100, field_ids, hash);
+        }
+        cmsketch.set_multi_distinct(100, 2, 100);
+        baikaldb::pb::Statistics stat_pb;
+        stat_pb.set_table_id(1);
+        stat_pb.mutable_histogram()->set_sample_rows(10000);
+        stat_pb.mutable_histogram()->set_total_rows(10000);
+        cmsketch.to_proto(stat_pb.mutable_cmsketch());
+        EXPECT_EQ(stat_pb.cmsketch().multi_columns_size(), 1);
+        EXPECT_EQ(stat_pb.cmsketch().multi_columns(0).distinct_cnt(), 100);
+
+        baikaldb::Statistics stat(stat_pb);
+        uint64_t hash = baikaldb::multi_column_hash(0, 3);
+        hash = baikaldb::multi_column_hash(hash, 35);
+        double r = stat.get_multi_column_ratio(field_ids, {hash});
+        EXPECT_EQ(true, r > 0.005 && r < 0.02);
+        r = stat.get_multi_column_ratio({2, 1}, {hash});
+        EXPECT_EQ(true, r < 0);
+    }
  
     sleep(1);
 
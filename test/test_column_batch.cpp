@@ -0,0 +1,327 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <iostream>
+#include <vector>
+#include "mem_row_descriptor.h"
+#include "mem_row.h"
+#include "column_batch.h"
+#include "arrow_row_codec.h"
+#include "slot_ref.h"
+#include "fn_manager.h"
+#include "parser.h"
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+namespace baikaldb {
+
+static pb::TupleDescriptor make_tuple_desc() {
+    pb::TupleDescriptor tuple;
+    tuple.set_tuple_id(0);
+    tuple.set_table_id(1);
+    std::vector<pb::PrimitiveType> types = {pb::INT32, pb::UINT64, pb::DOUBLE, pb::STRING, pb::DATETIME};
+    for (size_t i = 0; i < types.size(); i++) {
+        pb::SlotDescriptor* slot = tuple.add_slots();
+        slot->set_slot_id(i + 1);
+        slot->set_slot_type(types[i]);
+        slot->set_tuple_id(0);
+    }
+    return tuple;
+}
+
+static int init_desc(MemRowDescriptor* desc) {
+    std::vector<pb::TupleDescriptor> tuple_desc;
+    tuple_desc.push_back(make_tuple_desc());
+    return desc->init(tuple_desc);
+}
+
+static void fill_batch(MemRowDescriptor* desc, RowBatch* batch) {
+    for (int i = 0; i < 100; i++) {
+        std::unique_ptr<MemRow> row = desc->fetch_mem_row();
+        ExprValue v1(pb::INT32);
+        v1._u.int32_val = i - 50;
+        row->set_value(0, 1, v1);
+        if (i % 10 != 0) {
+            ExprValue v2(pb::UINT64);
+            v2._u.uint64_val = i * 1000;
+            row->set_value(0, 2, v2);
+        }
+        ExprValue v3(pb::DOUBLE);
+        v3._u.double_val = i * 0.5;
+        row->set_value(0, 3, v3);
+        ExprValue v4(pb::STRING);
+        v4.str_val = "str_" + std::to_string(i);
+        row->set_value(0, 4, v4);
+        batch->move_row(std::move(row));
+    }
+}
+
+TEST(test_column_batch, row_to_column_and_back) {
+    MemRowDescriptor desc;
+    ASSERT_EQ(0, init_desc(&desc));
+    RowBatch batch;
+    fill_batch(&desc, &batch);
+    ColumnBatch columns;
+    EXPECT_EQ(0, columns.add_column(0, 1, pb::INT32));
+    EXPECT_EQ(1, columns.add_column(0, 2, pb::UINT64));
+    EXPECT_EQ(2, columns.add_column(0, 3, pb::DOUBLE));
+    EXPECT_EQ(3, columns.add_column(0, 4, pb::STRING));
+    EXPECT_EQ(-1, columns.add_column(0, 1, pb::STRING));
+    ASSERT_EQ(0, columns.append_rows(&batch));
+    ASSERT_EQ(100u, columns.num_rows());
+
+    ColumnVector* col1 = columns.get_column(0, 1);
+    ColumnVector* col2 = columns.get_column(0, 2);
+    ASSERT_TRUE(col1 != nullptr);
+    ASSERT_TRUE(col2 != nullptr);
+    EXPECT_EQ(COL_INT, col1->storage());
+    EXPECT_EQ(-50, col1->int_data()[0]);
+    EXPECT_EQ(49, col1->int_data()[99]);
+    EXPECT_EQ(10u, col2->null_count());
+    EXPECT_TRUE(col2->is_null(0));
+    EXPECT_EQ(1000u, col2->uint_data()[1]);
+    EXPECT_EQ("str_7", columns.get_column(0, 4)->string_data()[7]);
+
+    for (size_t i = 0; i < batch.size(); i++) {
+        MemRow* row = batch.get_row(i).get();
+        for (int32_t slot = 1; slot <= 4; slot++) {
+            ExprValue expect = row->get_value(0, slot);
+            ExprValue actual = columns.get_column(0, slot)->get_value(i);
+            EXPECT_EQ(expect.is_null(), actual.is_null());
+            if (!expect.is_null()) {
+                EXPECT_EQ(0, expect.compare(actual));
+            }
+        }
+    }
+
+    RowBatch out;
+    ASSERT_EQ(0, columns.to_row_batch(&desc, &out));
+    ASSERT_EQ(batch.size(), out.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        std::string l;
+        std::string r;
+        batch.get_row(i)->to_string(0, &l);
+        out.get_row(i)->to_string(0, &r);
+        EXPECT_EQ(l, r);
+    }
+}
+
+TEST(test_column_batch, arrow_codec) {
+    MemRowDescriptor desc;
+    ASSERT_EQ(0, init_desc(&desc));
+    RowBatch batch;
+    fill_batch(&desc, &batch);
+    // 两端各自由tuple desc构造schema
+    pb::TupleDescriptor tuple = make_tuple_desc();
+    ArrowRowCodec encoder;
+    ASSERT_EQ(0, encoder.init({&tuple}));
+    for (size_t i = 0; i < batch.size(); i++) {
+        ASSERT_EQ(0, encoder.append_row(batch.get_row(i).get()));
+    }
+    std::string data;
+    ASSERT_EQ(0, encoder.serialize(&data));
+    EXPECT_EQ(0u, encoder.num_rows());
+
+    ArrowRowCodec decoder;
+    ASSERT_EQ(0, decoder.init({&tuple}));
+    RowBatch out;
+    ASSERT_EQ(0, decoder.deserialize(data, &desc, &out));
+    ASSERT_EQ(batch.size(), out.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        std::string l;
+        std::string r;
+        batch.get_row(i)->to_string(0, &l);
+        out.get_row(i)->to_string(0, &r);
+        EXPECT_EQ(l, r);
+    }
+
+    pb::TupleDescriptor bad_tuple = tuple;
+    bad_tuple.mutable_slots(0)->set_slot_type(pb::HLL);
+    ArrowRowCodec fallback;
+    EXPECT_EQ(-1, fallback.init({&bad_tuple}));
+}
+
+TEST(test_column_batch, compare_row) {
+    MemRowDescriptor desc;
+    ASSERT_EQ(0, init_desc(&desc));
+    RowBatch batch;
+    std::vector<std::pair<int32_t, std::string>> values = {{3, "a"}, {1, "b"}, {1, "a"}, {2, "c"}};
+    for (auto& pair : values) {
+        std::unique_ptr<MemRow> row = desc.fetch_mem_row();
+        ExprValue v1(pb::INT32);
+        v1._u.int32_val = pair.first;
+        row->set_value(0, 1, v1);
+        ExprValue v4(pb::STRING);
+        v4.str_val = pair.second;
+        row->set_value(0, 4, v4);
+        batch.move_row(std::move(row));
+    }
+    std::unique_ptr<MemRow> null_row = desc.fetch_mem_row();
+    batch.move_row(std::move(null_row));
+
+    std::vector<ExprNode*> exprs;
+    for (int32_t slot : {1, 4}) {
+        pb::ExprNode node;
+        node.set_node_type(pb::SLOT_REF);
+        node.set_col_type(slot == 1 ? pb::INT32 : pb::STRING);
+        node.set_num_children(0);
+        node.mutable_derive_node()->set_tuple_id(0);
+        node.mutable_derive_node()->set_slot_id(slot);
+        SlotRef* slot_ref = new SlotRef;
+        slot_ref->init(node);
+        exprs.push_back(slot_ref);
+    }
+    std::vector<bool> is_asc = {true, false};
+    std::vector<bool> is_null_first = {true, true};
+    ColumnBatch columns;
+    ASSERT_EQ(0, columns.add_slot_ref_columns(exprs));
+    ASSERT_EQ(0, columns.append_rows(&batch));
+    MemRowCompare comp(exprs, is_asc, is_null_first);
+    for (size_t i = 0; i < batch.size(); i++) {
+        for (size_t j = 0; j < batch.size(); j++) {
+            int64_t expect = comp.compare(batch.get_row(i).get(), batch.get_row(j).get());
+            int64_t actual = columns.compare_row(i, j, is_asc, is_null_first);
+            EXPECT_EQ(expect < 0, actual < 0);
+            EXPECT_EQ(expect == 0, actual == 0);
+        }
+    }
+    for (auto expr : exprs) {
+        delete expr;
+    }
+}
+
+static void add_slot_node(pb::Expr* expr, int32_t slot_id, pb::PrimitiveType type) {
+    pb::ExprNode* node = expr->add_nodes();
+    node->set_node_type(pb::SLOT_REF);
+    node->set_col_type(type);
+    node->set_num_children(0);
+    node->mutable_derive_node()->set_tuple_id(0);
+    node->mutable_derive_node()->set_slot_id(slot_id);
+}
+
+static void add_fn_node(pb::Expr* expr, pb::ExprNodeType node_type, const std::string& name,
+        int32_t fn_op, pb::PrimitiveType arg_type, pb::PrimitiveType ret_type, int num_children) {
+    pb::ExprNode* node = expr->add_nodes();
+    node->set_node_type(node_type);
+    node->set_col_type(ret_type);
+    node->set_num_children(num_children);
+    pb::Function* fn = node->mutable_fn();
+    fn->set_name(name);
+    fn->set_fn_op(fn_op);
+    for (int i = 0; i < num_children; i++) {
+        fn->add_arg_types(arg_type);
+    }
+    fn->set_return_type(ret_type);
+}
+
+TEST(test_column_batch, vectorized_expr) {
+    FunctionManager::instance()->init();
+    MemRowDescriptor desc;
+    ASSERT_EQ(0, init_desc(&desc));
+    RowBatch batch;
+    fill_batch(&desc, &batch);
+
+    // ((slot1 + 10) > 20 and not (slot2 is null)) or slot4 in ('str_1', 'str_3')
+    pb::Expr expr;
+    add_fn_node(&expr, pb::OR_PREDICATE, "logic_or", parser::FT_LOGIC_OR, pb::BOOL, pb::BOOL, 2);
+    add_fn_node(&expr, pb::AND_PREDICATE, "logic_and", parser::FT_LOGIC_AND, pb::BOOL, pb::BOOL, 2);
+    add_fn_node(&expr, pb::FUNCTION_CALL, "gt_int_int", parser::FT_GT, pb::INT64, pb::BOOL, 2);
+    add_fn_node(&expr, pb::FUNCTION_CALL, "add_int_int", parser::FT_ADD, pb::INT64, pb::INT64, 2);
+    add_slot_node(&expr, 1, pb::INT32);
+    for (int64_t val : {10, 20}) {
+        pb::ExprNode* node = expr.add_nodes();
+        node->set_node_type(pb::INT_LITERAL);
+        node->set_col_type(pb::INT64);
+        node->set_num_children(0);
+        node->mutable_derive_node()->set_int_val(val);
+    }
+    add_fn_node(&expr, pb::NOT_PREDICATE, "logic_not", parser::FT_LOGIC_NOT, pb::BOOL, pb::BOOL, 1);
+    add_fn_node(&expr, pb::IS_NULL_PREDICATE, "is_null", parser::FT_IS_NULL, pb::UINT64, pb::BOOL, 1);
+    add_slot_node(&expr, 2, pb::UINT64);
+    add_fn_node(&expr, pb::IN_PREDICATE, "in", parser::FT_IN, pb::STRING, pb::BOOL, 3);
+    add_slot_node(&expr, 4, pb::STRING);
+    for (auto val : {"str_1", "str_3"}) {
+        pb::ExprNode* node = expr.add_nodes();
+        node->set_node_type(pb::STRING_LITERAL);
+        node->set_col_type(pb::STRING);
+        node->set_num_children(0);
+        node->mutable_derive_node()->set_string_val(val);
+    }
+    ExprNode* root = nullptr;
+    ASSERT_EQ(0, ExprNode::create_tree(expr, &root));
+    ASSERT_EQ(0, root->open());
+    ASSERT_TRUE(root->can_vectorize());
+
+    ColumnBatch columns;
+    std::vector<ExprNode*> slot_refs;
+    root->get_all_slot_refs(slot_refs);
+    for (auto slot_ref : slot_refs) {
+        ASSERT_LE(0, columns.add_column(slot_ref->tuple_id(), slot_ref->slot_id(),
+                    slot_ref->col_type()));
+    }
+    ASSERT_EQ(0, columns.append_rows(&batch));
+    const ColumnVector* result = root->get_batch_value(&columns);
+    ASSERT_TRUE(result != nullptr);
+    ASSERT_EQ(batch.size(), result->size());
+    size_t true_cnt = 0;
+    for (size_t i = 0; i < batch.size(); i++) {
+        ExprValue expect = root->get_value(batch.get_row(i).get());
+        ExprValue actual = result->get_value(i);
+        EXPECT_EQ(expect.is_null(), actual.is_null());
+        if (!expect.is_null()) {
+            EXPECT_EQ(expect.get_numberic<bool>(), actual.get_numberic<bool>());
+            true_cnt += expect.get_numberic<bool>();
+        }
+    }
+    // slot1+10>20 即 i>60，去掉slot2为null的3行，再加上in命中的2行
+    EXPECT_EQ(38u, true_cnt);
+    root->close();
+    ExprNode::destroy_tree(root);
+}
+
+// get_batch_value只支持double的除法和整数的取模，其他类型不能向量化
+TEST(test_column_batch, vectorize_divide_mod_type) {
+    FunctionManager::instance()->init();
+    struct Case {
+        std::string name;
+        int32_t fn_op;
+        pb::PrimitiveType type;
+        bool expect;
+    };
+    std::vector<Case> cases = {
+        {"divides_int_int", parser::FT_DIVIDES, pb::INT64, false},
+        {"divides_uint_uint", parser::FT_DIVIDES, pb::UINT64, false},
+        {"divides_double_double", parser::FT_DIVIDES, pb::DOUBLE, true},
+        {"mod_int_int", parser::FT_MOD, pb::INT64, true},
+    };
+    for (auto& c : cases) {
+        pb::Expr expr;
+        add_fn_node(&expr, pb::FUNCTION_CALL, c.name, c.fn_op, c.type, c.type, 2);
+        add_slot_node(&expr, 1, c.type);
+        add_slot_node(&expr, 1, c.type);
+        ExprNode* root = nullptr;
+        ASSERT_EQ(0, ExprNode::create_tree(expr, &root));
+        ASSERT_EQ(0, root->open());
+        EXPECT_EQ(c.expect, root->can_vectorize()) << c.name;
+        root->close();
+        ExprNode::destroy_tree(root);
+    }
+}
+
+}  // namespace baikaldb
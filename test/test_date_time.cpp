@@ -202,4 +202,18 @@ TEST(test_datetime_timestamp, case_all) {
     //EXPECT_EQ(datetime_to_str(timestamp_to_datetime(str_to_timestamp("2017-12-03 19:28:44"))), "2017-12-03 19:28:44");
 }
 
+TEST(test_datetime_to_buf, case_all) {
+    char buf[DATETIME_STR_MAX_LEN];
+    size_t len = datetime_to_str(str_to_datetime("2017-12-03 19:28:44.000123"), buf);
+    EXPECT_EQ(std::string(buf, len), "2017-12-03 19:28:44.000123");
+    len = datetime_to_str(str_to_datetime("0001-02-03 04:05:06"), buf);
+    EXPECT_EQ(std::string(buf, len), "0001-02-03 04:05:06");
+    len = date_to_str(datetime_to_date(str_to_datetime("2017-12-03")), buf);
+    EXPECT_EQ(std::string(buf, len), "2017-12-03");
+    len = time_to_str(str_to_time("-1192844"), buf);
+    EXPECT_EQ(std::string(buf, len), "-119:28:44");
+    len = timestamp_to_str(datetime_to_timestamp(str_to_datetime("2017-12-03 19:28:44")), buf);
+    EXPECT_EQ(std::string(buf, len), "2017-12-03 19:28:44");
+}
+
 }  // namespace baikal
@@ -0,0 +1,257 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <iostream>
+#include <vector>
+#include "external_sorter.h"
+#include "runtime_state.h"
+#include "slot_ref.h"
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+namespace baikaldb {
+DECLARE_int64(sort_spill_memory_bytes);
+DECLARE_string(sort_spill_dir);
+
+TEST(test_loser_tree, merge) {
+    std::vector<std::vector<int>> runs = {{1, 4, 7, 10}, {2, 5, 8}, {}, {0, 3, 6, 9, 11}, {5}};
+    std::vector<size_t> pos(runs.size(), 0);
+    auto less = [&](int left, int right) {
+        bool left_over = pos[left] >= runs[left].size();
+        bool right_over = pos[right] >= runs[right].size();
+        if (left_over) {
+            return false;
+        }
+        if (right_over) {
+            return true;
+        }
+        return runs[left][pos[left]] < runs[right][pos[right]];
+    };
+    LoserTree tree;
+    tree.init(runs.size(), less);
+    std::vector<int> out;
+    while (true) {
+        int idx = tree.top();
+        if (pos[idx] >= runs[idx].size()) {
+            break;
+        }
+        out.push_back(runs[idx][pos[idx]++]);
+        tree.adjust(idx);
+    }
+    std::vector<int> expect = {0, 1, 2, 3, 4, 5, 5, 6, 7, 8, 9, 10, 11};
+    EXPECT_EQ(expect, out);
+}
+
+static int init_desc(MemRowDescriptor* desc) {
+    std::vector<pb::TupleDescriptor> tuple_desc;
+    pb::TupleDescriptor tuple;
+    tuple.set_tuple_id(0);
+    tuple.set_table_id(1);
+    std::vector<pb::PrimitiveType> types = {pb::INT64, pb::STRING};
+    for (size_t i = 0; i < types.size(); i++) {
+        pb::SlotDescriptor* slot = tuple.add_slots();
+        slot->set_slot_id(i + 1);
+        slot->set_slot_type(types[i]);
+        slot->set_tuple_id(0);
+    }
+    tuple_desc.push_back(tuple);
+    return desc->init(tuple_desc);
+}
+
+static SlotRef* make_slot_ref() {
+    pb::ExprNode node;
+    node.set_node_type(pb::SLOT_REF);
+    node.set_col_type(pb::INT64);
+    node.set_num_children(0);
+    node.mutable_derive_node()->set_tuple_id(0);
+    node.mutable_derive_node()->set_slot_id(1);
+    SlotRef* slot_ref = new SlotRef;
+    slot_ref->init(node);
+    return slot_ref;
+}
+
+static std::shared_ptr<RowBatch> make_batch(MemRowDescriptor* desc, int b, int batch_rows) {
+    std::shared_ptr<RowBatch> batch = std::make_shared<RowBatch>();
+    for (int i = 0; i < batch_rows; i++) {
+        std::unique_ptr<MemRow> row = desc->fetch_mem_row();
+        ExprValue v1(pb::INT64);
+        v1._u.int64_val = (b * 7919 + i * 104729) % 3001;
+        row->set_value(0, 1, v1);
+        ExprValue v2(pb::STRING);
+        v2.str_val = "row_" + std::to_string(v1._u.int64_val);
+        row->set_value(0, 2, v2);
+        batch->move_row(std::move(row));
+    }
+    return batch;
+}
+
+TEST(test_external_sorter, spill_and_merge) {
+    MemRowDescriptor desc;
+    ASSERT_EQ(0, init_desc(&desc));
+    SlotRef* slot_ref = make_slot_ref();
+    std::vector<ExprNode*> exprs = {slot_ref};
+    std::vector<bool> is_asc = {true};
+    std::vector<bool> is_null_first = {true};
+    MemRowCompare comp(exprs, is_asc, is_null_first);
+
+    FLAGS_sort_spill_memory_bytes = 20000;
+    FLAGS_sort_spill_dir = "./sort_spill_test";
+    RuntimeState state;
+    ExternalSorter sorter(&comp, &desc, &state);
+    const int batch_cnt = 20;
+    const int batch_rows = 100;
+    for (int b = 0; b < batch_cnt; b++) {
+        std::shared_ptr<RowBatch> batch = make_batch(&desc, b, batch_rows);
+        ASSERT_EQ(0, sorter.add_batch(batch));
+    }
+    ASSERT_EQ(0, sorter.sort());
+    EXPECT_GT(sorter.run_count(), 1u);
+
+    int64_t last = -1;
+    int count = 0;
+    bool eos = false;
+    while (!eos) {
+        RowBatch batch;
+        ASSERT_EQ(0, sorter.get_next(&batch, &eos));
+        for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
+            MemRow* row = batch.get_row().get();
+            int64_t val = row->get_value(0, 1).get_numberic<int64_t>();
+            EXPECT_LE(last, val);
+            EXPECT_EQ("row_" + std::to_string(val), row->get_value(0, 2).get_string());
+            last = val;
+            ++count;
+        }
+    }
+    EXPECT_EQ(batch_cnt * batch_rows, count);
+    delete slot_ref;
+}
+
+TEST(test_external_sorter, spill_release_charged_only) {
+    MemRowDescriptor desc;
+    ASSERT_EQ(0, init_desc(&desc));
+    SlotRef* slot_ref = make_slot_ref();
+    std::vector<ExprNode*> exprs = {slot_ref};
+    std::vector<bool> is_asc = {true};
+    std::vector<bool> is_null_first = {true};
+    MemRowCompare comp(exprs, is_asc, is_null_first);
+
+    FLAGS_sort_spill_memory_bytes = 20000;
+    FLAGS_sort_spill_dir = "./sort_spill_test";
+    RuntimeState state;
+    // 其他算子计入的内存，spill不能归还
+    const int64_t other_bytes = 1000000;
+    ASSERT_EQ(0, state.memory_limit_exceeded(other_bytes));
+    int64_t charged_bytes = 0;
+    ExternalSorter sorter(&comp, &desc, &state);
+    for (int b = 0; b < 20; b++) {
+        std::shared_ptr<RowBatch> batch = make_batch(&desc, b, 100);
+        // 只有后一半batch计入MemTracker
+        if (b >= 10) {
+            int64_t batch_bytes = 0;
+            for (batch->reset(); !batch->is_traverse_over(); batch->next()) {
+                MemRow* row = batch->get_row().get();
+                row->set_charged_size(row->used_size());
+                batch_bytes += row->used_size();
+            }
+            ASSERT_EQ(0, state.memory_limit_exceeded(batch_bytes));
+            charged_bytes += batch_bytes;
+        }
+        ASSERT_EQ(0, sorter.add_batch(batch));
+    }
+    EXPECT_GT(sorter.run_count(), 1u);
+    EXPECT_GE(state.used_bytes(), other_bytes);
+    EXPECT_LE(state.used_bytes(), other_bytes + charged_bytes);
+    delete slot_ref;
+}
+
+TEST(test_topn_sorter, desc_limit) {
+    MemRowDescriptor desc;
+    ASSERT_EQ(0, init_desc(&desc));
+    SlotRef* slot_ref = make_slot_ref();
+    std::vector<ExprNode*> exprs = {slot_ref};
+    std::vector<bool> is_asc = {false};
+    std::vector<bool> is_null_first = {false};
+    MemRowCompare comp(exprs, is_asc, is_null_first);
+
+    const int64_t limit = 20;
+    TopNSorter topn(&comp, limit);
+    std::vector<int64_t> all;
+    for (int b = 0; b < 10; b++) {
+        std::shared_ptr<RowBatch> batch = make_batch(&desc, b, 100);
+        for (batch->reset(); !batch->is_traverse_over(); batch->next()) {
+            all.push_back(batch->get_row()->get_value(0, 1).get_numberic<int64_t>());
+        }
+        topn.add_batch(batch.get());
+        EXPECT_GE(limit, (int64_t)topn.size());
+    }
+    topn.sort();
+    std::sort(all.begin(), all.end(), std::greater<int64_t>());
+    std::vector<int64_t> out;
+    bool eos = false;
+    while (!eos) {
+        RowBatch batch;
+        ASSERT_EQ(0, topn.get_next(&batch, &eos));
+        for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
+            out.push_back(batch.get_row()->get_value(0, 1).get_numberic<int64_t>());
+        }
+    }
+    std::vector<int64_t> expect(all.begin(), all.begin() + limit);
+    EXPECT_EQ(expect, out);
+    delete slot_ref;
+}
+
+TEST(test_topn_sorter, release_charged_only) {
+    MemRowDescriptor desc;
+    ASSERT_EQ(0, init_desc(&desc));
+    SlotRef* slot_ref = make_slot_ref();
+    std::vector<ExprNode*> exprs = {slot_ref};
+    std::vector<bool> is_asc = {true};
+    std::vector<bool> is_null_first = {true};
+    MemRowCompare comp(exprs, is_asc, is_null_first);
+
+    TopNSorter topn(&comp, 10);
+    // 未计入MemTracker的行淘汰时不归还
+    std::shared_ptr<RowBatch> batch = make_batch(&desc, 0, 100);
+    EXPECT_EQ(0, topn.add_batch(batch.get()));
+    // 全部计入后，归还的大小等于被淘汰行的大小之和
+    batch = make_batch(&desc, 1, 100);
+    int64_t charged_bytes = 0;
+    for (batch->reset(); !batch->is_traverse_over(); batch->next()) {
+        MemRow* row = batch->get_row().get();
+        row->set_charged_size(row->used_size());
+        charged_bytes += row->used_size();
+    }
+    int64_t released = topn.add_batch(batch.get());
+    EXPECT_GT(released, 0);
+    EXPECT_LE(released, charged_bytes);
+    topn.sort();
+    int64_t kept_charged = 0;
+    bool eos = false;
+    while (!eos) {
+        RowBatch out;
+        ASSERT_EQ(0, topn.get_next(&out, &eos));
+        for (out.reset(); !out.is_traverse_over(); out.next()) {
+            kept_charged += out.get_row()->charged_size();
+        }
+    }
+    EXPECT_EQ(charged_bytes, released + kept_charged);
+    delete slot_ref;
+}
+
+}  // namespace baikaldb
@@ -0,0 +1,198 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <map>
+#include <mutex>
+#include <set>
+#include <brpc/server.h>
+#include "fetcher_store.h"
+#include "network_socket.h"
+
+namespace baikaldb {
+DECLARE_bool(select_arrow_result);
+DECLARE_int64(max_select_rows);
+
+// 模拟store上的游标: 每块返回2行，读完后不再返回cursor_id
+class MockStoreService : public pb::StoreService {
+public:
+    virtual void query(google::protobuf::RpcController* controller,
+            const pb::StoreReq* request,
+            pb::StoreRes* response,
+            google::protobuf::Closure* done) {
+        brpc::ClosureGuard done_guard(done);
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(request->cursor_id());
+        auto iter = cursors.find(request->cursor_id());
+        if (iter == cursors.end()) {
+            response->set_errcode(pb::EXEC_FAIL);
+            response->set_errmsg("select cursor not exist");
+            return;
+        }
+        int64_t left = iter->second;
+        cursors.erase(iter);
+        if (request->close_cursor()) {
+            closed.insert(request->cursor_id());
+            response->set_errcode(pb::SUCCESS);
+            return;
+        }
+        response->set_errcode(pb::SUCCESS);
+        response->add_tuple_ids(0);
+        int64_t rows = std::min(left, 2L);
+        for (int64_t i = 0; i < rows; i++) {
+            pb::RowValue* row = response->add_row_values();
+            row->add_tuple_values("");
+            if (bad_row) {
+                row->add_tuple_values("");
+            }
+        }
+        left -= rows;
+        if (left > 0) {
+            uint64_t cursor_id = ++next_id;
+            cursors[cursor_id] = left;
+            response->set_cursor_id(cursor_id);
+        }
+    }
+    std::mutex mutex;
+    std::map<uint64_t, int64_t> cursors; // cursor_id -> 剩余行数
+    std::set<uint64_t> closed;
+    std::vector<uint64_t> requests;
+    uint64_t next_id = 100;
+    bool bad_row = false;
+};
+
+static MockStoreService g_service;
+static std::string g_addr;
+
+static void init_state(RuntimeState* state, NetworkSocket* sock) {
+    std::vector<pb::TupleDescriptor> tuple_desc;
+    pb::TupleDescriptor tuple;
+    tuple.set_tuple_id(0);
+    tuple.set_table_id(1);
+    pb::SlotDescriptor* slot = tuple.add_slots();
+    slot->set_slot_id(1);
+    slot->set_slot_type(pb::INT64);
+    slot->set_tuple_id(0);
+    tuple_desc.push_back(tuple);
+    state->mem_row_desc()->init(tuple_desc);
+    state->set_client_conn(sock);
+}
+
+static std::shared_ptr<StoreCursor> add_cursor(FetcherStore* fetcher, int64_t region_id,
+        uint64_t cursor_id, int64_t rows) {
+    g_service.cursors[cursor_id] = rows;
+    std::shared_ptr<StoreCursor> cursor = std::make_shared<StoreCursor>();
+    cursor->info.set_region_id(region_id);
+    cursor->addr = g_addr;
+    cursor->cursor_id = cursor_id;
+    fetcher->region_cursors[region_id] = cursor;
+    return cursor;
+}
+
+TEST(test_fetcher_cursor, read_all) {
+    NetworkSocket sock;
+    RuntimeState state;
+    init_state(&state, &sock);
+    FetcherStore fetcher;
+    add_cursor(&fetcher, 1, 1, 5);
+    int64_t total = 0;
+    while (fetcher.has_cursor(1)) {
+        std::shared_ptr<RowBatch> batch;
+        ASSERT_EQ(0, fetcher.next_cursor_batch(&state, 1, batch));
+        ASSERT_TRUE(batch != nullptr);
+        total += batch->size();
+    }
+    EXPECT_EQ(5, total);
+    EXPECT_TRUE(g_service.cursors.empty());
+}
+
+TEST(test_fetcher_cursor, close_on_bad_response) {
+    NetworkSocket sock;
+    RuntimeState state;
+    init_state(&state, &sock);
+    FetcherStore fetcher;
+    auto cursor = add_cursor(&fetcher, 2, 2, 10);
+    g_service.bad_row = true;
+    EXPECT_EQ(E_FATAL, fetcher.fetch_cursor(&state, cursor.get(), false));
+    g_service.bad_row = false;
+    // 响应解析失败时，store返回的新游标要被关闭
+    EXPECT_EQ(0u, cursor->cursor_id);
+    EXPECT_EQ(1u, g_service.closed.count(g_service.next_id));
+    EXPECT_TRUE(g_service.cursors.empty());
+}
+
+TEST(test_fetcher_cursor, close_on_rpc_fail) {
+    NetworkSocket sock;
+    RuntimeState state;
+    init_state(&state, &sock);
+    FetcherStore fetcher;
+    auto cursor = add_cursor(&fetcher, 3, 3, 10);
+    cursor->addr = "127.0.0.1:1";
+    EXPECT_EQ(E_FATAL, fetcher.fetch_cursor(&state, cursor.get(), false));
+    // 没收到响应，游标id失效，不再续读
+    EXPECT_EQ(0u, cursor->cursor_id);
+    g_service.cursors.erase(3);
+}
+
+TEST(test_fetcher_cursor, max_select_rows) {
+    NetworkSocket sock;
+    RuntimeState state;
+    init_state(&state, &sock);
+    FetcherStore fetcher;
+    add_cursor(&fetcher, 4, 4, 10);
+    FLAGS_max_select_rows = 3;
+    std::shared_ptr<RowBatch> batch;
+    EXPECT_EQ(0, fetcher.next_cursor_batch(&state, 4, batch));
+    EXPECT_EQ(-1, fetcher.next_cursor_batch(&state, 4, batch));
+    FLAGS_max_select_rows = 10000000;
+    EXPECT_EQ(ER_SQL_TOO_BIG, state.error_code);
+    EXPECT_FALSE(fetcher.has_cursor(4));
+    EXPECT_TRUE(g_service.cursors.empty());
+}
+
+TEST(test_fetcher_cursor, close_cursors) {
+    NetworkSocket sock;
+    RuntimeState state;
+    init_state(&state, &sock);
+    FetcherStore fetcher;
+    add_cursor(&fetcher, 5, 5, 10);
+    add_cursor(&fetcher, 6, 6, 10);
+    std::shared_ptr<RowBatch> batch;
+    ASSERT_EQ(0, fetcher.next_cursor_batch(&state, 5, batch));
+    // region 5已经在预取下一块，region 6还没读过
+    fetcher.close_cursors(&state);
+    EXPECT_FALSE(fetcher.has_cursor(5));
+    EXPECT_FALSE(fetcher.has_cursor(6));
+    EXPECT_EQ(1u, g_service.closed.count(6));
+    EXPECT_TRUE(g_service.cursors.empty());
+}
+
+}  // namespace baikaldb
+
+int main(int argc, char* argv[]) {
+    testing::InitGoogleTest(&argc, argv);
+    baikaldb::FLAGS_select_arrow_result = false;
+    brpc::Server server;
+    if (server.AddService(&baikaldb::g_service, brpc::SERVER_DOESNT_OWN_SERVICE) != 0) {
+        return -1;
+    }
+    if (server.Start("127.0.0.1:0", NULL) != 0) {
+        return -1;
+    }
+    baikaldb::g_addr = butil::endpoint2str(server.listen_address()).c_str();
+    int ret = RUN_ALL_TESTS();
+    server.Stop(0);
+    server.Join();
+    return ret;
+}
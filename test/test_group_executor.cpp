@@ -0,0 +1,92 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include "group_executor.h"
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+namespace baikaldb {
+struct TestTask {
+    int64_t weight = 1;
+    int64_t batch_id = -1;
+};
+
+TEST(test_group_executor, batch_limit) {
+    const int thread_num = 64;
+    const int loop = 100;
+    const size_t max_count = 8;
+    const int64_t max_weight = 10;
+    std::atomic<int64_t> batch_num{0};
+    std::atomic<int64_t> task_num{0};
+    std::atomic<bool> running{false};
+    std::atomic<int> bad_batch{0};
+    GroupExecutor<TestTask> executor([&](std::vector<TestTask*>& batch) {
+                // 同一时刻只有一个执行者
+                if (running.exchange(true)) {
+                    ++bad_batch;
+                }
+                int64_t weight = 0;
+                for (auto task : batch) {
+                    weight += task->weight;
+                }
+                if (batch.empty() || (batch.size() > 1 &&
+                        (batch.size() > max_count || weight > max_weight))) {
+                    ++bad_batch;
+                }
+                int64_t batch_id = batch_num++;
+                for (auto task : batch) {
+                    task->batch_id = batch_id;
+                }
+                task_num += batch.size();
+                bthread_usleep(100);
+                running = false;
+            },
+            [&](size_t count, int64_t weight) {
+                return count > max_count || weight > max_weight;
+            },
+            [](const TestTask* task) {
+                return task->weight;
+            });
+    BthreadCond cond;
+    std::atomic<int> unprocessed{0};
+    for (int i = 0; i < thread_num; i++) {
+        cond.increase();
+        Bthread bth;
+        bth.run([&executor, &cond, &unprocessed, i, loop]() {
+            for (int j = 0; j < loop; j++) {
+                TestTask task;
+                // 超过max_weight的task单独成批
+                task.weight = (i + j) % 13;
+                executor.run(&task);
+                if (task.batch_id < 0) {
+                    ++unprocessed;
+                }
+            }
+            cond.decrease_signal();
+        });
+    }
+    cond.wait();
+    EXPECT_EQ(0, bad_batch.load());
+    EXPECT_EQ(0, unprocessed.load());
+    EXPECT_EQ(thread_num * loop, task_num.load());
+    // 并发提交时会合并
+    EXPECT_LT(batch_num.load(), thread_num * loop);
+}
+}  // namespace baikaldb
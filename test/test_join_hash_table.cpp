@@ -0,0 +1,199 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <iostream>
+#include <vector>
+#include "join_hash_table.h"
+#include "runtime_filter.h"
+#include "mem_row_descriptor.h"
+#include "slot_ref.h"
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+namespace baikaldb {
+// tuple 0: (INT64 id, STRING name), tuple 1: (INT32 id, STRING name)
+static int init_desc(MemRowDescriptor* desc) {
+    std::vector<pb::TupleDescriptor> tuple_desc;
+    std::vector<std::vector<pb::PrimitiveType>> types = {
+        {pb::INT64, pb::STRING}, {pb::INT32, pb::STRING}};
+    for (size_t t = 0; t < types.size(); t++) {
+        pb::TupleDescriptor tuple;
+        tuple.set_tuple_id(t);
+        tuple.set_table_id(t + 1);
+        for (size_t i = 0; i < types[t].size(); i++) {
+            pb::SlotDescriptor* slot = tuple.add_slots();
+            slot->set_slot_id(i + 1);
+            slot->set_slot_type(types[t][i]);
+            slot->set_tuple_id(t);
+        }
+        tuple_desc.push_back(tuple);
+    }
+    return desc->init(tuple_desc);
+}
+
+static SlotRef* make_slot_ref(int32_t tuple_id, int32_t slot_id, pb::PrimitiveType type) {
+    pb::ExprNode node;
+    node.set_node_type(pb::SLOT_REF);
+    node.set_col_type(type);
+    node.set_num_children(0);
+    node.mutable_derive_node()->set_tuple_id(tuple_id);
+    node.mutable_derive_node()->set_slot_id(slot_id);
+    SlotRef* slot_ref = new SlotRef;
+    slot_ref->init(node);
+    return slot_ref;
+}
+
+static MemRow* make_row(MemRowDescriptor* desc, int32_t tuple_id, pb::PrimitiveType type,
+        int64_t id, bool id_null = false) {
+    MemRow* row = desc->fetch_mem_row().release();
+    if (!id_null) {
+        ExprValue v1(type);
+        v1._u.int64_val = 0;
+        if (type == pb::INT32) {
+            v1._u.int32_val = id;
+        } else {
+            v1._u.int64_val = id;
+        }
+        row->set_value(tuple_id, 1, v1);
+    }
+    ExprValue v2(pb::STRING);
+    v2.str_val = "name_" + std::to_string(id);
+    row->set_value(tuple_id, 2, v2);
+    return row;
+}
+
+static void check_join(JoinHashTable& table, MemRowDescriptor* desc, pb::PrimitiveType probe_type,
+        int32_t build_tuple, int32_t probe_tuple) {
+    std::vector<MemRow*> build_rows;
+    // 每个偶数id两行，另有一行null
+    for (int64_t id = 0; id < 100; id += 2) {
+        build_rows.push_back(make_row(desc, build_tuple, pb::INT64, id));
+        build_rows.push_back(make_row(desc, build_tuple, pb::INT64, id));
+    }
+    build_rows.push_back(make_row(desc, build_tuple, pb::INT64, 0, true));
+    table.build(build_rows);
+    EXPECT_EQ(100u, table.size());
+    EXPECT_EQ(50u, table.key_count());
+    for (int64_t id = 0; id < 100; id++) {
+        std::unique_ptr<MemRow> probe_row(make_row(desc, probe_tuple, probe_type, id));
+        int count = 0;
+        for (int32_t idx = table.probe(probe_row.get()); idx >= 0; idx = table.next(idx)) {
+            EXPECT_EQ(id, table.row(idx)->get_value(build_tuple, 1).get_numberic<int64_t>());
+            ++count;
+        }
+        EXPECT_EQ(id % 2 == 0 ? 2 : 0, count);
+    }
+    std::unique_ptr<MemRow> null_row(make_row(desc, probe_tuple, probe_type, 0, true));
+    EXPECT_EQ(-1, table.probe(null_row.get()));
+    for (auto row : build_rows) {
+        delete row;
+    }
+}
+
+TEST(test_join_hash_table, fixed_key) {
+    MemRowDescriptor desc;
+    ASSERT_EQ(0, init_desc(&desc));
+    std::unique_ptr<SlotRef> build_slot(make_slot_ref(0, 1, pb::INT64));
+    std::unique_ptr<SlotRef> probe_slot(make_slot_ref(1, 1, pb::INT32));
+    JoinHashTable table;
+    ASSERT_EQ(0, table.init({build_slot.get()}, {probe_slot.get()}));
+    EXPECT_TRUE(table.is_fixed_key());
+    check_join(table, &desc, pb::INT32, 0, 1);
+}
+
+TEST(test_join_hash_table, fixed_key_type) {
+    // TIME的存储也是COL_INT，但编码与整数不同，不能按原始值比较
+    std::unique_ptr<SlotRef> time_slot(make_slot_ref(0, 1, pb::TIME));
+    std::unique_ptr<SlotRef> int_slot(make_slot_ref(1, 1, pb::INT64));
+    JoinHashTable table;
+    ASSERT_EQ(0, table.init({time_slot.get()}, {int_slot.get()}));
+    EXPECT_FALSE(table.is_fixed_key());
+    std::unique_ptr<SlotRef> time_slot2(make_slot_ref(1, 1, pb::TIME));
+    ASSERT_EQ(0, table.init({time_slot.get()}, {time_slot2.get()}));
+    EXPECT_TRUE(table.is_fixed_key());
+}
+
+TEST(test_join_hash_table, string_key) {
+    MemRowDescriptor desc;
+    ASSERT_EQ(0, init_desc(&desc));
+    std::unique_ptr<SlotRef> build_id(make_slot_ref(0, 1, pb::INT64));
+    std::unique_ptr<SlotRef> build_name(make_slot_ref(0, 2, pb::STRING));
+    std::unique_ptr<SlotRef> probe_id(make_slot_ref(1, 1, pb::INT32));
+    std::unique_ptr<SlotRef> probe_name(make_slot_ref(1, 2, pb::STRING));
+    JoinHashTable table;
+    ASSERT_EQ(0, table.init({build_id.get(), build_name.get()}, {probe_id.get(), probe_name.get()}));
+    EXPECT_FALSE(table.is_fixed_key());
+    check_join(table, &desc, pb::INT32, 0, 1);
+}
+
+TEST(test_runtime_filter, bloom_and_range) {
+    RuntimeFilter filter;
+    ASSERT_EQ(0, filter.init(pb::INT64, 1000));
+    for (int64_t i = 0; i < 1000; i++) {
+        ExprValue v(pb::INT32);
+        v._u.int32_val = i * 3 + 100;
+        filter.insert(v);
+    }
+    filter.insert(ExprValue::Null());
+    EXPECT_EQ(1000, filter.num_values());
+    EXPECT_EQ(100, filter.min_value().get_numberic<int64_t>());
+    EXPECT_EQ(3097, filter.max_value().get_numberic<int64_t>());
+    int false_positive = 0;
+    for (int64_t i = 0; i < 3000; i++) {
+        ExprValue v(pb::INT64);
+        v._u.int64_val = i + 100;
+        bool contain = filter.may_contain(v);
+        if (i % 3 == 0) {
+            // 不能漏判，类型不同也要命中
+            EXPECT_TRUE(contain);
+        } else if (contain) {
+            ++false_positive;
+        }
+    }
+    EXPECT_LT(false_positive, 100);
+    EXPECT_FALSE(filter.may_contain(ExprValue::Null()));
+
+    // 序列化后在store上的判断结果一致
+    pb::RuntimeFilter pb_filter;
+    filter.to_pb(3, &pb_filter);
+    EXPECT_EQ(3, pb_filter.slot_id());
+    EXPECT_EQ(filter.byte_size(), pb_filter.bloom_bits().size());
+    RuntimeFilter store_filter;
+    ASSERT_EQ(0, store_filter.init_from_pb(pb_filter));
+    for (int64_t i = 0; i < 3200; i++) {
+        ExprValue v(pb::INT64);
+        v._u.int64_val = i;
+        EXPECT_EQ(filter.may_contain(v), store_filter.may_contain(v));
+    }
+}
+
+TEST(test_runtime_filter, type_match) {
+    EXPECT_TRUE(RuntimeFilter::type_match(pb::INT32, pb::INT64));
+    EXPECT_TRUE(RuntimeFilter::type_match(pb::UINT8, pb::UINT64));
+    EXPECT_TRUE(RuntimeFilter::type_match(pb::STRING, pb::STRING));
+    EXPECT_TRUE(RuntimeFilter::type_match(pb::DATETIME, pb::DATETIME));
+    // hash join按字符串匹配时相等，原始值不同，bloom会漏判
+    EXPECT_FALSE(RuntimeFilter::type_match(pb::TIMESTAMP, pb::DATETIME));
+    EXPECT_FALSE(RuntimeFilter::type_match(pb::FLOAT, pb::DOUBLE));
+    EXPECT_FALSE(RuntimeFilter::type_match(pb::INT64, pb::UINT64));
+    EXPECT_FALSE(RuntimeFilter::type_match(pb::INT64, pb::TIME));
+    EXPECT_FALSE(RuntimeFilter::type_match(pb::HLL, pb::HLL));
+}
+
+}  // namespace baikaldb
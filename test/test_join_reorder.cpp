@@ -0,0 +1,185 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <cfloat>
+#include "join_reorder.h"
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+namespace baikaldb {
+DECLARE_int32(join_reorder_dp_max_tables);
+
+class TestScanNode : public ScanNode {
+public:
+    // 增加一个以field_id为第一列的普通索引
+    void add_index_prefix(int32_t field_id) {
+        SmartPath path = std::make_shared<AccessPath>();
+        path->index_type = pb::I_KEY;
+        SmartIndex index = std::make_shared<IndexInfo>();
+        FieldInfo field;
+        field.id = field_id;
+        index->fields.push_back(field);
+        path->index_info_ptr = index;
+        _paths[field_id] = path;
+    }
+};
+
+class JoinReorderTest : public testing::Test {
+protected:
+    void TearDown() override {
+        for (auto node : _scan_nodes) {
+            delete node;
+        }
+        _scan_nodes.clear();
+        FLAGS_join_reorder_dp_max_tables = 8;
+    }
+    // relation的join列field_id固定为1
+    void add_relation(double rows, bool has_index = false) {
+        TestScanNode* scan_node = new TestScanNode;
+        if (has_index) {
+            scan_node->add_index_prefix(1);
+        }
+        _scan_nodes.push_back(scan_node);
+        JoinReorder::Relation rel;
+        rel.tuple_id = _reorder._relations.size();
+        rel.scan_node = scan_node;
+        rel.rows = rows;
+        rel.read_rows = rows;
+        _reorder._relations.push_back(rel);
+        _reorder._adjacent.push_back(0);
+    }
+    void add_edge(int left, int right, double selectivity) {
+        JoinReorder::EqualEdge edge;
+        edge.left = left;
+        edge.right = right;
+        edge.left_field = 1;
+        edge.right_field = 1;
+        edge.selectivity = selectivity;
+        _reorder._edges.push_back(edge);
+        _reorder._adjacent[left] |= (1U << right);
+        _reorder._adjacent[right] |= (1U << left);
+    }
+    std::vector<int> enumerate(std::vector<pb::JoinAlgorithm>* algos = nullptr) {
+        JoinReorder::JoinPlan best;
+        _reorder.enumerate(best);
+        if (algos != nullptr) {
+            *algos = best.algos;
+        }
+        return best.order;
+    }
+    // 对比不同的枚举方式
+    std::vector<int> dp() {
+        JoinReorder::JoinPlan best;
+        best.cost = DBL_MAX;
+        _reorder.dp_enumerate(best);
+        return best.order;
+    }
+    std::vector<int> greedy() {
+        JoinReorder::JoinPlan best;
+        best.cost = DBL_MAX;
+        _reorder.greedy_enumerate(best);
+        return best.order;
+    }
+    JoinReorder _reorder;
+    std::vector<TestScanNode*> _scan_nodes;
+};
+
+// t0(1000000) - t1(100) - t2(10000)
+TEST_F(JoinReorderTest, chain_3_tables) {
+    add_relation(1000000);
+    add_relation(100);
+    add_relation(10000);
+    add_edge(0, 1, 1.0 / 100);
+    add_edge(1, 2, 1.0 / 10000);
+    std::vector<pb::JoinAlgorithm> algos;
+    EXPECT_EQ(std::vector<int>({1, 2, 0}), enumerate(&algos));
+    EXPECT_EQ(std::vector<pb::JoinAlgorithm>({pb::JA_AUTO, pb::JA_HASH_SCAN, pb::JA_HASH_SCAN}),
+            algos);
+}
+
+// t0(1000000) - t1(100) - t2(10000) - t3(10)
+TEST_F(JoinReorderTest, chain_4_tables) {
+    add_relation(1000000);
+    add_relation(100);
+    add_relation(10000);
+    add_relation(10);
+    add_edge(0, 1, 1.0 / 100);
+    add_edge(1, 2, 1.0 / 10000);
+    add_edge(2, 3, 1.0 / 10000);
+    std::vector<pb::JoinAlgorithm> algos;
+    EXPECT_EQ(std::vector<int>({3, 2, 1, 0}), enumerate(&algos));
+    EXPECT_EQ(pb::JA_HASH_SCAN, algos[3]);
+}
+
+// 大表在join列上有索引时，最后按驱动表的key回查
+TEST_F(JoinReorderTest, chain_4_tables_index_lookup) {
+    add_relation(1000000, true);
+    add_relation(100);
+    add_relation(10000);
+    add_relation(10);
+    add_edge(0, 1, 1.0 / 100);
+    add_edge(1, 2, 1.0 / 10000);
+    add_edge(2, 3, 1.0 / 10000);
+    std::vector<pb::JoinAlgorithm> algos;
+    EXPECT_EQ(std::vector<int>({3, 2, 1, 0}), enumerate(&algos));
+    EXPECT_EQ(std::vector<pb::JoinAlgorithm>({pb::JA_AUTO, pb::JA_HASH_SCAN,
+            pb::JA_HASH_SCAN, pb::JA_INDEX_LOOKUP}), algos);
+}
+
+// dp和贪心结果不同的chain，超过dp上限时使用贪心
+TEST_F(JoinReorderTest, greedy_above_dp_limit) {
+    add_relation(100000);
+    add_relation(10000);
+    add_relation(10);
+    add_relation(100);
+    add_edge(0, 1, 1.0 / 10);
+    add_edge(1, 2, 1.0 / 100000);
+    add_edge(2, 3, 1.0 / 100);
+    std::vector<int> dp_order({2, 1, 3, 0});
+    std::vector<int> greedy_order({2, 3, 1, 0});
+    EXPECT_EQ(dp_order, dp());
+    EXPECT_EQ(greedy_order, greedy());
+
+    FLAGS_join_reorder_dp_max_tables = 4;
+    EXPECT_EQ(dp_order, enumerate());
+    FLAGS_join_reorder_dp_max_tables = 3;
+    EXPECT_EQ(greedy_order, enumerate());
+}
+
+// 贪心也不会选出需要笛卡尔积的顺序
+TEST_F(JoinReorderTest, greedy_connected) {
+    add_relation(10);
+    add_relation(1000000);
+    add_relation(20);
+    add_edge(0, 1, 1.0 / 1000000);
+    add_edge(1, 2, 1.0 / 1000000);
+    FLAGS_join_reorder_dp_max_tables = 2;
+    std::vector<int> order = enumerate();
+    ASSERT_EQ(3u, order.size());
+    EXPECT_EQ(1, order[1]);
+}
+
+// 没有统计信息时返回-1，退回基于规则的reorder
+TEST_F(JoinReorderTest, estimate_rows_without_statistics) {
+    TestScanNode scan_node;
+    int64_t read_rows = 0;
+    EXPECT_EQ(-1, scan_node.estimate_rows(&read_rows));
+}
+
+}  // namespace baikaldb
@@ -0,0 +1,102 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include "region_manager.h"
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+namespace baikaldb {
+DECLARE_int32(leader_load_dml_weight);
+DECLARE_int64(leader_load_scan_rows_per_unit);
+
+// 上报一次心跳，只记录负载不迁移leader
+static void report(const std::string& instance, const std::string& resource_tag,
+        const std::vector<std::vector<int64_t>>& regions) {
+    pb::StoreHeartBeatRequest request;
+    pb::StoreHeartBeatResponse response;
+    request.mutable_instance_info()->set_address(instance);
+    request.mutable_instance_info()->set_resource_tag(resource_tag);
+    int64_t region_id = 1;
+    for (auto& load : regions) {
+        pb::LeaderHeartBeat* leader = request.add_leader_regions();
+        leader->mutable_region()->set_region_id(region_id++);
+        leader->set_select_qps(load[0]);
+        leader->set_dml_qps(load[1]);
+        leader->set_scan_rows_per_second(load[2]);
+    }
+    std::set<int64_t> trans_leader_region_ids;
+    RegionManager::get_instance()->leader_load_balance_on_hot(instance, &request, false,
+            trans_leader_region_ids, &response);
+    EXPECT_TRUE(trans_leader_region_ids.empty());
+    EXPECT_EQ(0, response.trans_leader_size());
+}
+
+TEST(test_leader_load_balance, weighted_load) {
+    RegionManager* manager = RegionManager::get_instance();
+    // select_qps, dml_qps, scan_rows_per_second
+    report("10.0.0.1:8110", "weight", {{1000, 0, 0}, {500, 0, 0}});
+    report("10.0.0.2:8110", "weight", {{0, 500, 0}});
+    report("10.0.0.3:8110", "weight", {{0, 0, 1000000}});
+    std::unordered_map<std::string, int64_t> loads;
+    int64_t total = 1500 + 500 * FLAGS_leader_load_dml_weight +
+        1000000 / FLAGS_leader_load_scan_rows_per_unit;
+    EXPECT_EQ(total / 3, manager->get_average_leader_load("weight", &loads));
+    ASSERT_EQ(3u, loads.size());
+    EXPECT_EQ(1500, loads["10.0.0.1:8110"]);
+    EXPECT_EQ(500 * FLAGS_leader_load_dml_weight, loads["10.0.0.2:8110"]);
+    EXPECT_EQ(1000000 / FLAGS_leader_load_scan_rows_per_unit, loads["10.0.0.3:8110"]);
+}
+
+TEST(test_leader_load_balance, hot_instance) {
+    RegionManager* manager = RegionManager::get_instance();
+    report("10.0.1.1:8110", "hot", {{3000, 0, 0}, {1000, 0, 0}});
+    report("10.0.1.2:8110", "hot", {{1000, 0, 0}});
+    report("10.0.1.3:8110", "hot", {{0, 300, 0}});
+    // 平均(4000 + 1000 + 900) / 3
+    EXPECT_EQ(1966, manager->get_average_leader_load("hot", nullptr));
+    EXPECT_TRUE(manager->is_leader_load_hot("10.0.1.1:8110"));
+    EXPECT_FALSE(manager->is_leader_load_hot("10.0.1.2:8110"));
+    EXPECT_FALSE(manager->is_leader_load_hot("10.0.1.3:8110"));
+
+    // 负载下降后不再是热点
+    report("10.0.1.1:8110", "hot", {{1200, 0, 0}});
+    EXPECT_FALSE(manager->is_leader_load_hot("10.0.1.1:8110"));
+}
+
+TEST(test_leader_load_balance, low_load_not_hot) {
+    RegionManager* manager = RegionManager::get_instance();
+    // 远高于平均但总量低于leader_load_min_qps
+    report("10.0.2.1:8110", "low", {{900, 0, 0}});
+    report("10.0.2.2:8110", "low", {{10, 0, 0}});
+    EXPECT_FALSE(manager->is_leader_load_hot("10.0.2.1:8110"));
+}
+
+TEST(test_leader_load_balance, resource_tag_isolated) {
+    RegionManager* manager = RegionManager::get_instance();
+    report("10.0.3.1:8110", "tag_a", {{5000, 0, 0}});
+    report("10.0.3.2:8110", "tag_b", {{100, 0, 0}});
+    report("10.0.3.3:8110", "tag_b", {{100, 0, 0}});
+    // 只和同resource_tag的实例比较
+    EXPECT_EQ(5000, manager->get_average_leader_load("tag_a", nullptr));
+    EXPECT_FALSE(manager->is_leader_load_hot("10.0.3.1:8110"));
+    EXPECT_EQ(100, manager->get_average_leader_load("tag_b", nullptr));
+    EXPECT_EQ(-1, manager->get_average_leader_load("tag_none", nullptr));
+}
+
+}  // namespace baikaldb
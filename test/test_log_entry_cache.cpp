@@ -0,0 +1,174 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include "log_entry_cache.h"
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+namespace baikaldb {
+DECLARE_int64(raft_log_cache_total_max_bytes);
+
+static const size_t DATA_SIZE = 1000;
+
+static std::string log_data(int64_t index, int64_t term) {
+    std::string data = std::to_string(index) + "_" + std::to_string(term);
+    data.resize(DATA_SIZE, 'x');
+    return data;
+}
+
+// 追加[begin, end]
+static void append(RegionLogCache* cache, int64_t begin, int64_t end, int64_t term = 1) {
+    std::vector<braft::LogEntry*> entries;
+    for (int64_t index = begin; index <= end; ++index) {
+        braft::LogEntry* entry = new braft::LogEntry;
+        entry->AddRef();
+        entry->type = braft::ENTRY_TYPE_DATA;
+        entry->id = braft::LogId(index, term);
+        entry->data.append(log_data(index, term));
+        entries.push_back(entry);
+    }
+    cache->append(entries);
+    for (auto entry : entries) {
+        entry->Release();
+    }
+}
+
+// 返回命中的term，未命中返回0
+static int64_t get_term(RegionLogCache* cache, int64_t index) {
+    braft::LogEntry* entry = cache->get_entry(index);
+    if (entry == nullptr) {
+        return 0;
+    }
+    int64_t term = entry->id.term;
+    EXPECT_EQ(log_data(index, term), entry->data.to_string());
+    entry->Release();
+    return term;
+}
+
+// 返回scan的返回值，visited为访问到的index
+static int scan(RegionLogCache* cache, int64_t start_index, int64_t end_index,
+        std::vector<int64_t>* visited, int64_t stop_index = 0) {
+    visited->clear();
+    return cache->scan(start_index, end_index,
+            [visited, stop_index](int64_t log_index, const LogHead& head,
+                    const rocksdb::Slice& data) -> int {
+        visited->push_back(log_index);
+        EXPECT_EQ(log_data(log_index, head.term), data.ToString());
+        return log_index == stop_index ? 1 : 0;
+    });
+}
+
+TEST(test_log_entry_cache, truncate_and_reset) {
+    LogEntryCache* log_cache = LogEntryCache::get_instance();
+    std::shared_ptr<RegionLogCache> cache = log_cache->register_region(1);
+    append(cache.get(), 1, 10);
+    EXPECT_EQ(1, get_term(cache.get(), 1));
+    EXPECT_EQ(1, get_term(cache.get(), 10));
+    EXPECT_EQ(0, get_term(cache.get(), 11));
+
+    // truncate_suffix后重新追加，读到的是新term
+    cache->truncate_suffix(7);
+    EXPECT_EQ(1, get_term(cache.get(), 7));
+    EXPECT_EQ(0, get_term(cache.get(), 8));
+    append(cache.get(), 8, 9, 2);
+    EXPECT_EQ(2, get_term(cache.get(), 8));
+    EXPECT_EQ(2, get_term(cache.get(), 9));
+    EXPECT_EQ(0, get_term(cache.get(), 10));
+
+    cache->truncate_prefix(5);
+    EXPECT_EQ(0, get_term(cache.get(), 4));
+    EXPECT_EQ(1, get_term(cache.get(), 5));
+
+    // 不连续的追加丢弃之前的缓存，保证缓存区间连续
+    append(cache.get(), 20, 21, 3);
+    EXPECT_EQ(0, get_term(cache.get(), 9));
+    EXPECT_EQ(3, get_term(cache.get(), 20));
+
+    // reset
+    cache->clear();
+    EXPECT_EQ(0, get_term(cache.get(), 21));
+    append(cache.get(), 100, 101, 4);
+    EXPECT_EQ(4, get_term(cache.get(), 100));
+    log_cache->unregister_region(1, cache);
+    EXPECT_TRUE(log_cache->get_region(1) == nullptr);
+}
+
+TEST(test_log_entry_cache, scan_hit_miss) {
+    LogEntryCache* log_cache = LogEntryCache::get_instance();
+    std::shared_ptr<RegionLogCache> cache = log_cache->register_region(2);
+    std::vector<int64_t> visited;
+    // 空缓存未命中，由调用方读盘
+    EXPECT_EQ(-2, scan(cache.get(), 1, 10, &visited));
+    append(cache.get(), 5, 10);
+    // 起点已被淘汰
+    EXPECT_EQ(-2, scan(cache.get(), 3, 10, &visited));
+    EXPECT_TRUE(visited.empty());
+    // 后面还有日志返回1
+    EXPECT_EQ(1, scan(cache.get(), 5, 7, &visited));
+    EXPECT_EQ(std::vector<int64_t>({5, 6, 7}), visited);
+    // 读到末尾返回0
+    EXPECT_EQ(0, scan(cache.get(), 8, 20, &visited));
+    EXPECT_EQ(std::vector<int64_t>({8, 9, 10}), visited);
+    // 回调要求停止
+    EXPECT_EQ(1, scan(cache.get(), 5, 10, &visited, 6));
+    EXPECT_EQ(std::vector<int64_t>({5, 6}), visited);
+    EXPECT_EQ(0, scan(cache.get(), 11, 20, &visited));
+    EXPECT_TRUE(visited.empty());
+
+    // truncate之后scan与get_entry一致
+    cache->truncate_suffix(8);
+    EXPECT_EQ(0, scan(cache.get(), 5, 20, &visited));
+    EXPECT_EQ(std::vector<int64_t>({5, 6, 7, 8}), visited);
+    cache->truncate_prefix(7);
+    EXPECT_EQ(-2, scan(cache.get(), 6, 20, &visited));
+    EXPECT_EQ(0, scan(cache.get(), 7, 20, &visited));
+    EXPECT_EQ(std::vector<int64_t>({7, 8}), visited);
+    log_cache->unregister_region(2, cache);
+}
+
+TEST(test_log_entry_cache, evict_by_region_share) {
+    LogEntryCache* log_cache = LogEntryCache::get_instance();
+    const int64_t entry_bytes = sizeof(braft::LogEntry) + DATA_SIZE;
+    FLAGS_raft_log_cache_total_max_bytes = 10 * entry_bytes;
+    std::shared_ptr<RegionLogCache> cache_a = log_cache->register_region(3);
+    std::shared_ptr<RegionLogCache> cache_b = log_cache->register_region(4);
+    EXPECT_EQ(5 * entry_bytes, log_cache->region_share_bytes());
+    append(cache_a.get(), 1, 8);
+    EXPECT_FALSE(log_cache->over_limit());
+
+    // 总量超限，但b没有超过份额，不淘汰自己
+    append(cache_b.get(), 1, 4);
+    EXPECT_TRUE(log_cache->over_limit());
+    EXPECT_EQ(1, get_term(cache_b.get(), 1));
+    EXPECT_EQ(1, get_term(cache_b.get(), 4));
+
+    // a超过份额，追加时淘汰到份额以内
+    append(cache_a.get(), 9, 9);
+    EXPECT_EQ(0, get_term(cache_a.get(), 4));
+    EXPECT_EQ(1, get_term(cache_a.get(), 5));
+    EXPECT_EQ(1, get_term(cache_a.get(), 9));
+    EXPECT_FALSE(log_cache->over_limit());
+    EXPECT_EQ(1, get_term(cache_b.get(), 1));
+
+    log_cache->unregister_region(3, cache_a);
+    log_cache->unregister_region(4, cache_b);
+    FLAGS_raft_log_cache_total_max_bytes = 1024 * 1024 * 1024LL;
+}
+
+}  // namespace baikaldb
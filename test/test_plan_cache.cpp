@@ -0,0 +1,165 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include "plan_cache.h"
+#include "logical_planner.h"
+#include "schema_factory.h"
+#include "network_socket.h"
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+namespace baikaldb {
+static const int64_t TABLE_ID = 1001;
+static const int64_t DB_ID = 11;
+
+// t1(id int64 primary key, name string)，extra_field为true时增加一列
+static void update_table(int64_t version, bool extra_field) {
+    pb::SchemaInfo info;
+    info.set_namespace_name("test_ns");
+    info.set_namespace_id(1);
+    info.set_database("test_db");
+    info.set_database_id(DB_ID);
+    info.set_table_name("t1");
+    info.set_table_id(TABLE_ID);
+    info.set_partition_num(1);
+    info.set_version(version);
+    pb::FieldInfo* field = info.add_fields();
+    field->set_field_name("id");
+    field->set_field_id(1);
+    field->set_mysql_type(pb::INT64);
+    field = info.add_fields();
+    field->set_field_name("name");
+    field->set_field_id(2);
+    field->set_mysql_type(pb::STRING);
+    if (extra_field) {
+        field = info.add_fields();
+        field->set_field_name("age");
+        field->set_field_id(3);
+        field->set_mysql_type(pb::INT32);
+    }
+    pb::IndexInfo* index_pk = info.add_indexs();
+    index_pk->set_index_type(pb::I_PRIMARY);
+    index_pk->set_index_name("pk_index");
+    index_pk->set_index_id(TABLE_ID);
+    index_pk->add_field_ids(1);
+    SchemaFactory::get_instance()->update_table(info);
+}
+
+class PlanCacheTest : public testing::Test {
+protected:
+    static void SetUpTestCase() {
+        SchemaFactory::get_instance()->init();
+        update_table(1, false);
+    }
+    void SetUp() override {
+        _user.reset(new UserInfo);
+        _user->username = "test_user";
+        _user->namespace_ = "test_ns";
+        _user->database[DB_ID] = pb::WRITE;
+        _sock.reset(new NetworkSocket);
+    }
+    // 返回0表示生成了逻辑计划，hit表示是否命中plan cache
+    int analyze(const std::string& sql, bool* hit, std::shared_ptr<QueryContext>* out = nullptr) {
+        std::shared_ptr<QueryContext> ctx(new QueryContext);
+        ctx->sql = sql;
+        ctx->mysql_cmd = COM_QUERY;
+        ctx->cur_db = "test_db";
+        ctx->charset = "utf8";
+        ctx->user_info = _user;
+        ctx->client_conn = _sock.get();
+        ctx->get_runtime_state()->set_client_conn(_sock.get());
+        int ret = LogicalPlanner::analyze(ctx.get());
+        *hit = ctx->stat_info.hit_cache;
+        if (out != nullptr) {
+            *out = ctx;
+        }
+        return ret;
+    }
+    // 结果tuple中的列数
+    static int select_slot_cnt(const std::shared_ptr<QueryContext>& ctx) {
+        for (auto& tuple : ctx->tuple_descs()) {
+            if (tuple.has_table_id() && tuple.table_id() == TABLE_ID) {
+                return tuple.slots_size();
+            }
+        }
+        return 0;
+    }
+    std::shared_ptr<UserInfo> _user;
+    std::unique_ptr<NetworkSocket> _sock;
+};
+
+TEST_F(PlanCacheTest, hit_with_different_literals) {
+    bool hit = true;
+    std::shared_ptr<QueryContext> ctx;
+    ASSERT_EQ(0, analyze("select id, name from t1 where id = 1 and name = 'a'", &hit));
+    EXPECT_FALSE(hit);
+    ASSERT_EQ(0, analyze("select id, name from t1 where id = 2 and name = 'bb'", &hit, &ctx));
+    EXPECT_TRUE(hit);
+    // 命中后绑定的是本次的常量
+    ASSERT_EQ(2u, ctx->placeholders.size());
+    EXPECT_EQ(2, ctx->placeholders[0]->get_value(nullptr).get_numberic<int64_t>());
+    EXPECT_EQ("bb", ctx->placeholders[1]->get_value(nullptr).get_string());
+
+    // 常量类型不同不共享模板
+    ASSERT_EQ(0, analyze("select id, name from t1 where id = 'x' and name = 'a'", &hit));
+    EXPECT_FALSE(hit);
+    // where以外的常量是key的一部分
+    ASSERT_EQ(0, analyze("select id, name from t1 where id = 1 and name = 'a' limit 1", &hit));
+    EXPECT_FALSE(hit);
+    ASSERT_EQ(0, analyze("select id, name from t1 where id = 3 and name = 'c' limit 1", &hit));
+    EXPECT_TRUE(hit);
+    ASSERT_EQ(0, analyze("select id, name from t1 where id = 3 and name = 'c' limit 2", &hit));
+    EXPECT_FALSE(hit);
+}
+
+TEST_F(PlanCacheTest, invalid_after_schema_change) {
+    bool hit = true;
+    std::shared_ptr<QueryContext> ctx;
+    ASSERT_EQ(0, analyze("select * from t1 where id = 1", &hit, &ctx));
+    ASSERT_EQ(0, analyze("select * from t1 where id = 2", &hit, &ctx));
+    EXPECT_TRUE(hit);
+    EXPECT_EQ(2, select_slot_cnt(ctx));
+
+    // 加列后version变化，模板重新生成
+    update_table(2, true);
+    ASSERT_EQ(0, analyze("select * from t1 where id = 3", &hit, &ctx));
+    EXPECT_FALSE(hit);
+    EXPECT_EQ(3, select_slot_cnt(ctx));
+    ASSERT_EQ(0, analyze("select * from t1 where id = 4", &hit, &ctx));
+    EXPECT_TRUE(hit);
+    EXPECT_EQ(3, select_slot_cnt(ctx));
+
+    // 只有version变化也失效
+    update_table(3, true);
+    ASSERT_EQ(0, analyze("select * from t1 where id = 5", &hit, &ctx));
+    EXPECT_FALSE(hit);
+}
+
+TEST_F(PlanCacheTest, invalid_without_privilege) {
+    bool hit = true;
+    ASSERT_EQ(0, analyze("select name from t1 where id = 1", &hit));
+    ASSERT_EQ(0, analyze("select name from t1 where id = 2", &hit));
+    EXPECT_TRUE(hit);
+    // 没有权限的用户不能复用别人生成的模板
+    _user->database.clear();
+    analyze("select name from t1 where id = 3", &hit);
+    EXPECT_FALSE(hit);
+}
+
+}  // namespace baikaldb
@@ -0,0 +1,322 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <map>
+#include <boost/filesystem.hpp>
+#include "segment_log_storage.h"
+#include "mut_table_key.h"
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+namespace baikaldb {
+DECLARE_string(raft_log_segment_path);
+DECLARE_int64(raft_log_segment_max_size);
+DECLARE_int32(raft_log_segment_max_num);
+DECLARE_bool(raft_log_segment_sync);
+DECLARE_int32(raft_log_segment_gc_interval_s);
+
+// index => term，key为该term的起始index
+typedef std::map<int64_t, int64_t> TermMap;
+
+static int64_t term_of(const TermMap& terms, int64_t index) {
+    auto iter = terms.upper_bound(index);
+    --iter;
+    return iter->second;
+}
+
+static std::string log_data(int64_t region_id, int64_t index, int64_t term) {
+    return std::to_string(region_id) + "_" + std::to_string(index) + "_" + std::to_string(term);
+}
+
+class SegmentLogEngineTest : public testing::Test {
+protected:
+    static void SetUpTestCase() {
+        boost::filesystem::remove_all("./rocks_segment_log");
+        ASSERT_EQ(0, RocksWrapper::get_instance()->init("./rocks_segment_log"));
+        FLAGS_raft_log_segment_path = "./segment_log_test";
+        FLAGS_raft_log_segment_sync = false;
+        // 后台gc不参与，由用例调用gc_once
+        FLAGS_raft_log_segment_gc_interval_s = 3600;
+    }
+    void SetUp() override {
+        FLAGS_raft_log_segment_max_size = 256 * 1024 * 1024LL;
+        FLAGS_raft_log_segment_max_num = 32;
+        boost::filesystem::remove_all(FLAGS_raft_log_segment_path);
+        restart();
+    }
+    static SegmentLogEngine* engine() {
+        return SegmentLogEngine::get_instance();
+    }
+    // 模拟进程重启：丢弃内存中的索引，重新扫描segment
+    void restart() {
+        SegmentLogEngine* log_engine = engine();
+        log_engine->close();
+        log_engine->_region_logs.clear();
+        log_engine->_segments.clear();
+        log_engine->_active.reset();
+        log_engine->_region_write_mutex.clear();
+        log_engine->_shutdown = false;
+        log_engine->_is_init = false;
+        ASSERT_EQ(0, log_engine->init());
+    }
+    void gc_once() {
+        engine()->gc_once();
+    }
+    std::string active_path() {
+        return engine()->_active->path;
+    }
+    int64_t active_size() {
+        return engine()->_active->size;
+    }
+    int64_t oldest_segment_id() {
+        return engine()->_segments.begin()->first;
+    }
+    std::string oldest_segment_path() {
+        return engine()->_segments.begin()->second->path;
+    }
+    size_t segment_num() {
+        return engine()->_segments.size();
+    }
+    // 追加[begin, end]
+    void append(int64_t region_id, int64_t begin, int64_t end, int64_t term = 1) {
+        std::vector<LogRecord> records;
+        for (int64_t index = begin; index <= end; ++index) {
+            records.emplace_back();
+            LogRecord& record = records.back();
+            record.kind = LogRecord::ENTRY;
+            record.type = braft::ENTRY_TYPE_DATA;
+            record.region_id = region_id;
+            record.index = index;
+            record.term = term;
+            record.data.append(log_data(region_id, index, term));
+        }
+        ASSERT_EQ(0, engine()->append(region_id, records));
+    }
+    // 按持久化的first_log_index挂载后，日志为[first, last]且内容正确
+    void expect_log(int64_t region_id, int64_t first, int64_t last,
+            const TermMap& terms = {{0, 1}}) {
+        std::vector<LogLocation> locations;
+        ASSERT_EQ(0, engine()->attach_region(region_id, first, &locations));
+        ASSERT_EQ(last - first + 1, (int64_t)locations.size());
+        for (int64_t index = first; index <= last; ++index) {
+            LogLocation location;
+            butil::IOBuf data;
+            ASSERT_EQ(0, engine()->read(region_id, index, &location, &data));
+            int64_t term = term_of(terms, index);
+            EXPECT_EQ(term, location.term);
+            EXPECT_EQ(log_data(region_id, index, term), data.to_string());
+        }
+    }
+    braft::LogStorage* open_storage(int64_t region_id) {
+        SegmentLogStorage storage;
+        braft::LogStorage* log_storage = storage.new_instance(
+                "mysegmentlog://my_raft_log?id=" + std::to_string(region_id));
+        EXPECT_TRUE(log_storage != nullptr);
+        if (log_storage != nullptr && log_storage->init(&_conf_manager) != 0) {
+            delete log_storage;
+            return nullptr;
+        }
+        return log_storage;
+    }
+    void append_entries(braft::LogStorage* storage, int64_t region_id,
+            int64_t begin, int64_t end, int64_t term) {
+        std::vector<braft::LogEntry*> entries;
+        for (int64_t index = begin; index <= end; ++index) {
+            braft::LogEntry* entry = new braft::LogEntry;
+            entry->AddRef();
+            entry->type = braft::ENTRY_TYPE_DATA;
+            entry->id = braft::LogId(index, term);
+            entry->data.append(log_data(region_id, index, term));
+            entries.push_back(entry);
+        }
+        EXPECT_EQ((int)entries.size(), storage->append_entries(entries, nullptr));
+        for (auto entry : entries) {
+            entry->Release();
+        }
+    }
+    void expect_storage(braft::LogStorage* storage, int64_t region_id,
+            int64_t first, int64_t last, const TermMap& terms) {
+        ASSERT_EQ(first, storage->first_log_index());
+        ASSERT_EQ(last, storage->last_log_index());
+        for (int64_t index = first; index <= last; ++index) {
+            int64_t term = term_of(terms, index);
+            EXPECT_EQ(term, storage->get_term(index));
+            braft::LogEntry* entry = storage->get_entry(index);
+            ASSERT_TRUE(entry != nullptr);
+            EXPECT_EQ(term, entry->id.term);
+            EXPECT_EQ(log_data(region_id, index, term), entry->data.to_string());
+            entry->Release();
+        }
+    }
+    // 按myraftlog的格式写入raft_log_cf
+    void put_rocksdb_log(int64_t region_id, int64_t first, int64_t last) {
+        RocksWrapper* rocksdb = RocksWrapper::get_instance();
+        MutTableKey meta_key;
+        meta_key.append_i64(region_id).append_u8(MyRaftLogStorage::LOG_META_IDENTIFY);
+        ASSERT_TRUE(rocksdb->put(rocksdb::WriteOptions(), rocksdb->get_raft_log_handle(),
+                meta_key.data(), rocksdb::Slice((char*)&first, sizeof(int64_t))).ok());
+        for (int64_t index = first; index <= last; ++index) {
+            MutTableKey key;
+            key.append_i64(region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY)
+                    .append_i64(index);
+            char head[MyRaftLogStorage::LOG_HEAD_SIZE];
+            LogHead(1, braft::ENTRY_TYPE_DATA).serialize_to(head);
+            std::string value(head, sizeof(head));
+            value += log_data(region_id, index, 1);
+            ASSERT_TRUE(rocksdb->put(rocksdb::WriteOptions(), rocksdb->get_raft_log_handle(),
+                    key.data(), value).ok());
+        }
+    }
+    bool has_rocksdb_log(int64_t region_id, int64_t index) {
+        RocksWrapper* rocksdb = RocksWrapper::get_instance();
+        MutTableKey key;
+        key.append_i64(region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY).append_i64(index);
+        std::string value;
+        return rocksdb->get(rocksdb::ReadOptions(), rocksdb->get_raft_log_handle(),
+                key.data(), &value).ok();
+    }
+    braft::ConfigurationManager _conf_manager;
+};
+
+TEST_F(SegmentLogEngineTest, torn_tail) {
+    append(1, 1, 10);
+    append(2, 1, 10);
+    append(3, 1, 5);
+    append(1, 11, 12);
+    // 最后一条只写了一半
+    std::string path = active_path();
+    ASSERT_EQ(0, truncate(path.c_str(), active_size() - 3));
+    restart();
+    expect_log(1, 1, 11);
+    expect_log(2, 1, 10);
+    expect_log(3, 1, 5);
+
+    // 截断后可以继续追加
+    append(1, 12, 12);
+    restart();
+    expect_log(1, 1, 12);
+
+    // 尾部是垃圾数据
+    path = active_path();
+    int fd = open(path.c_str(), O_WRONLY | O_APPEND);
+    ASSERT_GE(fd, 0);
+    std::string garbage(100, 'x');
+    ASSERT_EQ((ssize_t)garbage.size(), write(fd, garbage.data(), garbage.size()));
+    close(fd);
+    restart();
+    EXPECT_EQ(0u, boost::filesystem::file_size(path));
+    expect_log(1, 1, 12);
+    expect_log(2, 1, 10);
+    expect_log(3, 1, 5);
+}
+
+TEST_F(SegmentLogEngineTest, truncate_and_reset) {
+    braft::LogStorage* storage = open_storage(10);
+    ASSERT_TRUE(storage != nullptr);
+    // 其他region的写入交错在同一个segment中
+    append(11, 1, 10);
+    append_entries(storage, 10, 1, 20, 1);
+    append(11, 11, 20);
+    ASSERT_EQ(0, storage->truncate_suffix(15));
+    append_entries(storage, 10, 16, 18, 2);
+    ASSERT_EQ(0, storage->truncate_prefix(5));
+    TermMap terms = {{0, 1}, {16, 2}};
+    expect_storage(storage, 10, 5, 18, terms);
+    delete storage;
+    restart();
+    storage = open_storage(10);
+    ASSERT_TRUE(storage != nullptr);
+    expect_storage(storage, 10, 5, 18, terms);
+    expect_log(11, 1, 20);
+
+    // reset后从100开始
+    ASSERT_EQ(0, storage->reset(100));
+    EXPECT_EQ(100, storage->first_log_index());
+    EXPECT_EQ(99, storage->last_log_index());
+    append_entries(storage, 10, 100, 102, 3);
+    delete storage;
+    restart();
+    storage = open_storage(10);
+    ASSERT_TRUE(storage != nullptr);
+    expect_storage(storage, 10, 100, 102, {{0, 3}});
+    delete storage;
+}
+
+TEST_F(SegmentLogEngineTest, gc_rewrite_delete_oldest) {
+    FLAGS_raft_log_segment_max_size = 4096;
+    FLAGS_raft_log_segment_max_num = 3;
+    // region 20一直不做snapshot，region 22有truncate记录在最老的segment中
+    append(20, 1, 10);
+    append(22, 1, 5);
+    ASSERT_EQ(0, engine()->truncate_suffix(22, 3));
+    // region 21持续写入并truncate_prefix，只保留最后一批
+    for (int64_t round = 0; round < 60; ++round) {
+        append(21, round * 10 + 1, round * 10 + 10);
+        engine()->truncate_prefix(21, round * 10 + 1);
+    }
+    ASSERT_GT(segment_num(), 3u);
+    const int64_t oldest_id = oldest_segment_id();
+    std::string oldest_path = oldest_segment_path();
+    // 最老的segment被region 20、22占用，先重写再删除
+    gc_once();
+    EXPECT_EQ(oldest_id, oldest_segment_id());
+    gc_once();
+    EXPECT_GT(oldest_segment_id(), oldest_id);
+    EXPECT_FALSE(boost::filesystem::exists(oldest_path));
+    expect_log(20, 1, 10);
+    expect_log(22, 1, 3);
+    expect_log(21, 591, 600);
+
+    // 删除最老的segment后重放结果不变
+    restart();
+    expect_log(20, 1, 10);
+    expect_log(22, 1, 3);
+    expect_log(21, 591, 600);
+    // 重写后region仍可以正常追加和truncate
+    append(20, 11, 12);
+    ASSERT_EQ(0, engine()->truncate_suffix(22, 2));
+    restart();
+    expect_log(20, 1, 12);
+    expect_log(22, 1, 2);
+}
+
+TEST_F(SegmentLogEngineTest, interrupted_migration) {
+    put_rocksdb_log(30, 1, 10);
+    // 上次迁移写了一部分segment后重启，rocksdb中的日志还没删除
+    append(30, 1, 6, 9);
+    restart();
+    braft::LogStorage* storage = open_storage(30);
+    ASSERT_TRUE(storage != nullptr);
+    expect_storage(storage, 30, 1, 10, {{0, 1}});
+    EXPECT_FALSE(has_rocksdb_log(30, 1));
+    EXPECT_FALSE(has_rocksdb_log(30, 10));
+    append_entries(storage, 30, 11, 12, 2);
+    delete storage;
+
+    // 再次启动不会重复迁移
+    restart();
+    storage = open_storage(30);
+    ASSERT_TRUE(storage != nullptr);
+    expect_storage(storage, 30, 1, 12, {{0, 1}, {11, 2}});
+    delete storage;
+}
+
+}  // namespace baikaldb
@@ -0,0 +1,230 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <map>
+#include <mutex>
+#include <brpc/server.h>
+#include "select_manager_node.h"
+#include "network_socket.h"
+
+namespace baikaldb {
+DECLARE_bool(select_arrow_result);
+DECLARE_int32(single_store_concurrency);
+
+static const int REGION_CNT = 10;
+static const int REGION_ROWS = 9;
+static const int CHUNK_ROWS = 2;
+
+static void init_desc(MemRowDescriptor* desc) {
+    std::vector<pb::TupleDescriptor> tuple_desc;
+    pb::TupleDescriptor tuple;
+    tuple.set_tuple_id(0);
+    tuple.set_table_id(1);
+    pb::SlotDescriptor* slot = tuple.add_slots();
+    slot->set_slot_id(1);
+    slot->set_slot_type(pb::INT64);
+    slot->set_tuple_id(0);
+    tuple_desc.push_back(tuple);
+    desc->init(tuple_desc);
+}
+
+// region r的第k行为r + k * REGION_CNT，各region内有序，region之间交错
+static int64_t row_value(int64_t region_id, int pos) {
+    return region_id + pos * REGION_CNT;
+}
+
+// 模拟store上的游标，每块返回CHUNK_ROWS行
+class MockStoreService : public pb::StoreService {
+public:
+    MockStoreService() {
+        init_desc(&desc);
+    }
+    virtual void query(google::protobuf::RpcController* controller,
+            const pb::StoreReq* request,
+            pb::StoreRes* response,
+            google::protobuf::Closure* done) {
+        brpc::ClosureGuard done_guard(done);
+        std::lock_guard<std::mutex> lock(mutex);
+        ++request_cnt;
+        auto iter = cursors.find(request->cursor_id());
+        if (iter == cursors.end()) {
+            response->set_errcode(pb::EXEC_FAIL);
+            return;
+        }
+        int64_t region_id = iter->second.first;
+        int pos = iter->second.second;
+        cursors.erase(iter);
+        response->set_errcode(pb::SUCCESS);
+        if (request->close_cursor()) {
+            return;
+        }
+        response->add_tuple_ids(0);
+        for (int i = 0; i < CHUNK_ROWS && pos < REGION_ROWS; i++, pos++) {
+            std::unique_ptr<MemRow> row = desc.fetch_mem_row();
+            ExprValue value(pb::INT64);
+            value._u.int64_val = row_value(region_id, pos);
+            row->set_value(0, 1, value);
+            row->to_string(0, response->add_row_values()->add_tuple_values());
+        }
+        if (pos < REGION_ROWS) {
+            uint64_t cursor_id = ++next_id;
+            cursors[cursor_id] = std::make_pair(region_id, pos);
+            response->set_cursor_id(cursor_id);
+        }
+    }
+    MemRowDescriptor desc;
+    std::mutex mutex;
+    std::map<uint64_t, std::pair<int64_t, int>> cursors; // cursor_id -> (region_id, 下一行)
+    int request_cnt = 0;
+    uint64_t next_id = 0;
+};
+
+static MockStoreService g_service;
+static std::string g_addr;
+
+class SelectManagerNodeTest : public testing::Test {
+protected:
+    void SetUp() override {
+        init_desc(_state.mem_row_desc());
+        _state.set_client_conn(&_sock);
+        pb::Expr slot_expr;
+        pb::ExprNode* node = slot_expr.add_nodes();
+        node->set_node_type(pb::SLOT_REF);
+        node->set_col_type(pb::INT64);
+        node->set_num_children(0);
+        node->mutable_derive_node()->set_tuple_id(0);
+        node->mutable_derive_node()->set_slot_id(1);
+        ExprNode* slot_ref = nullptr;
+        ASSERT_EQ(0, ExprNode::create_tree(slot_expr, &slot_ref));
+        _node._slot_order_exprs.push_back(slot_ref);
+        _node._is_asc.push_back(true);
+        _node._is_null_first.push_back(false);
+        _node._mem_row_compare = std::make_shared<MemRowCompare>(
+                _node._slot_order_exprs, _node._is_asc, _node._is_null_first);
+        // 首块随首次请求返回，剩余部分由游标续读
+        FetcherStore& fetcher = _node._fetcher_store;
+        for (int64_t region_id = 1; region_id <= REGION_CNT; region_id++) {
+            std::shared_ptr<RowBatch> batch = std::make_shared<RowBatch>();
+            for (int pos = 0; pos < CHUNK_ROWS; pos++) {
+                std::unique_ptr<MemRow> row = _state.mem_row_desc()->fetch_mem_row();
+                ExprValue value(pb::INT64);
+                value._u.int64_val = row_value(region_id, pos);
+                row->set_value(0, 1, value);
+                batch->move_row(std::move(row));
+            }
+            fetcher.region_batch[region_id] = batch;
+            fetcher.start_key_sort.emplace(std::string(1, 'a' + region_id), region_id);
+            std::shared_ptr<StoreCursor> cursor = std::make_shared<StoreCursor>();
+            cursor->info.set_region_id(region_id);
+            cursor->addr = g_addr;
+            cursor->cursor_id = 1000 + region_id;
+            fetcher.region_cursors[region_id] = cursor;
+            std::lock_guard<std::mutex> lock(g_service.mutex);
+            g_service.cursors[cursor->cursor_id] = std::make_pair(region_id, CHUNK_ROWS);
+        }
+        std::lock_guard<std::mutex> lock(g_service.mutex);
+        g_service.request_cnt = 0;
+    }
+    void TearDown() override {
+        _node._fetcher_store.close_cursors(&_state);
+        for (auto expr : _node._slot_order_exprs) {
+            ExprNode::destroy_tree(expr);
+        }
+        _node._slot_order_exprs.clear();
+        std::lock_guard<std::mutex> lock(g_service.mutex);
+        g_service.cursors.clear();
+    }
+    int open_merging() {
+        return _node.open_merging(&_state);
+    }
+    int get_next_merging(RowBatch* batch, bool* eos) {
+        return _node.get_next_merging(&_state, batch, eos);
+    }
+    void set_limit(int64_t limit) {
+        _node.set_limit(limit);
+    }
+    void close_cursors() {
+        _node._fetcher_store.close_cursors(&_state);
+    }
+    int in_flight() {
+        return _node._fetcher_store.cursor_in_flight;
+    }
+    NetworkSocket _sock;
+    RuntimeState _state;
+    SelectManagerNode _node;
+};
+
+TEST_F(SelectManagerNodeTest, merge_order) {
+    FLAGS_single_store_concurrency = 3;
+    ASSERT_EQ(0, open_merging());
+    // 只预取窗口内的region
+    EXPECT_EQ(3, in_flight());
+    std::vector<int64_t> values;
+    bool eos = false;
+    while (!eos) {
+        RowBatch batch;
+        ASSERT_EQ(0, get_next_merging(&batch, &eos));
+        for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
+            values.push_back(batch.get_row()->get_value(0, 1).get_numberic<int64_t>());
+        }
+        EXPECT_LE(in_flight(), 3);
+    }
+    // 全局有序，且每行只输出一次
+    ASSERT_EQ((size_t)REGION_CNT * REGION_ROWS, values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        EXPECT_EQ((int64_t)i + 1, values[i]);
+    }
+    EXPECT_TRUE(g_service.cursors.empty());
+    FLAGS_single_store_concurrency = 20;
+}
+
+TEST_F(SelectManagerNodeTest, merge_limit) {
+    FLAGS_single_store_concurrency = 3;
+    set_limit(15);
+    ASSERT_EQ(0, open_merging());
+    RowBatch batch;
+    bool eos = false;
+    ASSERT_EQ(0, get_next_merging(&batch, &eos));
+    ASSERT_EQ(15u, batch.size());
+    int64_t expect = 1;
+    for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
+        EXPECT_EQ(expect++, batch.get_row()->get_value(0, 1).get_numberic<int64_t>());
+    }
+    // 满足limit后不再续读，剩余游标在close时释放
+    int request_cnt = g_service.request_cnt;
+    EXPECT_LT(request_cnt, REGION_CNT * 2);
+    close_cursors();
+    EXPECT_TRUE(g_service.cursors.empty());
+    FLAGS_single_store_concurrency = 20;
+}
+
+}  // namespace baikaldb
+
+int main(int argc, char* argv[]) {
+    testing::InitGoogleTest(&argc, argv);
+    baikaldb::FLAGS_select_arrow_result = false;
+    brpc::Server server;
+    if (server.AddService(&baikaldb::g_service, brpc::SERVER_DOESNT_OWN_SERVICE) != 0) {
+        return -1;
+    }
+    if (server.Start("127.0.0.1:0", NULL) != 0) {
+        return -1;
+    }
+    baikaldb::g_addr = butil::endpoint2str(server.listen_address()).c_str();
+    int ret = RUN_ALL_TESTS();
+    server.Stop(0);
+    server.Join();
+    return ret;
+}